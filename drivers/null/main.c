@@ -0,0 +1,416 @@
+/* Main source file for Hexlet's headless null driver (for benchmarks and automated runs) */
+
+#if defined(__unix__) || defined(__APPLE__)
+#define _DEFAULT_SOURCE	/* for clock_gettime() */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+#include <hexlet_assembler.h>
+#include <hexlet_driver.h>
+#include <hexlet_emulate.h>
+#include <hexlet_graphics.h>
+#include <hexlet_loader.h>
+#include <hexlet_memory.h>
+#include <hexlet_version.h>
+
+/* The framebuffer covers every coordinate the driver can be given, packed like a gfx_Bitmap */
+#define drv_FRAMEBUFFER_WIDTH 256
+#define drv_FRAMEBUFFER_HEIGHT 256
+
+#define drv_DEFAULT_FRAMES 600
+
+/* The assembler benchmark's smallest and largest sources, in labels (each size is double the last) */
+#define drv_MIN_BENCHMARK_LABELS 1000
+#define drv_MAX_BENCHMARK_LABELS 16000
+
+static u8 drv_framebuffer[drv_FRAMEBUFFER_HEIGHT][drv_FRAMEBUFFER_WIDTH / 2];
+static u8 drv_backlight[3];
+static u8 drv_sevenSegments[8];
+
+/* Various command line arguments */
+static u32 drv_frames = drv_DEFAULT_FRAMES;
+static bool drv_monitored = FALSE;
+static bool drv_jitEnabled = TRUE;
+static bool drv_jitRequired = FALSE;
+static bool drv_compareJIT = FALSE;
+static bool drv_benchmarkAssembler = FALSE;
+static char *drv_romPath;
+static size_t drv_memoryUsage;
+
+void *drv_reallocate(void *oldPtr, size_t oldSize, size_t newSize) {
+	if (oldPtr == NULL) {
+		void *newPtr = malloc(newSize);
+		if (newPtr != NULL) {
+			drv_memoryUsage += newSize;
+		}
+		return newPtr;
+	}
+	else if (newSize == 0) {
+		free(oldPtr);
+		drv_memoryUsage -= oldSize;
+		return NULL;
+	}
+	else {
+		void *newPtr = realloc(oldPtr, newSize);
+		if (newPtr != NULL) {
+			drv_memoryUsage -= oldSize;
+			drv_memoryUsage += newSize;
+		}
+		else {
+			drv_memoryUsage -= oldSize;
+			free(oldPtr);
+		}
+		return newPtr;
+	}
+}
+
+bool drv_plotPix(u8 x, u8 y, u8 intensity) {
+	u8 *byte = &drv_framebuffer[y][x / 2];
+	intensity &= 0x0f;
+	
+	*byte = (x & 1) ? (*byte & 0xf0) | intensity : (*byte & 0x0f) | (intensity << 4);
+	return TRUE;
+}
+
+bool drv_copyRect(gfx_Rect *rect) {
+	u32 width = (rect->xPos + rect->width > drv_FRAMEBUFFER_WIDTH) ? drv_FRAMEBUFFER_WIDTH - rect->xPos : rect->width;
+	u32 height = (rect->yPos + rect->height > drv_FRAMEBUFFER_HEIGHT) ? drv_FRAMEBUFFER_HEIGHT - rect->yPos : rect->height;
+	
+	if (rect->hasPixels && rect->data.bitmap.data == NULL) {
+		return FALSE;
+	}
+	
+	for (u32 row = 0; row < height; row++) {
+		for (u32 column = 0; column < width; column++) {
+			u8 intensity = rect->data.color;
+			
+			if (rect->hasPixels) {
+				u32 pixel = row * rect->data.bitmap.width + column;
+				u8 byte = rect->data.bitmap.data[pixel / 2];
+				intensity = (pixel & 1) ? byte & 0x0f : byte >> 4;
+			}
+			drv_plotPix((u8)(rect->xPos + column), (u8)(rect->yPos + row), intensity);
+		}
+	}
+	
+	return TRUE;
+}
+
+bool drv_setBacklight(u8 r, u8 g, u8 b) {
+	drv_backlight[0] = r;
+	drv_backlight[1] = g;
+	drv_backlight[2] = b;
+	
+	return TRUE;
+}
+
+bool drv_setSevenSegment(gfx_SevenSegmentIndexMask indexMask, gfx_SevenSegmentMask segmentMask) {
+	for (u8 i = 0; i < 8; i++) {
+		if (indexMask & (1 << i)) drv_sevenSegments[i] = segmentMask;
+	}
+	
+	return TRUE;
+}
+
+/* What --compare-jit saves from each run: the CPU, and the RAM it worked on */
+#define drv_CPU_STATE ldr_STATE_FILE_FLAG_STORE_CPU
+#define drv_RAM_STATE (ldr_STATE_FILE_FLAG_STORE_WRAM | ldr_STATE_FILE_FLAG_STORE_VRAM | ldr_STATE_FILE_FLAG_STORE_TMRAM | ldr_STATE_FILE_FLAG_STORE_HRAM)
+
+/*
+*  The ROM run when none is given: an ALU-heavy block the recompiler can take, then a block that stores into WRAM, over and over.
+*  Without it, the console would run from empty memory, which reads as NOPs up to an idle loop and measures nothing.
+*/
+static const u16 drv_workload[] = {
+	0x1000 | (0x00 << 6) | 0x03,		/* MOV W0, #0 */
+	0x1000 | (0x04 << 6) | 0x21, 0x1234,	/* MOV W1, #$1234 */
+	0x1000 | (0x08 << 6) | 0x21, 0x0100,	/* MOV W2, #$0100 */
+	0x2000 | (0x00 << 6) | 0x04,		/* loop: ADD W0, W1 */
+	0x7000 | (0x04 << 6) | 0x00,		/* XOR W1, W0 */
+	0x2000 | (0x04 << 6) | 0x21, 0x9e37,	/* ADD W1, #$9E37 */
+	0x3000 | (0x0c << 6) | 0x04,		/* SUB W3, W1 */
+	0x5000 | (0x00 << 6) | 0x21, 0x7fff,	/* AND W0, #$7FFF */
+	0x6000 | (0x0c << 6) | 0x21, 0x0100,	/* OR W3, #$0100 */
+	0x4000 | (0x00 << 6) | 0x0c,		/* CMP W0, W3 */
+	0x8100 | 0x31, 0x0004,			/* BCC skip */
+	0x7000 | (0x0c << 6) | 0x04,		/* XOR W3, W1 */
+	0x1000 | (0x28 << 6) | 0x00,		/* skip: MOV @P2+, W0 */
+	0x5000 | (0x08 << 6) | 0x21, 0x3ffe,	/* AND W2, #$3FFE */
+	0x8000 | 0x31, (u16)((5 - 22) * 2),	/* BRA loop */
+};
+
+#define drv_WORKLOAD_WORDS (sizeof(drv_workload) / sizeof(u16))
+
+/*
+*  Seconds from a monotonic clock (clock() counts CPU time, so it would miss anything the emulator waits on).
+*/
+static double drv_getSeconds(void) {
+#if defined(__unix__) || defined(__APPLE__)
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+#else
+	return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+/*
+*  Assemble the built-in workload and load it. Return FALSE on failure or TRUE on success.
+*/
+static bool drv_loadWorkload(void) {
+	/* the assembler can't place RM operands yet, so the code goes in a byte at a time (which still gets it a header and a CRC) */
+	char source[80 + drv_WORKLOAD_WORDS * 2 * 9];
+	char *ptr = source + sprintf(source, ".HXH_TITLE \"Null Driver Workload\"\n.HXH_AUTHOR \"Hexlet\"\n");
+	
+	for (u32 i = 0; i < drv_WORKLOAD_WORDS; i++) {
+		ptr += sprintf(ptr, ".DB $%02X\n.DB $%02X\n", drv_workload[i] & 0xff, drv_workload[i] >> 8);
+	}
+	
+	u32 length;
+	u8 *image = asm_assembleToROMImage(source) ? asm_getROMImage(&length) : NULL;
+	
+	if (image == NULL) {
+		fprintf(stderr, "Error: The built-in workload didn't assemble:\n%s", asm_getError());
+		return FALSE;
+	}
+	
+	if (!ldr_loadROMImage(image, length)) {
+		fprintf(stderr, "%s\n", ldr_getError());
+		return FALSE;
+	}
+	
+	return TRUE;
+}
+
+/*
+*  Run the given number of frames from wherever the emulator is, as fast as possible, and print how fast they went.
+*  Return the frames per second, or a negative number on failure.
+*/
+static double drv_runFrames(u32 frames, char *label) {
+	u64 startCycles = emu_getCycles();
+	u64 startSkipped = emu_getSkippedCycles();
+	
+	double start = drv_getSeconds();
+	for (u32 frame = 0; frame < frames; frame++) {
+		if (!emu_tick()) {
+			fprintf(stderr, "Error: Frame %u failed.\n", frame);
+			return -1.0;
+		}
+	}
+	double seconds = drv_getSeconds() - start;
+	if (seconds <= 0.0) seconds = 1e-9;
+	
+	double framesPerSecond = frames / seconds;
+	u64 cycles = emu_getCycles() - startCycles;
+	u64 skipped = emu_getSkippedCycles() - startSkipped;
+	
+	printf("%-12s %u frames in %.3f s: %.1f frames/s, %.1f MHz emulated (%.1f%% of the cycles skipped while idle)\n",
+		label, frames, seconds, framesPerSecond, cycles / seconds / 1e6,
+		cycles ? 100.0 * skipped / cycles : 0.0
+	);
+	
+	return framesPerSecond;
+}
+
+/*
+*  Run the same frames from the same state with the recompiler and then with the interpreter, and compare where they end up.
+*  Return FALSE if they differ (or something failed) or TRUE if they match.
+*/
+static bool drv_compareJITRuns(u32 frames) {
+	if (!emu_reset() || !emu_setJITEnabled(TRUE)) {
+		fprintf(stderr, "Error: This build has no recompiler to compare.\n");
+		return FALSE;
+	}
+	
+	u32 size = ldr_getStateSize(drv_CPU_STATE | drv_RAM_STATE);
+	u8 *states = malloc((size_t)size * 5);
+	if (states == NULL) return FALSE;
+	
+	u8 *start = states;
+	u8 *jitCPU = states + size;
+	u8 *jitRAM = states + size * 2;
+	u8 *interpretedCPU = states + size * 3;
+	u8 *interpretedRAM = states + size * 4;
+	bool passed = FALSE;
+	
+	if (!ldr_saveState(start, size, drv_CPU_STATE | drv_RAM_STATE)) goto done;
+	
+	double jit = drv_runFrames(frames, "recompiler");
+	if (jit < 0.0 || !ldr_saveState(jitCPU, size, drv_CPU_STATE) || !ldr_saveState(jitRAM, size, drv_RAM_STATE)) goto done;
+	
+	/* the state doesn't hold the scheduler, so the second run starts from a reset too */
+	if (!emu_setJITEnabled(FALSE) || !emu_reset() || !ldr_loadState(start, size)) goto done;
+	
+	double interpreted = drv_runFrames(frames, "interpreter");
+	if (interpreted < 0.0 || !ldr_saveState(interpretedCPU, size, drv_CPU_STATE) || !ldr_saveState(interpretedRAM, size, drv_RAM_STATE)) goto done;
+	
+	/* the headers are the same in both, so whole states can be compared */
+	bool cpuMatches = !memcmp(jitCPU, interpretedCPU, ldr_getStateSize(drv_CPU_STATE));
+	bool ramMatches = !memcmp(jitRAM, interpretedRAM, ldr_getStateSize(drv_RAM_STATE));
+	passed = cpuMatches && ramMatches;
+	
+	printf("CPU state (registers, status register, PC and cycles) %s, RAM %s.\n", cpuMatches ? "matches" : "DIFFERS", ramMatches ? "matches" : "DIFFERS");
+	printf("The recompiler runs %.2fx as fast as the interpreter.\n", jit / interpreted);
+	
+done:
+	if (!passed && ldr_getError()[0] != '\0') fprintf(stderr, "%s\n", ldr_getError());
+	free(states);
+	return passed;
+}
+
+/*
+*  Assemble generated sources of more and more labels, .DEFINEs and references, and print how long each took.
+*  The time per label should stay about the same as the sources grow. Return FALSE on failure or TRUE on success.
+*/
+static bool drv_runAssemblerBenchmark(void) {
+	for (u32 labels = drv_MIN_BENCHMARK_LABELS; labels <= drv_MAX_BENCHMARK_LABELS; labels *= 2) {
+		char *source = malloc((size_t)labels * 80);
+		char *ptr = source;
+		if (source == NULL) return FALSE;
+		
+		/* each label is 3 bytes of code, and refers to a .DEFINE from all over the source (about half of them later on) */
+		for (u32 i = 0; i < labels; i++) {
+			ptr += sprintf(ptr, "label%05u:\nNOP\n.DB const%05u\n.DEFINE const%05u $12\n", i, (i * 7919) % labels, i);
+		}
+		
+		double start = drv_getSeconds();
+		bool assembled = asm_assembleToROMImage(source);
+		double seconds = drv_getSeconds() - start;
+		free(source);
+		
+		if (!assembled) {
+			fprintf(stderr, "Error: The benchmark source didn't assemble:\n%s", asm_getError());
+			return FALSE;
+		}
+		
+		printf("%6u labels: %8.2f ms (%.0f ns per label)\n", labels, seconds * 1e3, seconds * 1e9 / labels);
+	}
+	
+	return TRUE;
+}
+
+/*
+*  Return a negative number on failure, 0 for an immediate exit, and a positive number on success.
+*/
+static s32 drv_parseArgs(s32 argc, char **argv) {
+	bool parseFrames = FALSE;
+	
+	for (s32 c = 1; c < argc; c++) {
+		char *arg = argv[c];
+		
+		if (parseFrames) {
+			char *end;
+			unsigned long frames = strtoul(arg, &end, 0);
+			if (*end != '\0' || frames == 0 || frames > 0xffffffff) {
+				fprintf(stderr, "Error: Invalid frame count.\n");
+				return -1;
+			}
+			
+			drv_frames = (u32)frames;
+			parseFrames = FALSE;
+			continue;
+		}
+		
+		if (!strcmp(arg, "--help") || !strcmp(arg, "-h")) {
+			char versionNum[16];
+			
+			printf("Hexlet v%s (headless)\n\n", ver_getVersionString(versionNum, ver_getLatestVersion()));
+			printf("Usage: hexlet [options] [ROM image]\n\n");
+			printf("Runs frames as fast as possible with no display or input, and prints how fast they went.\n");
+			printf("With no ROM image, a built-in workload runs (ALU-heavy code and stores into WRAM).\n\n");
+			printf("  %-20s %s\n", "--help, -h", "Display this message and exit");
+			printf("  %-20s %s\n", "--frames <count>", "Run this many frames (the default is 600)");
+			printf("  %-20s %s\n", "--monitor", "Monitor every bus while running");
+			printf("  %-20s %s\n", "--jit", "Run with the dynamic recompiler (the default when it's built in)");
+			printf("  %-20s %s\n", "--no-jit", "Run with the interpreter only");
+			printf("  %-20s %s\n", "--compare-jit", "Run the frames with the recompiler and then the interpreter, and check they end the same");
+			printf("  %-20s %s\n", "--bench-asm", "Time the assembler on larger and larger generated sources and exit");
+			
+			return 0;
+		}
+		else if (!strcmp(arg, "--frames")) {
+			parseFrames = TRUE;
+		}
+		else if (!strcmp(arg, "--monitor")) {
+			drv_monitored = TRUE;
+		}
+		else if (!strcmp(arg, "--jit")) {
+			drv_jitEnabled = TRUE;
+			drv_jitRequired = TRUE;
+		}
+		else if (!strcmp(arg, "--no-jit")) {
+			drv_jitEnabled = FALSE;
+			drv_jitRequired = FALSE;
+		}
+		else if (!strcmp(arg, "--compare-jit")) {
+			drv_compareJIT = TRUE;
+		}
+		else if (!strcmp(arg, "--bench-asm")) {
+			drv_benchmarkAssembler = TRUE;
+		}
+		else if (arg[0] == '-') {
+			fprintf(stderr, "Error: Unknown option '%s'.\n", arg);
+			return -1;
+		}
+		else {
+			drv_romPath = arg;
+		}
+	}
+	
+	if (parseFrames) {
+		fprintf(stderr, "Error: --frames needs a frame count.\n");
+		return -1;
+	}
+	
+	return 1;
+}
+
+int main(int argc, char **argv) {
+	s32 exitCode = drv_parseArgs((s32)argc, argv);
+	if (exitCode <= 0) return exitCode;
+	
+	if (drv_benchmarkAssembler) {
+		return drv_runAssemblerBenchmark() ? 0 : -1;
+	}
+	
+	if (drv_romPath != NULL) {
+		if (!ldr_loadROMFile(drv_romPath)) {
+			fprintf(stderr, "%s\n", ldr_getError());
+			return -1;
+		}
+	}
+	else if (!drv_loadWorkload()) {
+		return -1;
+	}
+	
+	mem_monitorBuses(drv_monitored ? mem_BUS_TYPE_CPU | mem_BUS_TYPE_PPU | mem_BUS_TYPE_HEXRIDGE : 0);
+	
+	if (drv_compareJIT) {
+		exitCode = drv_compareJITRuns(drv_frames) ? 0 : -1;
+	}
+	else if (!emu_reset()) {
+		fprintf(stderr, "Error: Couldn't reset the emulator.\n");
+		exitCode = -1;
+	}
+	else {
+		/* without --jit, a build with no recompiler just runs the interpreter */
+		bool jit = drv_jitEnabled && emu_setJITEnabled(TRUE);
+		if (!jit) emu_setJITEnabled(FALSE);
+		
+		if (drv_jitRequired && !jit) {
+			fprintf(stderr, "Error: This build has no recompiler.\n");
+			exitCode = -1;
+		}
+		else {
+			exitCode = drv_runFrames(drv_frames, jit ? "recompiler" : "interpreter") < 0.0 ? -1 : 0;
+		}
+	}
+	
+	ldr_closeROMFile();
+	return exitCode;
+}
\ No newline at end of file
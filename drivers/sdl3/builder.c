@@ -0,0 +1,245 @@
+/* Source file for Hexlet's SDL3 ROM builder */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <SDL3/SDL.h>
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+#include <hexlet_assembler.h>
+
+#include "builder.h"
+#include "logger.h"
+
+typedef struct {
+	char *path;
+	char *objectPath;
+	
+	asm_Object *object;	/* NULL if the source couldn't be read */
+	bool assembled;	/* FALSE if the object came from an up-to-date object file */
+} bld_Source;
+
+/* The sources a build has to assemble, shared by its threads */
+typedef struct {
+	bld_Source *sources;
+	u32 count;
+	SDL_AtomicInt next;
+} bld_BuildJob;
+
+/*
+*  Load a source's object file, or return NULL if there isn't one or it's older than any of the files the object was assembled from.
+*/
+static asm_Object *bld_loadObjectFile(bld_Source *source) {
+	SDL_PathInfo info;
+	if (!SDL_GetPathInfo(source->objectPath, &info) || info.type != SDL_PATHTYPE_FILE) {
+		return NULL;
+	}
+	
+	SDL_Time objectTime = info.modify_time;
+	size_t size;
+	u8 *data = SDL_LoadFile(source->objectPath, &size);
+	if (data == NULL) return NULL;
+	
+	asm_Object *object = size <= 0xffffffff ? asm_loadObject(data, (u32)size) : NULL;
+	SDL_free(data);
+	if (object == NULL) return NULL;
+	
+	/* the source and everything it included, as of when it was assembled */
+	for (u32 i = 0; i < asm_getObjectSourceCount(object); i++) {
+		const char *path = asm_getObjectSource(object, i);
+		
+		if (path == NULL || !SDL_GetPathInfo(path, &info) || info.modify_time > objectTime) {
+			asm_freeObject(object);
+			return NULL;
+		}
+	}
+	
+	return object;
+}
+
+/*
+*  Write a source's object file, so the next build can skip it. The build still works if it can't be written, it'll just be slower next time.
+*/
+static bool bld_writeObjectFile(bld_Source *source) {
+	u32 size = asm_getObjectSize(source->object);
+	if (size == 0) return FALSE;
+	
+	u8 *data = SDL_malloc(size);
+	if (data == NULL) return FALSE;
+	
+	char *tempPath;
+	if (!asm_saveObject(source->object, data, size) || SDL_asprintf(&tempPath, "%s.tmp", source->objectPath) < 0) {
+		SDL_free(data);
+		return FALSE;
+	}
+	
+	SDL_IOStream *file = SDL_IOFromFile(tempPath, "wb");
+	bool success = file != NULL;
+	
+	if (file != NULL) {
+		bool written = SDL_WriteIO(file, data, size) == size;
+		bool closed = SDL_CloseIO(file);
+		success = written && closed && SDL_RenamePath(tempPath, source->objectPath);
+		
+		if (!success) SDL_RemovePath(tempPath);
+	}
+	
+	SDL_free(tempPath);
+	SDL_free(data);
+	
+	return success;
+}
+
+/*
+*  Get one source's object, assembling it if its object file is out of date. Every thread of a build runs this on different sources.
+*/
+static void bld_buildSource(bld_Source *source) {
+	source->object = bld_loadObjectFile(source);
+	source->assembled = FALSE;
+	if (source->object != NULL) return;
+	
+	/* SDL_LoadFile() null-terminates what it reads, so it can be assembled as it is */
+	char *text = SDL_LoadFile(source->path, NULL);
+	if (text == NULL) return;
+	
+	source->object = asm_assembleObject(text, source->path);
+	source->assembled = TRUE;
+	SDL_free(text);
+	
+	if (source->object != NULL) {
+		bld_writeObjectFile(source);
+	}
+}
+
+static int bld_buildThread(void *data) {
+	bld_BuildJob *job = data;
+	s32 next;
+	
+	while ((next = SDL_AddAtomicInt(&job->next, 1)) < (s32)job->count) {
+		bld_buildSource(&job->sources[next]);
+	}
+	
+	return 0;
+}
+
+/*
+*  Build every source, split between this thread and as many more as there are cores to run them.
+*/
+static void bld_buildSources(bld_Source *sources, u32 count) {
+	bld_BuildJob job;
+	job.sources = sources;
+	job.count = count;
+	SDL_SetAtomicInt(&job.next, 0);
+	
+	/* every source is a big job, so there's no point in more threads than sources */
+	s32 threadCount = SDL_GetNumLogicalCPUCores() - 1;
+	if (threadCount > bld_MAX_THREADS) threadCount = bld_MAX_THREADS;
+	if (threadCount > (s32)count - 1) threadCount = (s32)count - 1;
+	
+	SDL_Thread *threads[bld_MAX_THREADS];
+	for (s32 i = 0; i < threadCount; i++) {
+		threads[i] = SDL_CreateThread(bld_buildThread, "hexlet builder", &job);
+	}
+	
+	bld_buildThread(&job);
+	
+	for (s32 i = 0; i < threadCount; i++) {
+		if (threads[i] != NULL) SDL_WaitThread(threads[i], NULL);
+	}
+}
+
+/*
+*  Link the sources' objects and write the ROM image. Return FALSE on failure or TRUE on success.
+*/
+static bool bld_linkSources(char *imagePath, bld_Source *sources, u32 count) {
+	char message[1024];
+	
+	asm_Object **objects = SDL_malloc(count * sizeof(asm_Object *));
+	if (objects == NULL) {
+		log_printError("Out of memory for the objects to link.");
+		return FALSE;
+	}
+	
+	for (u32 i = 0; i < count; i++) {
+		objects[i] = sources[i].object;
+	}
+	
+	bool linked = asm_linkObjects(objects, count);
+	SDL_free(objects);
+	
+	/* the diagnostics come from every object as well as the linker, so they're printed even if it worked */
+	printf("%s", asm_getError());
+	
+	if (!linked) {
+		log_printError("The ROM image couldn't be built.");
+		return FALSE;
+	}
+	
+	u32 length;
+	u8 *image = asm_getROMImage(&length);
+	SDL_IOStream *file = SDL_IOFromFile(imagePath, "wb");
+	
+	bool written = file != NULL && SDL_WriteIO(file, image, length) == length;
+	if (file != NULL && !SDL_CloseIO(file)) written = FALSE;
+	
+	if (!written) {
+		snprintf(message, sizeof(message), "Couldn't write the ROM image to '%s'.", imagePath);
+		log_printError(message);
+		return FALSE;
+	}
+	
+	return TRUE;
+}
+
+bool bld_buildROM(char *imagePath, char **sourcePaths, u32 sourceCount, u32 *assembledCount) {
+	char message[1024];
+	bool built = TRUE;
+	
+	*assembledCount = 0;
+	
+	bld_Source *sources = SDL_malloc((sourceCount ? sourceCount : 1) * sizeof(bld_Source));
+	if (sources == NULL) {
+		log_printError("Out of memory for the sources.");
+		return FALSE;
+	}
+	
+	memset(sources, 0, sourceCount * sizeof(bld_Source));
+	
+	for (u32 i = 0; i < sourceCount; i++) {
+		sources[i].path = sourcePaths[i];
+		if (SDL_asprintf(&sources[i].objectPath, "%s%s", sourcePaths[i], bld_OBJECT_EXTENSION) < 0) {
+			sources[i].objectPath = NULL;
+			built = FALSE;
+		}
+	}
+	
+	if (!built) {
+		log_printError("Out of memory for the object file paths.");
+	}
+	else {
+		bld_buildSources(sources, sourceCount);
+		
+		for (u32 i = 0; i < sourceCount; i++) {
+			if (sources[i].assembled) (*assembledCount)++;
+			
+			if (sources[i].object == NULL) {
+				snprintf(message, sizeof(message), "Couldn't read or assemble the source file '%s'.", sources[i].path);
+				log_printError(message);
+				built = FALSE;
+			}
+		}
+		
+		if (built) {
+			built = bld_linkSources(imagePath, sources, sourceCount);
+		}
+	}
+	
+	for (u32 i = 0; i < sourceCount; i++) {
+		asm_freeObject(sources[i].object);
+		SDL_free(sources[i].objectPath);
+	}
+	
+	SDL_free(sources);
+	return built;
+}
\ No newline at end of file
@@ -0,0 +1,22 @@
+/* Header file for Hexlet's SDL3 ROM builder */
+
+#ifndef HEXLET_BLD_H
+#define HEXLET_BLD_H
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+
+/* The extension added to a source's path for its object file, which is kept next to it for the next build */
+#define bld_OBJECT_EXTENSION ".hxo"
+
+/* The most threads a build uses (besides the one that called it) */
+#define bld_MAX_THREADS 16
+
+/*
+*  Assemble each source file into an object on a pool of threads, then link them in the order given and write the ROM image to imagePath.
+*  A source isn't assembled again if its object file is at least as new as it and every file it includes.
+*  Print the diagnostics, and put how many sources had to be assembled in assembledCount. Return FALSE on failure or TRUE on success.
+*/
+bool bld_buildROM(char *imagePath, char **sourcePaths, u32 sourceCount, u32 *assembledCount);
+
+#endif
\ No newline at end of file
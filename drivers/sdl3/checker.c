@@ -0,0 +1,57 @@
+/* Source file for Hexlet's SDL3 background ROM checker */
+
+#include <SDL3/SDL.h>
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+#include <hexlet_loader.h>
+
+#include "checker.h"
+#include "logger.h"
+
+static SDL_Thread *chk_thread;
+static SDL_AtomicInt chk_status;
+
+/* Only touched on the thread that polls, since the logger isn't thread-safe */
+static bool chk_resultLogged;
+
+static int chk_checkThread(void *data) {
+	bool good = ldr_verifyROM();
+	SDL_SetAtomicInt(&chk_status, good ? chk_STATUS_GOOD : chk_STATUS_BAD);
+	return 0;
+}
+
+bool chk_startChecking(void) {
+	chk_stopChecking();
+	
+	SDL_SetAtomicInt(&chk_status, chk_STATUS_CHECKING);
+	chk_resultLogged = FALSE;
+	chk_thread = SDL_CreateThread(chk_checkThread, "hexlet checker", NULL);
+	
+	if (chk_thread == NULL) {
+		SDL_SetAtomicInt(&chk_status, chk_STATUS_IDLE);
+		return FALSE;
+	}
+	
+	return TRUE;
+}
+
+chk_Status chk_stopChecking(void) {
+	if (chk_thread != NULL) {
+		SDL_WaitThread(chk_thread, NULL);
+		chk_thread = NULL;
+	}
+	
+	return chk_pollCheck();
+}
+
+chk_Status chk_pollCheck(void) {
+	chk_Status status = (chk_Status)SDL_GetAtomicInt(&chk_status);
+	
+	if (status == chk_STATUS_BAD && !chk_resultLogged) {
+		log_printError("The ROM's checksum doesn't match its header, so it may be corrupt.");
+		chk_resultLogged = TRUE;
+	}
+	
+	return status;
+}
\ No newline at end of file
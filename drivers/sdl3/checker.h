@@ -0,0 +1,33 @@
+/* Header file for Hexlet's SDL3 background ROM checker */
+
+#ifndef HEXLET_CHK_H
+#define HEXLET_CHK_H
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+
+typedef u8 chk_Status;
+#define chk_STATUS_IDLE		0x00	/* no check has been started */
+#define chk_STATUS_CHECKING	0x01
+#define chk_STATUS_GOOD		0x02
+#define chk_STATUS_BAD		0x03
+
+/*
+*  Check the loaded ROM's CRC on a worker thread, so it can start running right away (see ldr_setLazyROMVerification()).
+*  The thread reads the loaded ROM without a lock, so call chk_stopChecking() before loading another one.
+*  Return FALSE on failure or TRUE on success.
+*/
+bool chk_startChecking(void);
+
+/*
+*  Wait for the check to finish if it hasn't already, and return its result.
+*/
+chk_Status chk_stopChecking(void);
+
+/*
+*  Get the status of the check without waiting for it.
+*  The first time this (or chk_stopChecking()) sees a bad checksum, it logs it, so call it from the thread that owns the log.
+*/
+chk_Status chk_pollCheck(void);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,219 @@
+/* Source file for Hexlet's SDL3 pixel conversion kernels */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <SDL3/SDL.h>
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+
+#include "convert.h"
+
+#ifdef cvt_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef cvt_HAS_AVX2
+#include <immintrin.h>
+#endif
+
+static inline u8 cvt_tint(u8 intensity, u8 backlight) {
+	return (u8)((intensity * 17 * (backlight + 1)) >> 8);
+}
+
+bool cvt_setBacklight(cvt_Palette *palette, const SDL_PixelFormatDetails *format, u8 r, u8 g, u8 b) {
+	if (format == NULL || format->bytes_per_pixel != 4) {
+		return FALSE;
+	}
+	
+	for (u8 i = 0; i < 16; i++) {
+		palette->colors[i] = SDL_MapRGBA(format, NULL, cvt_tint(i, r), cvt_tint(i, g), cvt_tint(i, b), 0xff);
+	}
+	
+	/* the SSE2 kernel works on the bytes of each pixel as they sit in memory, which is little-endian on every host it runs on */
+	const u8 bits[4] = { format->Rbits, format->Gbits, format->Bbits, format->Abits };
+	const u8 shifts[4] = { format->Rshift, format->Gshift, format->Bshift, format->Ashift };
+	const u16 multipliers[4] = { r + 1, g + 1, b + 1, 0 };
+	
+	memset(palette->multipliers, 0, sizeof(palette->multipliers));
+	palette->alphaMask = format->Amask;
+	palette->byteAligned = TRUE;
+	
+	for (u8 channel = 0; channel < 4; channel++) {
+		if (bits[channel] == 0) continue;
+		
+		if (bits[channel] != 8 || shifts[channel] % 8) {
+			palette->byteAligned = FALSE;
+			break;
+		}
+		palette->multipliers[shifts[channel] / 8] = multipliers[channel];
+	}
+	
+	return TRUE;
+}
+
+void cvt_convertRowScalar(const cvt_Palette *palette, const u8 *src, u32 *dest, u32 pixels) {
+	for (u32 i = 0; i < pixels / 2; i++) {
+		dest[0] = palette->colors[src[i] >> 4];
+		dest[1] = palette->colors[src[i] & 0x0f];
+		dest += 2;
+	}
+	
+	if (pixels & 1) {
+		*dest = palette->colors[src[pixels / 2] >> 4];
+	}
+}
+
+#ifdef cvt_HAS_SSE2
+
+/*
+*  SSE2 has no byte shuffle to look colors up with, so this works out the tint itself:
+*  each intensity becomes i * 17 (0-255), gets copied into the four bytes of its pixel, and is multiplied by that byte's backlight + 1.
+*/
+void cvt_convertRowSSE2(const cvt_Palette *palette, const u8 *src, u32 *dest, u32 pixels) {
+	const u16 *m = palette->multipliers;
+	__m128i multipliers = _mm_setr_epi16((short)m[0], (short)m[1], (short)m[2], (short)m[3], (short)m[0], (short)m[1], (short)m[2], (short)m[3]);
+	__m128i alphaMask = _mm_set1_epi32((int)palette->alphaMask);
+	__m128i nibbleMask = _mm_set1_epi8(0x0f);
+	__m128i zero = _mm_setzero_si128();
+	
+	u32 blocks = pixels / 16;
+	for (u32 block = 0; block < blocks; block++) {
+		__m128i packed = _mm_loadl_epi64((const __m128i *)(src + block * 8));
+		__m128i high = _mm_and_si128(_mm_srli_epi16(packed, 4), nibbleMask);
+		__m128i low = _mm_and_si128(packed, nibbleMask);
+		
+		/* 16 intensities in pixel order, then scaled to 0-255 (i * 17 is i in both nibbles) */
+		__m128i intensities = _mm_unpacklo_epi8(high, low);
+		intensities = _mm_or_si128(intensities, _mm_slli_epi16(intensities, 4));
+		
+		for (u8 half = 0; half < 2; half++) {
+			__m128i doubled = half ? _mm_unpackhi_epi8(intensities, intensities) : _mm_unpacklo_epi8(intensities, intensities);
+			
+			for (u8 quarter = 0; quarter < 2; quarter++) {
+				/* four pixels with their intensity in every byte, then in the high byte of each word so mulhi does the >> 8 too */
+				__m128i quad = quarter ? _mm_unpackhi_epi16(doubled, doubled) : _mm_unpacklo_epi16(doubled, doubled);
+				__m128i first = _mm_mulhi_epu16(_mm_unpacklo_epi8(zero, quad), multipliers);
+				__m128i second = _mm_mulhi_epu16(_mm_unpackhi_epi8(zero, quad), multipliers);
+				
+				__m128i colors = _mm_or_si128(_mm_packus_epi16(first, second), alphaMask);
+				_mm_storeu_si128((__m128i *)dest, colors);
+				dest += 4;
+			}
+		}
+	}
+	
+	cvt_convertRowScalar(palette, src + blocks * 8, dest, pixels - blocks * 16);
+}
+
+#endif
+
+#ifdef cvt_HAS_AVX2
+
+/*
+*  AVX2 can look colors up directly: each half of the palette fits in one register for vpermd, and bit 3 of the intensity picks the half.
+*/
+__attribute__((target("avx2")))
+void cvt_convertRowAVX2(const cvt_Palette *palette, const u8 *src, u32 *dest, u32 pixels) {
+	__m256i lowColors = _mm256_loadu_si256((const __m256i *)palette->colors);
+	__m256i highColors = _mm256_loadu_si256((const __m256i *)(palette->colors + 8));
+	__m128i nibbleMask = _mm_set1_epi8(0x0f);
+	
+	u32 blocks = pixels / 16;
+	for (u32 block = 0; block < blocks; block++) {
+		__m128i packed = _mm_loadl_epi64((const __m128i *)(src + block * 8));
+		__m128i high = _mm_and_si128(_mm_srli_epi16(packed, 4), nibbleMask);
+		__m128i low = _mm_and_si128(packed, nibbleMask);
+		__m128i intensities = _mm_unpacklo_epi8(high, low);
+		
+		for (u8 half = 0; half < 2; half++) {
+			__m256i indices = _mm256_cvtepu8_epi32(half ? _mm_srli_si128(intensities, 8) : intensities);
+			__m256i lowHalf = _mm256_permutevar8x32_epi32(lowColors, indices);
+			__m256i highHalf = _mm256_permutevar8x32_epi32(highColors, indices);
+			
+			/* moving bit 3 up to the sign bit makes it the blend's selector */
+			__m256 selector = _mm256_castsi256_ps(_mm256_slli_epi32(indices, 28));
+			__m256 colors = _mm256_blendv_ps(_mm256_castsi256_ps(lowHalf), _mm256_castsi256_ps(highHalf), selector);
+			
+			_mm256_storeu_si256((__m256i *)dest, _mm256_castps_si256(colors));
+			dest += 8;
+		}
+	}
+	
+	cvt_convertRowScalar(palette, src + blocks * 8, dest, pixels - blocks * 16);
+}
+
+#endif
+
+void cvt_convertRow(const cvt_Palette *palette, const u8 *src, u32 *dest, u32 pixels) {
+#ifdef cvt_HAS_AVX2
+	static s8 hasAVX2 = -1;
+	if (hasAVX2 < 0) hasAVX2 = SDL_HasAVX2();
+	
+	if (hasAVX2) {
+		cvt_convertRowAVX2(palette, src, dest, pixels);
+		return;
+	}
+#endif
+
+#ifdef cvt_HAS_SSE2
+	if (palette->byteAligned) {
+		cvt_convertRowSSE2(palette, src, dest, pixels);
+		return;
+	}
+#endif
+	
+	cvt_convertRowScalar(palette, src, dest, pixels);
+}
+
+/*
+*  Time one kernel and check its output against the scalar one's. Return FALSE if they differ.
+*/
+static bool cvt_benchmarkKernel(char *name, cvt_Kernel kernel, const cvt_Palette *palette, const u8 *src, u32 *dest, const u32 *expected) {
+	kernel(palette, src, dest, cvt_BENCHMARK_PIXELS);
+	bool matches = !memcmp(dest, expected, cvt_BENCHMARK_PIXELS * sizeof(u32));
+	
+	u64 start = SDL_GetPerformanceCounter();
+	for (u32 run = 0; run < cvt_BENCHMARK_RUNS; run++) {
+		kernel(palette, src, dest, cvt_BENCHMARK_PIXELS);
+	}
+	double seconds = (double)(SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+	
+	printf("%-8s %8.1f Mpixels/s%s\n", name, (double)cvt_BENCHMARK_PIXELS * cvt_BENCHMARK_RUNS / seconds / 1e6, matches ? "" : "  (output differs from scalar!)");
+	return matches;
+}
+
+bool cvt_runBenchmark(void) {
+	u8 *src = SDL_malloc(cvt_BENCHMARK_PIXELS / 2);
+	u32 *expected = SDL_malloc(cvt_BENCHMARK_PIXELS * sizeof(u32));
+	u32 *dest = SDL_malloc(cvt_BENCHMARK_PIXELS * sizeof(u32));
+	cvt_Palette palette;
+	bool success = FALSE;
+	
+	if (src != NULL && expected != NULL && dest != NULL && cvt_setBacklight(&palette, SDL_GetPixelFormatDetails(SDL_PIXELFORMAT_XRGB8888), 0xff, 0xc0, 0x40)) {
+		for (u32 i = 0; i < cvt_BENCHMARK_PIXELS / 2; i++) src[i] = (u8)SDL_rand(256);
+		cvt_convertRowScalar(&palette, src, expected, cvt_BENCHMARK_PIXELS);
+		
+		success = cvt_benchmarkKernel("scalar", cvt_convertRowScalar, &palette, src, dest, expected);
+
+#ifdef cvt_HAS_SSE2
+		success = cvt_benchmarkKernel("SSE2", cvt_convertRowSSE2, &palette, src, dest, expected) && success;
+#endif
+
+#ifdef cvt_HAS_AVX2
+		if (SDL_HasAVX2()) {
+			success = cvt_benchmarkKernel("AVX2", cvt_convertRowAVX2, &palette, src, dest, expected) && success;
+		}
+		else {
+			printf("%-8s (not supported by this CPU)\n", "AVX2");
+		}
+#endif
+	}
+	
+	SDL_free(src);
+	SDL_free(expected);
+	SDL_free(dest);
+	
+	return success;
+}
\ No newline at end of file
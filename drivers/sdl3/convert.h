@@ -0,0 +1,70 @@
+/* Header file for Hexlet's SDL3 pixel conversion kernels */
+
+#ifndef HEXLET_CVT_H
+#define HEXLET_CVT_H
+
+#include <SDL3/SDL.h>
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+
+/* SSE2 is part of x86-64, so only AVX2 has to be checked for at runtime (and only GCC and Clang can target it per function) */
+#if defined(__SSE2__) || defined(_M_X64)
+#define cvt_HAS_SSE2
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define cvt_HAS_AVX2
+#endif
+
+/* How many pixels the benchmark converts per run, and how many runs it times */
+#define cvt_BENCHMARK_PIXELS (256 * 256)
+#define cvt_BENCHMARK_RUNS 2000
+
+/*
+*  What each of the 16 intensities looks like through the backlight, in a 32-bit surface format.
+*  Intensity i lights each channel to (i * 17 * (backlight + 1)) >> 8, so 15 is the backlight color itself and 0 is black.
+*/
+typedef struct {
+	u32 colors[16];
+	
+	/* For the SSE2 kernel, which does the math instead of looking colors up: each byte of a pixel's multiplier, and the bits that are always set */
+	u16 multipliers[4];
+	u32 alphaMask;
+	bool byteAligned;	/* FALSE if the format's channels aren't whole bytes, which the SSE2 kernel can't do */
+} cvt_Palette;
+
+typedef void (*cvt_Kernel)(const cvt_Palette *palette, const u8 *src, u32 *dest, u32 pixels);
+
+/*
+*  Build the palette for the given backlight color and surface format (which has to be 32 bits per pixel).
+*  Return FALSE on failure or TRUE on success.
+*/
+bool cvt_setBacklight(cvt_Palette *palette, const SDL_PixelFormatDetails *format, u8 r, u8 g, u8 b);
+
+/*
+*  Convert pixels 4-bit intensities (two per byte, the high nibble first) from src to 32-bit pixels at dest,
+*  using the fastest kernel the CPU and palette support.
+*/
+void cvt_convertRow(const cvt_Palette *palette, const u8 *src, u32 *dest, u32 pixels);
+
+/*
+*  The kernels themselves, for the benchmark. Only call the SIMD ones if the CPU has them (and the SSE2 one if the palette is byte-aligned).
+*/
+void cvt_convertRowScalar(const cvt_Palette *palette, const u8 *src, u32 *dest, u32 pixels);
+
+#ifdef cvt_HAS_SSE2
+void cvt_convertRowSSE2(const cvt_Palette *palette, const u8 *src, u32 *dest, u32 pixels);
+#endif
+
+#ifdef cvt_HAS_AVX2
+void cvt_convertRowAVX2(const cvt_Palette *palette, const u8 *src, u32 *dest, u32 pixels);
+#endif
+
+/*
+*  Time every kernel this host can run on a screen's worth of random pixels and print how many pixels per second each converts.
+*  Return FALSE if any of them disagree with the scalar one, or TRUE otherwise.
+*/
+bool cvt_runBenchmark(void);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,87 @@
+/* Source file for Hexlet's SDL3 dirty rectangle tracker */
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+
+#include "dirty.h"
+
+static inline u32 dty_getArea(const dty_Rect *rect) {
+	return (u32)(rect->right - rect->left) * (rect->bottom - rect->top);
+}
+
+static inline bool dty_contains(const dty_Rect *outer, const dty_Rect *inner) {
+	return inner->left >= outer->left && inner->right <= outer->right && inner->top >= outer->top && inner->bottom <= outer->bottom;
+}
+
+/*
+*  Return TRUE if the rectangles overlap or share an edge (so their union wastes no more than their gaps).
+*/
+static inline bool dty_touches(const dty_Rect *a, const dty_Rect *b) {
+	return a->left <= b->right && b->left <= a->right && a->top <= b->bottom && b->top <= a->bottom;
+}
+
+static inline void dty_merge(dty_Rect *into, const dty_Rect *rect) {
+	if (rect->left < into->left) into->left = rect->left;
+	if (rect->top < into->top) into->top = rect->top;
+	if (rect->right > into->right) into->right = rect->right;
+	if (rect->bottom > into->bottom) into->bottom = rect->bottom;
+}
+
+static inline void dty_removeRect(dty_List *list, u8 index) {
+	list->rects[index] = list->rects[--list->count];
+}
+
+void dty_clearList(dty_List *list) {
+	list->count = 0;
+}
+
+void dty_addRect(dty_List *list, u16 x, u16 y, u16 width, u16 height) {
+	if (width == 0 || height == 0) return;
+	
+	dty_Rect rect = { x, y, x + width, y + height };
+	
+	/* plotting pixel by pixel mostly lands inside a rectangle that's already there */
+	for (u8 i = 0; i < list->count; i++) {
+		if (dty_contains(&list->rects[i], &rect)) return;
+	}
+	
+	/* a merge can make the rectangle reach others it didn't before, so keep going until nothing changes */
+	bool merged;
+	do {
+		merged = FALSE;
+		
+		for (u8 i = 0; i < list->count; i++) {
+			if (dty_touches(&list->rects[i], &rect)) {
+				dty_merge(&rect, &list->rects[i]);
+				dty_removeRect(list, i);
+				merged = TRUE;
+				break;
+			}
+		}
+	} while (merged);
+	
+	if (list->count == dty_MAX_RECTS) {
+		u8 best = 0;
+		u32 bestGrowth = 0xffffffff;
+		
+		for (u8 i = 0; i < list->count; i++) {
+			dty_Rect combined = list->rects[i];
+			dty_merge(&combined, &rect);
+			
+			u32 growth = dty_getArea(&combined) - dty_getArea(&list->rects[i]) - dty_getArea(&rect);
+			if (growth < bestGrowth) {
+				best = i;
+				bestGrowth = growth;
+			}
+		}
+		
+		/* the bigger rectangle might now reach others, so it goes through the whole process again */
+		dty_merge(&rect, &list->rects[best]);
+		dty_removeRect(list, best);
+		
+		dty_addRect(list, rect.left, rect.top, rect.right - rect.left, rect.bottom - rect.top);
+		return;
+	}
+	
+	list->rects[list->count++] = rect;
+}
\ No newline at end of file
@@ -0,0 +1,41 @@
+/* Header file for Hexlet's SDL3 dirty rectangle tracker */
+
+#ifndef HEXLET_DTY_H
+#define HEXLET_DTY_H
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+
+/* How many separate rectangles a list holds before it starts merging ones that don't overlap */
+#define dty_MAX_RECTS 16
+
+/*
+*  A rectangle of screen pixels. The right and bottom edges are exclusive, so an empty rectangle has left == right.
+*/
+typedef struct {
+	u16 left;
+	u16 top;
+	u16 right;
+	u16 bottom;
+} dty_Rect;
+
+/*
+*  The parts of the screen that changed this frame. No two of the rectangles overlap or touch.
+*/
+typedef struct {
+	dty_Rect rects[dty_MAX_RECTS];
+	u8 count;
+} dty_List;
+
+/*
+*  Empty the list (after the frame's changes have been drawn).
+*/
+void dty_clearList(dty_List *list);
+
+/*
+*  Mark the given width * height rectangle at (x, y) as changed.
+*  It gets merged with every rectangle it overlaps or touches, and when the list is full, with the one that grows the least from it.
+*/
+void dty_addRect(dty_List *list, u16 x, u16 y, u16 width, u16 height);
+
+#endif
\ No newline at end of file
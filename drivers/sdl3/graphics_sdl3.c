@@ -1,6 +1,7 @@
 /* Graphics source file for Hexlet's sample SDL3 driver */
 
 #include <stdio.h>
+#include <string.h>
 
 #include <SDL3/SDL.h>
 
@@ -9,11 +10,73 @@
 #include <hexlet_graphics.h>
 #include <hexlet_driver.h>
 
+#include "convert.h"
+#include "dirty.h"
+
 #define SCREEN_WIDTH 640
 #define SCREEN_HEIGHT 480
 
+/* The screen is as big as the coordinates go */
+#define HEX_COLUMNS 256
+#define HEX_ROWS 256
+
+/*
+*  The pixels are pointy-topped hexagons, 4 * scale wide and tall. They're laid out in rows 3 * scale apart (so the points fit between the row above),
+*  with the odd rows shifted right by half a pixel. That's 160 by 160 of them in the window.
+*/
+#define HEX_WIDTH(scale) (4 * (scale))
+#define HEX_HEIGHT(scale) (4 * (scale))
+#define HEX_ROW_PITCH(scale) (3 * (scale))
+#define HEX_MAX_SCALE 4
+
 static SDL_Window *sdlWindow;
 static SDL_Surface *sdlSurf;
+static u8 gfx_displayScale;
+
+/*
+*  One row of a pixel's footprint, relative to the left edge of its column (so odd rows' spans include the half-pixel shift).
+*  The spans of neighboring pixels never overlap, so every surface pixel gets drawn once.
+*/
+typedef struct {
+	u8 start;
+	u8 length;
+} gfx_Span;
+
+/* The footprint of a pixel on an even and an odd row, for the scale in gfx_spanScale */
+static gfx_Span gfx_spans[2][HEX_HEIGHT(HEX_MAX_SCALE)];
+static u8 gfx_spanScale;
+
+/* What the screen shows: the intensities (packed like a gfx_Bitmap, so the backlight can change), and their colors in the surface's format */
+static u8 gfx_intensities[HEX_ROWS][HEX_COLUMNS / 2];
+static u32 gfx_colors[HEX_ROWS][HEX_COLUMNS];
+static cvt_Palette gfx_palette;
+
+/* What changed since the last frame, in screen pixels */
+static dty_List gfx_dirty;
+
+/* For bitmaps whose rows don't start on a byte, or that hang off the screen */
+static u32 gfx_scratch[HEX_COLUMNS * HEX_ROWS];
+
+/*
+*  Work out the hexagon's footprint at the given scale.
+*  For the first scale rows, the point is (4 * row + 2) wide, which is exactly the gap the two pixels in the row above leave.
+*/
+static void gfx_buildSpans(u8 scale) {
+	u8 width = HEX_WIDTH(scale);
+	u8 height = HEX_HEIGHT(scale);
+	
+	for (u8 parity = 0; parity < 2; parity++) {
+		for (u8 row = 0; row < height; row++) {
+			u8 fromEdge = (row < scale) ? row : (row >= height - scale) ? height - 1 - row : scale;
+			u8 halfWidth = (fromEdge < scale) ? 2 * fromEdge + 1 : width / 2;
+			
+			gfx_spans[parity][row].start = parity * (width / 2) + width / 2 - halfWidth;
+			gfx_spans[parity][row].length = 2 * halfWidth;
+		}
+	}
+	
+	gfx_spanScale = scale;
+}
 
 bool gfx_initDriver(u8 displayScale) {
 	char *lastError;
@@ -36,23 +99,181 @@ bool gfx_initDriver(u8 displayScale) {
 		return FALSE;
 	}
 	
-	return TRUE;
+	gfx_displayScale = displayScale;
+	if (gfx_spanScale != displayScale) {
+		gfx_buildSpans(displayScale);
+	}
+	dty_clearList(&gfx_dirty);
+	
+	/* setting the backlight marks the whole screen as changed, so the first frame draws all of it */
+	return gfx_setBacklight(0xff, 0xff, 0xff);
+}
+
+/*
+*  Draw the pixels in the given rectangle to the surface, and work out the part of the surface they cover.
+*/
+static void gfx_drawRect(const dty_Rect *rect, SDL_Rect *area) {
+	u32 width = HEX_WIDTH(gfx_displayScale);
+	u32 height = HEX_HEIGHT(gfx_displayScale);
+	u32 pitch = HEX_ROW_PITCH(gfx_displayScale);
+	u32 surfaceWidth = (u32)sdlSurf->w;
+	u32 surfaceHeight = (u32)sdlSurf->h;
+	
+	for (u32 y = rect->top; y < rect->bottom; y++) {
+		const gfx_Span *spans = gfx_spans[y & 1];
+		u32 top = y * pitch;
+		if (top >= surfaceHeight) break;
+		
+		for (u32 row = 0; row < height && top + row < surfaceHeight; row++) {
+			u32 *dest = (u32 *)((u8 *)sdlSurf->pixels + (top + row) * sdlSurf->pitch);
+			u32 start = spans[row].start;
+			u32 length = spans[row].length;
+			
+			for (u32 x = rect->left; x < rect->right; x++) {
+				u32 left = x * width + start;
+				if (left >= surfaceWidth) break;
+				
+				u32 right = (left + length < surfaceWidth) ? left + length : surfaceWidth;
+				u32 color = gfx_colors[y][x];
+				for (u32 column = left; column < right; column++) dest[column] = color;
+			}
+		}
+	}
+	
+	/* the odd rows stick out half a pixel to the right, and the last row's points stick out below */
+	u32 left = rect->left * width;
+	u32 top = rect->top * pitch;
+	u32 right = rect->right * width + width / 2;
+	u32 bottom = (rect->bottom - 1) * pitch + height;
+	
+	area->x = (int)left;
+	area->y = (int)top;
+	area->w = (left < surfaceWidth) ? (int)(((right < surfaceWidth) ? right : surfaceWidth) - left) : 0;
+	area->h = (top < surfaceHeight) ? (int)(((bottom < surfaceHeight) ? bottom : surfaceHeight) - top) : 0;
 }
 
 bool gfx_nextFrame(void) {
-	return FALSE;
+	if (!sdlSurf) return FALSE;
+	if (gfx_dirty.count == 0) return TRUE;
+	
+	if (!SDL_LockSurface(sdlSurf)) {
+		return FALSE;
+	}
+	
+	/* only the parts of the screen that changed get drawn and sent to the window */
+	SDL_Rect areas[dty_MAX_RECTS];
+	int areaCount = 0;
+	
+	for (u8 i = 0; i < gfx_dirty.count; i++) {
+		gfx_drawRect(&gfx_dirty.rects[i], &areas[areaCount]);
+		if (areas[areaCount].w > 0 && areas[areaCount].h > 0) areaCount++;
+	}
+	
+	SDL_UnlockSurface(sdlSurf);
+	dty_clearList(&gfx_dirty);
+	
+	return areaCount ? SDL_UpdateWindowSurfaceRects(sdlWindow, areas, areaCount) : TRUE;
+}
+
+static inline void gfx_setIntensity(u8 x, u8 y, u8 intensity) {
+	u8 *byte = &gfx_intensities[y][x / 2];
+	*byte = (x & 1) ? (*byte & 0xf0) | intensity : (*byte & 0x0f) | (intensity << 4);
 }
 
 bool gfx_plotPix(u8 x, u8 y, u8 intensity) {
-	return FALSE;
+	intensity &= 0x0f;
+	
+	gfx_setIntensity(x, y, intensity);
+	gfx_colors[y][x] = gfx_palette.colors[intensity];
+	dty_addRect(&gfx_dirty, x, y, 1, 1);
+	
+	return TRUE;
+}
+
+/*
+*  Store count intensities on row y from x onwards, starting with pixel number first of the packed data.
+*/
+static void gfx_storeIntensities(u32 x, u32 y, const u8 *data, u32 first, u32 count) {
+	if (!(first & 1) && !(x & 1) && !(count & 1)) {
+		memcpy(&gfx_intensities[y][x / 2], data + first / 2, count / 2);
+		return;
+	}
+	
+	for (u32 column = 0; column < count; column++) {
+		u32 pixel = first + column;
+		u8 byte = data[pixel / 2];
+		gfx_setIntensity(x + column, y, (pixel & 1) ? byte & 0x0f : byte >> 4);
+	}
+}
+
+bool gfx_plotSpan(u8 x, u8 y, u16 length, u8 *data) {
+	if (x + length > HEX_COLUMNS) length = HEX_COLUMNS - x;
+	if (length == 0) return TRUE;
+	
+	/* a span always starts on a byte, so it converts straight into place wherever it goes */
+	cvt_convertRow(&gfx_palette, data, &gfx_colors[y][x], length);
+	gfx_storeIntensities(x, y, data, 0, length);
+	dty_addRect(&gfx_dirty, x, y, length, 1);
+	
+	return TRUE;
 }
 
 bool gfx_copyRect(gfx_Rect *rect) {
-	return FALSE;
+	u32 width = (rect->xPos + rect->width > HEX_COLUMNS) ? HEX_COLUMNS - rect->xPos : rect->width;
+	u32 height = (rect->yPos + rect->height > HEX_ROWS) ? HEX_ROWS - rect->yPos : rect->height;
+	
+	dty_addRect(&gfx_dirty, rect->xPos, rect->yPos, width, height);
+	
+	if (!rect->hasPixels) {
+		u8 intensity = rect->data.color & 0x0f;
+		u32 color = gfx_palette.colors[intensity];
+		
+		for (u32 y = rect->yPos; y < rect->yPos + height; y++) {
+			for (u32 x = rect->xPos; x < rect->xPos + width; x++) {
+				gfx_setIntensity(x, y, intensity);
+				gfx_colors[y][x] = color;
+			}
+		}
+		return TRUE;
+	}
+	
+	gfx_Bitmap *bitmap = &rect->data.bitmap;
+	if (bitmap->data == NULL) return FALSE;
+	
+	/* rows only start on a byte when the width is even, so otherwise convert the bitmap all in one go and copy the rows out */
+	bool direct = !(bitmap->width & 1) && width == bitmap->width;
+	if (!direct) {
+		cvt_convertRow(&gfx_palette, bitmap->data, gfx_scratch, bitmap->width * bitmap->height);
+	}
+	
+	for (u32 row = 0; row < height; row++) {
+		u32 y = rect->yPos + row;
+		u32 first = row * bitmap->width;
+		
+		if (direct) {
+			cvt_convertRow(&gfx_palette, bitmap->data + first / 2, &gfx_colors[y][rect->xPos], width);
+		}
+		else {
+			memcpy(&gfx_colors[y][rect->xPos], &gfx_scratch[first], width * sizeof(u32));
+		}
+		gfx_storeIntensities(rect->xPos, y, bitmap->data, first, width);
+	}
+	
+	return TRUE;
 }
 
 bool gfx_setBacklight(u8 r, u8 g, u8 b) {
-	return FALSE;
+	if (!sdlSurf || !cvt_setBacklight(&gfx_palette, SDL_GetPixelFormatDetails(sdlSurf->format), r, g, b)) {
+		return FALSE;
+	}
+	
+	/* the whole screen changes color, so convert it again */
+	for (u32 y = 0; y < HEX_ROWS; y++) {
+		cvt_convertRow(&gfx_palette, gfx_intensities[y], gfx_colors[y], HEX_COLUMNS);
+	}
+	dty_addRect(&gfx_dirty, 0, 0, HEX_COLUMNS, HEX_ROWS);
+	
+	return TRUE;
 }
 
 bool gfx_setSevenSegment(gfx_SevenSegmentIndexMask indexMask, gfx_SevenSegmentMask segmentMask) {
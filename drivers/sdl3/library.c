@@ -0,0 +1,328 @@
+/* Source file for Hexlet's SDL3 ROM library scanner */
+
+#include <string.h>
+
+#include <SDL3/SDL.h>
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+#include <hexlet_loader.h>
+
+#include "library.h"
+
+/* The files a scan has to read, shared by its threads */
+typedef struct {
+	lib_Library *library;
+	char *directory;
+	
+	u32 *pending;
+	u32 pendingCount;
+	SDL_AtomicInt next;
+} lib_ScanJob;
+
+static inline void lib_put16(u8 *ptr, u16 value) {
+	ptr[0] = (u8)value;
+	ptr[1] = (u8)(value >> 8);
+}
+
+static inline void lib_put64(u8 *ptr, u64 value) {
+	for (u8 i = 0; i < 8; i++) ptr[i] = (u8)(value >> (i * 8));
+}
+
+static inline u16 lib_get16(u8 *ptr) {
+	return ptr[0] | (ptr[1] << 8);
+}
+
+static inline u64 lib_get64(u8 *ptr) {
+	u64 value = 0;
+	for (u8 i = 0; i < 8; i++) value |= (u64)ptr[i] << (i * 8);
+	
+	return value;
+}
+
+static lib_Entry *lib_addEntry(lib_Library *library, const char *name) {
+	if (library->count == library->capacity) {
+		u32 capacity = library->capacity ? library->capacity * 2 : 64;
+		lib_Entry *entries = SDL_realloc(library->entries, capacity * sizeof(lib_Entry));
+		if (entries == NULL) return NULL;
+		
+		library->entries = entries;
+		library->capacity = capacity;
+	}
+	
+	lib_Entry *entry = &library->entries[library->count];
+	memset(entry, 0, sizeof(lib_Entry));
+	
+	entry->name = SDL_strdup(name);
+	if (entry->name == NULL) return NULL;
+	
+	library->count++;
+	return entry;
+}
+
+static int lib_compareEntries(const void *a, const void *b) {
+	return strcmp(((const lib_Entry *)a)->name, ((const lib_Entry *)b)->name);
+}
+
+/*
+*  Read the entries from an index file into library. A missing or damaged index just means every file gets read.
+*/
+static void lib_readIndex(lib_Library *library, char *indexPath) {
+	size_t size;
+	u8 *data = SDL_LoadFile(indexPath, &size);
+	if (data == NULL) return;
+	
+	if (size < lib_INDEX_HEADER_SIZE || memcmp(data, lib_INDEX_MAGIC, lib_INDEX_MAGIC_SIZE) || data[4] != lib_INDEX_VERSION) {
+		SDL_free(data);
+		return;
+	}
+	
+	u32 count = lib_get16(data + 5) | ((u32)lib_get16(data + 7) << 16);
+	size_t offset = lib_INDEX_HEADER_SIZE;
+	
+	for (u32 i = 0; i < count && size - offset >= lib_INDEX_ENTRY_SIZE; i++) {
+		u8 *ptr = data + offset;
+		u16 nameLength = lib_get16(ptr + 28);
+		u8 titleLength = ptr[30];
+		u8 authorLength = ptr[31];
+		
+		if (size - offset - lib_INDEX_ENTRY_SIZE < (size_t)nameLength + titleLength + authorLength) break;
+		if (titleLength >= sizeof(((ldr_ROMInfo *)NULL)->title) || authorLength >= sizeof(((ldr_ROMInfo *)NULL)->author)) break;
+		offset += lib_INDEX_ENTRY_SIZE + nameLength + titleLength + authorLength;
+		
+		char *name = SDL_strndup((char *)ptr + lib_INDEX_ENTRY_SIZE, nameLength);
+		lib_Entry *entry = (name != NULL) ? lib_addEntry(library, name) : NULL;
+		SDL_free(name);
+		if (entry == NULL) break;
+		
+		entry->modifyTime = (s64)lib_get64(ptr);
+		entry->size = lib_get64(ptr + 8);
+		entry->valid = ptr[16] != 0;
+		entry->info.romSize = ptr[17];
+		entry->info.cs1 = ptr[18];
+		entry->info.cs2 = ptr[19];
+		entry->info.minHiveCraftVersion = ptr[20];
+		entry->info.softwareRevision = lib_get16(ptr + 21);
+		entry->info.crc = lib_get16(ptr + 23);
+		
+		memcpy(entry->info.title, ptr + lib_INDEX_ENTRY_SIZE + nameLength, titleLength);
+		memcpy(entry->info.author, ptr + lib_INDEX_ENTRY_SIZE + nameLength + titleLength, authorLength);
+	}
+	
+	SDL_free(data);
+}
+
+static bool lib_writeIndex(lib_Library *library, char *indexPath) {
+	char *tempPath;
+	if (SDL_asprintf(&tempPath, "%s.tmp", indexPath) < 0) {
+		return FALSE;
+	}
+	
+	SDL_IOStream *file = SDL_IOFromFile(tempPath, "wb");
+	if (file == NULL) {
+		SDL_free(tempPath);
+		return FALSE;
+	}
+	
+	u8 header[lib_INDEX_HEADER_SIZE];
+	memcpy(header, lib_INDEX_MAGIC, lib_INDEX_MAGIC_SIZE);
+	header[4] = lib_INDEX_VERSION;
+	lib_put16(header + 5, (u16)library->count);
+	lib_put16(header + 7, (u16)(library->count >> 16));
+	bool written = SDL_WriteIO(file, header, sizeof(header)) == sizeof(header);
+	
+	for (u32 i = 0; i < library->count && written; i++) {
+		lib_Entry *entry = &library->entries[i];
+		u8 ptr[lib_INDEX_ENTRY_SIZE];
+		memset(ptr, 0, sizeof(ptr));
+		
+		size_t nameLength = strlen(entry->name);
+		size_t titleLength = strlen(entry->info.title);
+		size_t authorLength = strlen(entry->info.author);
+		
+		lib_put64(ptr, (u64)entry->modifyTime);
+		lib_put64(ptr + 8, entry->size);
+		ptr[16] = entry->valid;
+		ptr[17] = entry->info.romSize;
+		ptr[18] = entry->info.cs1;
+		ptr[19] = entry->info.cs2;
+		ptr[20] = entry->info.minHiveCraftVersion;
+		lib_put16(ptr + 21, entry->info.softwareRevision);
+		lib_put16(ptr + 23, entry->info.crc);
+		lib_put16(ptr + 28, (u16)nameLength);
+		ptr[30] = (u8)titleLength;
+		ptr[31] = (u8)authorLength;
+		
+		written = SDL_WriteIO(file, ptr, sizeof(ptr)) == sizeof(ptr)
+			&& SDL_WriteIO(file, entry->name, nameLength) == nameLength
+			&& SDL_WriteIO(file, entry->info.title, titleLength) == titleLength
+			&& SDL_WriteIO(file, entry->info.author, authorLength) == authorLength;
+	}
+	
+	bool closed = SDL_CloseIO(file);
+	bool success = written && closed && SDL_RenamePath(tempPath, indexPath);
+	
+	if (!success) SDL_RemovePath(tempPath);
+	SDL_free(tempPath);
+	
+	return success;
+}
+
+/*
+*  Read just the header of one file. Every thread of a scan runs this on different entries.
+*/
+static void lib_readHeader(char *directory, lib_Entry *entry) {
+	u8 header[256];
+	char *path;
+	
+	entry->valid = FALSE;
+	memset(&entry->info, 0, sizeof(ldr_ROMInfo));
+	
+	if (SDL_asprintf(&path, "%s/%s", directory, entry->name) < 0) {
+		return;
+	}
+	
+	SDL_IOStream *file = SDL_IOFromFile(path, "rb");
+	SDL_free(path);
+	if (file == NULL) {
+		return;
+	}
+	
+	if (SDL_ReadIO(file, header, sizeof(header)) == sizeof(header)) {
+		entry->valid = ldr_readROMInfo(header, &entry->info);
+	}
+	SDL_CloseIO(file);
+}
+
+static int lib_scanThread(void *data) {
+	lib_ScanJob *job = data;
+	s32 next;
+	
+	while ((next = SDL_AddAtomicInt(&job->next, 1)) < (s32)job->pendingCount) {
+		lib_readHeader(job->directory, &job->library->entries[job->pending[next]]);
+	}
+	
+	return 0;
+}
+
+/*
+*  Add each ROM image in the directory to the library, keeping what the old index says about it if the file hasn't changed.
+*/
+static SDL_EnumerationResult lib_addFile(void *data, const char *directory, const char *name) {
+	lib_Library **libraries = data;
+	lib_Library *library = libraries[0];
+	lib_Library *index = libraries[1];
+	
+	size_t nameLength = strlen(name);
+	size_t extensionLength = strlen(lib_ROM_EXTENSION);
+	if (nameLength <= extensionLength || SDL_strcasecmp(name + nameLength - extensionLength, lib_ROM_EXTENSION)) {
+		return SDL_ENUM_CONTINUE;
+	}
+	
+	char *path;
+	SDL_PathInfo info;
+	if (SDL_asprintf(&path, "%s%s", directory, name) < 0) {
+		return SDL_ENUM_FAILURE;
+	}
+	
+	bool isFile = SDL_GetPathInfo(path, &info) && info.type == SDL_PATHTYPE_FILE;
+	SDL_free(path);
+	if (!isFile) return SDL_ENUM_CONTINUE;
+	
+	lib_Entry *entry = lib_addEntry(library, name);
+	if (entry == NULL) return SDL_ENUM_FAILURE;
+	
+	lib_Entry key = { (char *)name };
+	lib_Entry *indexed = SDL_bsearch(&key, index->entries, index->count, sizeof(lib_Entry), lib_compareEntries);
+	
+	entry->modifyTime = info.modify_time;
+	entry->size = info.size;
+	entry->changed = indexed == NULL || indexed->modifyTime != info.modify_time || indexed->size != info.size;
+	
+	if (!entry->changed) {
+		entry->valid = indexed->valid;
+		entry->info = indexed->info;
+	}
+	
+	return SDL_ENUM_CONTINUE;
+}
+
+/*
+*  Read the headers of every changed entry, split between this thread and as many more as there are cores to run them.
+*/
+static void lib_readChangedHeaders(lib_Library *library, char *directory) {
+	lib_ScanJob job;
+	job.library = library;
+	job.directory = directory;
+	job.pendingCount = 0;
+	SDL_SetAtomicInt(&job.next, 0);
+	
+	job.pending = SDL_malloc((library->count ? library->count : 1) * sizeof(u32));
+	if (job.pending == NULL) {
+		/* fall back to reading them all on this thread */
+		for (u32 i = 0; i < library->count; i++) {
+			if (!library->entries[i].changed) continue;
+			
+			lib_readHeader(directory, &library->entries[i]);
+			library->filesRead++;
+		}
+		return;
+	}
+	
+	for (u32 i = 0; i < library->count; i++) {
+		if (library->entries[i].changed) job.pending[job.pendingCount++] = i;
+	}
+	
+	/* the files are tiny reads, so a thread is only worth it for every few dozen of them */
+	s32 threadCount = SDL_GetNumLogicalCPUCores() - 1;
+	if (threadCount > lib_MAX_THREADS) threadCount = lib_MAX_THREADS;
+	if (threadCount > (s32)(job.pendingCount / 32)) threadCount = (s32)(job.pendingCount / 32);
+	
+	SDL_Thread *threads[lib_MAX_THREADS];
+	for (s32 i = 0; i < threadCount; i++) {
+		threads[i] = SDL_CreateThread(lib_scanThread, "hexlet scanner", &job);
+	}
+	
+	lib_scanThread(&job);
+	
+	for (s32 i = 0; i < threadCount; i++) {
+		if (threads[i] != NULL) SDL_WaitThread(threads[i], NULL);
+	}
+	
+	library->filesRead = job.pendingCount;
+	SDL_free(job.pending);
+}
+
+bool lib_scanLibrary(lib_Library *library, char *directory, char *indexPath) {
+	lib_Library index;
+	memset(&index, 0, sizeof(index));
+	memset(library, 0, sizeof(lib_Library));
+	
+	lib_readIndex(&index, indexPath);
+	SDL_qsort(index.entries, index.count, sizeof(lib_Entry), lib_compareEntries);
+	
+	lib_Library *libraries[2] = { library, &index };
+	bool enumerated = SDL_EnumerateDirectory(directory, lib_addFile, libraries);
+	lib_freeLibrary(&index);
+	
+	if (!enumerated) {
+		lib_freeLibrary(library);
+		return FALSE;
+	}
+	
+	SDL_qsort(library->entries, library->count, sizeof(lib_Entry), lib_compareEntries);
+	lib_readChangedHeaders(library, directory);
+	
+	/* the scan itself still worked if the index can't be written, it'll just be slower next time */
+	lib_writeIndex(library, indexPath);
+	return TRUE;
+}
+
+void lib_freeLibrary(lib_Library *library) {
+	for (u32 i = 0; i < library->count; i++) {
+		SDL_free(library->entries[i].name);
+	}
+	
+	SDL_free(library->entries);
+	memset(library, 0, sizeof(lib_Library));
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+/* Header file for Hexlet's SDL3 ROM library scanner */
+
+#ifndef HEXLET_LIB_H
+#define HEXLET_LIB_H
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+#include <hexlet_loader.h>
+
+/*
+*  Layout of an index file (all numbers little-endian):
+*  "HXLI", a version byte, and the entry count (32 bits), then for each entry:
+*  modification time (64 bits, nanoseconds), file size (64 bits), valid flag, ROM size, CS1 and CS2 chip types, minimum HiveCraft version,
+*  software revision (16 bits), CRC (16 bits), then the lengths of the file name (16 bits), title and author (8 bits each) and the strings themselves
+*/
+#define lib_INDEX_MAGIC "HXLI"
+#define lib_INDEX_MAGIC_SIZE 4
+#define lib_INDEX_VERSION 0x01
+#define lib_INDEX_HEADER_SIZE 9
+#define lib_INDEX_ENTRY_SIZE 32
+
+/* The name of the index file lib_scanLibrary() is given by the driver, in the library's directory */
+#define lib_INDEX_NAME "hexlet_library.hxi"
+
+/* The extension of the files that get scanned */
+#define lib_ROM_EXTENSION ".hxh"
+
+/* The most threads a scan uses (besides the one that called it) */
+#define lib_MAX_THREADS 16
+
+typedef struct {
+	char *name;	/* file name within the library's directory */
+	s64 modifyTime;
+	u64 size;
+	
+	bool changed;	/* TRUE if the last scan read this file, because it's new or changed since the index was written */
+	bool valid;	/* FALSE if the header couldn't be read or isn't a ROM this emulator can run */
+	ldr_ROMInfo info;
+} lib_Entry;
+
+typedef struct {
+	lib_Entry *entries;	/* sorted by name */
+	u32 count;
+	u32 capacity;
+	
+	/* How many files the last scan had to read (the rest came from the index) */
+	u32 filesRead;
+} lib_Library;
+
+/*
+*  Scan every ROM image in the given directory and write the results to the index file at indexPath.
+*  Files whose size and modification time match the index aren't read again, and the rest are read (just their headers) on a pool of threads.
+*  Return FALSE on failure or TRUE on success.
+*/
+bool lib_scanLibrary(lib_Library *library, char *directory, char *indexPath);
+
+/*
+*  Free everything a scan allocated.
+*/
+void lib_freeLibrary(lib_Library *library);
+
+#endif
\ No newline at end of file
@@ -10,39 +10,54 @@
 #include <hexlet_bools.h>
 #include <hexlet_driver.h>
 #include <hexlet_emulate.h>
+#include <hexlet_loader.h>
 #include <hexlet_version.h>
 
+#include "builder.h"
+#include "checker.h"
+#include "convert.h"
+#include "library.h"
 #include "logger.h"
+#include "recorder.h"
 
 /* Various command line arguments */
 static bool drv_nintendoControllerMap = FALSE;
 static u8 drv_displayScale = 1;
 static u8 drv_usedHiveCraftVersion;
 static size_t drv_memoryUsage;
+static char *drv_tracePath;
+static char *drv_romPath;
+
+/* The builder assembles on several threads, and they all allocate through drv_reallocate() */
+static SDL_SpinLock drv_memoryUsageLock;
 
 void *drv_reallocate(void *oldPtr, size_t oldSize, size_t newSize) {
 	if (oldPtr == NULL) {
 		void *newPtr = SDL_malloc(newSize);
 		if (newPtr != NULL) {
+			SDL_LockSpinlock(&drv_memoryUsageLock);
 			drv_memoryUsage += newSize;
+			SDL_UnlockSpinlock(&drv_memoryUsageLock);
 		}
 		return newPtr;
 	}
 	else if (newSize == 0) {
 		SDL_free(oldPtr);
+		SDL_LockSpinlock(&drv_memoryUsageLock);
 		drv_memoryUsage -= oldSize;
+		SDL_UnlockSpinlock(&drv_memoryUsageLock);
 		return NULL;
 	}
 	else {
 		void *newPtr = SDL_realloc(oldPtr, newSize);
-		if (newPtr != NULL) {
-			drv_memoryUsage -= oldSize;
-			drv_memoryUsage += newSize;
-		}
-		else {
-			drv_memoryUsage -= oldSize;
+		if (newPtr == NULL) {
 			SDL_free(oldPtr);
 		}
+		
+		SDL_LockSpinlock(&drv_memoryUsageLock);
+		drv_memoryUsage -= oldSize;
+		if (newPtr != NULL) drv_memoryUsage += newSize;
+		SDL_UnlockSpinlock(&drv_memoryUsageLock);
 		return newPtr;
 	}
 }
@@ -60,12 +75,95 @@ static inline void drv_logDesc(void) {
 	log_printInfo("");
 }
 
+/*
+*  List the ROM images in a directory, reading only the ones that changed since its index was written.
+*/
+static bool drv_scanLibrary(char *directory) {
+	lib_Library library;
+	char *indexPath;
+	
+	if (SDL_asprintf(&indexPath, "%s/%s", directory, lib_INDEX_NAME) < 0) {
+		return FALSE;
+	}
+	
+	bool scanned = lib_scanLibrary(&library, directory, indexPath);
+	SDL_free(indexPath);
+	
+	if (!scanned) {
+		log_printError("Couldn't read the ROM library's directory.");
+		return FALSE;
+	}
+	
+	for (u32 i = 0; i < library.count; i++) {
+		lib_Entry *entry = &library.entries[i];
+		
+		if (!entry->valid) {
+			printf("%-32s (not a usable ROM image)\n", entry->name);
+			continue;
+		}
+		
+		printf("%-32s %-40s %-24s %5u KiB  rev %-5u CRC $%04X\n", entry->name, entry->info.title, entry->info.author, entry->info.romSize * 64, entry->info.softwareRevision, entry->info.crc);
+	}
+	
+	printf("\n%u ROM images, %u read (the rest were unchanged)\n", library.count, library.filesRead);
+	
+	lib_freeLibrary(&library);
+	return TRUE;
+}
+
+/*
+*  Assemble the source files into objects on every core, link them in order and write the ROM image.
+*  Only the sources that changed (or include a file that changed) since the last build are assembled again.
+*/
+static bool drv_buildROM(char *imagePath, char **sourcePaths, u32 sourceCount) {
+	char message[128];
+	u32 assembledCount;
+	
+	if (sourceCount == 0) {
+		log_printError("--asm needs a ROM image to write and at least one source file.");
+		return FALSE;
+	}
+	
+	if (!bld_buildROM(imagePath, sourcePaths, sourceCount, &assembledCount)) {
+		return FALSE;
+	}
+	
+	snprintf(message, sizeof(message), "Built the ROM image (%u of %u sources assembled, the rest were unchanged).", assembledCount, sourceCount);
+	log_printInfo(message);
+	
+	return TRUE;
+}
+
+/*
+*  Map the ROM image and let it start right away, checking its CRC on a worker thread in the meantime.
+*  The check reads the loaded ROM without a lock, so any check of the last ROM has to finish before another one is loaded.
+*/
+static bool drv_loadROM(char *path) {
+	chk_stopChecking();
+	
+	ldr_setLazyROMVerification(TRUE);
+	if (!ldr_loadROMFile(path)) {
+		log_printError(ldr_getError());
+		return FALSE;
+	}
+	
+	/* without a thread to check it on, check it before it runs */
+	if (!chk_startChecking() && !ldr_verifyROM()) {
+		log_printError("The ROM's checksum doesn't match its header, so it may be corrupt.");
+	}
+	
+	return TRUE;
+}
+
 /*
 *  Return a negative number on failure, 0 for an immediate exit, and a positive number on success.
 */
 s32 drv_parseArgs(s32 argc, char **argv) {
 	bool parseVersion = FALSE;
 	bool parseScale = FALSE;
+	bool parseTrace = FALSE;
+	bool parseScan = FALSE;
+	bool launch = FALSE;
 	s32 exitCode = 0;
 	
 	if (argc == 1) {
@@ -108,6 +206,22 @@ s32 drv_parseArgs(s32 argc, char **argv) {
 			continue;
 		}
 		
+		if (parseTrace) {
+			drv_tracePath = arg;
+			parseTrace = FALSE;
+			continue;
+		}
+		
+		if (parseScan) {
+			return drv_scanLibrary(arg) ? 0 : -1;
+		}
+		
+		/* anything that isn't an option is the input file */
+		if (arg[0] != '-') {
+			drv_romPath = arg;
+			continue;
+		}
+		
 		if (arg[0] == '-' && arg[1] != '-') arg++;
 		
 		if (arg[0] == 'h' || !strcmp(arg, "--help")) {
@@ -123,7 +237,7 @@ s32 drv_parseArgs(s32 argc, char **argv) {
 			log_printTable("--version, -v",		"Display detailed version information and exit");
 			log_printTable("--credits, -c",		"Display credits and exit");
 			log_printTable("--bindings, -b",	"Display key and controller bindings and exit");
-			log_printTable("--asm, -a", 		"Assemble the input file and print the output");
+			log_printTable("--asm, -a <image> <files>",	"Assemble the source files and link them into a ROM image");
 			log_printTable("--disasm, -d", 		"Disassemble the input file and print the output");
 			log_printTable("--launch, -l", 		"Launch (assemble and run) the input file");
 			log_printTableRow(" ");
@@ -132,6 +246,9 @@ s32 drv_parseArgs(s32 argc, char **argv) {
 			log_printTable("--scale 3, -3",		"Upscale the display by a factor of 3");
 			log_printTable("--scale 4, -4",		"Upscale the display by a factor of 4");
 			log_printTable("--ninmap, -n",		"Make the controller bindings friendlier to Nintendo controllers");
+			log_printTable("--trace <file>",	"Record every bus transaction to a trace file while running");
+			log_printTable("--scan <directory>",	"List the ROM images in a directory (and update its index) and exit");
+			log_printTable("--bench-convert",	"Time the pixel conversion kernels this CPU supports and exit");
 			log_endTable();
 			log_printInfo("");
 			
@@ -207,7 +324,7 @@ s32 drv_parseArgs(s32 argc, char **argv) {
 			else {
 				log_printTable("Z/X/A/S", "Right/Down/Up/Left", "A/B/1/2 buttons (Button Controller)");
 			}
-	
+			
 			log_printTable("A/S", "Left/Up or rotate Left Stick", "Paddle CCW/CW (Paddle Controller)");
 			log_printTable("Z/X", "Down/Right", "A/B buttons (Paddle Controller)");
 			log_printTable("Z/X", "Right/Down", "A/B buttons (Paddle Controller)");
@@ -244,16 +361,21 @@ s32 drv_parseArgs(s32 argc, char **argv) {
 			return 0;
 		}
 		else if (arg[0] == 'a' || !strcmp(arg, "--asm")) {
+			/* the rest of the arguments are the ROM image, then the sources in the order they're linked */
+			if (c + 1 >= argc) {
+				log_printError("--asm needs a ROM image to write and at least one source file.");
+				return -1;
+			}
 			
-			return 0;
+			return drv_buildROM(argv[c + 1], argv + c + 2, (u32)(argc - c - 2)) ? 0 : -1;
 		}
 		else if (arg[0] == 'd' || !strcmp(arg, "--disasm")) {
 			
 			return 0;
 		}
 		else if (arg[0] == 'l' || !strcmp(arg, "--launch")) {
-			
-			return 1;
+			launch = TRUE;
+			continue;
 		}
 		else if (!strcmp(arg, "--soc")) {
 			parseVersion = TRUE;
@@ -263,6 +385,17 @@ s32 drv_parseArgs(s32 argc, char **argv) {
 			parseScale = TRUE;
 			continue;
 		}
+		else if (!strcmp(arg, "--trace")) {
+			parseTrace = TRUE;
+			continue;
+		}
+		else if (!strcmp(arg, "--scan")) {
+			parseScan = TRUE;
+			continue;
+		}
+		else if (!strcmp(arg, "--bench-convert")) {
+			return cvt_runBenchmark() ? 0 : -1;
+		}
 		else if (arg[0] == '2') {
 			drv_displayScale = 2;
 			continue;
@@ -277,20 +410,46 @@ s32 drv_parseArgs(s32 argc, char **argv) {
 		}
 	}
 	
+	if (launch && !exitCode) {
+		if (drv_romPath == NULL) {
+			log_printError("--launch needs a ROM image to run.");
+			return -1;
+		}
+		
+		return 1;
+	}
+	
 	return exitCode;
 }
 
 int main(int argc, char **argv) {
 	drv_usedHiveCraftVersion = ver_MAX_HIVECRAFT_VERSION();
 	
-	u32 exitCode = drv_parseArgs((s32)argc, argv);
+	s32 exitCode = drv_parseArgs((s32)argc, argv);
 	if (!exitCode) return 0;
 	else if (exitCode < 0) {
 		log_printError("Command line argument parsing failed.");
 		return -1;
 	}
 	
+	if (!drv_loadROM(drv_romPath)) {
+		return -1;
+	}
+	
+	if (drv_tracePath != NULL && !rec_startRecording(drv_tracePath, mem_BUS_TYPE_CPU | mem_BUS_TYPE_PPU | mem_BUS_TYPE_HEXRIDGE)) {
+		log_printError("Failed to start recording the bus trace.");
+		return -1;
+	}
+	
 	// gfx_initDriver(drv_displayScale);
 	
+	if (drv_tracePath != NULL && rec_stopRecording()) {
+		log_printError("The bus trace is missing transactions (the recorder couldn't keep up).");
+	}
+	
+	/* this logs the check's result if it found a bad checksum */
+	chk_stopChecking();
+	ldr_closeROMFile();
+	
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,83 @@
+/* Source file for Hexlet's SDL3 bus trace recorder */
+
+#include <SDL3/SDL.h>
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+#include <hexlet_memory.h>
+
+#include "logger.h"
+#include "recorder.h"
+
+static SDL_Thread *rec_thread;
+static SDL_IOStream *rec_file;
+static SDL_AtomicInt rec_stopping;
+
+/*
+*  Move everything in the ring buffer to the file. Return FALSE if writing failed.
+*/
+static bool rec_flush(u8 *chunk) {
+	size_t size;
+	
+	while ((size = mem_readTrace(chunk, rec_CHUNK_SIZE)) > 0) {
+		if (SDL_WriteIO(rec_file, chunk, size) != size) {
+			return FALSE;
+		}
+	}
+	
+	return TRUE;
+}
+
+static int rec_drainThread(void *data) {
+	static u8 chunk[rec_CHUNK_SIZE];
+	
+	while (!SDL_GetAtomicInt(&rec_stopping)) {
+		if (!rec_flush(chunk)) return -1;
+		
+		/* a millisecond fills well under a quarter of the ring, even with every bus traced */
+		SDL_Delay(1);
+	}
+	
+	/* the emulator has stopped by now, so this gets the last of it */
+	return rec_flush(chunk) ? 0 : -1;
+}
+
+bool rec_startRecording(char *path, mem_BusType buses) {
+	rec_file = SDL_IOFromFile(path, "wb");
+	if (rec_file == NULL) {
+		return FALSE;
+	}
+	
+	if (!mem_startTrace(buses, rec_RING_SIZE_LOG2)) {
+		SDL_CloseIO(rec_file);
+		return FALSE;
+	}
+	
+	SDL_SetAtomicInt(&rec_stopping, 0);
+	rec_thread = SDL_CreateThread(rec_drainThread, "hexlet trace", NULL);
+	if (rec_thread == NULL) {
+		mem_stopTrace();
+		SDL_CloseIO(rec_file);
+		return FALSE;
+	}
+	
+	return TRUE;
+}
+
+u32 rec_stopRecording(void) {
+	int status;
+	u32 overruns = mem_getTraceOverruns();
+	
+	SDL_SetAtomicInt(&rec_stopping, 1);
+	SDL_WaitThread(rec_thread, &status);
+	rec_thread = NULL;
+	
+	if (status) {
+		log_printError("Failed to write the bus trace.");
+	}
+	
+	mem_stopTrace();
+	SDL_CloseIO(rec_file);
+	
+	return overruns;
+}
\ No newline at end of file
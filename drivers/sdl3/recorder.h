@@ -0,0 +1,28 @@
+/* Header file for Hexlet's SDL3 bus trace recorder */
+
+#ifndef HEXLET_REC_H
+#define HEXLET_REC_H
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+#include <hexlet_memory.h>
+
+/* Log2 of the number of transactions the ring buffer can hold (about 24 MiB at 2^20) */
+#define rec_RING_SIZE_LOG2 20
+
+/* How much encoded trace gets written to the file at once */
+#define rec_CHUNK_SIZE 65536
+
+/*
+*  Start tracing the given buses and spawn a thread that writes the trace to the file at the given path.
+*  Return FALSE on failure or TRUE on success.
+*/
+bool rec_startRecording(char *path, mem_BusType buses);
+
+/*
+*  Stop tracing, write out whatever is left, and close the file.
+*  Return the number of transactions that were dropped because the thread fell behind.
+*/
+u32 rec_stopRecording(void);
+
+#endif
\ No newline at end of file
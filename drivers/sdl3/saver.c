@@ -0,0 +1,163 @@
+/* Source file for Hexlet's SDL3 background state saver */
+
+#include <stdio.h>
+
+#include <SDL3/SDL.h>
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+#include <hexlet_loader.h>
+
+#include "logger.h"
+#include "saver.h"
+
+static SDL_Thread *sav_thread;
+static SDL_Semaphore *sav_request;
+static SDL_AtomicInt sav_status;
+static SDL_AtomicInt sav_quitting;
+
+/* Everything below belongs to the saver's thread while the status is sav_STATUS_SAVING */
+static ldr_Snapshot *sav_snapshot;
+static u8 *sav_buffer;
+static u32 sav_bufferSize;
+
+static char *sav_path;
+static ldr_StateFileFlags sav_saveWhat;
+static sav_Callback sav_callback;
+static void *sav_userData;
+
+/* Why the last save failed; the thread fills it in, then sav_pollSave() logs it on the caller's thread */
+static char sav_error[256];
+static bool sav_errorLogged;
+
+/*
+*  Write the state to a temporary file next to the real one, then rename it, so a crash partway through never leaves a broken save.
+*/
+static bool sav_writeFile(u8 *data, u32 length) {
+	char *tempPath;
+	if (SDL_asprintf(&tempPath, "%s.tmp", sav_path) < 0) {
+		return FALSE;
+	}
+	
+	SDL_IOStream *file = SDL_IOFromFile(tempPath, "wb");
+	if (file == NULL) {
+		SDL_free(tempPath);
+		return FALSE;
+	}
+	
+	bool written = SDL_WriteIO(file, data, length) == length;
+	bool closed = SDL_CloseIO(file);
+	bool success = written && closed && SDL_RenamePath(tempPath, sav_path);
+	
+	if (!success) SDL_RemovePath(tempPath);
+	SDL_free(tempPath);
+	
+	return success;
+}
+
+static int sav_saveThread(void *data) {
+	while (TRUE) {
+		SDL_WaitSemaphore(sav_request);
+		if (SDL_GetAtomicInt(&sav_quitting)) break;
+		
+		u32 length = ldr_saveSnapshot(sav_snapshot, sav_buffer, sav_bufferSize, sav_saveWhat, TRUE);
+		bool success = length && sav_writeFile(sav_buffer, length);
+		
+		if (!length) {
+			snprintf(sav_error, sizeof(sav_error), "%s", ldr_getSnapshotError(sav_snapshot));
+		}
+		else if (!success) {
+			snprintf(sav_error, sizeof(sav_error), "Couldn't write the state to '%s'.", sav_path);
+		}
+		
+		if (sav_callback != NULL) {
+			sav_callback(success, sav_path, sav_userData);
+		}
+		
+		SDL_free(sav_path);
+		sav_path = NULL;
+		
+		/* this hands everything back to the emulation thread, so it has to come last */
+		SDL_SetAtomicInt(&sav_status, success ? sav_STATUS_SAVED : sav_STATUS_FAILED);
+	}
+	
+	return 0;
+}
+
+bool sav_initSaver(void) {
+	/* every part of the state, uncompressed, is the most a save can need */
+	sav_bufferSize = ldr_getStateSize(0xff);
+	sav_buffer = SDL_malloc(sav_bufferSize);
+	sav_snapshot = ldr_createSnapshot();
+	sav_request = SDL_CreateSemaphore(0);
+	
+	SDL_SetAtomicInt(&sav_status, sav_STATUS_IDLE);
+	SDL_SetAtomicInt(&sav_quitting, 0);
+	
+	if (sav_buffer != NULL && sav_snapshot != NULL && sav_request != NULL) {
+		sav_thread = SDL_CreateThread(sav_saveThread, "hexlet saver", NULL);
+	}
+	
+	if (sav_thread == NULL) {
+		sav_quitSaver();
+		return FALSE;
+	}
+	
+	return TRUE;
+}
+
+void sav_quitSaver(void) {
+	if (sav_thread != NULL) {
+		/* the thread only checks for quitting between saves, so one in progress still gets written */
+		SDL_SetAtomicInt(&sav_quitting, 1);
+		SDL_SignalSemaphore(sav_request);
+		SDL_WaitThread(sav_thread, NULL);
+		sav_thread = NULL;
+	}
+	
+	if (sav_request != NULL) {
+		SDL_DestroySemaphore(sav_request);
+		sav_request = NULL;
+	}
+	
+	ldr_freeSnapshot(sav_snapshot);
+	sav_snapshot = NULL;
+	
+	SDL_free(sav_buffer);
+	sav_buffer = NULL;
+}
+
+bool sav_saveState(char *path, ldr_StateFileFlags saveWhat, sav_Callback callback, void *userData) {
+	if (sav_thread == NULL || SDL_GetAtomicInt(&sav_status) == sav_STATUS_SAVING) {
+		return FALSE;
+	}
+	
+	sav_path = SDL_strdup(path);
+	if (sav_path == NULL) {
+		return FALSE;
+	}
+	
+	ldr_takeSnapshot(sav_snapshot);
+	sav_error[0] = '\0';
+	sav_errorLogged = FALSE;
+	sav_saveWhat = saveWhat;
+	sav_callback = callback;
+	sav_userData = userData;
+	
+	SDL_SetAtomicInt(&sav_status, sav_STATUS_SAVING);
+	SDL_SignalSemaphore(sav_request);
+	
+	return TRUE;
+}
+
+sav_Status sav_pollSave(void) {
+	sav_Status status = (sav_Status)SDL_GetAtomicInt(&sav_status);
+	
+	/* the logger isn't thread-safe, so the thread leaves the error for whoever polls */
+	if (status == sav_STATUS_FAILED && !sav_errorLogged) {
+		if (sav_error[0]) log_printError(sav_error);
+		sav_errorLogged = TRUE;
+	}
+	
+	return status;
+}
\ No newline at end of file
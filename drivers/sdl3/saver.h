@@ -0,0 +1,46 @@
+/* Header file for Hexlet's SDL3 background state saver */
+
+#ifndef HEXLET_SAV_H
+#define HEXLET_SAV_H
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+#include <hexlet_loader.h>
+
+typedef u8 sav_Status;
+#define sav_STATUS_IDLE		0x00	/* nothing has been saved yet */
+#define sav_STATUS_SAVING	0x01
+#define sav_STATUS_SAVED	0x02
+#define sav_STATUS_FAILED	0x03
+
+/*
+*  Called on the saver's thread when a save finishes, with the path it was saving to.
+*/
+typedef void (*sav_Callback)(bool success, char *path, void *userData);
+
+/*
+*  Allocate the snapshot and state buffers and start the saver's thread.
+*  Return FALSE on failure or TRUE on success.
+*/
+bool sav_initSaver(void);
+
+/*
+*  Wait for any save in progress to finish, then stop the saver's thread and free its buffers.
+*/
+void sav_quitSaver(void);
+
+/*
+*  Snapshot the specified parts of the state and save them, compressed and checksummed, to the file at the given path in the background.
+*  Call this between frames. It only copies the state, so the emulator can carry on right away.
+*  The callback (which can be NULL) gets the result, or use sav_pollSave().
+*  Return FALSE if the previous save hasn't finished yet or on failure, or TRUE if the save started.
+*/
+bool sav_saveState(char *path, ldr_StateFileFlags saveWhat, sav_Callback callback, void *userData);
+
+/*
+*  Get the status of the last save.
+*  The first time this sees a failed save, it logs why the save failed (so call it from the thread that owns the log).
+*/
+sav_Status sav_pollSave(void);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,115 @@
+/* Header file for Hexlet's assembler */
+
+#ifndef HEXLET_ASM_H
+#define HEXLET_ASM_H
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+
+typedef u8 asm_Severity;
+#define asm_SEVERITY_ERROR	0
+#define asm_SEVERITY_WARNING	1
+
+/* What a diagnostic is about, for tools that handle some of them specially */
+typedef u16 asm_DiagnosticCode;
+#define asm_ERROR_SYNTAX		1
+#define asm_ERROR_UNKNOWN_MNEMONIC	2
+#define asm_ERROR_MISSING_ARGUMENT	3
+#define asm_ERROR_BAD_CONSTANT		4
+#define asm_ERROR_OUT_OF_RANGE		5
+#define asm_ERROR_OPERAND_SIZE		6
+#define asm_ERROR_DUPLICATE_LABEL	7
+#define asm_ERROR_UNDEFINED_SYMBOL	8
+#define asm_ERROR_UNRESOLVABLE		9
+#define asm_ERROR_OUT_OF_MEMORY		10
+#define asm_ERROR_INCLUDE		11
+#define asm_ERROR_DUPLICATE_SYMBOL	12
+#define asm_ERROR_OVERLAP		13
+
+/*
+*  One diagnostic from the assembler. The line and column are 0 if it isn't about one place in the source,
+*  and the path is NULL if it isn't about a file. The message and path are only valid until the next assembly.
+*/
+typedef struct {
+	asm_Severity severity;
+	asm_DiagnosticCode code;
+	u32 lineNum;
+	u32 colNum;
+	const char *path;
+	const char *message;
+} asm_Diagnostic;
+
+/*
+*  The code, symbols and relocations from assembling one source (and the files it includes), for asm_linkObjects()
+*/
+typedef struct asm_Object asm_Object;
+
+/*
+*  Assemble the given code string, then link it on its own into the current ROM image, returning FALSE on failure or TRUE on success.
+*/
+bool asm_assembleToROMImage(const char *assemblyCode);
+
+/*
+*  Assemble the given code string into an object. The path is where the code came from (or NULL), which .INCLUDE paths are relative to.
+*  Symbols it doesn't define are left for the linker. Its diagnostics are kept in the object until it's linked.
+*  This doesn't touch anything global, so objects can be assembled on several threads at once if drv_reallocate() can be called from them.
+*  Return NULL only if there's no memory for the object.
+*/
+asm_Object *asm_assembleObject(const char *assemblyCode, const char *path);
+
+/*
+*  Free an object from asm_assembleObject() or asm_loadObject().
+*/
+void asm_freeObject(asm_Object *object);
+
+/*
+*  Get the number of files an object was assembled from (the source and everything it included),
+*  and the path of each one (or NULL if that one wasn't from a file), for deciding whether it's out of date.
+*/
+u32 asm_getObjectSourceCount(asm_Object *object);
+const char *asm_getObjectSource(asm_Object *object, u32 index);
+
+/*
+*  Get the size of an object file for the object, or 0 if it had errors (those objects aren't saved).
+*/
+u32 asm_getObjectSize(asm_Object *object);
+
+/*
+*  Write the object file for the object into data, which is length bytes long. Return FALSE on failure or TRUE on success.
+*/
+bool asm_saveObject(asm_Object *object, u8 *data, u32 length);
+
+/*
+*  Load an object from an object file. Return NULL if it isn't a valid object file or there's no memory for it.
+*/
+asm_Object *asm_loadObject(const u8 *data, u32 length);
+
+/*
+*  Link the objects, in order, into the current ROM image, filling in every symbol one of them left for the linker.
+*  The objects' diagnostics come first in the list, then the linker's. Return FALSE on failure or TRUE on success.
+*/
+bool asm_linkObjects(asm_Object **objects, u32 count);
+
+/*
+*  Get the current ROM image (header and all, ready to be saved as an .hxh file) and fill in its length,
+*  or return NULL if the last assembly failed. It's only valid until the next assembly.
+*/
+u8 *asm_getROMImage(u32 *length);
+
+/*
+*  Get every diagnostic from the last assembly as one string, a line each. It's only put together when this is called.
+*/
+char *asm_getError(void);
+
+/*
+*  Get the number of diagnostics from the last assembly.
+*/
+u32 asm_getDiagnosticCount(void);
+
+/*
+*  Fill in the diagnostic with the given index (in the order they were found), so tools can go through them with
+*  for (u32 i = 0; asm_getDiagnostic(i, &diagnostic); i++). Return FALSE if there isn't one or TRUE if there is.
+*/
+bool asm_getDiagnostic(u32 index, asm_Diagnostic *diagnostic);
+
+#endif
\ No newline at end of file
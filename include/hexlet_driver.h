@@ -16,6 +16,13 @@
 */
 bool drv_plotPix(u8 x, u8 y, u8 intensity);
 
+/*
+*  Plot length pixels on row y, starting at x, from packed intensities (two per byte with the high nibble first, like a gfx_Bitmap).
+*  This is optional: a driver that has it should add HEXLET_DRIVER_SPANS to its compile definitions.
+*  Without it, the core plots spans with drv_plotPix.
+*/
+bool drv_plotSpan(u8 x, u8 y, u16 length, u8 *data);
+
 /*
 *  Copy the given gfx_Rect to the screen.
 *  This should be at least as fast as calling drv_plotPix for each pixel copied.
@@ -37,6 +44,7 @@ bool drv_setSevenSegment(gfx_SevenSegmentIndexMask indexMask, gfx_SevenSegmentMa
 *  Macros so gfx_<functionName>() can be used for multi-file drivers
 */
 #define gfx_plotPix drv_plotPix
+#define gfx_plotSpan drv_plotSpan
 #define gfx_copyRect drv_copyRect
 #define gfx_setBacklight drv_setBacklight
 #define gfx_setSevenSegment drv_setSevenSegment
@@ -46,6 +54,8 @@ bool drv_setSevenSegment(gfx_SevenSegmentIndexMask indexMask, gfx_SevenSegmentMa
 *  When oldPtr is NULL, allocate a block of memory with size newSize and return a pointer to the new block.
 *  When newSize is 0, free the block of memory given by oldPtr with size oldSize and return NULL.
 *  Otherwise, reallocate the block of memory given by oldPtr from size oldSize to size newSize and return a pointer to the new block.
+*  If the new block can't be allocated, free the old one and return NULL.
+*  A driver that assembles on several threads (with asm_assembleObject()) has to make this safe to call from all of them.
 */
 void *drv_reallocate(void *oldPtr, size_t oldSize, size_t newSize);
 
@@ -3,6 +3,9 @@
 #ifndef HEXLET_EMULATE_H
 #define HEXLET_EMULATE_H
 
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+
 /*
 *  Get the string representing the last error from the emulator.
 */
@@ -16,10 +19,33 @@ char *emu_getError(void);
 s32 emu_decodeConstant(char *number);
 
 /*
-*  Step the emulator through one frame and update the screen buffer.
+*  Reset the emulated console: the CPU starts over from its reset vector and all pending events are dropped.
 *  Return FALSE on failure or TRUE on success.
-*  Note: You don't have to pass the buffer of the previous frame; it can be any gfx_Bitmap. This could be useful for a debugger.
+*  Note: emu_tick() does this by itself the first time it is called.
+*/
+bool emu_reset(void);
+
+/*
+*  Step the emulator through one frame.
+*  Return FALSE on failure or TRUE on success.
+*  Note: Nothing is drawn yet (there's no PPU), so this doesn't take a screen buffer until there is.
+*/
+bool emu_tick(void);
+
+/*
+*  Switch the CPU between the dynamic recompiler and the interpreter. This sticks across emu_reset().
+*  Return FALSE if Hexlet was built without the recompiler (and enabled is TRUE) or TRUE on success.
+*/
+bool emu_setJITEnabled(bool enabled);
+
+/*
+*  Get the number of CPU cycles emulated since the last reset.
+*/
+u64 emu_getCycles(void);
+
+/*
+*  Get how many of those cycles were skipped over instead of emulated, because the CPU was halted or spinning in an idle loop.
 */
-//bool emu_tick(gfx_Bitmap *screen);
+u64 emu_getSkippedCycles(void);
 
 #endif
\ No newline at end of file
@@ -16,6 +16,29 @@ typedef u8 ldr_StateFileFlags;
 #define ldr_STATE_FILE_FLAG_STORE_CS2	0x02
 #define ldr_STATE_FILE_FLAG_STORE_OAM	0x01
 
+typedef struct ldr_Snapshot ldr_Snapshot;
+
+/* What a ROM image's header says about it (see ldr_readROMInfo()) */
+typedef struct {
+	char title[128];
+	char author[96];
+	
+	/* Size is in 64-KiB units */
+	u8 romSize;
+	
+	/* Chip types on CS1 and CS2 */
+	u8 cs1;
+	u8 cs2;
+	
+	u8 minHiveCraftVersion;
+	u16 softwareRevision;
+	
+	u16 copyrightStartYear;
+	u16 copyrightEndYear;
+	
+	u16 crc;
+} ldr_ROMInfo;
+
 /*
 *  Get the error message representing the last error from the loader.
 */
@@ -25,9 +48,43 @@ char *ldr_getError(void);
 *  Load a ROM image (standard extension .hxh) from the specified data buffer, reading at most length bytes.
 *  Return FALSE on failure or TRUE on success.
 *  If length is 0, this will read from the buffer until a valid ROM image has been constructed.
+*  The ROM is mapped into memory straight from the buffer, so the buffer has to outlive it. emu_reset() starts it from the top.
 */
 bool ldr_loadROMImage(void *data, u32 length);
 
+/*
+*  Read the header of a ROM image from the first 256 bytes of data into info, without loading the ROM.
+*  Return FALSE if it isn't a ROM image this emulator can run (info is still filled in) or TRUE if it is.
+*  This doesn't touch the loaded ROM or the loader's error, so it's safe to call on several threads at once.
+*/
+bool ldr_readROMInfo(void *data, ldr_ROMInfo *info);
+
+/*
+*  Check the loaded ROM against the CRC in its header (X.25's CRC-16 of the ROM chunk). Return TRUE if it matches.
+*  This only reads the ROM and doesn't set the loader's error, so it can run on another thread while the ROM is in use.
+*  Nothing stops another ROM being loaded under it, though, so wait for it to finish before loading one.
+*/
+bool ldr_verifyROM(void);
+
+/*
+*  With lazy set, ldr_loadROMImage() and ldr_loadROMFile() skip checking the ROM's CRC, so the ROM can start right away.
+*  The driver should then call ldr_verifyROM() itself, for example on a worker thread.
+*/
+void ldr_setLazyROMVerification(bool lazy);
+
+/*
+*  Load a ROM image from the file at the given path by mapping it into memory, so the ROM is never copied.
+*  Instances of Hexlet running the same ROM share its pages, and only the banks that get used are read from disk.
+*  Return FALSE on failure (or if the host can't map files) or TRUE on success.
+*  Note: The ROM stays mapped until ldr_closeROMFile() is called or another ROM file is loaded.
+*/
+bool ldr_loadROMFile(char *path);
+
+/*
+*  Unmap the ROM file loaded by ldr_loadROMFile(), if there is one.
+*/
+void ldr_closeROMFile(void);
+
 /*
 *  Get the size in bytes of the loaded ROM image as a file. Return 0 on failure.
 */
@@ -51,9 +108,70 @@ bool ldr_loadState(u8 *data, u32 length);
 u32 ldr_getStateSize(ldr_StateFileFlags getWhat);
 
 /*
-*  Save the specified parts of the state to the specified data buffer, writing at most length bytes. 
+*  Save the specified parts of the state to the specified data buffer, writing at most length bytes.
 *  Return FALSE on failure or TRUE on success.
 */
 bool ldr_saveState(u8 *data, u32 length, ldr_StateFileFlags saveWhat);
 
+/*
+*  Save the specified parts of the state like ldr_saveState(), but compress the chunks that get smaller that way.
+*  A compressed state is never bigger than ldr_getStateSize() says, so that's the size to give the buffer.
+*  Return the number of bytes written, or 0 on failure.
+*/
+u32 ldr_saveCompressedState(u8 *data, u32 length, ldr_StateFileFlags saveWhat);
+
+/*
+*  Make the current state the base for delta states, which only store the RAM pages changed since then.
+*  A full state saved before the emulator runs again (with ldr_saveState()) is the base state the deltas apply to.
+*/
+void ldr_setDeltaBase(void);
+
+/*
+*  Get the size in bytes of the specified parts of the state as a delta state file. Return 0 on failure.
+*/
+u32 ldr_getDeltaStateSize(ldr_StateFileFlags getWhat);
+
+/*
+*  Save the specified parts of the state as a delta state, storing only the RAM pages changed since ldr_setDeltaBase(),
+*  to the specified data buffer, writing at most length bytes.
+*  Return FALSE on failure or TRUE on success.
+*  Note: ldr_loadState() can only load a delta state right after loading its base state.
+*/
+bool ldr_saveDeltaState(u8 *data, u32 length, ldr_StateFileFlags saveWhat);
+
+/*
+*  Save a delta state like ldr_saveDeltaState(), but compress the chunks that get smaller that way.
+*  A compressed delta state is never bigger than ldr_getDeltaStateSize() says.
+*  Return the number of bytes written, or 0 on failure.
+*/
+u32 ldr_saveCompressedDeltaState(u8 *data, u32 length, ldr_StateFileFlags saveWhat);
+
+/*
+*  Allocate a snapshot for ldr_takeSnapshot(). Return NULL on failure.
+*/
+ldr_Snapshot *ldr_createSnapshot(void);
+
+/*
+*  Free a snapshot allocated by ldr_createSnapshot().
+*/
+void ldr_freeSnapshot(ldr_Snapshot *snapshot);
+
+/*
+*  Copy everything a state file stores into the given snapshot. This is only a few memcpy()s, so it's cheap enough for every frame.
+*  Call it between frames, and nothing else touches the emulator's memory or CPU while the snapshot gets saved.
+*/
+void ldr_takeSnapshot(ldr_Snapshot *snapshot);
+
+/*
+*  Save the specified parts of a snapshot as a checksummed state (compressed if compress is set), writing at most length bytes.
+*  This only reads the snapshot, so it's safe to call on another thread while the emulator keeps running.
+*  The buffer should be ldr_getStateSize() bytes. Return the number of bytes written, or 0 on failure (see ldr_getSnapshotError()).
+*/
+u32 ldr_saveSnapshot(ldr_Snapshot *snapshot, u8 *data, u32 length, ldr_StateFileFlags saveWhat, bool compress);
+
+/*
+*  Get the error message representing the last error from ldr_saveSnapshot() with the given snapshot.
+*/
+char *ldr_getSnapshotError(ldr_Snapshot *snapshot);
+
 #endif
\ No newline at end of file
@@ -1,7 +1,9 @@
 /* Header file for Hexlet's memory bus emulator (could be used for debugging) */
 
-#ifndef HEXLET_MEMORY_H_INTERNAL
-#define HEXLET_MEMORY_H_INTERNAL
+#ifndef HEXLET_MEMORY_H
+#define HEXLET_MEMORY_H
+
+#include <stddef.h>
 
 #include <hexlet_ints.h>
 #include <hexlet_bools.h>
@@ -30,4 +32,65 @@ u32 mem_getAddress(mem_BusType buses);
 */
 u16 mem_getData(mem_BusType buses);
 
+/*
+*  One transaction on a bus, as recorded by the bus tracer
+*/
+typedef struct {
+	u64 cycle;	/* CPU cycle count at the start of the instruction that made the access (or of the block, for its instruction fetches) */
+	u32 address;
+	u16 data;
+	mem_BusType bus;
+	bool write;
+	bool word;	/* TRUE for a 16-bit access, FALSE for an 8-bit one */
+} mem_Transaction;
+
+/*
+*  Start recording every transaction on the given buses into a ring buffer with room for 2^sizeLog2 transactions.
+*  Another thread should call mem_readTrace() regularly to drain it; if it falls behind, transactions are dropped (see mem_getTraceOverruns()).
+*  Return FALSE on failure or TRUE on success.
+*/
+bool mem_startTrace(mem_BusType buses, u8 sizeLog2);
+
+/*
+*  Stop recording and free the ring buffer.
+*  Note: The thread calling mem_readTrace() has to be stopped first.
+*/
+void mem_stopTrace(void);
+
+/*
+*  Move as many recorded transactions as fit from the ring buffer into the given buffer, encoded in the trace file format.
+*  This is safe to call from one thread other than the emulator's while emulation runs.
+*  Return the number of bytes written (0 if nothing is pending).
+*/
+size_t mem_readTrace(u8 *buffer, size_t size);
+
+/*
+*  Return how many transactions were dropped because the ring buffer was full.
+*/
+u32 mem_getTraceOverruns(void);
+
+/*
+*  State for decoding a trace file, since each transaction is stored relative to the one before it
+*/
+typedef struct {
+	u64 cycle;
+	u32 address;
+} mem_TraceDecoder;
+
+/*
+*  Return the size of the header at the start of a trace file, or 0 if the data doesn't start with a valid header.
+*/
+size_t mem_checkTraceHeader(const u8 *data, size_t size);
+
+/*
+*  Prepare a decoder for the first transaction after the header.
+*/
+void mem_initTraceDecoder(mem_TraceDecoder *decoder);
+
+/*
+*  Decode the transaction at the start of data.
+*  Return the number of bytes it took up, or 0 if data ends in the middle of it.
+*/
+size_t mem_decodeTrace(mem_TraceDecoder *decoder, const u8 *data, size_t size, mem_Transaction *transaction);
+
 #endif
\ No newline at end of file
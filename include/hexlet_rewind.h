@@ -0,0 +1,52 @@
+/* Header file for Hexlet's rewind buffer */
+
+#ifndef HEXLET_RWD_H
+#define HEXLET_RWD_H
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+
+typedef struct {
+	u32 entries;		/* states in the buffer */
+	u32 keyframes;		/* how many of those are stored whole (the rest are deltas against one of them) */
+	u32 bytesUsed;		/* compressed bytes held by those states */
+	u32 bufferSize;
+	u32 stateSize;		/* size of one uncompressed state */
+	
+	u32 framesOfHistory;	/* how far back the buffer can rewind */
+	u32 bytesPerSecond;	/* memory used per second of history at 60 frames per second */
+	
+	u32 lastCaptureMicroseconds;
+	u32 lastRestoreMicroseconds;
+} rwd_Stats;
+
+/*
+*  Set up a rewind buffer of the given size in bytes.
+*  A state is captured every captureInterval frames, and every keyframeInterval-th captured state is stored whole.
+*  Return FALSE on failure or TRUE on success.
+*/
+bool rwd_initRewind(u32 bufferSize, u8 captureInterval, u8 keyframeInterval);
+
+/*
+*  Free the rewind buffer.
+*/
+void rwd_freeRewind(void);
+
+/*
+*  Call this once per frame (after emu_tick()) to capture the state when it's due.
+*  The oldest states are dropped to make room. Return FALSE on failure or TRUE on success.
+*/
+bool rwd_captureFrame(void);
+
+/*
+*  Load the newest captured state and drop it from the buffer, so calling this again goes further back.
+*  Return FALSE if there's nothing left to rewind to (or loading failed) or TRUE on success.
+*/
+bool rwd_stepBack(void);
+
+/*
+*  Fill in statistics about the rewind buffer.
+*/
+void rwd_getStats(rwd_Stats *stats);
+
+#endif
\ No newline at end of file
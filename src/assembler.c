@@ -2,6 +2,7 @@
 
 #include <ctype.h>
 #include <errno.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -10,9 +11,11 @@
 #include <hexlet_ints.h>
 #include <hexlet_bools.h>
 #include <hexlet_driver.h>
-#include "errors.h"
 
 #include "assembler.h"
+#include "crc.h"
+#include "mnemonics.h"
+#include "mnemonic_table.h"
 
 /*
 *  Internal lexer struct
@@ -22,20 +25,56 @@ typedef struct {
 	const char *current;
 	u32 lineNum;
 	u32 colNum;
+	u32 tokenLineNum;
+	u32 tokenColNum;
 	bool hasNewLine;
 } asm_Lexer;
 
+typedef u8 asm_SymbolKind;
+#define asm_SYMBOL_CONSTANT	0
+#define asm_SYMBOL_LABEL	1
+#define asm_SYMBOL_IMPORT	2
+
 /*
-*  Internal struct used to build the symbol table as a linked list
+*  Internal struct for one symbol. The name points into the source (or, while linking, into an object's names), so it isn't null-terminated.
 */
-typedef struct asm_SymbolTableEntry {
+typedef struct {
 	const char *symbol;
 	size_t symbolLength;
+	u32 hash;
 	s32 value;
+	u32 index;	/* its place in the object's symbols (while linking, in the defining object's) */
+	u32 owner;	/* while linking, the object that defines it */
+	u32 section;	/* for a label, the section it's in */
+	u16 file;	/* where it first shows up */
+	u32 lineNum;
+	u32 colNum;
+	asm_SymbolKind kind;
+	bool relocatable;	/* a label in a relocatable section only has its address once it's linked */
 	bool resolved;
-	struct asm_SymbolTableEntry *next;
 } asm_SymbolTableEntry;
 
+/*
+*  Internal struct for a block of the arena the symbols are allocated from
+*/
+typedef struct asm_ArenaBlock {
+	struct asm_ArenaBlock *next;
+	size_t used;
+	u8 data[asm_ARENA_BLOCK_SIZE];
+} asm_ArenaBlock;
+
+/*
+*  Internal struct for the symbol table: an open-addressing hash table (with linear probing) of pointers into the arena.
+*  The slot count is a power of 2 and at most half of the slots are used.
+*/
+typedef struct {
+	asm_SymbolTableEntry **slots;
+	u32 slotCount;
+	u32 symbolCount;
+	u32 unresolvedCount;
+	asm_ArenaBlock *arena;
+} asm_SymbolTable;
+
 typedef s8 asm_Token;
 #define asm_TOKEN_ERROR		-1
 #define asm_TOKEN_OPCODE	0
@@ -51,7 +90,8 @@ typedef s8 asm_Token;
 #define asm_TOKEN_COMMA		10
 #define asm_TOKEN_CONSTANT	11
 #define asm_TOKEN_IDENTIFIER	12
-#define asm_TOKEN_STRING	1
+#define asm_TOKEN_STRING	13
+#define asm_TOKEN_END		14
 
 typedef s8 asm_OperandSize;
 #define asm_SIZE_INFER		-1
@@ -59,10 +99,384 @@ typedef s8 asm_OperandSize;
 #define asm_SIZE_WORD		1
 #define asm_SIZE_POINTER	2
 
-static char asm_errorString[err_MAX_ERR_SIZE];
+/*
+*  Internal struct for one lexed token. The offset is from the start of its file's text, and the line and column are where it starts.
+*/
+typedef struct {
+	u32 offset;
+	u32 length;
+	u32 lineNum;
+	u32 colNum;
+	u16 file;
+	asm_Token type;
+} asm_LexedToken;
+
+/*
+*  Internal struct for a statement that has to be assembled again once more symbols are resolved
+*/
+typedef struct {
+	u32 firstToken;
+	u32 section;
+	u32 pgc;
+	u32 size;
+} asm_Statement;
+
+typedef struct {
+	asm_Statement *statements;
+	u32 count;
+	u32 capacity;
+} asm_StatementList;
+
+/*
+*  Internal struct for one diagnostic. The message (and the path, unless it's asm_NO_PATH) is stored in the diagnostic list's text buffer.
+*/
+typedef struct {
+	asm_Severity severity;
+	asm_DiagnosticCode code;
+	u32 lineNum;
+	u32 colNum;
+	size_t pathOffset;
+	size_t messageOffset;
+} asm_StoredDiagnostic;
+
+/*
+*  Internal struct for a list of diagnostics (the last assembly's, or an object's). The list and the text buffer double when they fill up,
+*  and the error string is only put together when something asks for it.
+*/
+typedef struct {
+	asm_StoredDiagnostic *diagnostics;
+	u32 count;
+	u32 capacity;
+	char *text;
+	size_t textSize;
+	size_t textCapacity;
+	const char *lastPath;	/* diagnostics from the same file share its path */
+	size_t lastPathOffset;
+	char *errorString;
+	size_t errorStringSize;
+	bool errorStringValid;
+	bool outOfMemory;
+} asm_DiagnosticList;
+
+/*
+*  Internal struct for a run of code in an object, stored back to back with the others. A relocatable section starts at 0 and goes
+*  wherever the linker puts it, and an absolute one (started by .ORG) goes at its origin. The path, line and column are where it starts.
+*/
+typedef struct {
+	u32 origin;
+	u32 size;
+	u32 codeOffset;
+	u32 address;	/* where the linker put it */
+	u32 pathOffset;
+	u32 lineNum;
+	u32 colNum;
+	bool absolute;
+} asm_Section;
+
+/*
+*  Internal struct for one of an object's symbols. A label's value is its address in its section, and an import is defined by another object.
+*  The name and path are offsets into the object's names.
+*/
+typedef struct {
+	u32 nameOffset;
+	u32 nameLength;
+	u32 pathOffset;
+	u32 lineNum;
+	u32 colNum;
+	s32 value;
+	u32 section;
+	asm_SymbolKind kind;
+} asm_ObjectSymbol;
+
+/*
+*  Internal struct for a place in an object's code that gets a symbol's value (little-endian, size bytes of it) when the object is linked
+*/
+typedef struct {
+	u32 section;
+	u32 codeOffset;
+	u32 symbol;
+	u32 size;
+	u32 pathOffset;
+	u32 lineNum;
+	u32 colNum;
+} asm_Relocation;
+
+struct asm_Object {
+	asm_Section *sections;
+	u32 sectionCount;
+	u32 sectionCapacity;
+	
+	u8 *code;
+	u32 codeSize;
+	u32 codeCapacity;
+	
+	asm_ObjectSymbol *symbols;
+	u32 symbolCount;
+	
+	asm_Relocation *relocations;
+	u32 relocationCount;
+	u32 relocationCapacity;
+	
+	/* the symbols' names and the files' paths, each null-terminated */
+	char *names;
+	u32 namesSize;
+	u32 namesCapacity;
+	
+	/* every file the object was assembled from (as offsets into the names), starting with the one given to asm_assembleObject() */
+	u32 *sourcePaths;
+	u32 sourceCount;
+	u32 sourceCapacity;
+	
+	char title[128];
+	char author[96];
+	
+	asm_DiagnosticList diagnostics;
+	bool hasError;
+};
+
+/*
+*  Internal struct for one file of the source: the one being assembled, or one it includes.
+*  The path is NULL for a source that isn't from a file, and the text is only the parser's to free if textSize isn't 0.
+*/
+typedef struct {
+	char *path;
+	u32 pathOffset;	/* in the object's names */
+	const char *text;
+	size_t textSize;
+} asm_SourceFile;
+
+/*
+*  Internal parser struct: the whole source and the files it includes, lexed once, and the token to read next.
+*  The last token is always asm_TOKEN_END. The fields after next describe the last token read.
+*/
+typedef struct {
+	asm_Object *object;
+	asm_SourceFile *files;
+	u32 fileCount;
+	u32 fileCapacity;
+	asm_LexedToken *tokens;
+	u32 tokenCount;
+	u32 tokenCapacity;
+	u32 next;
+	const char *tokenStart;
+	u16 file;
+	const char *path;
+	u32 lineNum;
+	u32 colNum;
+} asm_Parser;
+
+/* the diagnostics from the last assembly or link */
+static asm_DiagnosticList asm_diagnostics;
+
+/* the ROM image from the last link */
+static u8 *asm_romImage;
+static u32 asm_romImageSize;
+
+/*
+*  Forget the diagnostics in the list (but keep the memory for the next ones).
+*/
+static void asm_clearDiagnostics(asm_DiagnosticList *list) {
+	list->count = 0;
+	list->textSize = 0;
+	list->lastPath = NULL;
+	list->errorStringValid = FALSE;
+	list->outOfMemory = FALSE;
+}
+
+/*
+*  Free the memory used by the diagnostic list.
+*/
+static void asm_freeDiagnostics(asm_DiagnosticList *list) {
+	if (list->diagnostics != NULL) drv_reallocate(list->diagnostics, list->capacity * sizeof(asm_StoredDiagnostic), 0);
+	if (list->text != NULL) drv_reallocate(list->text, list->textCapacity, 0);
+	if (list->errorString != NULL) drv_reallocate(list->errorString, list->errorStringSize, 0);
+	
+	memset(list, 0, sizeof(asm_DiagnosticList));
+}
+
+/*
+*  Make room for size more bytes in the list's text buffer. Return FALSE on failure or TRUE on success.
+*/
+static bool asm_reserveDiagnosticText(asm_DiagnosticList *list, size_t size) {
+	if (list->textSize + size > list->textCapacity) {
+		size_t capacity = list->textCapacity ? list->textCapacity : asm_MIN_DIAGNOSTIC_TEXT;
+		while (list->textSize + size > capacity) capacity *= 2;
+		
+		char *text = drv_reallocate(list->text, list->textCapacity, capacity);
+		if (text == NULL) {
+			list->text = NULL;
+			list->textSize = 0;
+			list->textCapacity = 0;
+			list->count = 0;
+			list->lastPath = NULL;
+			list->outOfMemory = TRUE;
+			return FALSE;
+		}
+		
+		list->text = text;
+		list->textCapacity = capacity;
+	}
+	
+	return TRUE;
+}
+
+/*
+*  Add a diagnostic with a printf-style message to the list. The path is the file it's in, or NULL if it isn't from a file.
+*  If there's no memory for it, asm_getError() says so instead.
+*/
+static void asm_addDiagnostic(asm_DiagnosticList *list, asm_Severity severity, asm_DiagnosticCode code, const char *path, u32 lineNum, u32 colNum, const char *format, ...) {
+	va_list args;
+	
+	va_start(args, format);
+	s32 length = vsnprintf(NULL, 0, format, args);
+	va_end(args);
+	
+	if (length < 0) length = 0;
+	
+	if (list->count == list->capacity) {
+		u32 capacity = list->capacity ? list->capacity * 2 : asm_MIN_DIAGNOSTICS;
+		asm_StoredDiagnostic *diagnostics = drv_reallocate(list->diagnostics, list->capacity * sizeof(asm_StoredDiagnostic), capacity * sizeof(asm_StoredDiagnostic));
+		
+		if (diagnostics == NULL) {
+			list->diagnostics = NULL;
+			list->count = 0;
+			list->capacity = 0;
+			list->outOfMemory = TRUE;
+			return;
+		}
+		
+		list->diagnostics = diagnostics;
+		list->capacity = capacity;
+	}
+	
+	size_t pathOffset = asm_NO_PATH;
+	
+	if (path != NULL && path == list->lastPath) {
+		pathOffset = list->lastPathOffset;
+	}
+	else if (path != NULL) {
+		size_t pathLength = strlen(path) + 1;
+		if (!asm_reserveDiagnosticText(list, pathLength)) return;
+		
+		memcpy(list->text + list->textSize, path, pathLength);
+		pathOffset = list->textSize;
+		list->textSize += pathLength;
+		
+		list->lastPath = path;
+		list->lastPathOffset = pathOffset;
+	}
+	
+	if (!asm_reserveDiagnosticText(list, length + 1)) return;
+	
+	va_start(args, format);
+	vsnprintf(list->text + list->textSize, length + 1, format, args);
+	va_end(args);
+	
+	asm_StoredDiagnostic *diagnostic = &list->diagnostics[list->count++];
+	diagnostic->severity = severity;
+	diagnostic->code = code;
+	diagnostic->lineNum = lineNum;
+	diagnostic->colNum = colNum;
+	diagnostic->pathOffset = pathOffset;
+	diagnostic->messageOffset = list->textSize;
+	
+	list->textSize += length + 1;
+	list->errorStringValid = FALSE;
+}
+
+/*
+*  Add every diagnostic in one list to the end of another.
+*/
+static void asm_copyDiagnostics(asm_DiagnosticList *dest, const asm_DiagnosticList *src) {
+	if (src->outOfMemory) {
+		asm_addDiagnostic(dest, asm_SEVERITY_ERROR, asm_ERROR_OUT_OF_MEMORY, NULL, 0, 0, "Out of memory for the assembler's error messages");
+	}
+	
+	for (u32 i = 0; i < src->count; i++) {
+		const asm_StoredDiagnostic *diagnostic = &src->diagnostics[i];
+		const char *path = diagnostic->pathOffset == asm_NO_PATH ? NULL : src->text + diagnostic->pathOffset;
+		
+		asm_addDiagnostic(dest, diagnostic->severity, diagnostic->code, path, diagnostic->lineNum, diagnostic->colNum, "%s", src->text + diagnostic->messageOffset);
+	}
+}
+
+/*
+*  Format one diagnostic the way asm_getError() shows it, and return the length it needs (like snprintf).
+*/
+static s32 asm_formatDiagnostic(char *dest, size_t size, const asm_StoredDiagnostic *diagnostic) {
+	const char *severity = diagnostic->severity == asm_SEVERITY_WARNING ? "Warning: " : "";
+	const char *message = asm_diagnostics.text + diagnostic->messageOffset;
+	
+	if (diagnostic->pathOffset != asm_NO_PATH) {
+		const char *path = asm_diagnostics.text + diagnostic->pathOffset;
+		
+		if (diagnostic->lineNum == 0) {
+			return snprintf(dest, size, "%s: %s%s\n", path, severity, message);
+		}
+		else {
+			return snprintf(dest, size, "%s, line %u, column %u: %s%s\n", path, diagnostic->lineNum, diagnostic->colNum, severity, message);
+		}
+	}
+	else if (diagnostic->lineNum == 0) {
+		return snprintf(dest, size, "%s%s\n", severity, message);
+	}
+	else {
+		return snprintf(dest, size, "Line %u, column %u: %s%s\n", diagnostic->lineNum, diagnostic->colNum, severity, message);
+	}
+}
 
 char *asm_getError(void) {
-	return asm_errorString;
+	asm_DiagnosticList *list = &asm_diagnostics;
+	static char outOfMemory[] = "Out of memory for the assembler's error messages\n";
+	static char empty[] = "";
+	
+	if (list->outOfMemory) return outOfMemory;
+	if (list->count == 0) return empty;
+	if (list->errorStringValid) return list->errorString;
+	
+	size_t size = 1;
+	for (u32 i = 0; i < list->count; i++) {
+		size += asm_formatDiagnostic(NULL, 0, &list->diagnostics[i]);
+	}
+	
+	if (size > list->errorStringSize) {
+		char *errorString = drv_reallocate(list->errorString, list->errorStringSize, size);
+		if (errorString == NULL) {
+			list->errorString = NULL;
+			list->errorStringSize = 0;
+			return outOfMemory;
+		}
+		
+		list->errorString = errorString;
+		list->errorStringSize = size;
+	}
+	
+	size_t used = 0;
+	for (u32 i = 0; i < list->count; i++) {
+		used += asm_formatDiagnostic(list->errorString + used, size - used, &list->diagnostics[i]);
+	}
+	list->errorString[used] = '\0';
+	
+	list->errorStringValid = TRUE;
+	return list->errorString;
+}
+
+u32 asm_getDiagnosticCount(void) {
+	return asm_diagnostics.count;
+}
+
+bool asm_getDiagnostic(u32 index, asm_Diagnostic *diagnostic) {
+	if (index >= asm_diagnostics.count) return FALSE;
+	
+	const asm_StoredDiagnostic *stored = &asm_diagnostics.diagnostics[index];
+	diagnostic->severity = stored->severity;
+	diagnostic->code = stored->code;
+	diagnostic->lineNum = stored->lineNum;
+	diagnostic->colNum = stored->colNum;
+	diagnostic->path = stored->pathOffset == asm_NO_PATH ? NULL : asm_diagnostics.text + stored->pathOffset;
+	diagnostic->message = asm_diagnostics.text + stored->messageOffset;
+	
+	return TRUE;
 }
 
 #define asm_IS_ALPHA(ch) (((ch) >= 'a' && (ch) <= 'z') || ((ch) >= 'A' && (ch) <= 'Z') || (ch) == '_' || (ch) == '.')
@@ -77,10 +491,12 @@ char *asm_getError(void) {
 #define asm_IS_PGC(c0, c1, c2, c3) ((c0) == 'P' && (c1) == 'G' && (c2) == 'C' && !asm_IS_ALPHA(c3) && !asm_IS_DIGIT(c3))
 
 /*
-*  Advance the given lexer past the end of the next token and return its length, or -1 if there is an error.
+*  Advance the given lexer past the end of the next token and return its type, or asm_TOKEN_ERROR if there is an error.
 */
-static asm_Token asm_getNextToken(asm_Lexer *lexer, size_t *length) {
-	while (*lexer->current != '\0') {
+static asm_Token asm_getNextToken(asm_Lexer *lexer) {
+	bool skipping = TRUE;
+	
+	while (skipping && *lexer->current != '\0') {
 		switch (*lexer->current) {
 			case ';': {
 				while (*lexer->current != '\n' && *lexer->current != '\0') {
@@ -102,11 +518,18 @@ static asm_Token asm_getNextToken(asm_Lexer *lexer, size_t *length) {
 				lexer->current++;
 				break;
 			default:
+				skipping = FALSE;
 				break;
 		}
 	}
 	
 	lexer->tokenStart = lexer->current;
+	lexer->tokenLineNum = lexer->lineNum;
+	lexer->tokenColNum = lexer->colNum;
+	
+	if (*lexer->current == '\0') {
+		return asm_TOKEN_END;
+	}
 	
 	if (lexer->hasNewLine) {
 		lexer->hasNewLine = FALSE;
@@ -120,10 +543,6 @@ static asm_Token asm_getNextToken(asm_Lexer *lexer, size_t *length) {
 				lexer->colNum++;
 			}
 			
-			if (length != NULL) {
-				*length = lexer->current - lexer->tokenStart;
-			}
-			
 			return asm_TOKEN_DIRECTIVE;
 		}
 		else if (asm_IS_ALPHA(*lexer->current)) {
@@ -135,10 +554,6 @@ static asm_Token asm_getNextToken(asm_Lexer *lexer, size_t *length) {
 				lexer->colNum++;
 			}
 			
-			if (length != NULL) {
-				*length = lexer->current - lexer->tokenStart;
-			}
-			
 			if (*lexer->current == ':') {
 				lexer->current++;
 				lexer->colNum++;
@@ -160,10 +575,6 @@ static asm_Token asm_getNextToken(asm_Lexer *lexer, size_t *length) {
 			lexer->current = strPart;
 			lexer->colNum += (lexer->current - lexer->tokenStart);
 			
-			if (length != NULL) {
-				*length = lexer->current - lexer->tokenStart;
-			}
-			
 			if (!constant && errno) {
 				return asm_TOKEN_ERROR;
 			}
@@ -176,7 +587,10 @@ static asm_Token asm_getNextToken(asm_Lexer *lexer, size_t *length) {
 			lexer->colNum++;
 			
 			while (*lexer->current != '"') {
-				if (*lexer->current == '\n') {
+				if (*lexer->current == '\0') {
+					return asm_TOKEN_ERROR;
+				}
+				else if (*lexer->current == '\n') {
 					lexer->current++;
 					lexer->lineNum++;
 					lexer->colNum = 1;
@@ -187,9 +601,9 @@ static asm_Token asm_getNextToken(asm_Lexer *lexer, size_t *length) {
 				}
 			}
 			
-			if (length != NULL) {
-				*length = lexer->current - lexer->tokenStart;
-			}
+			/* the closing quote is part of the token too */
+			lexer->current++;
+			lexer->colNum++;
 			
 			return asm_TOKEN_STRING;
 		}
@@ -197,40 +611,24 @@ static asm_Token asm_getNextToken(asm_Lexer *lexer, size_t *length) {
 			lexer->current += 2;
 			lexer->colNum += 2;
 			
-			if (length != NULL) {
-				*length = lexer->current - lexer->tokenStart;
-			}
-			
 			return asm_TOKEN_REGISTER_8;
 		}
 		else if (asm_IS_REGISTER_16(toupper(lexer->current[0]), toupper(lexer->current[1]), toupper(lexer->current[2]))) {
 			lexer->current += 2;
 			lexer->colNum += 2;
 			
-			if (length != NULL) {
-				*length = lexer->current - lexer->tokenStart;
-			}
-			
 			return asm_TOKEN_REGISTER_16;
 		}
 		else if (asm_IS_REGISTER_24(toupper(lexer->current[0]), toupper(lexer->current[1]), toupper(lexer->current[2]))) {
 			lexer->current += 2;
 			lexer->colNum += 2;
 			
-			if (length != NULL) {
-				*length = lexer->current - lexer->tokenStart;
-			}
-			
 			return asm_TOKEN_REGISTER_24;
 		}
 		else if (asm_IS_PGC(toupper(lexer->current[0]), toupper(lexer->current[1]), toupper(lexer->current[2]), toupper(lexer->current[3]))) {
 			lexer->current += 3;
 			lexer->colNum += 3;
 			
-			if (length != NULL) {
-				*length = lexer->current - lexer->tokenStart;
-			}
-			
 			return asm_TOKEN_PGC;
 		}
 		else if (*lexer->current == '@') {
@@ -266,10 +664,6 @@ static asm_Token asm_getNextToken(asm_Lexer *lexer, size_t *length) {
 				lexer->colNum++;
 			}
 			
-			if (length != NULL) {
-				*length = lexer->current - lexer->tokenStart;
-			}
-			
 			return asm_TOKEN_IDENTIFIER;
 		}
 		else {
@@ -279,106 +673,728 @@ static asm_Token asm_getNextToken(asm_Lexer *lexer, size_t *length) {
 }
 
 /*
-*  Reallocate the memory buffer used for the ROM using drv_reallocate and return the new buffer, or NULL if there is an error.
+*  Look up an instruction mnemonic or a directive (in any case) in the generated table, and return it, or NULL if there isn't one of that type.
+*/
+static inline const asm_Mnemonic *asm_lookupMnemonic(const char *name, size_t length, asm_MnemonicType type) {
+	const asm_Mnemonic *mnemonic = &asm_mnemonicTable[asm_hashMnemonic(name, length, asm_MNEMONIC_SEED) & (asm_MNEMONIC_SLOTS - 1)];
+	
+	/* every name has its own slot, so one compare is enough */
+	if (mnemonic->name == NULL || mnemonic->type != type || mnemonic->length != length || strncasecmp(mnemonic->name, name, length)) {
+		return NULL;
+	}
+	
+	return mnemonic;
+}
+
+/*
+*  Add a lexed token to the parser's token array. Return FALSE on failure or TRUE on success.
 */
-static u8 *asm_reallocateROM(u8 *oldROMBank, u8 *size, u32 *firstROMIndex) {
-	if (size != NULL) {
-		u8 newSize = *size;
+static bool asm_addToken(asm_Parser *parser, u16 file, u32 offset, u32 length, u32 lineNum, u32 colNum, asm_Token type) {
+	if (parser->tokenCount == parser->tokenCapacity) {
+		u32 capacity = parser->tokenCapacity ? parser->tokenCapacity * 2 : asm_MIN_TOKENS;
+		asm_LexedToken *tokens = drv_reallocate(parser->tokens, parser->tokenCapacity * sizeof(asm_LexedToken), capacity * sizeof(asm_LexedToken));
 		
-		if (firstROMIndex != NULL) {
-			newSize = (u8)((0x1000000 - *firstROMIndex) >> 16);
+		if (tokens == NULL) {
+			/* drv_reallocate already freed the old array */
+			parser->tokens = NULL;
+			parser->tokenCount = 0;
+			parser->tokenCapacity = 0;
+			return FALSE;
 		}
 		
-		u8 *ptr = drv_reallocate(oldROMBank, (u32)(*size) << 16, (u32)newSize << 16);
-		*size = newSize;
+		parser->tokens = tokens;
+		parser->tokenCapacity = capacity;
+	}
+	
+	asm_LexedToken *token = &parser->tokens[parser->tokenCount++];
+	token->offset = offset;
+	token->length = length;
+	token->lineNum = lineNum;
+	token->colNum = colNum;
+	token->file = file;
+	token->type = type;
+	
+	return TRUE;
+}
+
+/*
+*  Append length bytes of a name (and a null terminator) to the object's names, and put where it went in offset.
+*  Return FALSE on failure or TRUE on success.
+*/
+static bool asm_addName(asm_Object *object, const char *name, u32 length, u32 *offset) {
+	if (object->namesSize + length + 1 > object->namesCapacity) {
+		u32 capacity = object->namesCapacity ? object->namesCapacity : asm_MIN_NAMES;
+		while (object->namesSize + length + 1 > capacity) capacity *= 2;
 		
-		if (firstROMIndex != NULL) {
-			*firstROMIndex = 0x1000000 - ((u32)newSize << 16);
+		char *names = drv_reallocate(object->names, object->namesCapacity, capacity);
+		if (names == NULL) {
+			object->names = NULL;
+			object->namesSize = 0;
+			object->namesCapacity = 0;
+			return FALSE;
 		}
 		
-		return ptr;
+		object->names = names;
+		object->namesCapacity = capacity;
 	}
 	
-	return NULL;
+	memcpy(object->names + object->namesSize, name, length);
+	object->names[object->namesSize + length] = '\0';
+	
+	*offset = object->namesSize;
+	object->namesSize += length + 1;
+	
+	return TRUE;
 }
 
 /*
-*  Append a new symbol with the specified name onto the end of the symbol table and return it.
+*  Add a file to the parser, and its path to the object's source files. The parser takes the path, and the text too if textSize isn't 0.
+*  Return FALSE on failure (after freeing them) or TRUE on success.
 */
-static asm_SymbolTableEntry *asm_addSymbol(asm_SymbolTableEntry **symbolTable, asm_SymbolTableEntry *lastSymbol, const char *name, size_t nameLength) {
-	asm_SymbolTableEntry *newSymbol = drv_reallocate(NULL, 0, sizeof(asm_SymbolTableEntry));
-	newSymbol->symbol = name;
-	newSymbol->symbolLength = nameLength;
-	newSymbol->value = 0;
-	newSymbol->resolved = FALSE;
-	newSymbol->next = NULL;
+static bool asm_addSourceFile(asm_Parser *parser, char *path, const char *text, size_t textSize) {
+	asm_Object *object = parser->object;
+	bool added = FALSE;
 	
-	if (*symbolTable == NULL) {
-		*symbolTable = newSymbol;
+	if (parser->fileCount == parser->fileCapacity) {
+		u32 capacity = parser->fileCapacity ? parser->fileCapacity * 2 : asm_MIN_SOURCE_FILES;
+		asm_SourceFile *files = drv_reallocate(parser->files, parser->fileCapacity * sizeof(asm_SourceFile), capacity * sizeof(asm_SourceFile));
+		
+		if (files != NULL) {
+			parser->files = files;
+			parser->fileCapacity = capacity;
+		}
+		else {
+			parser->files = NULL;
+			parser->fileCount = 0;
+			parser->fileCapacity = 0;
+		}
 	}
-	else {
-		lastSymbol->next = newSymbol;
+	
+	if (object->sourceCount == object->sourceCapacity) {
+		u32 capacity = object->sourceCapacity ? object->sourceCapacity * 2 : asm_MIN_SOURCE_FILES;
+		u32 *sourcePaths = drv_reallocate(object->sourcePaths, object->sourceCapacity * sizeof(u32), capacity * sizeof(u32));
+		
+		if (sourcePaths != NULL) {
+			object->sourcePaths = sourcePaths;
+			object->sourceCapacity = capacity;
+		}
+		else {
+			object->sourcePaths = NULL;
+			object->sourceCount = 0;
+			object->sourceCapacity = 0;
+		}
 	}
 	
-	return newSymbol;
+	u32 pathOffset = asm_NO_PATH;
+	
+	if (parser->files != NULL && object->sourcePaths != NULL && (path == NULL || asm_addName(object, path, (u32)strlen(path), &pathOffset))) {
+		asm_SourceFile *file = &parser->files[parser->fileCount++];
+		file->path = path;
+		file->pathOffset = pathOffset;
+		file->text = text;
+		file->textSize = textSize;
+		
+		object->sourcePaths[object->sourceCount++] = pathOffset;
+		added = TRUE;
+	}
+	
+	if (!added) {
+		if (path != NULL) drv_reallocate(path, strlen(path) + 1, 0);
+		if (textSize != 0) drv_reallocate((char *)text, textSize, 0);
+		
+		asm_addDiagnostic(&object->diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OUT_OF_MEMORY, NULL, 0, 0, "Out of memory for the source files");
+	}
+	
+	return added;
 }
 
 /*
-*  Get a reference to the symbol with the specified name.
+*  Read the file an .INCLUDE directive names (relative to the directory of the file it's in) and add it to the parser.
+*  Return FALSE on failure (after adding a diagnostic) or TRUE on success.
 */
-static asm_SymbolTableEntry *asm_lookupSymbol(asm_SymbolTableEntry **symbolTable, const char *name, size_t nameLength) {
-	asm_SymbolTableEntry *sym = NULL;
+static bool asm_includeFile(asm_Parser *parser, u16 including, const char *name, u32 nameLength, u32 lineNum, u32 colNum) {
+	asm_DiagnosticList *diagnostics = &parser->object->diagnostics;
+	const char *includingPath = parser->files[including].path;
+	size_t directoryLength = 0;
+	
+	/* absolute paths stay as they are */
+	bool absolute = nameLength > 0 && (name[0] == '/' || name[0] == '\\' || (nameLength > 1 && name[1] == ':'));
+	
+	if (includingPath != NULL && !absolute) {
+		for (size_t i = 0; includingPath[i] != '\0'; i++) {
+			if (includingPath[i] == '/' || includingPath[i] == '\\') directoryLength = i + 1;
+		}
+	}
+	
+	char *path = drv_reallocate(NULL, 0, directoryLength + nameLength + 1);
+	if (path == NULL) {
+		asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OUT_OF_MEMORY, NULL, 0, 0, "Out of memory for the source files");
+		return FALSE;
+	}
+	
+	if (directoryLength > 0) memcpy(path, includingPath, directoryLength);
+	memcpy(path + directoryLength, name, nameLength);
+	path[directoryLength + nameLength] = '\0';
 	
-	if (symbolTable != NULL) {
-		for (sym = *symbolTable; sym->next != NULL; sym = sym->next) {
-			if (!strncmp(sym->symbol, name, (nameLength > sym->symbolLength) ? nameLength : sym->symbolLength)) {
-				return sym;
+	char *text = NULL;
+	size_t textSize = 0;
+	FILE *file = fopen(path, "rb");
+	
+	if (file != NULL) {
+		long length = -1;
+		if (!fseek(file, 0, SEEK_END)) length = ftell(file);
+		
+		if (length >= 0 && length < 0x7fffffff && !fseek(file, 0, SEEK_SET)) {
+			textSize = (size_t)length + 1;
+			text = drv_reallocate(NULL, 0, textSize);
+			
+			if (text != NULL && fread(text, 1, (size_t)length, file) == (size_t)length) {
+				text[length] = '\0';
+			}
+			else if (text != NULL) {
+				drv_reallocate(text, textSize, 0);
+				text = NULL;
 			}
 		}
+		fclose(file);
 	}
 	
-	return NULL;
+	if (text == NULL) {
+		asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_INCLUDE, includingPath, lineNum, colNum, "Couldn't read included file '%s'", path);
+		drv_reallocate(path, directoryLength + nameLength + 1, 0);
+		return FALSE;
+	}
+	
+	return asm_addSourceFile(parser, path, text, textSize);
 }
 
 /*
-*  Assemble a single RM operand in the assembler source and return the value that goes into the opcode, or -1 on error.
+*  Lex one of the parser's files into its token array, lexing the files it includes in their place.
+*  Only the source itself (at depth 0) ends with asm_TOKEN_END. Return FALSE on failure (after adding a diagnostic) or TRUE on success.
 */
-static s8 asm_assembleRMOperand(asm_Lexer *lexer, u32 *pgc, u32 firstROMIndex, u8 *assembledROMBank, asm_OperandSize size, u32 pass, bool *requiresMorePasses) {
-	size_t length;
+static bool asm_lexFile(asm_Parser *parser, u16 file, u32 depth) {
+	asm_DiagnosticList *diagnostics = &parser->object->diagnostics;
+	const char *text = parser->files[file].text;
+	asm_Lexer lexer;
 	
-	switch (asm_getNextToken(lexer, &length)) {
-		case asm_TOKEN_REGISTER_8: {
-			switch (size) {
-				case asm_SIZE_INFER:
-				case asm_SIZE_BYTE: {
-					s8 value = 0;
-					
-					if (lexer->tokenStart[0] == 'M') {
-						value |= 0x10;
-					}
-					
-					value |= (lexer->tokenStart[1] - '0') << 2;
-					return value;
+	lexer.current = text;
+	lexer.lineNum = 1;
+	lexer.colNum = 1;
+	lexer.hasNewLine = TRUE;
+	
+	asm_Token type;
+	
+	while ((type = asm_getNextToken(&lexer)) != asm_TOKEN_END || depth == 0) {
+		/* skip the character that didn't start a token, so lexing always moves on (the parser reports the error) */
+		if (type == asm_TOKEN_ERROR && lexer.current == lexer.tokenStart) {
+			lexer.current++;
+			lexer.colNum++;
+		}
+		
+		u32 length = (u32)(lexer.current - lexer.tokenStart);
+		
+		if (type == asm_TOKEN_DIRECTIVE) {
+			const asm_Mnemonic *directive = asm_lookupMnemonic(lexer.tokenStart, length, asm_MNEMONIC_DIRECTIVE);
+			
+			/* an included file's tokens go where the .INCLUDE was, so the parser never sees it */
+			if (directive != NULL && directive->handler == asm_DIRECTIVE_INCLUDE) {
+				u32 lineNum = lexer.tokenLineNum;
+				u32 colNum = lexer.tokenColNum;
+				
+				if (asm_getNextToken(&lexer) != asm_TOKEN_STRING) {
+					asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_MISSING_ARGUMENT, parser->files[file].path, lexer.tokenLineNum, lexer.tokenColNum, ".INCLUDE directive needs a file name string");
+					return FALSE;
 				}
-				case asm_SIZE_WORD: {
-					if (pass == 0) {
-						char err[err_MAX_ERR_SIZE];
-						
-						snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: Register operand is an 8-bit register, but operand size is .W (16-bit)\n", asm_errorString, lexer->lineNum, lexer->colNum);
-						strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-					}
-					
-					return -1;
+				
+				if (depth >= asm_MAX_INCLUDE_DEPTH) {
+					asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_INCLUDE, parser->files[file].path, lineNum, colNum, "Included files are nested too deeply (does a file include itself?)");
+					return FALSE;
 				}
-				case asm_SIZE_POINTER: {
-					if (pass == 0) {
-						char err[err_MAX_ERR_SIZE];
-						
-						snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: Register operand is an 8-bit register, but operand size is .P (24-bit)\n", asm_errorString, lexer->lineNum, lexer->colNum);
-						strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-					}
-					
-					return -1;
+				
+				if (parser->fileCount > 0xffff) {
+					asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_INCLUDE, parser->files[file].path, lineNum, colNum, "Too many included files");
+					return FALSE;
+				}
+				
+				/* the file name is the string without its quotes */
+				u32 included = parser->fileCount;
+				if (!asm_includeFile(parser, file, lexer.tokenStart + 1, (u32)(lexer.current - lexer.tokenStart) - 2, lexer.tokenLineNum, lexer.tokenColNum)) {
+					return FALSE;
+				}
+				
+				if (!asm_lexFile(parser, (u16)included, depth + 1)) {
+					return FALSE;
+				}
+				
+				/* the included file might have ended partway through a line */
+				lexer.hasNewLine = TRUE;
+				continue;
+			}
+		}
+		
+		/* a label's name doesn't include its colon */
+		if (type == asm_TOKEN_LABEL) {
+			length--;
+		}
+		
+		if (!asm_addToken(parser, file, (u32)(lexer.tokenStart - text), length, lexer.tokenLineNum, lexer.tokenColNum, type)) {
+			asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OUT_OF_MEMORY, NULL, 0, 0, "Out of memory for the lexed source");
+			return FALSE;
+		}
+		
+		if (type == asm_TOKEN_END) {
+			break;
+		}
+	}
+	
+	return TRUE;
+}
+
+/*
+*  Lex the whole source (and the files it includes) into the parser's token array, ending it with asm_TOKEN_END.
+*  Return FALSE on failure (after adding a diagnostic) or TRUE on success.
+*/
+static bool asm_lexSource(asm_Parser *parser, asm_Object *object, const char *source, const char *path) {
+	parser->object = object;
+	parser->files = NULL;
+	parser->fileCount = 0;
+	parser->fileCapacity = 0;
+	parser->tokens = NULL;
+	parser->tokenCount = 0;
+	parser->tokenCapacity = 0;
+	parser->next = 0;
+	
+	char *pathCopy = NULL;
+	
+	if (path != NULL) {
+		pathCopy = drv_reallocate(NULL, 0, strlen(path) + 1);
+		if (pathCopy == NULL) {
+			asm_addDiagnostic(&object->diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OUT_OF_MEMORY, NULL, 0, 0, "Out of memory for the source files");
+			return FALSE;
+		}
+		
+		memcpy(pathCopy, path, strlen(path) + 1);
+	}
+	
+	return asm_addSourceFile(parser, pathCopy, source, 0) && asm_lexFile(parser, 0, 0);
+}
+
+/*
+*  Free the parser's token array and the files it read.
+*/
+static void asm_freeParser(asm_Parser *parser) {
+	if (parser->tokens != NULL) {
+		drv_reallocate(parser->tokens, parser->tokenCapacity * sizeof(asm_LexedToken), 0);
+		parser->tokens = NULL;
+	}
+	
+	if (parser->files != NULL) {
+		for (u32 i = 0; i < parser->fileCount; i++) {
+			asm_SourceFile *file = &parser->files[i];
+			
+			if (file->path != NULL) drv_reallocate(file->path, strlen(file->path) + 1, 0);
+			if (file->textSize != 0) drv_reallocate((char *)file->text, file->textSize, 0);
+		}
+		
+		drv_reallocate(parser->files, parser->fileCapacity * sizeof(asm_SourceFile), 0);
+		parser->files = NULL;
+	}
+}
+
+/*
+*  Read the parser's next token and return its type. This never reads past the asm_TOKEN_END at the end.
+*/
+static asm_Token asm_readToken(asm_Parser *parser, size_t *length) {
+	asm_LexedToken *token = &parser->tokens[parser->next];
+	
+	if (token->type != asm_TOKEN_END) {
+		parser->next++;
+	}
+	
+	parser->tokenStart = parser->files[token->file].text + token->offset;
+	parser->file = token->file;
+	parser->path = parser->files[token->file].path;
+	parser->lineNum = token->lineNum;
+	parser->colNum = token->colNum;
+	
+	if (length != NULL) {
+		*length = token->length;
+	}
+	
+	return token->type;
+}
+
+/*
+*  Add a statement to the list. Return FALSE on failure or TRUE on success.
+*/
+static bool asm_addStatement(asm_StatementList *list, u32 firstToken, u32 section, u32 pgc, u32 size) {
+	if (list->count == list->capacity) {
+		u32 capacity = list->capacity ? list->capacity * 2 : asm_MIN_STATEMENTS;
+		asm_Statement *statements = drv_reallocate(list->statements, list->capacity * sizeof(asm_Statement), capacity * sizeof(asm_Statement));
+		
+		if (statements == NULL) {
+			list->statements = NULL;
+			list->count = 0;
+			list->capacity = 0;
+			return FALSE;
+		}
+		
+		list->statements = statements;
+		list->capacity = capacity;
+	}
+	
+	asm_Statement *statement = &list->statements[list->count++];
+	statement->firstToken = firstToken;
+	statement->section = section;
+	statement->pgc = pgc;
+	statement->size = size;
+	
+	return TRUE;
+}
+
+/*
+*  Free the statement list.
+*/
+static void asm_freeStatements(asm_StatementList *list) {
+	if (list->statements != NULL) {
+		drv_reallocate(list->statements, list->capacity * sizeof(asm_Statement), 0);
+		list->statements = NULL;
+	}
+}
+
+/*
+*  Start a new section in the object, at the given origin (0 for a relocatable one) and with where it starts in the source.
+*  Return FALSE on failure or TRUE on success.
+*/
+static bool asm_startSection(asm_Object *object, u32 origin, bool absolute, u32 pathOffset, u32 lineNum, u32 colNum) {
+	if (object->sectionCount == object->sectionCapacity) {
+		u32 capacity = object->sectionCapacity ? object->sectionCapacity * 2 : asm_MIN_SECTIONS;
+		asm_Section *sections = drv_reallocate(object->sections, object->sectionCapacity * sizeof(asm_Section), capacity * sizeof(asm_Section));
+		
+		if (sections == NULL) {
+			object->sections = NULL;
+			object->sectionCount = 0;
+			object->sectionCapacity = 0;
+			return FALSE;
+		}
+		
+		object->sections = sections;
+		object->sectionCapacity = capacity;
+	}
+	
+	asm_Section *section = &object->sections[object->sectionCount++];
+	section->origin = origin;
+	section->size = 0;
+	section->codeOffset = object->codeSize;
+	section->address = origin;
+	section->pathOffset = pathOffset;
+	section->lineNum = lineNum;
+	section->colNum = colNum;
+	section->absolute = absolute;
+	
+	return TRUE;
+}
+
+/*
+*  Put a byte of code at the given address in one of the object's sections. Only the last section can grow, one byte at a time.
+*  Return FALSE on failure (after adding a diagnostic) or TRUE on success.
+*/
+static bool asm_emitByte(asm_Object *object, u32 section, u32 pgc, u8 byte) {
+	asm_Section *sec = &object->sections[section];
+	u32 offset = sec->codeOffset + (pgc - sec->origin);
+	
+	if (offset >= object->codeSize) {
+		if (offset >= object->codeCapacity) {
+			u32 capacity = object->codeCapacity ? object->codeCapacity * 2 : asm_MIN_CODE;
+			u8 *code = drv_reallocate(object->code, object->codeCapacity, capacity);
+			
+			if (code == NULL) {
+				object->code = NULL;
+				object->codeSize = 0;
+				object->codeCapacity = 0;
+				
+				asm_addDiagnostic(&object->diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OUT_OF_MEMORY, NULL, 0, 0, "Out of memory for the assembled code");
+				object->hasError = TRUE;
+				return FALSE;
+			}
+			
+			object->code = code;
+			object->codeCapacity = capacity;
+		}
+		
+		object->codeSize = offset + 1;
+		sec->size = object->codeSize - sec->codeOffset;
+	}
+	
+	object->code[offset] = byte;
+	return TRUE;
+}
+
+/*
+*  Add a relocation for the size bytes at the given address in one of the object's sections, which get the symbol's value when it's linked.
+*  Return FALSE on failure or TRUE on success.
+*/
+static bool asm_addRelocation(asm_Object *object, u32 section, u32 pgc, u32 symbol, u32 size, u32 pathOffset, u32 lineNum, u32 colNum) {
+	if (object->relocationCount == object->relocationCapacity) {
+		u32 capacity = object->relocationCapacity ? object->relocationCapacity * 2 : asm_MIN_RELOCATIONS;
+		asm_Relocation *relocations = drv_reallocate(object->relocations, object->relocationCapacity * sizeof(asm_Relocation), capacity * sizeof(asm_Relocation));
+		
+		if (relocations == NULL) {
+			object->relocations = NULL;
+			object->relocationCount = 0;
+			object->relocationCapacity = 0;
+			return FALSE;
+		}
+		
+		object->relocations = relocations;
+		object->relocationCapacity = capacity;
+	}
+	
+	asm_Relocation *relocation = &object->relocations[object->relocationCount++];
+	relocation->section = section;
+	relocation->codeOffset = object->sections[section].codeOffset + (pgc - object->sections[section].origin);
+	relocation->symbol = symbol;
+	relocation->size = size;
+	relocation->pathOffset = pathOffset;
+	relocation->lineNum = lineNum;
+	relocation->colNum = colNum;
+	
+	return TRUE;
+}
+
+/*
+*  Hash a symbol name (FNV-1a).
+*/
+static inline u32 asm_hashSymbol(const char *name, size_t nameLength) {
+	u32 hash = 2166136261u;
+	
+	for (size_t i = 0; i < nameLength; i++) {
+		hash = (hash ^ (u8)name[i]) * 16777619u;
+	}
+	
+	return hash;
+}
+
+/*
+*  Allocate size bytes from the symbol table's arena, or return NULL if there is an error.
+*/
+static void *asm_allocateSymbolMemory(asm_SymbolTable *symbols, size_t size) {
+	asm_ArenaBlock *block = symbols->arena;
+	
+	if (block == NULL || block->used + size > asm_ARENA_BLOCK_SIZE) {
+		block = drv_reallocate(NULL, 0, sizeof(asm_ArenaBlock));
+		if (block == NULL) return NULL;
+		
+		block->next = symbols->arena;
+		block->used = 0;
+		symbols->arena = block;
+	}
+	
+	void *ptr = &block->data[block->used];
+	block->used += size;
+	
+	return ptr;
+}
+
+/*
+*  Set up an empty symbol table. Return FALSE on failure or TRUE on success.
+*/
+static bool asm_initSymbolTable(asm_SymbolTable *symbols) {
+	symbols->slotCount = asm_MIN_SYMBOL_SLOTS;
+	symbols->symbolCount = 0;
+	symbols->unresolvedCount = 0;
+	symbols->arena = NULL;
+	
+	symbols->slots = drv_reallocate(NULL, 0, symbols->slotCount * sizeof(asm_SymbolTableEntry *));
+	if (symbols->slots == NULL) return FALSE;
+	
+	memset(symbols->slots, 0, symbols->slotCount * sizeof(asm_SymbolTableEntry *));
+	return TRUE;
+}
+
+/*
+*  Free the symbol table, along with every symbol in it.
+*/
+static void asm_freeSymbolTable(asm_SymbolTable *symbols) {
+	while (symbols->arena != NULL) {
+		asm_ArenaBlock *next = symbols->arena->next;
+		drv_reallocate(symbols->arena, sizeof(asm_ArenaBlock), 0);
+		symbols->arena = next;
+	}
+	
+	if (symbols->slots != NULL) {
+		drv_reallocate(symbols->slots, symbols->slotCount * sizeof(asm_SymbolTableEntry *), 0);
+		symbols->slots = NULL;
+	}
+}
+
+/*
+*  Double the number of slots in the symbol table. Return FALSE on failure or TRUE on success.
+*/
+static bool asm_growSymbolTable(asm_SymbolTable *symbols) {
+	u32 slotCount = symbols->slotCount * 2;
+	asm_SymbolTableEntry **slots = drv_reallocate(NULL, 0, slotCount * sizeof(asm_SymbolTableEntry *));
+	if (slots == NULL) return FALSE;
+	
+	memset(slots, 0, slotCount * sizeof(asm_SymbolTableEntry *));
+	
+	/* the hashes are stored, so moving a symbol doesn't look at its name */
+	for (u32 i = 0; i < symbols->slotCount; i++) {
+		asm_SymbolTableEntry *sym = symbols->slots[i];
+		if (sym == NULL) continue;
+		
+		u32 slot = sym->hash & (slotCount - 1);
+		while (slots[slot] != NULL) slot = (slot + 1) & (slotCount - 1);
+		slots[slot] = sym;
+	}
+	
+	drv_reallocate(symbols->slots, symbols->slotCount * sizeof(asm_SymbolTableEntry *), 0);
+	symbols->slots = slots;
+	symbols->slotCount = slotCount;
+	
+	return TRUE;
+}
+
+/*
+*  Add a new, unresolved symbol with the specified name (first seen in the given file, line and column) to the symbol table and return it,
+*  or NULL if there is an error.
+*/
+static asm_SymbolTableEntry *asm_addSymbol(asm_SymbolTable *symbols, const char *name, size_t nameLength, u16 file, u32 lineNum, u32 colNum) {
+	if ((symbols->symbolCount + 1) * 2 > symbols->slotCount && !asm_growSymbolTable(symbols)) {
+		return NULL;
+	}
+	
+	asm_SymbolTableEntry *newSymbol = asm_allocateSymbolMemory(symbols, sizeof(asm_SymbolTableEntry));
+	if (newSymbol == NULL) return NULL;
+	
+	newSymbol->symbol = name;
+	newSymbol->symbolLength = nameLength;
+	newSymbol->hash = asm_hashSymbol(name, nameLength);
+	newSymbol->value = 0;
+	newSymbol->index = symbols->symbolCount;
+	newSymbol->owner = 0;
+	newSymbol->section = 0;
+	newSymbol->file = file;
+	newSymbol->lineNum = lineNum;
+	newSymbol->colNum = colNum;
+	newSymbol->kind = asm_SYMBOL_CONSTANT;
+	newSymbol->relocatable = FALSE;
+	newSymbol->resolved = FALSE;
+	
+	u32 slot = newSymbol->hash & (symbols->slotCount - 1);
+	while (symbols->slots[slot] != NULL) slot = (slot + 1) & (symbols->slotCount - 1);
+	symbols->slots[slot] = newSymbol;
+	
+	symbols->symbolCount++;
+	symbols->unresolvedCount++;
+	
+	return newSymbol;
+}
+
+/*
+*  Get a reference to the symbol with the specified name, or NULL if it isn't in the symbol table.
+*/
+static asm_SymbolTableEntry *asm_lookupSymbol(asm_SymbolTable *symbols, const char *name, size_t nameLength) {
+	u32 hash = asm_hashSymbol(name, nameLength);
+	
+	for (u32 slot = hash & (symbols->slotCount - 1); symbols->slots[slot] != NULL; slot = (slot + 1) & (symbols->slotCount - 1)) {
+		asm_SymbolTableEntry *sym = symbols->slots[slot];
+		
+		if (sym->hash == hash && sym->symbolLength == nameLength && !memcmp(sym->symbol, name, nameLength)) {
+			return sym;
+		}
+	}
+	
+	return NULL;
+}
+
+/*
+*  Give a symbol its value.
+*/
+static inline void asm_resolveSymbol(asm_SymbolTable *symbols, asm_SymbolTableEntry *symbol, s32 value) {
+	if (!symbol->resolved) {
+		symbols->unresolvedCount--;
+		symbol->resolved = TRUE;
+	}
+	
+	symbol->value = value;
+}
+
+/*
+*  Make every symbol in the table that was never resolved an import, for the linker to find in another object.
+*/
+static void asm_importUndefinedSymbols(asm_SymbolTable *symbols) {
+	for (u32 i = 0; i < symbols->slotCount; i++) {
+		asm_SymbolTableEntry *sym = symbols->slots[i];
+		
+		if (sym != NULL && !sym->resolved) {
+			sym->kind = asm_SYMBOL_IMPORT;
+			asm_resolveSymbol(symbols, sym, 0);
+		}
+	}
+}
+
+/*
+*  Copy the symbol table into the object's symbols, in the order they were added. Return FALSE on failure or TRUE on success.
+*/
+static bool asm_exportSymbols(asm_Object *object, asm_SymbolTable *symbols, asm_Parser *parser) {
+	if (symbols->symbolCount == 0) {
+		return TRUE;
+	}
+	
+	object->symbols = drv_reallocate(NULL, 0, symbols->symbolCount * sizeof(asm_ObjectSymbol));
+	if (object->symbols == NULL) return FALSE;
+	
+	object->symbolCount = symbols->symbolCount;
+	
+	for (u32 i = 0; i < symbols->slotCount; i++) {
+		asm_SymbolTableEntry *sym = symbols->slots[i];
+		if (sym == NULL) continue;
+		
+		asm_ObjectSymbol *objectSymbol = &object->symbols[sym->index];
+		if (!asm_addName(object, sym->symbol, (u32)sym->symbolLength, &objectSymbol->nameOffset)) return FALSE;
+		
+		objectSymbol->nameLength = (u32)sym->symbolLength;
+		objectSymbol->pathOffset = parser->files[sym->file].pathOffset;
+		objectSymbol->lineNum = sym->lineNum;
+		objectSymbol->colNum = sym->colNum;
+		objectSymbol->value = sym->value;
+		objectSymbol->section = sym->section;
+		objectSymbol->kind = sym->kind;
+	}
+	
+	return TRUE;
+}
+
+/*
+*  Assemble a single RM operand in the assembler source and return the value that goes into the opcode, or -1 on error.
+*/
+static s8 asm_assembleRMOperand(asm_Parser *parser, asm_SymbolTable *symbols, u32 section, u32 *pgc, asm_OperandSize size, bool *requiresMorePasses) {
+	size_t length;
+	
+	switch (asm_readToken(parser, &length)) {
+		case asm_TOKEN_REGISTER_8: {
+			switch (size) {
+				case asm_SIZE_INFER:
+				case asm_SIZE_BYTE: {
+					s8 value = 0;
+					
+					if (parser->tokenStart[0] == 'M') {
+						value |= 0x10;
+					}
+					
+					value |= (parser->tokenStart[1] - '0') << 2;
+					return value;
+				}
+				case asm_SIZE_WORD: {
+					asm_addDiagnostic(&parser->object->diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OPERAND_SIZE, parser->path, parser->lineNum, parser->colNum, "Register operand is an 8-bit register, but operand size is .W (16-bit)");
+					
+					return -1;
+				}
+				case asm_SIZE_POINTER: {
+					asm_addDiagnostic(&parser->object->diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OPERAND_SIZE, parser->path, parser->lineNum, parser->colNum, "Register operand is an 8-bit register, but operand size is .P (24-bit)");
+					
+					return -1;
 				}
 				default:
 					return -1;
@@ -387,26 +1403,16 @@ static s8 asm_assembleRMOperand(asm_Lexer *lexer, u32 *pgc, u32 firstROMIndex, u
 		case asm_TOKEN_REGISTER_16: {
 			switch (size) {
 				case asm_SIZE_BYTE: {
-					if (pass == 0) {
-						char err[err_MAX_ERR_SIZE];
-						
-						snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: Register operand is a 16-bit register, but operand size is .B (8-bit)\n", asm_errorString, lexer->lineNum, lexer->colNum);
-						strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-					}
+					asm_addDiagnostic(&parser->object->diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OPERAND_SIZE, parser->path, parser->lineNum, parser->colNum, "Register operand is a 16-bit register, but operand size is .B (8-bit)");
 					
 					return -1;
 				}
 				case asm_SIZE_INFER:
 				case asm_SIZE_WORD: {
-					return (lexer->tokenStart[1] - '0') << 2;
+					return (parser->tokenStart[1] - '0') << 2;
 				}
 				case asm_SIZE_POINTER: {
-					if (pass == 0) {
-						char err[err_MAX_ERR_SIZE];
-						
-						snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: Register operand is a 16-bit register, but operand size is .P (24-bit)\n", asm_errorString, lexer->lineNum, lexer->colNum);
-						strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-					}
+					asm_addDiagnostic(&parser->object->diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OPERAND_SIZE, parser->path, parser->lineNum, parser->colNum, "Register operand is a 16-bit register, but operand size is .P (24-bit)");
 					
 					return -1;
 				}
@@ -417,32 +1423,22 @@ static s8 asm_assembleRMOperand(asm_Lexer *lexer, u32 *pgc, u32 firstROMIndex, u
 		case asm_TOKEN_REGISTER_24: {
 			switch (size) {
 				case asm_SIZE_BYTE: {
-					if (pass == 0) {
-						char err[err_MAX_ERR_SIZE];
-						
-						snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: Register operand is a 24-bit register, but operand size is .B (8-bit)\n", asm_errorString, lexer->lineNum, lexer->colNum);
-						strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-					}
+					asm_addDiagnostic(&parser->object->diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OPERAND_SIZE, parser->path, parser->lineNum, parser->colNum, "Register operand is a 24-bit register, but operand size is .B (8-bit)");
 					
 					return -1;
 				}
 				case asm_SIZE_WORD: {
-					if (pass == 0) {
-						char err[err_MAX_ERR_SIZE];
-						
-						snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: Register operand is a 24-bit register, but operand size is .W (16-bit)\n", asm_errorString, lexer->lineNum, lexer->colNum);
-						strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-					}
+					asm_addDiagnostic(&parser->object->diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OPERAND_SIZE, parser->path, parser->lineNum, parser->colNum, "Register operand is a 24-bit register, but operand size is .W (16-bit)");
 					
 					return -1;
 				}
 				case asm_SIZE_INFER:
 				case asm_SIZE_POINTER: {
-					if (toupper(lexer->tokenStart[0]) == 'S') {
+					if (toupper(parser->tokenStart[0]) == 'S') {
 						return 0x1c;
 					}
 					else {
-						return (lexer->tokenStart[1] - '0') << 2;
+						return (parser->tokenStart[1] - '0') << 2;
 					}
 				}
 				default:
@@ -450,31 +1446,21 @@ static s8 asm_assembleRMOperand(asm_Lexer *lexer, u32 *pgc, u32 firstROMIndex, u
 			}
 		}
 		case asm_TOKEN_CONSTANT: {
-			s32 constant = asm_decodeConstant(lexer->tokenStart, NULL, TRUE);
+			s32 constant = asm_decodeConstant(parser->tokenStart, NULL, TRUE);
 			if (!constant && errno) {
-				if (pass == 0) {
-					char err[err_MAX_ERR_SIZE];
-				
-					snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: Error decoding immediate value for RM operand\n", asm_errorString, lexer->lineNum, lexer->colNum);
-					strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-				}
+				asm_addDiagnostic(&parser->object->diagnostics, asm_SEVERITY_ERROR, asm_ERROR_BAD_CONSTANT, parser->path, parser->lineNum, parser->colNum, "Error decoding immediate value for RM operand");
 				
 				return -1;
 			}
 			
 			if (constant > 0xffffff || constant < -0x8000) {
-				if (pass == 0) {
-					char err[err_MAX_ERR_SIZE];
-	
-					snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: Immediate value for RM operand out of range\n", asm_errorString, lexer->lineNum, lexer->colNum);
-					strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-				}
+				asm_addDiagnostic(&parser->object->diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OUT_OF_RANGE, parser->path, parser->lineNum, parser->colNum, "Immediate value for RM operand out of range");
 	
 				return -1;
 			}
 			else if (constant < 0x0000 || constant > 0x0010 && constant < 0x8000) {
-				assembledROMBank[((*pgc)++) - firstROMIndex] = constant & 0xff;
-				assembledROMBank[((*pgc)++) - firstROMIndex] = (constant >> 8) & 0xff;
+				asm_emitByte(parser->object, section, (*pgc)++, constant & 0xff);
+				asm_emitByte(parser->object, section, (*pgc)++, (constant >> 8) & 0xff);
 				
 				return 0x21;
 			}
@@ -482,41 +1468,41 @@ static s8 asm_assembleRMOperand(asm_Lexer *lexer, u32 *pgc, u32 firstROMIndex, u
 				return 0x03 | (constant << 2);
 			}
 			else {
-				assembledROMBank[((*pgc)++) - firstROMIndex] = constant & 0xff;
-				assembledROMBank[((*pgc)++) - firstROMIndex] = (constant >> 8) & 0xff;
-				assembledROMBank[((*pgc)++) - firstROMIndex] = (constant >> 16) & 0xff;
-				assembledROMBank[((*pgc)++) - firstROMIndex] = 0x00;
+				asm_emitByte(parser->object, section, (*pgc)++, constant & 0xff);
+				asm_emitByte(parser->object, section, (*pgc)++, (constant >> 8) & 0xff);
+				asm_emitByte(parser->object, section, (*pgc)++, (constant >> 16) & 0xff);
+				asm_emitByte(parser->object, section, (*pgc)++, 0x00);
 				
 				return 0x25;
 			}
 		}
 		case asm_TOKEN_IDENTIFIER: {
-			asm_SymbolTableEntry *symbol = asm_lookupSymbol(&symbolTable, lexer->tokenStart, length);
+			asm_SymbolTableEntry *symbol = asm_lookupSymbol(symbols, parser->tokenStart, length);
 			
 			if (symbol == NULL) {
-				symbol = asm_addSymbol(&symbolTable, lastSymbol, lexer->tokenStart, length);
-				lastSymbol = symbol;
+				symbol = asm_addSymbol(symbols, parser->tokenStart, length, parser->file, parser->lineNum, parser->colNum);
 				
 				*requiresMorePasses = TRUE;
 				
 				return 0x00;
 			}
+			else if (symbol->resolved && (symbol->kind == asm_SYMBOL_IMPORT || symbol->relocatable)) {
+				/* the operand's size depends on its value, which only the linker knows for these */
+				asm_addDiagnostic(&parser->object->diagnostics, asm_SEVERITY_ERROR, asm_ERROR_UNRESOLVABLE, parser->path, parser->lineNum, parser->colNum, "RM operand can't refer to a relocatable label or a symbol from another source");
+				
+				return -1;
+			}
 			else if (symbol->resolved) {
 				s32 value = symbol->value;
 				
 				if (value > 0xffffff || value < -0x8000) {
-					if (pass == 0) {
-						char err[err_MAX_ERR_SIZE];
-						
-						snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: Immediate value for RM operand out of range\n", asm_errorString, lexer->lineNum, lexer->colNum);
-						strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-					}
+					asm_addDiagnostic(&parser->object->diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OUT_OF_RANGE, parser->path, parser->lineNum, parser->colNum, "Immediate value for RM operand out of range");
 					
 					return -1;
 				}
 				else if (value < 0x0000 || value > 0x0010 && value < 0x8000) {
-					assembledROMBank[((*pgc)++) - firstROMIndex] = constant & 0xff;
-					assembledROMBank[((*pgc)++) - firstROMIndex] = (constant >> 8) & 0xff;
+					asm_emitByte(parser->object, section, (*pgc)++, value & 0xff);
+					asm_emitByte(parser->object, section, (*pgc)++, (value >> 8) & 0xff);
 				
 					return 0x21;
 				}
@@ -524,10 +1510,10 @@ static s8 asm_assembleRMOperand(asm_Lexer *lexer, u32 *pgc, u32 firstROMIndex, u
 					return 0x03 | (value << 2);
 				}
 				else {
-					assembledROMBank[((*pgc)++) - firstROMIndex] = value & 0xff;
-					assembledROMBank[((*pgc)++) - firstROMIndex] = (value >> 8) & 0xff;
-					assembledROMBank[((*pgc)++) - firstROMIndex] = (value >> 16) & 0xff;
-					assembledROMBank[((*pgc)++) - firstROMIndex] = 0x00;
+					asm_emitByte(parser->object, section, (*pgc)++, value & 0xff);
+					asm_emitByte(parser->object, section, (*pgc)++, (value >> 8) & 0xff);
+					asm_emitByte(parser->object, section, (*pgc)++, (value >> 16) & 0xff);
+					asm_emitByte(parser->object, section, (*pgc)++, 0x00);
 					
 					return 0x25;
 				}
@@ -539,140 +1525,124 @@ static s8 asm_assembleRMOperand(asm_Lexer *lexer, u32 *pgc, u32 firstROMIndex, u
 			}
 		}
 		case asm_TOKEN_AT: {
-			switch (asm_getNextToken(lexer, &length)) {
+			switch (asm_readToken(parser, &length)) {
 				case asm_TOKEN_CONSTANT: {
-					s32 constant = asm_decodeConstant(lexer->tokenStart, NULL, TRUE);
+					s32 constant = asm_decodeConstant(parser->tokenStart, NULL, TRUE);
 					if (!constant && errno) {
-						if (pass == 0) {
-							char err[err_MAX_ERR_SIZE];
-					
-							snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: Error decoding absolute value for RM operand\n", asm_errorString, lexer->lineNum, lexer->colNum);
-							strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-						}
+						asm_addDiagnostic(&parser->object->diagnostics, asm_SEVERITY_ERROR, asm_ERROR_BAD_CONSTANT, parser->path, parser->lineNum, parser->colNum, "Error decoding absolute value for RM operand");
 						
 						return -1;
 					}
 					else if (constant > 0xffffff || constant < -0x8000) {
-						if (pass == 0) {
-							char err[err_MAX_ERR_SIZE];
-							
-							snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: Absolute value for RM operand out of range\n", asm_errorString, lexer->lineNum, lexer->colNum);
-							strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-						}
+						asm_addDiagnostic(&parser->object->diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OUT_OF_RANGE, parser->path, parser->lineNum, parser->colNum, "Absolute value for RM operand out of range");
 						
 						return -1;
 					}
 					
-					asm_Token token = asm_getNextToken(lexer, &length);
+					asm_Token token = asm_readToken(parser, &length);
 					
 					if (token == asm_TOKEN_PLUS) {
-						switch (asm_getNextToken(lexer, &length)) {
+						switch (asm_readToken(parser, &length)) {
 							case asm_TOKEN_REGISTER_8: {
 								u8 indexWord = 0x00;
 								
-								if (lexer->tokenStart[0] == 'M') {
+								if (parser->tokenStart[0] == 'M') {
 									indexWord |= 0x04;
 								}
 								
-								indexWord |= (lexer->tokenStart[1] - '0');
+								indexWord |= (parser->tokenStart[1] - '0');
 								
-								assembledROMBank[((*pgc)++) - firstROMIndex] = constant & 0xff;
-								assembledROMBank[((*pgc)++) - firstROMIndex] = (constant >> 8) & 0xff;
-								assembledROMBank[((*pgc)++) - firstROMIndex] = (constant >> 16) & 0xff;
-								assembledROMBank[((*pgc)++) - firstROMIndex] = indexWord;
+								asm_emitByte(parser->object, section, (*pgc)++, constant & 0xff);
+								asm_emitByte(parser->object, section, (*pgc)++, (constant >> 8) & 0xff);
+								asm_emitByte(parser->object, section, (*pgc)++, (constant >> 16) & 0xff);
+								asm_emitByte(parser->object, section, (*pgc)++, indexWord);
 								
 								return 0x3d;
 							}
 							case asm_TOKEN_REGISTER_16: {
-								u8 indexWord = 0x40 | ((lexer->tokenStart[1] - '0') << 8);
+								u8 indexWord = 0x40 | ((parser->tokenStart[1] - '0') << 8);
 								
-								assembledROMBank[((*pgc)++) - firstROMIndex] = constant & 0xff;
-								assembledROMBank[((*pgc)++) - firstROMIndex] = (constant >> 8) & 0xff;
-								assembledROMBank[((*pgc)++) - firstROMIndex] = (constant >> 16) & 0xff;
-								assembledROMBank[((*pgc)++) - firstROMIndex] = indexWord;
+								asm_emitByte(parser->object, section, (*pgc)++, constant & 0xff);
+								asm_emitByte(parser->object, section, (*pgc)++, (constant >> 8) & 0xff);
+								asm_emitByte(parser->object, section, (*pgc)++, (constant >> 16) & 0xff);
+								asm_emitByte(parser->object, section, (*pgc)++, indexWord);
 								
 								return 0x3d;
 							}
 							case asm_TOKEN_REGISTER_24: {
 								u8 indexWord = 0x80;
 								
-								if (lexer->tokenStart[0] == 'S') {
+								if (parser->tokenStart[0] == 'S') {
 									indexWord |= 0x07;
 								}
 								else {
-									indexWord |= ((lexer->tokenStart[1] - '0') << 8);
+									indexWord |= ((parser->tokenStart[1] - '0') << 8);
 								}
 								
-								assembledROMBank[((*pgc)++) - firstROMIndex] = constant & 0xff;
-								assembledROMBank[((*pgc)++) - firstROMIndex] = (constant >> 8) & 0xff;
-								assembledROMBank[((*pgc)++) - firstROMIndex] = (constant >> 16) & 0xff;
-								assembledROMBank[((*pgc)++) - firstROMIndex] = indexWord;
+								asm_emitByte(parser->object, section, (*pgc)++, constant & 0xff);
+								asm_emitByte(parser->object, section, (*pgc)++, (constant >> 8) & 0xff);
+								asm_emitByte(parser->object, section, (*pgc)++, (constant >> 16) & 0xff);
+								asm_emitByte(parser->object, section, (*pgc)++, indexWord);
 								
 								return 0x3d;
 							}
 							case asm_TOKEN_IDENTIFIER: {
-								if (toupper(lexer->tokenStart[2]) == 'S' && toupper(lexer->tokenStart[3]) == 'X' && !asm_IS_ALPHA(lexer->tokenStart[4]) && !asm_IS_DIGIT(lexer->tokenStart[4])) {
-									if (asm_IS_REGISTER_8(toupper(lexer->tokenStart[0]), toupper(lexer->tokenStart[1]), ' ')) {
+								if (toupper(parser->tokenStart[2]) == 'S' && toupper(parser->tokenStart[3]) == 'X' && !asm_IS_ALPHA(parser->tokenStart[4]) && !asm_IS_DIGIT(parser->tokenStart[4])) {
+									if (asm_IS_REGISTER_8(toupper(parser->tokenStart[0]), toupper(parser->tokenStart[1]), ' ')) {
 										u8 indexWord = 0x08;
 										
-										if (lexer->tokenStart[0] == 'M') {
+										if (parser->tokenStart[0] == 'M') {
 											indexWord |= 0x04;
 										}
 										
-										indexWord |= (lexer->tokenStart[1] - '0');
+										indexWord |= (parser->tokenStart[1] - '0');
 										
-										assembledROMBank[((*pgc)++) - firstROMIndex] = constant & 0xff;
-										assembledROMBank[((*pgc)++) - firstROMIndex] = (constant >> 8) & 0xff;
-										assembledROMBank[((*pgc)++) - firstROMIndex] = (constant >> 16) & 0xff;
-										assembledROMBank[((*pgc)++) - firstROMIndex] = indexWord;
+										asm_emitByte(parser->object, section, (*pgc)++, constant & 0xff);
+										asm_emitByte(parser->object, section, (*pgc)++, (constant >> 8) & 0xff);
+										asm_emitByte(parser->object, section, (*pgc)++, (constant >> 16) & 0xff);
+										asm_emitByte(parser->object, section, (*pgc)++, indexWord);
 										
 										return 0x3d;
 									}
-									else if (asm_IS_REGISTER_16(toupper(lexer->tokenStart[0]), toupper(lexer->tokenStart[1]), ' ')) {
-										u8 indexWord = 0x48 | ((lexer->tokenStart[1] - '0') << 8);
+									else if (asm_IS_REGISTER_16(toupper(parser->tokenStart[0]), toupper(parser->tokenStart[1]), ' ')) {
+										u8 indexWord = 0x48 | ((parser->tokenStart[1] - '0') << 8);
 										
-										assembledROMBank[((*pgc)++) - firstROMIndex] = constant & 0xff;
-										assembledROMBank[((*pgc)++) - firstROMIndex] = (constant >> 8) & 0xff;
-										assembledROMBank[((*pgc)++) - firstROMIndex] = (constant >> 16) & 0xff;
-										assembledROMBank[((*pgc)++) - firstROMIndex] = indexWord;
+										asm_emitByte(parser->object, section, (*pgc)++, constant & 0xff);
+										asm_emitByte(parser->object, section, (*pgc)++, (constant >> 8) & 0xff);
+										asm_emitByte(parser->object, section, (*pgc)++, (constant >> 16) & 0xff);
+										asm_emitByte(parser->object, section, (*pgc)++, indexWord);
 										
 										return 0x3d;
 									}
 								}
 							}
 							default: {
-								if (pass == 0) {
-									char err[err_MAX_ERR_SIZE];
-									
-									snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: Syntax error\n", asm_errorString, lexer->lineNum, lexer->colNum);
-									strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-								}
+								asm_addDiagnostic(&parser->object->diagnostics, asm_SEVERITY_ERROR, asm_ERROR_SYNTAX, parser->path, parser->lineNum, parser->colNum, "Syntax error");
 								
 								return -1;
 							}
 						}
 					}
 					else if (constant < 0x8000 || constant > 0xff7fff) {
-						assembledROMBank[((*pgc)++) - firstROMIndex] = constant & 0xff;
-						assembledROMBank[((*pgc)++) - firstROMIndex] = (constant >> 8) & 0xff;
+						asm_emitByte(parser->object, section, (*pgc)++, constant & 0xff);
+						asm_emitByte(parser->object, section, (*pgc)++, (constant >> 8) & 0xff);
 						
 						return 0x29;
 					}
 					else {
-						assembledROMBank[((*pgc)++) - firstROMIndex] = constant & 0xff;
-						assembledROMBank[((*pgc)++) - firstROMIndex] = (constant >> 8) & 0xff;
-						assembledROMBank[((*pgc)++) - firstROMIndex] = (constant >> 16) & 0xff;
-						assembledROMBank[((*pgc)++) - firstROMIndex] = 0x00;
+						asm_emitByte(parser->object, section, (*pgc)++, constant & 0xff);
+						asm_emitByte(parser->object, section, (*pgc)++, (constant >> 8) & 0xff);
+						asm_emitByte(parser->object, section, (*pgc)++, (constant >> 16) & 0xff);
+						asm_emitByte(parser->object, section, (*pgc)++, 0x00);
 						
 						return 0x2d;
 					}
 				}
 				case asm_TOKEN_IDENTIFIER: {
-					asm_SymbolTableEntry *symbol = asm_lookupSymbol(&symbolTable, lexer->tokenStart, length);
+					asm_SymbolTableEntry *symbol = asm_lookupSymbol(symbols, parser->tokenStart, length);
 					
 					if (symbol == NULL) {
-						symbol = asm_addSymbol(&symbolTable, lastSymbol, lexer->tokenStart, length);
-						lastSymbol = symbol;
+						symbol = asm_addSymbol(symbols, parser->tokenStart, length, parser->file, parser->lineNum, parser->colNum);
 						
 						*requiresMorePasses = TRUE;
 						
@@ -683,32 +1653,27 @@ static s8 asm_assembleRMOperand(asm_Lexer *lexer, u32 *pgc, u32 firstROMIndex, u
 						s32 pgcValue = value - *pgc;
 						
 						if (value > 0xffffff || value < -0x8000) {
-							if (pass == 0) {
-								char err[err_MAX_ERR_SIZE];
-						
-								snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: Absolute value for RM operand out of range\n", asm_errorString, lexer->lineNum, lexer->colNum);
-								strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-							}
+							asm_addDiagnostic(&parser->object->diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OUT_OF_RANGE, parser->path, parser->lineNum, parser->colNum, "Absolute value for RM operand out of range");
 							
 							return -1;
 						}
 						if (value < 0x8000 || value > 0xff7fff) {
-							assembledROMBank[((*pgc)++) - firstROMIndex] = value & 0xff;
-							assembledROMBank[((*pgc)++) - firstROMIndex] = (value >> 8) & 0xff;
+							asm_emitByte(parser->object, section, (*pgc)++, value & 0xff);
+							asm_emitByte(parser->object, section, (*pgc)++, (value >> 8) & 0xff);
 							
 							return 0x29;
 						}
 						else if (pgcValue < 0x8000 || pgcValue > 0xff7fff) {
-							assembledROMBank[((*pgc)++) - firstROMIndex] = pgcValue & 0xff;
-							assembledROMBank[((*pgc)++) - firstROMIndex] = (pgcValue >> 8) & 0xff;
+							asm_emitByte(parser->object, section, (*pgc)++, pgcValue & 0xff);
+							asm_emitByte(parser->object, section, (*pgc)++, (pgcValue >> 8) & 0xff);
 							
 							return 0x31;
 						}
 						else {
-							assembledROMBank[((*pgc)++) - firstROMIndex] = value & 0xff;
-							assembledROMBank[((*pgc)++) - firstROMIndex] = (value >> 8) & 0xff;
-							assembledROMBank[((*pgc)++) - firstROMIndex] = (value >> 16) & 0xff;
-							assembledROMBank[((*pgc)++) - firstROMIndex] = 0x00;
+							asm_emitByte(parser->object, section, (*pgc)++, value & 0xff);
+							asm_emitByte(parser->object, section, (*pgc)++, (value >> 8) & 0xff);
+							asm_emitByte(parser->object, section, (*pgc)++, (value >> 16) & 0xff);
+							asm_emitByte(parser->object, section, (*pgc)++, 0x00);
 							
 							return 0x2d;
 						}
@@ -722,51 +1687,36 @@ static s8 asm_assembleRMOperand(asm_Lexer *lexer, u32 *pgc, u32 firstROMIndex, u
 				case asm_TOKEN_REGISTER_24: {
 					u8 regNumber = 0x00;
 					
-					if (lexer->tokenStart[0] == 'S') {
+					if (parser->tokenStart[0] == 'S') {
 						regNumber = 0x1c;
 					}
 					else {
-						regNumber |= ((lexer->tokenStart[1] - '0') << 2);
+						regNumber |= ((parser->tokenStart[1] - '0') << 2);
 					}
 					
-					switch (asm_getNextToken(lexer, &length)) {
+					switch (asm_readToken(parser, &length)) {
 						case asm_TOKEN_PLUS: {
-							switch (asm_getNextToken(lexer, &length)) {
+							switch (asm_readToken(parser, &length)) {
 								case asm_TOKEN_CONSTANT: {
-									s32 constant = asm_decodeConstant(lexer->tokenStart, NULL, TRUE);
+									s32 constant = asm_decodeConstant(parser->tokenStart, NULL, TRUE);
 									if (!constant && errno) {
-										if (pass == 0) {
-											char err[err_MAX_ERR_SIZE];
-											
-											snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: Error decoding register relative value for RM operand\n", asm_errorString, lexer->lineNum, lexer->colNum);
-											strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-										}
+										asm_addDiagnostic(&parser->object->diagnostics, asm_SEVERITY_ERROR, asm_ERROR_BAD_CONSTANT, parser->path, parser->lineNum, parser->colNum, "Error decoding register relative value for RM operand");
 										
 										return -1;
 									}
 									else if (constant > 0xffffff || constant < -0x8000) {
-										if (pass == 0) {
-											char err[err_MAX_ERR_SIZE];
-											
-											snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: Register relative value for RM operand out of range\n", asm_errorString, lexer->lineNum, lexer->colNum);
-											strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-										}
+										asm_addDiagnostic(&parser->object->diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OUT_OF_RANGE, parser->path, parser->lineNum, parser->colNum, "Register relative value for RM operand out of range");
 										
 										return -1;
 									}
 									else if (constant < 0x8000 || constant > 0xff7fff) {
-										assembledROMBank[((*pgc)++) - firstROMIndex] = constant & 0xff;
-										assembledROMBank[((*pgc)++) - firstROMIndex] = (constant >> 8) & 0xff;
+										asm_emitByte(parser->object, section, (*pgc)++, constant & 0xff);
+										asm_emitByte(parser->object, section, (*pgc)++, (constant >> 8) & 0xff);
 										
 										return 0x01 | regNumber;
 									}
 									else {
-										if (pass == 0) {
-											char err[err_MAX_ERR_SIZE];
-											
-											snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: Register relative value for RM operand out of range\n", asm_errorString, lexer->lineNum, lexer->colNum);
-											strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-										}
+										asm_addDiagnostic(&parser->object->diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OUT_OF_RANGE, parser->path, parser->lineNum, parser->colNum, "Register relative value for RM operand out of range");
 										
 										return -1;
 									}
@@ -774,61 +1724,61 @@ static s8 asm_assembleRMOperand(asm_Lexer *lexer, u32 *pgc, u32 firstROMIndex, u
 								case asm_TOKEN_REGISTER_8: {
 									u8 indexWord = 0x00;
 									
-									if (lexer->tokenStart[0] == 'M') {
+									if (parser->tokenStart[0] == 'M') {
 										indexWord |= 0x04;
 									}
 									
-									indexWord |= (lexer->tokenStart[1] - '0');
+									indexWord |= (parser->tokenStart[1] - '0');
 									
-									assembledROMBank[((*pgc)++) - firstROMIndex] = regNumber;
-									assembledROMBank[((*pgc)++) - firstROMIndex] = indexWord;
+									asm_emitByte(parser->object, section, (*pgc)++, regNumber);
+									asm_emitByte(parser->object, section, (*pgc)++, indexWord);
 									
 									return 0x39;
 								}
 								case asm_TOKEN_REGISTER_16: {
-									u8 indexWord = 0x40 | ((lexer->tokenStart[1] - '0') << 8);
+									u8 indexWord = 0x40 | ((parser->tokenStart[1] - '0') << 8);
 									
-									assembledROMBank[((*pgc)++) - firstROMIndex] = regNumber;
-									assembledROMBank[((*pgc)++) - firstROMIndex] = indexWord;
+									asm_emitByte(parser->object, section, (*pgc)++, regNumber);
+									asm_emitByte(parser->object, section, (*pgc)++, indexWord);
 									
 									return 0x39;
 								}
 								case asm_TOKEN_REGISTER_24: {
 									u8 indexWord = 0x80;
 									
-									if (lexer->tokenStart[0] == 'S') {
+									if (parser->tokenStart[0] == 'S') {
 										indexWord |= 0x07;
 									}
 									else {
-										indexWord |= ((lexer->tokenStart[1] - '0') << 8);
+										indexWord |= ((parser->tokenStart[1] - '0') << 8);
 									}
 									
-									assembledROMBank[((*pgc)++) - firstROMIndex] = regNumber;
-									assembledROMBank[((*pgc)++) - firstROMIndex] = indexWord;
+									asm_emitByte(parser->object, section, (*pgc)++, regNumber);
+									asm_emitByte(parser->object, section, (*pgc)++, indexWord);
 									
 									return 0x39;
 								}
 								case asm_TOKEN_IDENTIFIER: {
-									if (toupper(lexer->tokenStart[2]) == 'S' && toupper(lexer->tokenStart[3]) == 'X' && !asm_IS_ALPHA(lexer->tokenStart[4]) && !asm_IS_DIGIT(lexer->tokenStart[4])) {
-										if (asm_IS_REGISTER_8(toupper(lexer->tokenStart[0]), toupper(lexer->tokenStart[1]), ' ')) {
+									if (toupper(parser->tokenStart[2]) == 'S' && toupper(parser->tokenStart[3]) == 'X' && !asm_IS_ALPHA(parser->tokenStart[4]) && !asm_IS_DIGIT(parser->tokenStart[4])) {
+										if (asm_IS_REGISTER_8(toupper(parser->tokenStart[0]), toupper(parser->tokenStart[1]), ' ')) {
 											u8 indexWord = 0x08;
 											
-											if (lexer->tokenStart[0] == 'M') {
+											if (parser->tokenStart[0] == 'M') {
 												indexWord |= 0x04;
 											}
 											
-											indexWord |= (lexer->tokenStart[1] - '0');
+											indexWord |= (parser->tokenStart[1] - '0');
 											
-											assembledROMBank[((*pgc)++) - firstROMIndex] = regNumber;
-											assembledROMBank[((*pgc)++) - firstROMIndex] = indexWord;
+											asm_emitByte(parser->object, section, (*pgc)++, regNumber);
+											asm_emitByte(parser->object, section, (*pgc)++, indexWord);
 										
 											return 0x39;
 										}
-										else if (asm_IS_REGISTER_16(toupper(lexer->tokenStart[0]), toupper(lexer->tokenStart[1]), ' ')) {
-											u8 indexWord = 0x48 | ((lexer->tokenStart[1] - '0') << 8);
+										else if (asm_IS_REGISTER_16(toupper(parser->tokenStart[0]), toupper(parser->tokenStart[1]), ' ')) {
+											u8 indexWord = 0x48 | ((parser->tokenStart[1] - '0') << 8);
 											
-											assembledROMBank[((*pgc)++) - firstROMIndex] = regNumber;
-											assembledROMBank[((*pgc)++) - firstROMIndex] = indexWord;
+											asm_emitByte(parser->object, section, (*pgc)++, regNumber);
+											asm_emitByte(parser->object, section, (*pgc)++, indexWord);
 											
 											return 0x39;
 										}
@@ -840,12 +1790,7 @@ static s8 asm_assembleRMOperand(asm_Lexer *lexer, u32 *pgc, u32 firstROMIndex, u
 									return 0x20 | regNumber;
 								}
 								default: {
-									if (pass == 0) {
-										char err[err_MAX_ERR_SIZE];
-										
-										snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: Syntax error\n", asm_errorString, lexer->lineNum, lexer->colNum);
-										strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-									}
+									asm_addDiagnostic(&parser->object->diagnostics, asm_SEVERITY_ERROR, asm_ERROR_SYNTAX, parser->path, parser->lineNum, parser->colNum, "Syntax error");
 									
 									return -1;
 								}
@@ -857,64 +1802,48 @@ static s8 asm_assembleRMOperand(asm_Lexer *lexer, u32 *pgc, u32 firstROMIndex, u
 							return 0x02 | regNumber;
 						}
 						default: {
-							if (pass == 0) {
-								char err[err_MAX_ERR_SIZE];
-								
-								snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: Syntax error\n", asm_errorString, lexer->lineNum, lexer->colNum);
-								strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-							}
+							asm_addDiagnostic(&parser->object->diagnostics, asm_SEVERITY_ERROR, asm_ERROR_SYNTAX, parser->path, parser->lineNum, parser->colNum, "Syntax error");
 							
 							return -1;
 						}
 					}
 				}
 				case asm_TOKEN_PGC: {
-					switch (asm_getNextToken(lexer, &length)) {
+					switch (asm_readToken(parser, &length)) {
 						case asm_TOKEN_PLUS: {
-							switch (asm_getNextToken(lexer, &length)) {
+							switch (asm_readToken(parser, &length)) {
 								case asm_TOKEN_CONSTANT: {
-									s32 constant = asm_decodeConstant(lexer->tokenStart, NULL, TRUE);
+									s32 constant = asm_decodeConstant(parser->tokenStart, NULL, TRUE);
 									if (!constant && errno) {
-										if (pass == 0) {
-											char err[err_MAX_ERR_SIZE];
-											
-											snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: Error decoding PGC relative value for RM operand\n", asm_errorString, lexer->lineNum, lexer->colNum);
-											strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-										}
+										asm_addDiagnostic(&parser->object->diagnostics, asm_SEVERITY_ERROR, asm_ERROR_BAD_CONSTANT, parser->path, parser->lineNum, parser->colNum, "Error decoding PGC relative value for RM operand");
 										
 										return -1;
 									}
 									else if (constant > 0xffffff || constant < -0x8000) {
-										if (pass == 0) {
-											char err[err_MAX_ERR_SIZE];
-											
-											snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: PGC relative value for RM operand out of range\n", asm_errorString, lexer->lineNum, lexer->colNum);
-											strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-										}
+										asm_addDiagnostic(&parser->object->diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OUT_OF_RANGE, parser->path, parser->lineNum, parser->colNum, "PGC relative value for RM operand out of range");
 										
 										return -1;
 									}
 									else if (constant < 0x8000 || constant > 0xff7fff) {
-										assembledROMBank[((*pgc)++) - firstROMIndex] = constant & 0xff;
-										assembledROMBank[((*pgc)++) - firstROMIndex] = (constant >> 8) & 0xff;
+										asm_emitByte(parser->object, section, (*pgc)++, constant & 0xff);
+										asm_emitByte(parser->object, section, (*pgc)++, (constant >> 8) & 0xff);
 										
 										return 0x31;
 									}
 									else {
-										assembledROMBank[((*pgc)++) - firstROMIndex] = constant & 0xff;
-										assembledROMBank[((*pgc)++) - firstROMIndex] = (constant >> 8) & 0xff;
-										assembledROMBank[((*pgc)++) - firstROMIndex] = (constant >> 16) & 0xff;
-										assembledROMBank[((*pgc)++) - firstROMIndex] = 0x00;
+										asm_emitByte(parser->object, section, (*pgc)++, constant & 0xff);
+										asm_emitByte(parser->object, section, (*pgc)++, (constant >> 8) & 0xff);
+										asm_emitByte(parser->object, section, (*pgc)++, (constant >> 16) & 0xff);
+										asm_emitByte(parser->object, section, (*pgc)++, 0x00);
 										
 										return 0x35;
 									}
 								}
 								case asm_TOKEN_IDENTIFIER: {
-									asm_SymbolTableEntry *symbol = asm_lookupSymbol(&symbolTable, lexer->tokenStart, length);
+									asm_SymbolTableEntry *symbol = asm_lookupSymbol(symbols, parser->tokenStart, length);
 			
 									if (symbol == NULL) {
-										symbol = asm_addSymbol(&symbolTable, lastSymbol, lexer->tokenStart, length);
-										lastSymbol = symbol;
+										symbol = asm_addSymbol(symbols, parser->tokenStart, length, parser->file, parser->lineNum, parser->colNum);
 				
 										*requiresMorePasses = TRUE;
 				
@@ -924,26 +1853,21 @@ static s8 asm_assembleRMOperand(asm_Lexer *lexer, u32 *pgc, u32 firstROMIndex, u
 										s32 value = symbol->value;
 										
 										if (value > 0xffffff || value < -0x8000) {
-											if (pass == 0) {
-												char err[err_MAX_ERR_SIZE];
-						
-												snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: Immediate value for RM operand out of range\n", asm_errorString, lexer->lineNum, lexer->colNum);
-												strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-											}
+											asm_addDiagnostic(&parser->object->diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OUT_OF_RANGE, parser->path, parser->lineNum, parser->colNum, "Immediate value for RM operand out of range");
 											
 											return -1;
 										}
 										if (value < 0x8000 || value > 0xff7fff) {
-											assembledROMBank[((*pgc)++) - firstROMIndex] = value & 0xff;
-											assembledROMBank[((*pgc)++) - firstROMIndex] = (value >> 8) & 0xff;
+											asm_emitByte(parser->object, section, (*pgc)++, value & 0xff);
+											asm_emitByte(parser->object, section, (*pgc)++, (value >> 8) & 0xff);
 											
 											return 0x31;
 										}
 										else {
-											assembledROMBank[((*pgc)++) - firstROMIndex] = value & 0xff;
-											assembledROMBank[((*pgc)++) - firstROMIndex] = (value >> 8) & 0xff;
-											assembledROMBank[((*pgc)++) - firstROMIndex] = (value >> 16) & 0xff;
-											assembledROMBank[((*pgc)++) - firstROMIndex] = 0x00;
+											asm_emitByte(parser->object, section, (*pgc)++, value & 0xff);
+											asm_emitByte(parser->object, section, (*pgc)++, (value >> 8) & 0xff);
+											asm_emitByte(parser->object, section, (*pgc)++, (value >> 16) & 0xff);
+											asm_emitByte(parser->object, section, (*pgc)++, 0x00);
 											
 											return 0x35;
 										}
@@ -955,12 +1879,7 @@ static s8 asm_assembleRMOperand(asm_Lexer *lexer, u32 *pgc, u32 firstROMIndex, u
 									}
 								}
 								default: {
-									if (pass == 0) {
-										char err[err_MAX_ERR_SIZE];
-								
-										snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: Syntax error\n", asm_errorString, lexer->lineNum, lexer->colNum);
-										strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-									}
+									asm_addDiagnostic(&parser->object->diagnostics, asm_SEVERITY_ERROR, asm_ERROR_SYNTAX, parser->path, parser->lineNum, parser->colNum, "Syntax error");
 							
 									return -1;
 								}
@@ -969,392 +1888,1028 @@ static s8 asm_assembleRMOperand(asm_Lexer *lexer, u32 *pgc, u32 firstROMIndex, u
 						case asm_TOKEN_LABEL:
 						case asm_TOKEN_DIRECTIVE:
 						case asm_TOKEN_OPCODE: {
-							assembledROMBank[((*pgc)++) - firstROMIndex] = 0x00;
-							assembledROMBank[((*pgc)++) - firstROMIndex] = 0x00;
+							asm_emitByte(parser->object, section, (*pgc)++, 0x00);
+							asm_emitByte(parser->object, section, (*pgc)++, 0x00);
 							
 							return 0x31;
 						}
 						default: {
-							if (pass == 0) {
-								char err[err_MAX_ERR_SIZE];
-								
-								snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: Syntax error\n", asm_errorString, lexer->lineNum, lexer->colNum);
-								strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-							}
+							asm_addDiagnostic(&parser->object->diagnostics, asm_SEVERITY_ERROR, asm_ERROR_SYNTAX, parser->path, parser->lineNum, parser->colNum, "Syntax error");
 							
 							return -1;
 						}
 					}
 				}
 				case asm_TOKEN_MINUS: {
-					switch (asm_getNextToken(lexer, &length)) {
+					switch (asm_readToken(parser, &length)) {
 						case asm_TOKEN_REGISTER_24: {
 							u8 regNumber = 0x00;
 							
-							if (lexer->tokenStart[0] == 'S') {
+							if (parser->tokenStart[0] == 'S') {
 								regNumber = 0x1c;
 							}
 							else {
-								regNumber |= ((lexer->tokenStart[1] - '0') << 2);
+								regNumber |= ((parser->tokenStart[1] - '0') << 2);
 							}
 							
 							return 0x22 | regNumber;
 						}
 						default: {
-							if (pass == 0) {
-								char err[err_MAX_ERR_SIZE];
-								
-								snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: Syntax error\n", asm_errorString, lexer->lineNum, lexer->colNum);
-								strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-							}
+							asm_addDiagnostic(&parser->object->diagnostics, asm_SEVERITY_ERROR, asm_ERROR_SYNTAX, parser->path, parser->lineNum, parser->colNum, "Syntax error");
 							
 							return -1;
 						}
 					}
 				}
 				default: {
-					if (pass == 0) {
-						char err[err_MAX_ERR_SIZE];
-						
-						snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: Syntax error\n", asm_errorString, lexer->lineNum, lexer->colNum);
-						strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-					}
+					asm_addDiagnostic(&parser->object->diagnostics, asm_SEVERITY_ERROR, asm_ERROR_SYNTAX, parser->path, parser->lineNum, parser->colNum, "Syntax error");
 					
 					return -1;
 				}
 			}
 		}
 		default: {
-			if (pass == 0) {
-				char err[err_MAX_ERR_SIZE];
-				
-				snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: Syntax error\n", asm_errorString, lexer->lineNum, lexer->colNum);
-				strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-			}
+			asm_addDiagnostic(&parser->object->diagnostics, asm_SEVERITY_ERROR, asm_ERROR_SYNTAX, parser->path, parser->lineNum, parser->colNum, "Syntax error");
 			
 			return -1;
 		}
 	}
 }
 
-bool asm_assembleToROMImage(const char *assemblyCode) {
-	snprintf(asm_errorString, err_MAX_ERR_SIZE, "");
+asm_Object *asm_assembleObject(const char *assemblyCode, const char *path) {
+	asm_Object *object = drv_reallocate(NULL, 0, sizeof(asm_Object));
+	if (object == NULL) return NULL;
 	
-	const char *title = "(No title)";
-	const char *developer = "(No developer)";
+	memset(object, 0, sizeof(asm_Object));
 	
-	asm_Lexer lexer;
+	asm_Parser parser;
+	asm_DiagnosticList *diagnostics = &object->diagnostics;
 	
-	bool hasError = FALSE;
+	bool assembled = FALSE;
 	
-	u32 pgc;
+	u32 section = 0;
+	u32 pgc = 0;
 	
-	asm_SymbolTableEntry *symbolTable = NULL;
-	asm_SymbolTableEntry *lastSymbol = NULL;
+	asm_SymbolTable symbolTable;
+	asm_SymbolTable *symbols = &symbolTable;
+	
+	if (!asm_lexSource(&parser, object, assemblyCode, path)) {
+		asm_freeParser(&parser);
+		object->hasError = TRUE;
+		return object;
+	}
 	
-	u8 romSize = 0x00;
-	u32 firstROMIndex = 0xff0000;
+	if (!asm_initSymbolTable(symbols)) {
+		asm_freeParser(&parser);
+		asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OUT_OF_MEMORY, NULL, 0, 0, "Out of memory for the symbol table");
+		object->hasError = TRUE;
+		return object;
+	}
 	
-	u8 *assembledROMBank = asm_reallocateROM(NULL, &romSize, &firstROMIndex);
+	/* the statements that depend on a symbol that wasn't resolved when they were last assembled */
+	asm_StatementList pending = { NULL, 0, 0 };
+	bool layoutChanged = FALSE;
 	
-	for (u32 pass = 0; pass < asm_MAX_PASSES; pass++) {
-		lexer.current = assemblyCode;
-		lexer.lineNum = 1;
-		lexer.colNum = 0;
-		lexer.hasNewLine = TRUE;
+	for (u32 pass = 0; pass < asm_MAX_PASSES && !assembled && !object->hasError; pass++) {
+		/*
+		*  A full pass assembles every statement. After that, only the pending statements get assembled again (at the
+		*  addresses they had before), until one of them changes size or a label moves, which needs another full pass.
+		*/
+		bool fullPass = pass == 0 || layoutChanged;
+		u32 revisited = 0;
+		u32 stillPending = 0;
 		
-		pgc = 0xff0000;
+		layoutChanged = FALSE;
 		
-		bool requiresMorePasses = FALSE;
+		if (fullPass) {
+			pending.count = 0;
+			parser.next = 0;
+			
+			/* the code and relocations are all put together again, starting with a relocatable section */
+			object->sectionCount = 0;
+			object->codeSize = 0;
+			object->relocationCount = 0;
+			
+			if (!asm_startSection(object, 0, FALSE, parser.files[0].pathOffset, 0, 0)) {
+				asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OUT_OF_MEMORY, NULL, 0, 0, "Out of memory for the sections");
+				object->hasError = TRUE;
+				break;
+			}
+			
+			section = 0;
+			pgc = 0;
+		}
 		
-		while (*lexer.current != '\0') {
+		while (fullPass ? parser.tokens[parser.next].type != asm_TOKEN_END : revisited < pending.count) {
 			size_t length;
 			
-			switch (asm_getNextToken(&lexer, &length)) {
+			if (!fullPass) {
+				parser.next = pending.statements[revisited].firstToken;
+				section = pending.statements[revisited].section;
+				pgc = pending.statements[revisited].pgc;
+				revisited++;
+			}
+			
+			u32 firstToken = parser.next;
+			u32 firstSection = section;
+			u32 firstPGC = pgc;
+			bool requiresMorePasses = FALSE;
+			
+			switch (asm_readToken(&parser, &length)) {
 				case asm_TOKEN_DIRECTIVE: {
-					if (!strncasecmp(lexer.tokenStart, ".ORG", length)) {
-						if (asm_getNextToken(&lexer, &length) != asm_TOKEN_CONSTANT) {
-							if (pass == 0) {
-								char err[err_MAX_ERR_SIZE];
-							
-								snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: .ORG directive needs a literal value\n", asm_errorString, lexer.lineNum, lexer.colNum);
-								strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-								hasError = TRUE;
-							}
+					const asm_Mnemonic *directive = asm_lookupMnemonic(parser.tokenStart, length, asm_MNEMONIC_DIRECTIVE);
+					
+					if (directive == NULL) {
+						asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_UNKNOWN_MNEMONIC, parser.path, parser.lineNum, parser.colNum, "Unknown directive '%.*s'", (int)length, parser.tokenStart);
+						object->hasError = TRUE;
+					}
+					else if (directive->handler == asm_DIRECTIVE_ORG) {
+						u32 lineNum = parser.lineNum;
+						u32 colNum = parser.colNum;
+						
+						if (asm_readToken(&parser, &length) != asm_TOKEN_CONSTANT) {
+							asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_MISSING_ARGUMENT, parser.path, parser.lineNum, parser.colNum, ".ORG directive needs a literal value");
+							object->hasError = TRUE;
 						}
 						else {
-							s32 constant = asm_decodeConstant(lexer.tokenStart, NULL, TRUE);
+							s32 constant = asm_decodeConstant(parser.tokenStart, NULL, TRUE);
 							if (!constant && errno) {
-								if (pass == 0) {
-									char err[err_MAX_ERR_SIZE];
-									
-									snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: Error decoding literal constant for .ORG directive\n", asm_errorString, lexer.lineNum, lexer.colNum);
-									strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-									hasError = TRUE;
-								}
+								asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_BAD_CONSTANT, parser.path, parser.lineNum, parser.colNum, "Error decoding literal constant for .ORG directive");
+								object->hasError = TRUE;
 							}
 							else if (constant < 0x010000 || constant > 0xffffff) {
-								if (pass == 0) {
-									char err[err_MAX_ERR_SIZE];
-									
-									snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: .ORG directive out of range (valid values are $010000-$FFFFFF)\n", asm_errorString, lexer.lineNum, lexer.colNum);
-									strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-									hasError = TRUE;
-								}
+								asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OUT_OF_RANGE, parser.path, parser.lineNum, parser.colNum, ".ORG directive out of range (valid values are $010000-$FFFFFF)");
+								object->hasError = TRUE;
 							}
 							else {
-								if (constant < firstROMIndex) {
-									firstROMIndex = constant & 0xff0000;
-									
-									assembledROMBank = asm_reallocateROM(assembledROMBank, &romSize, &firstROMIndex);
+								/* the code after an .ORG stays where it says, so it gets its own section */
+								if (!asm_startSection(object, (u32)constant, TRUE, parser.files[parser.file].pathOffset, lineNum, colNum)) {
+									asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OUT_OF_MEMORY, NULL, 0, 0, "Out of memory for the sections");
+									object->hasError = TRUE;
+									break;
 								}
 								
+								section = object->sectionCount - 1;
 								pgc = (u32)constant;
 							}
 						}
 						break;
 					}
-					else if (!strncasecmp(lexer.tokenStart, ".HXH_TITLE", length)) {
-						if (asm_getNextToken(&lexer, &length) != asm_TOKEN_STRING) {
-							if (pass == 0) {
-								char err[err_MAX_ERR_SIZE];
-								
-								snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: .HXH_TITLE directive needs a title string\n", asm_errorString, lexer.lineNum, lexer.colNum);
-								strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-								hasError = TRUE;
-							}
+					else if (directive->handler == asm_DIRECTIVE_HXH_TITLE) {
+						if (asm_readToken(&parser, &length) != asm_TOKEN_STRING) {
+							asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_MISSING_ARGUMENT, parser.path, parser.lineNum, parser.colNum, ".HXH_TITLE directive needs a title string");
+							object->hasError = TRUE;
 						}
-						else if (length > 127) {
-							if (pass == 0) {
-								char err[err_MAX_ERR_SIZE];
-								
-								snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: ROM title is too long (maximum length: 127 bytes)\n", asm_errorString, lexer.lineNum, lexer.colNum);
-								strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-								hasError = TRUE;
-							}
+						else if (length - 2 > 127) {
+							asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OUT_OF_RANGE, parser.path, parser.lineNum, parser.colNum, "ROM title is too long (maximum length: 127 bytes)");
+							object->hasError = TRUE;
 						}
 						else {
-							memcpy(&assembledROMBank[(romSize << 16) - (0x10000 - 0x9f00)], lexer.tokenStart + sizeof(char), length);
+							memset(object->title, 0, sizeof(object->title));
+							memcpy(object->title, parser.tokenStart + sizeof(char), length - 2);
 						}
 					}
-					else if (!strncasecmp(lexer.tokenStart, ".HXH_AUTHOR", length)) {
-						if (asm_getNextToken(&lexer, &length) != asm_TOKEN_STRING) {
-							if (pass == 0) {
-								char err[err_MAX_ERR_SIZE];
-								
-								snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: .HXH_AUTHOR directive needs an author string\n", asm_errorString, lexer.lineNum, lexer.colNum);
-								strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-								hasError = TRUE;
-							}
+					else if (directive->handler == asm_DIRECTIVE_HXH_AUTHOR) {
+						if (asm_readToken(&parser, &length) != asm_TOKEN_STRING) {
+							asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_MISSING_ARGUMENT, parser.path, parser.lineNum, parser.colNum, ".HXH_AUTHOR directive needs an author string");
+							object->hasError = TRUE;
 						}
-						else if (length > 95) {
-							if (pass == 0) {
-								char err[err_MAX_ERR_SIZE];
-								
-								snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: ROM author is too long (maximum length: 95 bytes)\n", asm_errorString, lexer.lineNum, lexer.colNum);
-								strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-								hasError = TRUE;
-							}
+						else if (length - 2 > 95) {
+							asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OUT_OF_RANGE, parser.path, parser.lineNum, parser.colNum, "ROM author is too long (maximum length: 95 bytes)");
+							object->hasError = TRUE;
 						}
 						else {
-							memcpy(&assembledROMBank[(romSize << 16) - (0x10000 - 0x9f00) + 128], lexer.tokenStart + sizeof(char), length);
+							memset(object->author, 0, sizeof(object->author));
+							memcpy(object->author, parser.tokenStart + sizeof(char), length - 2);
 						}
 					}
-					else if (!strncasecmp(lexer.tokenStart, ".DEFINE", length)) {
-						if (asm_getNextToken(&lexer, &length) == asm_TOKEN_IDENTIFIER) {
-							asm_SymbolTableEntry *symbol = asm_lookupSymbol(&symbolTable, lexer.tokenStart, length);
+					else if (directive->handler == asm_DIRECTIVE_DEFINE) {
+						if (asm_readToken(&parser, &length) == asm_TOKEN_IDENTIFIER) {
+							asm_SymbolTableEntry *symbol = asm_lookupSymbol(symbols, parser.tokenStart, length);
 							
 							if (symbol == NULL) {
-								symbol = asm_addSymbol(&symbolTable, lastSymbol, lexer.tokenStart, length);
-								lastSymbol = symbol;
+								symbol = asm_addSymbol(symbols, parser.tokenStart, length, parser.file, parser.lineNum, parser.colNum);
 							}
+							if (symbol == NULL) {
+								asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OUT_OF_MEMORY, parser.path, parser.lineNum, parser.colNum, "Out of memory for the symbol table");
+								object->hasError = TRUE;
+								break;
+							}
+							
+							/* a symbol is added where it's first used, but the linker reports where it's defined */
+							symbol->file = parser.file;
+							symbol->lineNum = parser.lineNum;
+							symbol->colNum = parser.colNum;
 							
-							if (asm_getNextToken(&lexer, &length) == asm_TOKEN_CONSTANT) {
-								s32 constant = asm_decodeConstant(lexer.tokenStart, NULL, TRUE);
+							if (asm_readToken(&parser, &length) == asm_TOKEN_CONSTANT) {
+								s32 constant = asm_decodeConstant(parser.tokenStart, NULL, TRUE);
 							
 								if (!constant && errno) {
-									if (pass == 0) {
-										char err[err_MAX_ERR_SIZE];
-									
-										snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: Error decoding literal constant for .DEFINE directive\n", asm_errorString, lexer.lineNum, lexer.colNum);
-										strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-										hasError = TRUE;
-									}
+									asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_BAD_CONSTANT, parser.path, parser.lineNum, parser.colNum, "Error decoding literal constant for .DEFINE directive");
+									object->hasError = TRUE;
 								}
 								else {
-									symbol->resolved = TRUE;
-									symbol->value = constant;
+									symbol->kind = asm_SYMBOL_CONSTANT;
+									asm_resolveSymbol(symbols, symbol, constant);
 								}
 							}
 							else {
-								if (pass == 0) {
-									char err[err_MAX_ERR_SIZE];
-									
-									snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: .DEFINE directive argument must be a literal constant\n", asm_errorString, lexer.lineNum, lexer.colNum);
-									strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-									hasError = TRUE;
-								}
+								asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_MISSING_ARGUMENT, parser.path, parser.lineNum, parser.colNum, ".DEFINE directive argument must be a literal constant");
+								object->hasError = TRUE;
 							}
 						}
 						
 					}
-					else if (!strncasecmp(lexer.tokenStart, ".DB", length)) {
-						asm_Token token = asm_getNextToken(&lexer, &length);
+					else if (directive->handler == asm_DIRECTIVE_DB) {
+						asm_Token token = asm_readToken(&parser, &length);
 						
 						// todo: comma-separated list
 						if (token == asm_TOKEN_CONSTANT) {
-							s32 constant = asm_decodeConstant(lexer.tokenStart, NULL, TRUE);
+							s32 constant = asm_decodeConstant(parser.tokenStart, NULL, TRUE);
 							
 							if (!constant && errno) {
-								if (pass == 0) {
-									char err[err_MAX_ERR_SIZE];
-									
-									snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: Error decoding literal constant for .DB directive\n", asm_errorString, lexer.lineNum, lexer.colNum);
-									strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-									hasError = TRUE;
-								}
+								asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_BAD_CONSTANT, parser.path, parser.lineNum, parser.colNum, "Error decoding literal constant for .DB directive");
+								object->hasError = TRUE;
 							}
 							else if (constant > 0xff || constant < -0x80) {
-								if (pass == 0) {
-									char err[err_MAX_ERR_SIZE];
-									
-									snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: Literal constant for .DB directive cannot fit in 1 byte\n", asm_errorString, lexer.lineNum, lexer.colNum);
-									strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-									hasError = TRUE;
-								}
+								asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OUT_OF_RANGE, parser.path, parser.lineNum, parser.colNum, "Literal constant for .DB directive cannot fit in 1 byte");
+								object->hasError = TRUE;
 							}
 							else {
-								assembledROMBank[(pgc++) - firstROMIndex] = constant & 0xff;
+								asm_emitByte(object, section, pgc++, constant & 0xff);
 							}
 						}
 						else if (token == asm_TOKEN_IDENTIFIER) {
-							asm_SymbolTableEntry *symbol = asm_lookupSymbol(&symbolTable, lexer.tokenStart, length);
+							asm_SymbolTableEntry *symbol = asm_lookupSymbol(symbols, parser.tokenStart, length);
 							
 							if (symbol == NULL) {
-								symbol = asm_addSymbol(&symbolTable, lastSymbol, lexer.tokenStart, length);
-								lastSymbol = symbol;
+								symbol = asm_addSymbol(symbols, parser.tokenStart, length, parser.file, parser.lineNum, parser.colNum);
+							}
+							if (symbol == NULL) {
+								asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OUT_OF_MEMORY, parser.path, parser.lineNum, parser.colNum, "Out of memory for the symbol table");
+								object->hasError = TRUE;
+								break;
 							}
 							
-							if (symbol->resolved) {
+							if (symbol->resolved && (symbol->kind == asm_SYMBOL_IMPORT || symbol->relocatable)) {
+								/* the linker fills in the byte once it knows the value */
+								if (!asm_addRelocation(object, section, pgc, symbol->index, 1, parser.files[parser.file].pathOffset, parser.lineNum, parser.colNum)) {
+									asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OUT_OF_MEMORY, NULL, 0, 0, "Out of memory for the relocations");
+									object->hasError = TRUE;
+								}
+								asm_emitByte(object, section, pgc++, 0x00);
+							}
+							else if (symbol->resolved) {
 								if (symbol->value > 0xff || symbol->value < -0x80) {
-									if (pass == 0) {
-										char err[err_MAX_ERR_SIZE];
-										
-										snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: Literal constant for .DB directive cannot fit in 1 byte\n", asm_errorString, lexer.lineNum, lexer.colNum);
-										strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-										hasError = TRUE;
-									}
+									asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OUT_OF_RANGE, parser.path, parser.lineNum, parser.colNum, "Literal constant for .DB directive cannot fit in 1 byte");
+									object->hasError = TRUE;
 								}
-								assembledROMBank[(pgc++) - firstROMIndex] = symbol->value & 0xff;
+								asm_emitByte(object, section, pgc++, symbol->value & 0xff);
+							}
+							else {
+								/* keep the byte's place, so only this statement needs assembling again */
+								asm_emitByte(object, section, pgc++, 0x00);
+								requiresMorePasses = TRUE;
 							}
 						}
 						else {
-							if (pass == 0) {
-								char err[err_MAX_ERR_SIZE];
-								
-								snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: .DB directive needs at least one constant or identifier value\n", asm_errorString, lexer.lineNum, lexer.colNum);
-								strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-								hasError = TRUE;
-							}
+							asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_MISSING_ARGUMENT, parser.path, parser.lineNum, parser.colNum, ".DB directive needs at least one constant or identifier value");
+							object->hasError = TRUE;
 						}
 					}
 					
 					break;
 				}
 				case asm_TOKEN_OPCODE: {
-					// resolve opcodes here
-					if (!requiresMorePasses) {
-						if (!strncasecmp(lexer.tokenStart, "NOP", length)) {
-							assembledROMBank[(pgc++) - firstROMIndex] = 0x00;
-							assembledROMBank[(pgc++) - firstROMIndex] = 0x00;
-						}
-						else if (!strncasecmp(lexer.tokenStart, "HALT", length)) {
-							assembledROMBank[(pgc++) - firstROMIndex] = 0x01;
-							assembledROMBank[(pgc++) - firstROMIndex] = 0x00;
-						}
-						else if (!strncasecmp(lexer.tokenStart, "ILG", length)) {
-							assembledROMBank[(pgc++) - firstROMIndex] = 0x02;
-							assembledROMBank[(pgc++) - firstROMIndex] = 0x00;
-						}
+					const asm_Mnemonic *instruction = asm_lookupMnemonic(parser.tokenStart, length, asm_MNEMONIC_INSTRUCTION);
+					
+					if (instruction == NULL) {
+						asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_UNKNOWN_MNEMONIC, parser.path, parser.lineNum, parser.colNum, "Unknown instruction '%.*s'", (int)length, parser.tokenStart);
+						object->hasError = TRUE;
+					}
+					else if (instruction->operandCount > 0) {
+						/* nothing in instructions.def takes operands yet, so there's no operand syntax to parse */
+						asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_SYNTAX, parser.path, parser.lineNum, parser.colNum, "Instruction '%.*s' takes operands, which the assembler doesn't support yet", (int)length, parser.tokenStart);
+						object->hasError = TRUE;
+					}
+					else {
+						asm_emitByte(object, section, pgc++, instruction->opcode & 0xff);
+						asm_emitByte(object, section, pgc++, instruction->opcode >> 8);
 					}
 					
 					break;
 				}
 				case asm_TOKEN_LABEL: {
-					bool isNewSymbol = FALSE;
+					asm_SymbolTableEntry *symbol = asm_lookupSymbol(symbols, parser.tokenStart, length);
 					
-					asm_SymbolTableEntry *symbol = asm_lookupSymbol(&symbolTable, lexer.tokenStart, length);
+					if (symbol == NULL) {
+						symbol = asm_addSymbol(symbols, parser.tokenStart, length, parser.file, parser.lineNum, parser.colNum);
+					}
 					
 					if (symbol == NULL) {
-						symbol = asm_addSymbol(&symbolTable, lastSymbol, lexer.tokenStart, length);
-						lastSymbol = symbol;
-						
-						isNewSymbol = TRUE;
+						asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OUT_OF_MEMORY, parser.path, parser.lineNum, parser.colNum, "Out of memory for the symbol table");
+						object->hasError = TRUE;
+						break;
 					}
 					
-					if (symbol != NULL && symbol->resolved) {
-						if (pass == 0) {
-							char err[err_MAX_ERR_SIZE];
-							
-							snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: Label has already been defined\n", asm_errorString, lexer.lineNum, lexer.colNum);
-							strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-							hasError = TRUE;
-						}
+					/* labels are only ever assembled in full passes, so a label that's already resolved after the first one has moved */
+					if (symbol->resolved && pass == 0) {
+						asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_DUPLICATE_LABEL, parser.path, parser.lineNum, parser.colNum, "Label has already been defined");
+						object->hasError = TRUE;
 					}
-					else if (!requiresMorePasses) {
-						if (!isNewSymbol) {
-							requiresMorePasses = TRUE;
+					else {
+						if (symbol->resolved && (symbol->value != (s32)pgc || symbol->section != section)) {
+							layoutChanged = TRUE;
 						}
 						
-						symbol->resolved = TRUE;
-						symbol->value = (s32)pgc;
+						symbol->kind = asm_SYMBOL_LABEL;
+						symbol->file = parser.file;
+						symbol->lineNum = parser.lineNum;
+						symbol->colNum = parser.colNum;
+						symbol->section = section;
+						symbol->relocatable = !object->sections[section].absolute;
+						asm_resolveSymbol(symbols, symbol, (s32)pgc);
 					}
 					
 					break;
 				}
+				case asm_TOKEN_END:
+					break;
 				case asm_TOKEN_ERROR:
 				default: {
-					if (pass == 0) {
-						char err[err_MAX_ERR_SIZE];
-						
-						snprintf(err, err_MAX_ERR_SIZE, "%sLine %d, column %d: Syntax error\n", asm_errorString, lexer.lineNum, lexer.colNum);
-						strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
-						hasError = TRUE;
-						break;
-					}
+					asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_SYNTAX, parser.path, parser.lineNum, parser.colNum, "Syntax error");
+					object->hasError = TRUE;
+					break;
+				}
+			}
+			
+			u32 size = pgc - firstPGC;
+			
+			if (fullPass) {
+				if (requiresMorePasses && !asm_addStatement(&pending, firstToken, firstSection, firstPGC, size)) {
+					asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OUT_OF_MEMORY, NULL, 0, 0, "Out of memory for the pending statements");
+					object->hasError = TRUE;
+					break;
+				}
+			}
+			else {
+				/* anything after a statement that changed size is at the wrong address now */
+				if (size != pending.statements[revisited - 1].size) {
+					layoutChanged = TRUE;
+				}
+				
+				if (requiresMorePasses) {
+					pending.statements[stillPending] = pending.statements[revisited - 1];
+					pending.statements[stillPending].size = size;
+					stillPending++;
 				}
 			}
 		}
 		
-		if (hasError) {
-			return !hasError;
+		if (!fullPass) {
+			pending.count = stillPending;
 		}
 		
-		bool allResolved = !requiresMorePasses;
-		if (symbolTable != NULL) {
-			for (asm_SymbolTableEntry *sym = symbolTable; sym->next != NULL; sym = sym->next) {
-				if (!sym->resolved) {
-					allResolved = FALSE;
-					break;
+		if (object->hasError) {
+			break;
+		}
+		
+		/* everything this source defines has been seen by the end of a full pass, so the rest must come from other objects */
+		if (fullPass && !layoutChanged && symbols->unresolvedCount > 0) {
+			asm_importUndefinedSymbols(symbols);
+		}
+		else if (pending.count == 0 && !layoutChanged) {
+			assembled = TRUE;
+		}
+	}
+	
+	if (!assembled && !object->hasError) {
+		asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_UNRESOLVABLE, parser.files[0].path, 0, 0, "Symbol resolution failed (tried %d times)", asm_MAX_PASSES);
+		object->hasError = TRUE;
+	}
+	
+	if (assembled && !asm_exportSymbols(object, symbols, &parser)) {
+		asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OUT_OF_MEMORY, NULL, 0, 0, "Out of memory for the object's symbols");
+		object->hasError = TRUE;
+	}
+	
+	asm_freeStatements(&pending);
+	asm_freeSymbolTable(symbols);
+	asm_freeParser(&parser);
+	
+	return object;
+}
+
+bool asm_assembleToROMImage(const char *assemblyCode) {
+	asm_Object *object = asm_assembleObject(assemblyCode, NULL);
+	
+	if (object == NULL) {
+		asm_clearDiagnostics(&asm_diagnostics);
+		asm_addDiagnostic(&asm_diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OUT_OF_MEMORY, NULL, 0, 0, "Out of memory for the object");
+		return FALSE;
+	}
+	
+	bool linked = asm_linkObjects(&object, 1);
+	asm_freeObject(object);
+	
+	return linked;
+}
+
+void asm_freeObject(asm_Object *object) {
+	if (object == NULL) return;
+	
+	if (object->sections != NULL) drv_reallocate(object->sections, object->sectionCapacity * sizeof(asm_Section), 0);
+	if (object->code != NULL) drv_reallocate(object->code, object->codeCapacity, 0);
+	if (object->symbols != NULL) drv_reallocate(object->symbols, object->symbolCount * sizeof(asm_ObjectSymbol), 0);
+	if (object->relocations != NULL) drv_reallocate(object->relocations, object->relocationCapacity * sizeof(asm_Relocation), 0);
+	if (object->names != NULL) drv_reallocate(object->names, object->namesCapacity, 0);
+	if (object->sourcePaths != NULL) drv_reallocate(object->sourcePaths, object->sourceCapacity * sizeof(u32), 0);
+	
+	asm_freeDiagnostics(&object->diagnostics);
+	drv_reallocate(object, sizeof(asm_Object), 0);
+}
+
+u32 asm_getObjectSourceCount(asm_Object *object) {
+	return object->sourceCount;
+}
+
+const char *asm_getObjectSource(asm_Object *object, u32 index) {
+	if (index >= object->sourceCount || object->sourcePaths[index] == asm_NO_PATH) return NULL;
+	
+	return object->names + object->sourcePaths[index];
+}
+
+static inline void asm_put32(u8 *ptr, u32 value) {
+	ptr[0] = value & 0xff;
+	ptr[1] = (value >> 8) & 0xff;
+	ptr[2] = (value >> 16) & 0xff;
+	ptr[3] = value >> 24;
+}
+
+static inline u32 asm_get32(const u8 *ptr) {
+	return ptr[0] | (ptr[1] << 8) | (ptr[2] << 16) | ((u32)ptr[3] << 24);
+}
+
+u32 asm_getObjectSize(asm_Object *object) {
+	if (object->hasError) return 0;
+	
+	u64 size = asm_OBJECT_HEADER_SIZE;
+	size += (u64)object->sectionCount * asm_OBJECT_SECTION_SIZE;
+	size += (u64)object->symbolCount * asm_OBJECT_SYMBOL_SIZE;
+	size += (u64)object->relocationCount * asm_OBJECT_RELOCATION_SIZE;
+	size += (u64)object->sourceCount * 4;
+	size += object->codeSize;
+	size += object->namesSize;
+	
+	return size > 0xffffffff ? 0 : (u32)size;
+}
+
+bool asm_saveObject(asm_Object *object, u8 *data, u32 length) {
+	u32 size = asm_getObjectSize(object);
+	if (size == 0 || length < size) return FALSE;
+	
+	memset(data, 0, asm_OBJECT_HEADER_SIZE);
+	memcpy(data, asm_OBJECT_MAGIC, asm_OBJECT_MAGIC_SIZE);
+	data[asm_OBJECT_MAGIC_SIZE] = asm_OBJECT_VERSION;
+	
+	asm_put32(data + 0x04, object->sectionCount);
+	asm_put32(data + 0x08, object->symbolCount);
+	asm_put32(data + 0x0c, object->relocationCount);
+	asm_put32(data + 0x10, object->sourceCount);
+	asm_put32(data + 0x14, object->codeSize);
+	asm_put32(data + 0x18, object->namesSize);
+	memcpy(data + 0x1c, object->title, sizeof(object->title));
+	memcpy(data + 0x1c + sizeof(object->title), object->author, sizeof(object->author));
+	
+	u8 *ptr = data + asm_OBJECT_HEADER_SIZE;
+	
+	for (u32 i = 0; i < object->sectionCount; i++, ptr += asm_OBJECT_SECTION_SIZE) {
+		asm_Section *section = &object->sections[i];
+		
+		asm_put32(ptr, section->origin);
+		asm_put32(ptr + 4, section->size);
+		asm_put32(ptr + 8, section->absolute);
+		asm_put32(ptr + 12, section->pathOffset);
+		asm_put32(ptr + 16, section->lineNum);
+		asm_put32(ptr + 20, section->colNum);
+	}
+	
+	for (u32 i = 0; i < object->symbolCount; i++, ptr += asm_OBJECT_SYMBOL_SIZE) {
+		asm_ObjectSymbol *symbol = &object->symbols[i];
+		
+		asm_put32(ptr, symbol->nameOffset);
+		asm_put32(ptr + 4, symbol->nameLength);
+		asm_put32(ptr + 8, symbol->pathOffset);
+		asm_put32(ptr + 12, symbol->lineNum);
+		asm_put32(ptr + 16, symbol->colNum);
+		asm_put32(ptr + 20, (u32)symbol->value);
+		asm_put32(ptr + 24, symbol->section);
+		asm_put32(ptr + 28, symbol->kind);
+	}
+	
+	for (u32 i = 0; i < object->relocationCount; i++, ptr += asm_OBJECT_RELOCATION_SIZE) {
+		asm_Relocation *relocation = &object->relocations[i];
+		
+		asm_put32(ptr, relocation->section);
+		asm_put32(ptr + 4, relocation->codeOffset);
+		asm_put32(ptr + 8, relocation->symbol);
+		asm_put32(ptr + 12, relocation->size);
+		asm_put32(ptr + 16, relocation->pathOffset);
+		asm_put32(ptr + 20, relocation->lineNum);
+		asm_put32(ptr + 24, relocation->colNum);
+	}
+	
+	for (u32 i = 0; i < object->sourceCount; i++, ptr += 4) {
+		asm_put32(ptr, object->sourcePaths[i]);
+	}
+	
+	if (object->codeSize > 0) memcpy(ptr, object->code, object->codeSize);
+	ptr += object->codeSize;
+	
+	if (object->namesSize > 0) memcpy(ptr, object->names, object->namesSize);
+	
+	return TRUE;
+}
+
+/*
+*  Allocate one of a loaded object's arrays, which has exactly as much room as it needs. Return FALSE on failure or TRUE on success.
+*/
+static bool asm_allocateObjectArray(void **array, u32 count, size_t elementSize) {
+	*array = NULL;
+	if (count == 0) return TRUE;
+	
+	*array = drv_reallocate(NULL, 0, count * elementSize);
+	return *array != NULL;
+}
+
+/*
+*  Check that an offset into a loaded object's names is asm_NO_PATH or the start of a null-terminated path.
+*/
+static inline bool asm_isValidPath(asm_Object *object, u32 pathOffset) {
+	return pathOffset == asm_NO_PATH || pathOffset < object->namesSize;
+}
+
+asm_Object *asm_loadObject(const u8 *data, u32 length) {
+	if (length < asm_OBJECT_HEADER_SIZE || memcmp(data, asm_OBJECT_MAGIC, asm_OBJECT_MAGIC_SIZE) || data[asm_OBJECT_MAGIC_SIZE] != asm_OBJECT_VERSION) {
+		return NULL;
+	}
+	
+	asm_Object *object = drv_reallocate(NULL, 0, sizeof(asm_Object));
+	if (object == NULL) return NULL;
+	
+	memset(object, 0, sizeof(asm_Object));
+	
+	u32 sectionCount = asm_get32(data + 0x04);
+	u32 symbolCount = asm_get32(data + 0x08);
+	u32 relocationCount = asm_get32(data + 0x0c);
+	u32 sourceCount = asm_get32(data + 0x10);
+	u32 codeSize = asm_get32(data + 0x14);
+	u32 namesSize = asm_get32(data + 0x18);
+	
+	u64 size = asm_OBJECT_HEADER_SIZE;
+	size += (u64)sectionCount * asm_OBJECT_SECTION_SIZE;
+	size += (u64)symbolCount * asm_OBJECT_SYMBOL_SIZE;
+	size += (u64)relocationCount * asm_OBJECT_RELOCATION_SIZE;
+	size += (u64)sourceCount * 4;
+	size += codeSize;
+	size += namesSize;
+	
+	/* the paths and names are all null-terminated, so the last byte of the names has to be a terminator */
+	bool valid = size <= length && (namesSize == 0 || data[size - 1] == '\0');
+	
+	if (valid) {
+		valid = asm_allocateObjectArray((void **)&object->sections, sectionCount, sizeof(asm_Section)) &&
+			asm_allocateObjectArray((void **)&object->symbols, symbolCount, sizeof(asm_ObjectSymbol)) &&
+			asm_allocateObjectArray((void **)&object->relocations, relocationCount, sizeof(asm_Relocation)) &&
+			asm_allocateObjectArray((void **)&object->sourcePaths, sourceCount, sizeof(u32)) &&
+			asm_allocateObjectArray((void **)&object->code, codeSize, 1) &&
+			asm_allocateObjectArray((void **)&object->names, namesSize, 1);
+		
+		/* every array that got allocated has its count set, so asm_freeObject() can free it */
+		object->sectionCount = object->sectionCapacity = object->sections != NULL ? sectionCount : 0;
+		object->symbolCount = object->symbols != NULL ? symbolCount : 0;
+		object->relocationCount = object->relocationCapacity = object->relocations != NULL ? relocationCount : 0;
+		object->sourceCount = object->sourceCapacity = object->sourcePaths != NULL ? sourceCount : 0;
+		object->codeSize = object->codeCapacity = object->code != NULL ? codeSize : 0;
+		object->namesSize = object->namesCapacity = object->names != NULL ? namesSize : 0;
+	}
+	
+	if (!valid) {
+		asm_freeObject(object);
+		return NULL;
+	}
+	
+	memcpy(object->title, data + 0x1c, sizeof(object->title));
+	memcpy(object->author, data + 0x1c + sizeof(object->title), sizeof(object->author));
+	object->title[sizeof(object->title) - 1] = '\0';
+	object->author[sizeof(object->author) - 1] = '\0';
+	
+	const u8 *ptr = data + asm_OBJECT_HEADER_SIZE;
+	u32 codeOffset = 0;
+	
+	for (u32 i = 0; i < sectionCount; i++, ptr += asm_OBJECT_SECTION_SIZE) {
+		asm_Section *section = &object->sections[i];
+		
+		section->origin = asm_get32(ptr);
+		section->size = asm_get32(ptr + 4);
+		section->absolute = asm_get32(ptr + 8) != 0;
+		section->pathOffset = asm_get32(ptr + 12);
+		section->lineNum = asm_get32(ptr + 16);
+		section->colNum = asm_get32(ptr + 20);
+		section->codeOffset = codeOffset;
+		section->address = section->origin;
+		
+		if (section->size > codeSize - codeOffset || !asm_isValidPath(object, section->pathOffset)) valid = FALSE;
+		else codeOffset += section->size;
+	}
+	
+	for (u32 i = 0; i < symbolCount; i++, ptr += asm_OBJECT_SYMBOL_SIZE) {
+		asm_ObjectSymbol *symbol = &object->symbols[i];
+		
+		symbol->nameOffset = asm_get32(ptr);
+		symbol->nameLength = asm_get32(ptr + 4);
+		symbol->pathOffset = asm_get32(ptr + 8);
+		symbol->lineNum = asm_get32(ptr + 12);
+		symbol->colNum = asm_get32(ptr + 16);
+		symbol->value = (s32)asm_get32(ptr + 20);
+		symbol->section = asm_get32(ptr + 24);
+		symbol->kind = (asm_SymbolKind)asm_get32(ptr + 28);
+		
+		if ((u64)symbol->nameOffset + symbol->nameLength >= namesSize || !asm_isValidPath(object, symbol->pathOffset)) valid = FALSE;
+		if (symbol->kind > asm_SYMBOL_IMPORT || (symbol->kind == asm_SYMBOL_LABEL && symbol->section >= sectionCount)) valid = FALSE;
+	}
+	
+	for (u32 i = 0; i < relocationCount; i++, ptr += asm_OBJECT_RELOCATION_SIZE) {
+		asm_Relocation *relocation = &object->relocations[i];
+		
+		relocation->section = asm_get32(ptr);
+		relocation->codeOffset = asm_get32(ptr + 4);
+		relocation->symbol = asm_get32(ptr + 8);
+		relocation->size = asm_get32(ptr + 12);
+		relocation->pathOffset = asm_get32(ptr + 16);
+		relocation->lineNum = asm_get32(ptr + 20);
+		relocation->colNum = asm_get32(ptr + 24);
+		
+		if (relocation->section >= sectionCount || relocation->symbol >= symbolCount || relocation->size < 1 || relocation->size > 4) {
+			valid = FALSE;
+			continue;
+		}
+		
+		/* the bytes it fills in have to be in its section */
+		asm_Section *section = &object->sections[relocation->section];
+		if (relocation->codeOffset < section->codeOffset || (u64)relocation->codeOffset + relocation->size > (u64)section->codeOffset + section->size) valid = FALSE;
+		if (!asm_isValidPath(object, relocation->pathOffset)) valid = FALSE;
+	}
+	
+	for (u32 i = 0; i < sourceCount; i++, ptr += 4) {
+		object->sourcePaths[i] = asm_get32(ptr);
+		if (!asm_isValidPath(object, object->sourcePaths[i])) valid = FALSE;
+	}
+	
+	if (!valid || codeOffset != codeSize) {
+		asm_freeObject(object);
+		return NULL;
+	}
+	
+	if (codeSize > 0) memcpy(object->code, ptr, codeSize);
+	ptr += codeSize;
+	
+	if (namesSize > 0) memcpy(object->names, ptr, namesSize);
+	
+	return object;
+}
+
+/*
+*  Internal struct for a section that's been placed by the linker, for sorting them by address
+*/
+typedef struct {
+	asm_Object *object;
+	asm_Section *section;
+} asm_PlacedSection;
+
+static int asm_comparePlacedSections(const void *a, const void *b) {
+	u32 addressA = ((const asm_PlacedSection *)a)->section->address;
+	u32 addressB = ((const asm_PlacedSection *)b)->section->address;
+	
+	return (addressA > addressB) - (addressA < addressB);
+}
+
+/*
+*  Get the path at the given offset into the object's names, or NULL if there isn't one.
+*/
+static inline const char *asm_getObjectPath(asm_Object *object, u32 pathOffset) {
+	return pathOffset == asm_NO_PATH ? NULL : object->names + pathOffset;
+}
+
+/*
+*  Get the value of one of the object's symbols (other than an import) once the linker has placed its sections.
+*/
+static inline s32 asm_getSymbolValue(asm_Object *object, asm_ObjectSymbol *symbol) {
+	if (symbol->kind == asm_SYMBOL_LABEL) {
+		asm_Section *section = &object->sections[symbol->section];
+		return (s32)(symbol->value - section->origin + section->address);
+	}
+	
+	return symbol->value;
+}
+
+/*
+*  Place every section of the objects: absolute ones at their origins, and relocatable ones one after another from the reset vector.
+*  Check that none of them overlap (each other, or the title and author if there are any) or run past the end of the ROM, and put the lowest bank used in firstROMIndex.
+*  Return FALSE on failure (after adding diagnostics) or TRUE on success.
+*/
+static bool asm_placeSections(asm_Object **objects, u32 count, u32 *firstROMIndex) {
+	asm_DiagnosticList *diagnostics = &asm_diagnostics;
+	u32 sectionCount = 0;
+	bool placedAll = TRUE;
+	
+	for (u32 i = 0; i < count; i++) {
+		sectionCount += objects[i]->sectionCount;
+	}
+	
+	asm_PlacedSection *placed = drv_reallocate(NULL, 0, (sectionCount ? sectionCount : 1) * sizeof(asm_PlacedSection));
+	if (placed == NULL) {
+		asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OUT_OF_MEMORY, NULL, 0, 0, "Out of memory for the linker's sections");
+		return FALSE;
+	}
+	
+	u32 placedCount = 0;
+	u64 next = asm_DEFAULT_ORIGIN;
+	bool hasText = FALSE;
+	
+	/* the header's in the last bank, so that's always part of the ROM */
+	*firstROMIndex = asm_DEFAULT_ORIGIN;
+	
+	for (u32 i = 0; i < count; i++) {
+		if (objects[i]->title[0] != '\0' || objects[i]->author[0] != '\0') hasText = TRUE;
+		
+		for (u32 j = 0; j < objects[i]->sectionCount; j++) {
+			asm_Section *section = &objects[i]->sections[j];
+			
+			if (!section->absolute) {
+				section->address = next > 0xffffff ? 0x1000000 : (u32)next;
+				next += section->size;
+			}
+			
+			if (section->size == 0) continue;
+			
+			placed[placedCount].object = objects[i];
+			placed[placedCount].section = section;
+			placedCount++;
+		}
+	}
+	
+	qsort(placed, placedCount, sizeof(asm_PlacedSection), asm_comparePlacedSections);
+	
+	for (u32 i = 0; i < placedCount; i++) {
+		asm_Section *section = placed[i].section;
+		const char *path = asm_getObjectPath(placed[i].object, section->pathOffset);
+		
+		if ((u64)section->address + section->size > 0x1000000) {
+			asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OVERLAP, path, section->lineNum, section->colNum, "Code at $%06X doesn't fit in the ROM (it ends past $FFFFFF)", section->address);
+			placedAll = FALSE;
+		}
+		else if (i > 0 && (u64)placed[i - 1].section->address + placed[i - 1].section->size > section->address) {
+			asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OVERLAP, path, section->lineNum, section->colNum, "Code at $%06X overlaps the code before it", section->address);
+			placedAll = FALSE;
+		}
+		else if (hasText && section->address < asm_ROM_TEXT_ADDRESS + asm_ROM_TEXT_SIZE && section->address + section->size > asm_ROM_TEXT_ADDRESS) {
+			asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OVERLAP, path, section->lineNum, section->colNum, "Code at $%06X overlaps the ROM's title and author at $%06X", section->address, asm_ROM_TEXT_ADDRESS);
+			placedAll = FALSE;
+		}
+		else if ((section->address & 0xff0000) < *firstROMIndex) {
+			*firstROMIndex = section->address & 0xff0000;
+		}
+	}
+	
+	drv_reallocate(placed, (sectionCount ? sectionCount : 1) * sizeof(asm_PlacedSection), 0);
+	return placedAll;
+}
+
+/*
+*  Add every symbol the objects define to the linker's symbol table. The same constant can be defined by more than one object
+*  (like one from a file they all include), but anything else can only be defined once.
+*  Return FALSE on failure (after adding diagnostics) or TRUE on success.
+*/
+static bool asm_addObjectSymbols(asm_SymbolTable *symbols, asm_Object **objects, u32 count) {
+	asm_DiagnosticList *diagnostics = &asm_diagnostics;
+	bool addedAll = TRUE;
+	
+	for (u32 i = 0; i < count; i++) {
+		asm_Object *object = objects[i];
+		
+		for (u32 j = 0; j < object->symbolCount; j++) {
+			asm_ObjectSymbol *symbol = &object->symbols[j];
+			if (symbol->kind == asm_SYMBOL_IMPORT) continue;
+			
+			const char *name = object->names + symbol->nameOffset;
+			s32 value = asm_getSymbolValue(object, symbol);
+			asm_SymbolTableEntry *entry = asm_lookupSymbol(symbols, name, symbol->nameLength);
+			
+			if (entry == NULL) {
+				entry = asm_addSymbol(symbols, name, symbol->nameLength, 0, symbol->lineNum, symbol->colNum);
+				if (entry == NULL) {
+					asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OUT_OF_MEMORY, NULL, 0, 0, "Out of memory for the linker's symbol table");
+					return FALSE;
+				}
+				
+				entry->owner = i;
+				entry->index = j;
+				entry->kind = symbol->kind;
+				asm_resolveSymbol(symbols, entry, value);
+			}
+			else if (entry->kind != asm_SYMBOL_CONSTANT || symbol->kind != asm_SYMBOL_CONSTANT || entry->value != value) {
+				asm_Object *owner = objects[entry->owner];
+				asm_ObjectSymbol *first = &owner->symbols[entry->index];
+				const char *firstPath = asm_getObjectPath(owner, first->pathOffset);
+				const char *path = asm_getObjectPath(object, symbol->pathOffset);
+				
+				if (firstPath != NULL) {
+					asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_DUPLICATE_SYMBOL, path, symbol->lineNum, symbol->colNum, "Symbol '%s' is already defined at line %u of %s", name, first->lineNum, firstPath);
+				}
+				else {
+					asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_DUPLICATE_SYMBOL, path, symbol->lineNum, symbol->colNum, "Symbol '%s' is already defined at line %u", name, first->lineNum);
 				}
+				addedAll = FALSE;
 			}
 		}
+	}
+	
+	return addedAll;
+}
+
+/*
+*  Fill in every relocation in the objects with its symbol's value, in the ROM that starts at firstROMIndex.
+*  Return FALSE on failure (after adding diagnostics) or TRUE on success.
+*/
+static bool asm_applyRelocations(asm_SymbolTable *symbols, asm_Object **objects, u32 count, u8 *rom, u32 firstROMIndex) {
+	asm_DiagnosticList *diagnostics = &asm_diagnostics;
+	bool appliedAll = TRUE;
+	
+	for (u32 i = 0; i < count; i++) {
+		asm_Object *object = objects[i];
 		
-		if (allResolved) {
-			return !hasError;
+		for (u32 j = 0; j < object->relocationCount; j++) {
+			asm_Relocation *relocation = &object->relocations[j];
+			asm_ObjectSymbol *symbol = &object->symbols[relocation->symbol];
+			const char *name = object->names + symbol->nameOffset;
+			const char *path = asm_getObjectPath(object, relocation->pathOffset);
+			s32 value;
+			
+			if (symbol->kind == asm_SYMBOL_IMPORT) {
+				asm_SymbolTableEntry *entry = asm_lookupSymbol(symbols, name, symbol->nameLength);
+				
+				if (entry == NULL || !entry->resolved) {
+					/* a symbol that's never defined is only reported where it's first used (it's in the table, unresolved, after that) */
+					if (entry == NULL) {
+						asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_UNDEFINED_SYMBOL, path, relocation->lineNum, relocation->colNum, "Symbol '%s' is never defined", name);
+						
+						if (asm_addSymbol(symbols, name, symbol->nameLength, 0, relocation->lineNum, relocation->colNum) == NULL) {
+							asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OUT_OF_MEMORY, NULL, 0, 0, "Out of memory for the linker's symbol table");
+							return FALSE;
+						}
+					}
+					
+					appliedAll = FALSE;
+					continue;
+				}
+				
+				value = entry->value;
+			}
+			else {
+				value = asm_getSymbolValue(object, symbol);
+			}
+			
+			s64 min = -((s64)1 << (relocation->size * 8 - 1));
+			s64 max = ((s64)1 << (relocation->size * 8)) - 1;
+			
+			if (value < min || value > max) {
+				asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OUT_OF_RANGE, path, relocation->lineNum, relocation->colNum, "Value of '%s' ($%X) cannot fit in %u byte%s", name, (u32)value, relocation->size, relocation->size == 1 ? "" : "s");
+				appliedAll = FALSE;
+				continue;
+			}
+			
+			asm_Section *section = &object->sections[relocation->section];
+			u8 *dest = &rom[section->address - firstROMIndex + (relocation->codeOffset - section->codeOffset)];
+			
+			for (u32 k = 0; k < relocation->size; k++) {
+				dest[k] = ((u32)value >> (k * 8)) & 0xff;
+			}
 		}
 	}
 	
-	char err[err_MAX_ERR_SIZE];
-	snprintf(err, err_MAX_ERR_SIZE, "%sSymbol resolution failed (tried %d times)\n", asm_errorString, asm_MAX_PASSES);
-	strncpy(asm_errorString, err, err_MAX_ERR_SIZE);
+	return appliedAll;
+}
+
+bool asm_linkObjects(asm_Object **objects, u32 count) {
+	asm_DiagnosticList *diagnostics = &asm_diagnostics;
+	bool hasError = FALSE;
+	
+	asm_clearDiagnostics(diagnostics);
+	
+	if (asm_romImage != NULL) {
+		drv_reallocate(asm_romImage, asm_romImageSize, 0);
+		asm_romImage = NULL;
+		asm_romImageSize = 0;
+	}
+	
+	/* the objects' own diagnostics come first, in the order the objects were given */
+	for (u32 i = 0; i < count; i++) {
+		asm_copyDiagnostics(diagnostics, &objects[i]->diagnostics);
+		if (objects[i]->hasError) hasError = TRUE;
+	}
+	
+	if (hasError) {
+		return FALSE;
+	}
+	
+	u32 firstROMIndex;
+	if (!asm_placeSections(objects, count, &firstROMIndex)) {
+		return FALSE;
+	}
+	
+	asm_SymbolTable symbolTable;
+	asm_SymbolTable *symbols = &symbolTable;
+	
+	if (!asm_initSymbolTable(symbols)) {
+		asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OUT_OF_MEMORY, NULL, 0, 0, "Out of memory for the linker's symbol table");
+		return FALSE;
+	}
+	
+	/* the image is the header, the ROM chunk's length, then the ROM itself, which ends at $FFFFFF */
+	u32 romLength = 0x1000000 - firstROMIndex;
+	u32 imageSize = asm_ROM_HEADER_SIZE + asm_ROM_CHUNK_LENGTH_SIZE + romLength;
+	u8 *image = NULL;
+	
+	if (!asm_addObjectSymbols(symbols, objects, count)) {
+		hasError = TRUE;
+	}
+	else if ((image = drv_reallocate(NULL, 0, imageSize)) == NULL) {
+		asm_addDiagnostic(diagnostics, asm_SEVERITY_ERROR, asm_ERROR_OUT_OF_MEMORY, NULL, 0, 0, "Out of memory for the ROM image");
+		hasError = TRUE;
+	}
 	
-	return FALSE;
+	if (!hasError) {
+		memset(image, 0, imageSize);
+		u8 *rom = image + asm_ROM_HEADER_SIZE + asm_ROM_CHUNK_LENGTH_SIZE;
+		
+		const char *title = "";
+		const char *author = "";
+		
+		for (u32 i = 0; i < count; i++) {
+			asm_Object *object = objects[i];
+			
+			for (u32 j = 0; j < object->sectionCount; j++) {
+				asm_Section *section = &object->sections[j];
+				if (section->size > 0) memcpy(&rom[section->address - firstROMIndex], object->code + section->codeOffset, section->size);
+			}
+			
+			/* like more than one .HXH_TITLE in a source, the last object's title wins */
+			if (object->title[0] != '\0') title = object->title;
+			if (object->author[0] != '\0') author = object->author;
+		}
+		
+		hasError = !asm_applyRelocations(symbols, objects, count, rom, firstROMIndex);
+		
+		if (!hasError) {
+			/* the title and author go in the last bank too, where the code can read them (asm_placeSections() kept it clear) */
+			if (title[0] != '\0') memcpy(&rom[asm_ROM_TEXT_ADDRESS - firstROMIndex], title, strlen(title));
+			if (author[0] != '\0') memcpy(&rom[asm_ROM_TEXT_ADDRESS - firstROMIndex + 128], author, strlen(author));
+			
+			memcpy(image, title, strlen(title));
+			memcpy(image + 128, author, strlen(author));
+			memcpy(image + 224, asm_ROM_IMAGE_MAGIC, 16);
+			image[0xf0] = (u8)(romLength >> 16);
+			
+			u16 crc = crc_getCRC16(0, rom, romLength);
+			image[0xfe] = crc & 0xff;
+			image[0xff] = crc >> 8;
+			
+			image[asm_ROM_HEADER_SIZE] = romLength & 0xff;
+			image[asm_ROM_HEADER_SIZE + 1] = (romLength >> 8) & 0xff;
+			image[asm_ROM_HEADER_SIZE + 2] = (romLength >> 16) & 0xff;
+			
+			asm_romImage = image;
+			asm_romImageSize = imageSize;
+		}
+	}
+	
+	if (hasError && image != NULL) {
+		drv_reallocate(image, imageSize, 0);
+	}
+	
+	asm_freeSymbolTable(symbols);
+	return !hasError;
+}
+
+u8 *asm_getROMImage(u32 *length) {
+	if (length != NULL) *length = asm_romImageSize;
+	return asm_romImage;
 }
 
 s32 asm_decodeConstant(const char *number, char **strPart, bool noError) {
 	if (!noError) {
-		snprintf(asm_errorString, err_MAX_ERR_SIZE, "");
+		asm_clearDiagnostics(&asm_diagnostics);
 	}
 	
 	const char *copy = number;
@@ -1371,7 +2926,7 @@ s32 asm_decodeConstant(const char *number, char **strPart, bool noError) {
 				break;
 			default: {
 				if (!noError) {
-					snprintf(asm_errorString, err_MAX_ERR_SIZE, "Error decoding base prefix: '%c'", *copy);
+					asm_addDiagnostic(&asm_diagnostics, asm_SEVERITY_ERROR, asm_ERROR_BAD_CONSTANT, NULL, 0, 0, "Error decoding base prefix: '%c'", *copy);
 				}
 				return 0;
 			}
@@ -1383,7 +2938,7 @@ s32 asm_decodeConstant(const char *number, char **strPart, bool noError) {
 	errno = 0;
 	s32 ret = (s32)strtol(copy, strPart, base);
 	
-	if (errno && !noError) snprintf(asm_errorString, err_MAX_ERR_SIZE, "Error decoding number with base %i: '%s'", base, number);
+	if (errno && !noError) asm_addDiagnostic(&asm_diagnostics, asm_SEVERITY_ERROR, asm_ERROR_BAD_CONSTANT, NULL, 0, 0, "Error decoding number with base %i: '%s'", base, number);
 	return ret;
 }
 
@@ -1396,4 +2951,4 @@ s32 asm_decodeConstant(const char *number, char **strPart, bool noError) {
 #undef asm_IS_REGISTER_24
 #undef asm_IS_REGISTER
 
-#undef asm_IS_PGC
+#undef asm_IS_PGC
\ No newline at end of file
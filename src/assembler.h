@@ -5,19 +5,67 @@
 
 #include <hexlet_ints.h>
 #include <hexlet_bools.h>
+#include <hexlet_assembler.h>
 #include <hexlet_emulate.h>
 
 #define asm_MAX_PASSES 10000
 
-/*
-*  Assemble the given code string and load it into the current ROM image, returning FALSE on failure or TRUE on success.
-*/
-bool asm_assembleToROMImage(const char *assemblyCode);
+/* Symbols are allocated from blocks this big, which are all freed at once when assembly ends */
+#define asm_ARENA_BLOCK_SIZE 65536
+
+/* The lexed token array and the list of statements to assemble again start this big, and double whenever they fill up */
+#define asm_MIN_TOKENS 4096
+#define asm_MIN_STATEMENTS 256
+
+/* The diagnostic list and its text start this big, and double whenever they fill up */
+#define asm_MIN_DIAGNOSTICS 16
+#define asm_MIN_DIAGNOSTIC_TEXT 1024
+
+/* The symbol table starts with this many slots (a power of 2), and doubles whenever it gets half full */
+#define asm_MIN_SYMBOL_SLOTS 1024
+
+/* An object's sections, code, relocations, names and source files, and the parser's files, start this big and double whenever they fill up */
+#define asm_MIN_SECTIONS 4
+#define asm_MIN_CODE 4096
+#define asm_MIN_RELOCATIONS 64
+#define asm_MIN_NAMES 4096
+#define asm_MIN_SOURCE_FILES 8
+
+/* How deeply .INCLUDEs can nest, which stops a file that includes itself */
+#define asm_MAX_INCLUDE_DEPTH 16
+
+/* Marks a diagnostic, section, symbol or relocation that isn't from a file */
+#define asm_NO_PATH 0xffffffff
+
+/* Relocatable sections are placed one after another from the reset vector, in the last bank */
+#define asm_DEFAULT_ORIGIN 0xff0000
+
+/* A linked ROM image is a 256-byte header, the 3-byte length of the ROM chunk, then the ROM, which ends at $FFFFFF */
+#define asm_ROM_HEADER_SIZE 256
+#define asm_ROM_CHUNK_LENGTH_SIZE 3
+#define asm_ROM_IMAGE_MAGIC "HEXHELD SOFTWARE"
+
+/* The linker copies the title (128 bytes) and author (96 bytes) into the last bank here too, so no code can go there when there are any */
+#define asm_ROM_TEXT_ADDRESS 0xff9f00
+#define asm_ROM_TEXT_SIZE (128 + 96)
 
 /*
-*  Get the string representing the last error from the assembler.
+*  Layout of an object file (all numbers little-endian):
+*  "HXO", version (1 byte), section count, symbol count, relocation count, source count, code size, names size (4 bytes each),
+*  title (128 bytes), author (96 bytes), then every section, symbol and relocation, a 4-byte path offset per source file,
+*  the code of every section one after another, and the null-terminated names and paths.
+*  A section is its origin, size, whether it's absolute, path offset, line and column (4 bytes each).
+*  A symbol is its name offset, name length, path offset, line, column, value, section and kind (4 bytes each).
+*  A relocation is its section, code offset, symbol, size, path offset, line and column (4 bytes each).
+*  Path offsets are into the names, or asm_NO_PATH.
 */
-char *asm_getError(void);
+#define asm_OBJECT_MAGIC "HXO"
+#define asm_OBJECT_MAGIC_SIZE 3
+#define asm_OBJECT_VERSION 0x01
+#define asm_OBJECT_HEADER_SIZE 252
+#define asm_OBJECT_SECTION_SIZE 24
+#define asm_OBJECT_SYMBOL_SIZE 32
+#define asm_OBJECT_RELOCATION_SIZE 28
 
 /*
 *  Return the constant value parsed from the specified string. 
@@ -0,0 +1,170 @@
+/* Source file for Hexlet's LZ compressor */
+
+#include <string.h>
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+
+#include "compress.h"
+
+static inline u32 cmp_read32(const u8 *ptr) {
+	return ptr[0] | (ptr[1] << 8) | (ptr[2] << 16) | ((u32)ptr[3] << 24);
+}
+
+static inline u32 cmp_hash(u32 value) {
+	return (value * 2654435761u) >> (32 - cmp_HASH_BITS);
+}
+
+/*
+*  Write the extra bytes of a literal count or match length (the part that didn't fit in the token).
+*/
+static inline u8 *cmp_putLength(u8 *ptr, size_t length) {
+	while (length >= 255) {
+		*ptr++ = 255;
+		length -= 255;
+	}
+	*ptr++ = (u8)length;
+	
+	return ptr;
+}
+
+/*
+*  Write one sequence. Return NULL if it doesn't fit.
+*/
+static u8 *cmp_putSequence(u8 *ptr, u8 *end, const u8 *literals, size_t literalCount, u32 offset, size_t matchLength) {
+	/* the worst case for this sequence, so nothing below needs to check */
+	if ((size_t)(end - ptr) < 1 + literalCount / 255 + 1 + literalCount + 2 + matchLength / 255 + 1) {
+		return NULL;
+	}
+	
+	u8 *token = ptr++;
+	*token = (u8)((literalCount < 15 ? literalCount : 15) << 4);
+	if (literalCount >= 15) ptr = cmp_putLength(ptr, literalCount - 15);
+	
+	memcpy(ptr, literals, literalCount);
+	ptr += literalCount;
+	
+	if (matchLength > 0) {
+		*ptr++ = (u8)offset;
+		*ptr++ = (u8)(offset >> 8);
+		
+		matchLength -= cmp_MIN_MATCH;
+		*token |= (u8)(matchLength < 15 ? matchLength : 15);
+		if (matchLength >= 15) ptr = cmp_putLength(ptr, matchLength - 15);
+	}
+	
+	return ptr;
+}
+
+size_t cmp_compress(const u8 *src, size_t length, u8 *dest, size_t capacity) {
+	u32 table[1 << cmp_HASH_BITS];
+	memset(table, 0, sizeof(table));
+	
+	const u8 *ip = src;
+	const u8 *anchor = src;
+	u8 *op = dest;
+	u8 *end = dest + capacity;
+	
+	/* the hash table stores positions + 1, so 0 means empty */
+	if (length > cmp_MIN_MATCH + cmp_LAST_LITERALS) {
+		const u8 *matchLimit = src + length - cmp_LAST_LITERALS;
+		
+		while (ip + cmp_MIN_MATCH <= matchLimit) {
+			u32 sequence = cmp_read32(ip);
+			u32 *entry = &table[cmp_hash(sequence)];
+			u32 position = *entry;
+			*entry = (u32)(ip - src) + 1;
+			
+			if (position == 0 || (size_t)(ip - src) - (position - 1) > cmp_MAX_OFFSET || cmp_read32(src + position - 1) != sequence) {
+				ip++;
+				continue;
+			}
+			
+			const u8 *candidate = src + position - 1;
+			
+			const u8 *matchEnd = ip + cmp_MIN_MATCH;
+			const u8 *ref = candidate + cmp_MIN_MATCH;
+			while (matchEnd < matchLimit && *matchEnd == *ref) {
+				matchEnd++;
+				ref++;
+			}
+			
+			op = cmp_putSequence(op, end, anchor, (size_t)(ip - anchor), (u32)(ip - candidate), (size_t)(matchEnd - ip));
+			if (op == NULL) return 0;
+			
+			/* remember a position inside the match too, so runs keep finding themselves */
+			if (matchEnd - 2 > ip) {
+				table[cmp_hash(cmp_read32(matchEnd - 2))] = (u32)(matchEnd - 2 - src) + 1;
+			}
+			
+			ip = matchEnd;
+			anchor = ip;
+		}
+	}
+	
+	op = cmp_putSequence(op, end, anchor, (size_t)(src + length - anchor), 0, 0);
+	return (op != NULL) ? (size_t)(op - dest) : 0;
+}
+
+/*
+*  Read the extra bytes of a literal count or match length. Return FALSE if the data ends first.
+*/
+static inline bool cmp_getLength(const u8 **ptr, const u8 *end, size_t *length) {
+	u8 byte;
+	
+	do {
+		if (*ptr >= end) return FALSE;
+		byte = *(*ptr)++;
+		*length += byte;
+	} while (byte == 255);
+	
+	return TRUE;
+}
+
+size_t cmp_decompress(const u8 *src, size_t length, u8 *dest, size_t capacity) {
+	const u8 *ip = src;
+	const u8 *inEnd = src + length;
+	u8 *op = dest;
+	u8 *outEnd = dest + capacity;
+	
+	while (ip < inEnd) {
+		u8 token = *ip++;
+		
+		size_t literalCount = token >> 4;
+		if (literalCount == 15 && !cmp_getLength(&ip, inEnd, &literalCount)) return 0;
+		
+		if ((size_t)(inEnd - ip) < literalCount || (size_t)(outEnd - op) < literalCount) return 0;
+		memcpy(op, ip, literalCount);
+		ip += literalCount;
+		op += literalCount;
+		
+		/* the last sequence has no match */
+		if (ip == inEnd) break;
+		
+		if (inEnd - ip < 2) return 0;
+		size_t offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		
+		size_t matchLength = token & 0x0f;
+		if (matchLength == 15 && !cmp_getLength(&ip, inEnd, &matchLength)) return 0;
+		matchLength += cmp_MIN_MATCH;
+		
+		if (offset == 0 || offset > (size_t)(op - dest) || (size_t)(outEnd - op) < matchLength) return 0;
+		
+		const u8 *match = op - offset;
+		if (offset >= matchLength) {
+			memcpy(op, match, matchLength);
+			op += matchLength;
+		}
+		else if (offset == 1) {
+			memset(op, *match, matchLength);
+			op += matchLength;
+		}
+		else {
+			/* the match overlaps what it's producing (e.g. a run of one byte), so it has to go in order */
+			while (matchLength--) *op++ = *match++;
+		}
+	}
+	
+	return (size_t)(op - dest);
+}
\ No newline at end of file
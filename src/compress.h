@@ -0,0 +1,46 @@
+/* Internal header file for Hexlet's LZ compressor */
+
+#ifndef HEXLET_CMP_H_INTERNAL
+#define HEXLET_CMP_H_INTERNAL
+
+#include <stddef.h>
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+
+/*
+*  The compressed format is a series of sequences, like LZ4's block format:
+*  - a token byte (high nibble: literal count, low nibble: match length - 4, where 15 means more length bytes follow)
+*  - extra literal count bytes (each adds up to 255; a byte below 255 ends the count)
+*  - the literals
+*  - a 16-bit little-endian match offset (how far back the match starts, at least 1)
+*  - extra match length bytes, the same way as the literal count
+*  The last sequence is only literals (it has no offset), and the last 5 bytes of the input are always literals.
+*/
+#define cmp_MIN_MATCH 4
+#define cmp_MAX_OFFSET 0xffff
+#define cmp_LAST_LITERALS 5
+
+/* Log2 of the number of entries in the compressor's match finder */
+#define cmp_HASH_BITS 12
+
+/*
+*  Return the largest size the given number of bytes can compress to (for incompressible data).
+*/
+static inline size_t cmp_getBound(size_t length) {
+	return length + length / 255 + 16;
+}
+
+/*
+*  Compress length bytes from src into dest, which has room for capacity bytes.
+*  Return the compressed size, or 0 if it doesn't fit (a capacity of cmp_getBound(length) always fits).
+*/
+size_t cmp_compress(const u8 *src, size_t length, u8 *dest, size_t capacity);
+
+/*
+*  Decompress length bytes of compressed data from src into dest, which has room for capacity bytes.
+*  Return the decompressed size, or 0 if the data is corrupt or doesn't fit.
+*/
+size_t cmp_decompress(const u8 *src, size_t length, u8 *dest, size_t capacity);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,178 @@
+/* Source file for Hexlet's checksums */
+
+#include <stddef.h>
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+
+#include "crc.h"
+
+#ifdef crc_HAS_PCLMUL
+#include <immintrin.h>
+#endif
+
+static crc_Model crc_model32 = { 32, 0xedb88320 };
+static crc_Model crc_model16 = { 16, 0x8408 };
+static bool crc_tablesReady;
+
+static inline u32 crc_read32(const u8 *ptr) {
+	return ptr[0] | (ptr[1] << 8) | (ptr[2] << 16) | ((u32)ptr[3] << 24);
+}
+
+/*
+*  Get x^n mod the model's polynomial, bit-reversed into 64 bits (so x^63 is bit 0), which is how the folding code sees polynomials.
+*/
+static u64 crc_getFoldConstant(crc_Model *model, u32 n) {
+	u32 normalPoly = 0;
+	for (u8 i = 0; i < model->width; i++) {
+		if (model->poly & (1u << i)) normalPoly |= 1u << (model->width - 1 - i);
+	}
+	
+	u64 remainder = 1;
+	for (u32 i = 0; i < n; i++) {
+		remainder <<= 1;
+		if (remainder & ((u64)1 << model->width)) remainder ^= ((u64)1 << model->width) | normalPoly;
+	}
+	
+	u64 reflected = 0;
+	for (u8 i = 0; i < model->width; i++) {
+		if (remainder & ((u64)1 << i)) reflected |= (u64)1 << (63 - i);
+	}
+	
+	return reflected;
+}
+
+static void crc_initModel(crc_Model *model) {
+	for (u32 i = 0; i < 256; i++) {
+		u32 crc = i;
+		for (u8 bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ ((crc & 1) ? model->poly : 0);
+		model->tables[0][i] = crc;
+	}
+	
+	for (u32 i = 0; i < 256; i++) {
+		for (u8 k = 1; k < 8; k++) {
+			u32 previous = model->tables[k - 1][i];
+			model->tables[k][i] = (previous >> 8) ^ model->tables[0][previous & 0xff];
+		}
+	}
+	
+	/*
+	*  A carry-less multiply of two bit-reversed values comes out one bit short (as if multiplied by x),
+	*  so shifting 128 bits along takes x^(128 - 1) for the low half and x^(128 + 64 - 1) for the high-order one.
+	*/
+	model->fold128[0] = crc_getFoldConstant(model, 128 + 64 - 1);
+	model->fold128[1] = crc_getFoldConstant(model, 128 - 1);
+	model->fold512[0] = crc_getFoldConstant(model, 512 + 64 - 1);
+	model->fold512[1] = crc_getFoldConstant(model, 512 - 1);
+}
+
+void crc_initTables(void) {
+	if (crc_tablesReady) return;
+	
+	crc_initModel(&crc_model32);
+	crc_initModel(&crc_model16);
+	crc_tablesReady = TRUE;
+}
+
+/*
+*  Run the CRC over the data 8 bytes at a time. crc is the raw remainder (without the start and end inversions).
+*/
+static u32 crc_slice8(const crc_Model *model, u32 crc, const u8 *data, size_t length) {
+	const u32 (*t)[256] = model->tables;
+	
+	while (length >= 8) {
+		u32 low = crc ^ crc_read32(data);
+		u32 high = crc_read32(data + 4);
+		
+		crc = t[7][low & 0xff] ^ t[6][(low >> 8) & 0xff] ^ t[5][(low >> 16) & 0xff] ^ t[4][low >> 24]
+			^ t[3][high & 0xff] ^ t[2][(high >> 8) & 0xff] ^ t[1][(high >> 16) & 0xff] ^ t[0][high >> 24];
+		
+		data += 8;
+		length -= 8;
+	}
+	
+	while (length--) {
+		crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xff];
+	}
+	
+	return crc;
+}
+
+#ifdef crc_HAS_PCLMUL
+
+/*
+*  Multiply both halves of a 128-bit remainder by their constants and add them up, which shifts it along without changing its CRC.
+*/
+__attribute__((target("pclmul,sse2")))
+static inline __m128i crc_fold(__m128i value, __m128i constants) {
+	return _mm_xor_si128(_mm_clmulepi64_si128(value, constants, 0x00), _mm_clmulepi64_si128(value, constants, 0x11));
+}
+
+/*
+*  Fold the data down to 16 bytes with the same CRC using four independent lanes, then finish off with the tables.
+*  length has to be at least 64.
+*/
+__attribute__((target("pclmul,sse2")))
+static u32 crc_foldPCLMUL(const crc_Model *model, u32 crc, const u8 *data, size_t length) {
+	__m128i fold128 = _mm_set_epi64x((long long)model->fold128[1], (long long)model->fold128[0]);
+	__m128i fold512 = _mm_set_epi64x((long long)model->fold512[1], (long long)model->fold512[0]);
+	
+	/* the remainder so far lines up with the first bytes of the data */
+	__m128i lane0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)data), _mm_cvtsi32_si128((int)crc));
+	__m128i lane1 = _mm_loadu_si128((const __m128i *)(data + 16));
+	__m128i lane2 = _mm_loadu_si128((const __m128i *)(data + 32));
+	__m128i lane3 = _mm_loadu_si128((const __m128i *)(data + 48));
+	data += 64;
+	length -= 64;
+	
+	while (length >= 64) {
+		lane0 = _mm_xor_si128(crc_fold(lane0, fold512), _mm_loadu_si128((const __m128i *)data));
+		lane1 = _mm_xor_si128(crc_fold(lane1, fold512), _mm_loadu_si128((const __m128i *)(data + 16)));
+		lane2 = _mm_xor_si128(crc_fold(lane2, fold512), _mm_loadu_si128((const __m128i *)(data + 32)));
+		lane3 = _mm_xor_si128(crc_fold(lane3, fold512), _mm_loadu_si128((const __m128i *)(data + 48)));
+		data += 64;
+		length -= 64;
+	}
+	
+	lane1 = _mm_xor_si128(crc_fold(lane0, fold128), lane1);
+	lane2 = _mm_xor_si128(crc_fold(lane1, fold128), lane2);
+	lane3 = _mm_xor_si128(crc_fold(lane2, fold128), lane3);
+	
+	u8 folded[16];
+	_mm_storeu_si128((__m128i *)folded, lane3);
+	
+	return crc_slice8(model, crc_slice8(model, 0, folded, 16), data, length);
+}
+
+static bool crc_hasPCLMUL(void) {
+	static s8 supported = -1;
+	
+	if (supported < 0) {
+		__builtin_cpu_init();
+		supported = __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse2");
+	}
+	
+	return supported != 0;
+}
+
+#endif
+
+static u32 crc_update(const crc_Model *model, u32 crc, const u8 *data, size_t length) {
+#ifdef crc_HAS_PCLMUL
+	if (length >= crc_MIN_FOLD_LENGTH && crc_hasPCLMUL()) {
+		return crc_foldPCLMUL(model, crc, data, length);
+	}
+#endif
+	
+	return crc_slice8(model, crc, data, length);
+}
+
+u32 crc_getCRC32(u32 crc, const u8 *data, size_t length) {
+	crc_initTables();
+	return ~crc_update(&crc_model32, ~crc, data, length);
+}
+
+u16 crc_getCRC16(u16 crc, const u8 *data, size_t length) {
+	crc_initTables();
+	return (u16)~crc_update(&crc_model16, (u16)~crc, data, length);
+}
\ No newline at end of file
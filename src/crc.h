@@ -0,0 +1,49 @@
+/* Internal header file for Hexlet's checksums */
+
+#ifndef HEXLET_CRC_H_INTERNAL
+#define HEXLET_CRC_H_INTERNAL
+
+#include <stddef.h>
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+
+/* x86-64 hosts can fold 64 bytes at a time with carry-less multiplies if the CPU has them (checked at runtime) */
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define crc_HAS_PCLMUL
+#endif
+
+/* Below this many bytes the setup for carry-less folding costs more than it saves */
+#define crc_MIN_FOLD_LENGTH 256
+
+/*
+*  A CRC of up to 32 bits, computed least significant bit first (like zlib's), with an all-ones start and end.
+*  poly is the bit-reversed polynomial. The tables are for slicing-by-8 (tables[k] advances a byte k bytes further),
+*  and the fold constants are x^n mod the polynomial for carry-less folding, bit-reversed into 64 bits.
+*/
+typedef struct {
+	u8 width;
+	u32 poly;
+	
+	u32 tables[8][256];
+	u64 fold128[2];
+	u64 fold512[2];
+} crc_Model;
+
+/*
+*  Build the tables for both CRCs. Every function below does this on first use, but anything that computes CRCs on another thread
+*  should call this on its own thread first.
+*/
+void crc_initTables(void);
+
+/*
+*  Continue a CRC-32 (the one zlib and PNG use) over length more bytes. Start with a crc of 0.
+*/
+u32 crc_getCRC32(u32 crc, const u8 *data, size_t length);
+
+/*
+*  Continue a CRC-16 (X.25's: polynomial $1021, least significant bit first) over length more bytes. Start with a crc of 0.
+*/
+u16 crc_getCRC16(u16 crc, const u8 *data, size_t length);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,151 @@
+/* Source file for Hexlet's emulator main loop */
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+#include <hexlet_emulate.h>
+
+#include "memory.h"
+#include "pilot.h"
+#include "scheduler.h"
+
+/* Frame timing (until the PPU's timing is pinned down) */
+#define emu_CYCLES_PER_SCANLINE 512
+#define emu_SCANLINES_PER_FRAME 256
+#define emu_CYCLES_PER_FRAME (emu_CYCLES_PER_SCANLINE * emu_SCANLINES_PER_FRAME)
+
+/* Where the assembler puts code by default */
+#define emu_RESET_VECTOR 0xff0000
+
+static bool emu_initialized = FALSE;
+static sch_Scheduler emu_scheduler;
+
+static u16 emu_scanline;
+static u8 emu_irqLevel;
+static bool emu_dmaActive;
+static bool emu_frameDone;
+static bool emu_jitEnabled = TRUE;
+
+bool emu_reset(void) {
+	cpu_Pilot *cpu = cpu_getCurrentPilot();
+	
+	if (emu_initialized) {
+		cpu_freePilot(cpu);
+	}
+	
+	emu_initialized = FALSE;
+	
+	for (u8 i = 0; i < 8; i++) cpu->regs[i] = 0;
+	cpu_setStatusReg(cpu, 0x0000);
+	cpu->programCounter = emu_RESET_VECTOR;
+	
+	if (!cpu_initPilot(cpu)) {
+		return FALSE;
+	}
+	
+	/* a build without the recompiler just stays on the interpreter */
+	cpu_setJITEnabled(cpu, emu_jitEnabled);
+	
+	mem_initMemory(mem_getCurrentMemory());
+	
+	sch_initScheduler(&emu_scheduler);
+	sch_schedule(&emu_scheduler, sch_EVENT_SCANLINE, emu_CYCLES_PER_SCANLINE, 0);
+	sch_schedule(&emu_scheduler, sch_EVENT_FRAME, emu_CYCLES_PER_FRAME, 0);
+	
+	emu_scanline = 0;
+	emu_irqLevel = 0;
+	emu_dmaActive = FALSE;
+	emu_initialized = TRUE;
+	
+	return TRUE;
+}
+
+/*
+*  Act on an event that just came due.
+*/
+static void emu_handleEvent(sch_Event *event) {
+	cpu_Pilot *cpu = cpu_getCurrentPilot();
+	
+	switch (event->type) {
+		case sch_EVENT_SCANLINE: {
+			/* the PPU will draw emu_scanline here */
+			emu_scanline = (emu_scanline + 1) % emu_SCANLINES_PER_FRAME;
+			sch_schedule(&emu_scheduler, sch_EVENT_SCANLINE, event->deadline + emu_CYCLES_PER_SCANLINE, 0);
+			break;
+		}
+		case sch_EVENT_FRAME: {
+			emu_frameDone = TRUE;
+			sch_schedule(&emu_scheduler, sch_EVENT_FRAME, event->deadline + emu_CYCLES_PER_FRAME, 0);
+			break;
+		}
+		case sch_EVENT_DMA: {
+			emu_dmaActive = FALSE;
+			break;
+		}
+		case sch_EVENT_IRQ: {
+			emu_irqLevel = (u8)event->data;
+			
+			/* an IRQ above the CPU's mask level wakes it up (taking the exception isn't emulated yet) */
+			if (emu_irqLevel > ((cpu->statusReg & cpu_IRQ_LEVEL_MASK) >> 8)) {
+				cpu->halted = FALSE;
+			}
+			break;
+		}
+		case sch_EVENT_TIMER:
+		default:
+			break;
+	}
+}
+
+bool emu_tick(void) {
+	if (!emu_initialized && !emu_reset()) {
+		return FALSE;
+	}
+	
+	mem_Memory *memory = mem_getCurrentMemory();
+	cpu_Pilot *cpu = cpu_getCurrentPilot();
+	emu_frameDone = FALSE;
+	
+	while (!emu_frameDone) {
+		u64 deadline = sch_getNextDeadline(&emu_scheduler);
+		
+		/* run the CPU in one burst up to the next event (nothing else can happen before then) */
+		if (deadline > emu_scheduler.now) {
+			u64 burst = deadline - emu_scheduler.now;
+			
+			if (emu_dmaActive) {
+				emu_scheduler.now = deadline;
+			}
+			else {
+				emu_scheduler.now += cpu_runPilot(cpu, memory, (burst > 0xffffffff) ? 0xffffffff : (u32)burst);
+			}
+		}
+		
+		sch_Event event;
+		while (sch_popDueEvent(&emu_scheduler, &event)) {
+			emu_handleEvent(&event);
+		}
+	}
+	
+	return TRUE;
+}
+
+bool emu_setJITEnabled(bool enabled) {
+	if (!emu_initialized && !emu_reset()) {
+		return FALSE;
+	}
+	
+	if (!cpu_setJITEnabled(cpu_getCurrentPilot(), enabled)) {
+		return FALSE;
+	}
+	
+	emu_jitEnabled = enabled;
+	return TRUE;
+}
+
+u64 emu_getCycles(void) {
+	return cpu_getCurrentPilot()->cycles;
+}
+
+u64 emu_getSkippedCycles(void) {
+	return cpu_getCurrentPilot()->skippedCycles;
+}
\ No newline at end of file
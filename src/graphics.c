@@ -0,0 +1,28 @@
+/* Source file for Hexlet's graphics engine */
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+#include <hexlet_driver.h>
+#include <hexlet_graphics.h>
+
+#include "graphics.h"
+
+/* The coordinates are 8 bits, so a row is at most this many pixels long */
+#define gfx_MAX_SPAN 256
+
+bool gfx_drawSpan(u8 x, u8 y, u16 length, u8 *data) {
+	if (x + length > gfx_MAX_SPAN) length = gfx_MAX_SPAN - x;
+	if (length == 0) return TRUE;
+	
+#ifdef HEXLET_DRIVER_SPANS
+	return drv_plotSpan(x, y, length, data);
+#else
+	/* the driver only has drv_plotPix, so a span costs a call per pixel */
+	for (u16 i = 0; i < length; i++) {
+		u8 intensity = (i & 1) ? data[i / 2] & 0x0f : data[i / 2] >> 4;
+		if (!drv_plotPix((u8)(x + i), y, intensity)) return FALSE;
+	}
+	
+	return TRUE;
+#endif
+}
\ No newline at end of file
@@ -12,6 +12,12 @@
 */
 char *gfx_getError(void);
 
+/*
+*  Plot a span of packed intensities on one row of the screen, through the driver's drv_plotSpan if it has one (see hexlet_driver.h).
+*  Pixels past the right edge of the screen are dropped. Return FALSE on failure or TRUE on success.
+*/
+bool gfx_drawSpan(u8 x, u8 y, u16 length, u8 *data);
+
 
 // to be continued
 
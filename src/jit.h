@@ -0,0 +1,58 @@
+/* Internal header file for Hexlet's x86-64 dynamic recompiler */
+
+#ifndef HEXLET_JIT_H_INTERNAL
+#define HEXLET_JIT_H_INTERNAL
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+
+#include "pilot.h"
+
+/* A block has to run this many times in the interpreter before it gets translated */
+#define jit_HOT_THRESHOLD 16
+
+/* Size of the executable buffer the translated blocks live in */
+#define jit_CODE_BUFFER_SIZE (1024 * 1024)
+
+/*
+*  Translated code for one basic block.
+*  It takes the CPU, runs the whole block with the guest registers and status register in host registers, writes them back, and returns the cycles taken.
+*  The status register has to be up to date (see cpu_getStatusReg()) when it's called.
+*/
+typedef u32 (*jit_BlockFunction)(cpu_Pilot *pilot);
+
+typedef struct jit_CodeBuffer {
+	u8 *code;
+	u32 used;
+	u32 pageSize;	/* the host's, so a translation only unprotects the pages it writes */
+} jit_CodeBuffer;
+
+/*
+*  Map the executable code buffer. Return FALSE on failure or TRUE on success.
+*/
+bool jit_initCodeBuffer(jit_CodeBuffer *buffer);
+
+/*
+*  Unmap the executable code buffer.
+*/
+void jit_freeCodeBuffer(jit_CodeBuffer *buffer);
+
+/*
+*  Return TRUE if the given block can be translated.
+*  So far that's blocks of NOPs, and MOV and ALU instructions from registers or immediates into registers,
+*  ending with HALT, ILG, or a branch to a register or a fixed address.
+*/
+bool jit_canTranslateBlock(cpu_Block *block);
+
+/*
+*  Translate the given block (which jit_canTranslateBlock() has to have accepted) into native code and return it.
+*  Return NULL if the code buffer is full; the caller must then drop every translated block and call jit_resetCodeBuffer().
+*/
+jit_BlockFunction jit_translateBlock(jit_CodeBuffer *buffer, cpu_Block *block);
+
+/*
+*  Throw away every translated block.
+*/
+void jit_resetCodeBuffer(jit_CodeBuffer *buffer);
+
+#endif
\ No newline at end of file
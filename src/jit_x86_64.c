@@ -0,0 +1,432 @@
+/* Source file for Hexlet's x86-64 dynamic recompiler (System V hosts only) */
+
+#if defined(HEXLET_JIT) && defined(__x86_64__)
+
+/* for MAP_ANONYMOUS */
+#define _DEFAULT_SOURCE
+
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+
+#include "jit.h"
+
+/*
+*  Host register assignment while a translated block runs:
+*  rdi = cpu_Pilot *, r8d-r15d = regs[0]-regs[7], esi = statusReg, edx = programCounter, eax = return value
+*/
+#define jit_HOST_EAX	0
+#define jit_HOST_ECX	1
+#define jit_HOST_EDX	2
+#define jit_HOST_ESI	6
+#define jit_HOST_EDI	7
+#define jit_HOST_R8D	8
+
+#define jit_GUEST_REG(n) (jit_HOST_R8D + (n))
+
+/* Worst-case size of the code emitted for one block */
+#define jit_MAX_BLOCK_CODE (256 + 8 * cpu_MAX_BLOCK_INSTRUCTIONS)
+
+/*
+*  x86 encodings of MOV and the ALU instructions, indexed from cpu_OP_MOV:
+*  the opcode for r/m16, r16, the opcode and ModRM digit for r/m16, imm16, and which flags the instruction sets
+*/
+typedef struct {
+	u8 registerOpcode;
+	u8 immediateOpcode;
+	u8 digit;
+	cpu_FlagOperation flags;
+} jit_ALUEncoding;
+
+static const jit_ALUEncoding jit_aluEncodings[] = {
+	{ 0x89, 0xc7, 0, cpu_FLAGS_NONE },	/* MOV */
+	{ 0x01, 0x81, 0, cpu_FLAGS_ADD },	/* ADD */
+	{ 0x29, 0x81, 5, cpu_FLAGS_SUB },	/* SUB */
+	{ 0x39, 0x81, 7, cpu_FLAGS_SUB },	/* CMP */
+	{ 0x21, 0x81, 4, cpu_FLAGS_LOGIC },	/* AND */
+	{ 0x09, 0x81, 1, cpu_FLAGS_LOGIC },	/* OR */
+	{ 0x31, 0x81, 6, cpu_FLAGS_LOGIC },	/* XOR */
+};
+
+#define jit_IS_ALU(operation) ((operation) >= cpu_OP_MOV && (operation) <= cpu_OP_XOR)
+
+/* The flag each pair of conditional branches tests (BEQ/BNE, BCS/BCC, BMI/BPL, BVS/BVC) */
+static const u16 jit_conditionFlags[] = { cpu_FLAG_ZERO, cpu_FLAG_CARRY, cpu_FLAG_SIGN, cpu_FLAG_OVERFLOW };
+
+bool jit_initCodeBuffer(jit_CodeBuffer *buffer) {
+	long pageSize = sysconf(_SC_PAGESIZE);
+	
+	buffer->code = mmap(NULL, jit_CODE_BUFFER_SIZE, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	buffer->used = 0;
+	buffer->pageSize = (pageSize > 0) ? (u32)pageSize : 4096;
+	
+	if (buffer->code == MAP_FAILED) {
+		buffer->code = NULL;
+		return FALSE;
+	}
+	
+	return TRUE;
+}
+
+void jit_freeCodeBuffer(jit_CodeBuffer *buffer) {
+	if (buffer->code != NULL) {
+		munmap(buffer->code, jit_CODE_BUFFER_SIZE);
+		buffer->code = NULL;
+	}
+}
+
+void jit_resetCodeBuffer(jit_CodeBuffer *buffer) {
+	buffer->used = 0;
+}
+
+/*
+*  Change the protection of just the pages covering length bytes from offset in the code buffer.
+*  Return FALSE on failure or TRUE on success.
+*/
+static bool jit_protectCode(jit_CodeBuffer *buffer, u32 offset, u32 length, int protection) {
+	u32 start = offset & ~(buffer->pageSize - 1);
+	u32 end = (offset + length + buffer->pageSize - 1) & ~(buffer->pageSize - 1);
+	if (end > jit_CODE_BUFFER_SIZE) end = jit_CODE_BUFFER_SIZE;
+	
+	return !mprotect(buffer->code + start, end - start, protection);
+}
+
+static inline void jit_emitByte(u8 **ptr, u8 value) {
+	*(*ptr)++ = value;
+}
+
+static inline void jit_emitDword(u8 **ptr, u32 value) {
+	jit_emitByte(ptr, (u8)value);
+	jit_emitByte(ptr, (u8)(value >> 8));
+	jit_emitByte(ptr, (u8)(value >> 16));
+	jit_emitByte(ptr, (u8)(value >> 24));
+}
+
+static inline void jit_emitBytes(u8 **ptr, const u8 *bytes, u32 count) {
+	memcpy(*ptr, bytes, count);
+	*ptr += count;
+}
+
+/*
+*  Emit a ModRM byte (and displacement) addressing [rdi + offset].
+*/
+static inline void jit_emitPilotField(u8 **ptr, u8 hostReg, u32 offset) {
+	jit_emitByte(ptr, 0x80 | ((hostReg & 0x07) << 3) | jit_HOST_EDI);
+	jit_emitDword(ptr, offset);
+}
+
+/* mov r32, dword [rdi + offset] */
+static void jit_emitLoad32(u8 **ptr, u8 hostReg, u32 offset) {
+	if (hostReg >= 8) jit_emitByte(ptr, 0x44);
+	jit_emitByte(ptr, 0x8b);
+	jit_emitPilotField(ptr, hostReg, offset);
+}
+
+/* mov dword [rdi + offset], r32 */
+static void jit_emitStore32(u8 **ptr, u8 hostReg, u32 offset) {
+	if (hostReg >= 8) jit_emitByte(ptr, 0x44);
+	jit_emitByte(ptr, 0x89);
+	jit_emitPilotField(ptr, hostReg, offset);
+}
+
+/* movzx r32, word [rdi + offset] */
+static void jit_emitLoad16(u8 **ptr, u8 hostReg, u32 offset) {
+	jit_emitByte(ptr, 0x0f);
+	jit_emitByte(ptr, 0xb7);
+	jit_emitPilotField(ptr, hostReg, offset);
+}
+
+/* mov word [rdi + offset], r16 */
+static void jit_emitStore16(u8 **ptr, u8 hostReg, u32 offset) {
+	jit_emitByte(ptr, 0x66);
+	jit_emitByte(ptr, 0x89);
+	jit_emitPilotField(ptr, hostReg, offset);
+}
+
+/* mov r32, imm32 */
+static void jit_emitMoveImmediate(u8 **ptr, u8 hostReg, u32 value) {
+	if (hostReg >= 8) jit_emitByte(ptr, 0x41);
+	jit_emitByte(ptr, 0xb8 + (hostReg & 0x07));
+	jit_emitDword(ptr, value);
+}
+
+/* mov byte [rdi + offset], imm8 */
+static void jit_emitStoreImmediate8(u8 **ptr, u32 offset, u8 value) {
+	jit_emitByte(ptr, 0xc6);
+	jit_emitPilotField(ptr, 0, offset);
+	jit_emitByte(ptr, value);
+}
+
+/* mov r32, r32 */
+static void jit_emitMoveRegister(u8 **ptr, u8 destination, u8 source) {
+	if (destination >= 8 || source >= 8) jit_emitByte(ptr, 0x40 | ((source >= 8) << 2) | (destination >= 8));
+	jit_emitByte(ptr, 0x89);
+	jit_emitByte(ptr, 0xc0 | ((source & 0x07) << 3) | (destination & 0x07));
+}
+
+/* op r16, r16 between two guest registers (a W register is the low half of its host register) */
+static void jit_emitALURegister(u8 **ptr, const jit_ALUEncoding *encoding, u8 destination, u8 source) {
+	jit_emitByte(ptr, 0x66);
+	jit_emitByte(ptr, 0x45);
+	jit_emitByte(ptr, encoding->registerOpcode);
+	jit_emitByte(ptr, 0xc0 | ((source & 0x07) << 3) | (destination & 0x07));
+}
+
+/* op r16, imm16 on a guest register */
+static void jit_emitALUImmediate(u8 **ptr, const jit_ALUEncoding *encoding, u8 destination, u16 value) {
+	jit_emitByte(ptr, 0x66);
+	jit_emitByte(ptr, 0x41);
+	jit_emitByte(ptr, encoding->immediateOpcode);
+	jit_emitByte(ptr, 0xc0 | (encoding->digit << 3) | (destination & 0x07));
+	jit_emitByte(ptr, (u8)value);
+	jit_emitByte(ptr, (u8)(value >> 8));
+}
+
+/*
+*  Copy the host's flags after an ALU instruction into the guest status register in esi.
+*  lahf leaves SF and ZF in ah at the same bits as the Pilot's sign and zero flags, with CF in bit 0, and seto gets OF.
+*/
+static void jit_emitCaptureFlags(u8 **ptr, cpu_FlagOperation operation) {
+	u32 affected = cpu_FLAG_SIGN | cpu_FLAG_ZERO | cpu_FLAG_CARRY | cpu_FLAG_OVERFLOW;
+	if (operation != cpu_FLAGS_LOGIC) affected |= cpu_FLAG_EXTEND;
+	
+	static const u8 capture[] = {
+		0x9f,				/* lahf */
+		0x0f, 0x90, 0xc0,		/* seto al */
+		0x0f, 0xb6, 0xcc,		/* movzx ecx, ah */
+		0x81, 0xe1, 0xc1, 0x00, 0x00, 0x00,	/* and ecx, SF | ZF | CF */
+		0x8d, 0x0c, 0xc9,		/* lea ecx, [rcx + rcx * 8] (a copy of CF lands on the carry flag's bit) */
+		0x0f, 0xb6, 0xc0,		/* movzx eax, al */
+		0xc1, 0xe0, 0x02,		/* shl eax, 2 (OF to the overflow flag's bit) */
+	};
+	jit_emitBytes(ptr, capture, sizeof(capture));
+	
+	/* and ecx, affected (the logic instructions leave extend alone, and x86 clears CF and OF for them just like the Pilot) */
+	jit_emitByte(ptr, 0x81);
+	jit_emitByte(ptr, 0xe1);
+	jit_emitDword(ptr, affected & ~cpu_FLAG_OVERFLOW);
+	
+	/* and esi, ~affected */
+	jit_emitByte(ptr, 0x81);
+	jit_emitByte(ptr, 0xe6);
+	jit_emitDword(ptr, ~affected);
+	
+	static const u8 merge[] = {
+		0x09, 0xce,			/* or esi, ecx */
+		0x09, 0xc6,			/* or esi, eax */
+	};
+	jit_emitBytes(ptr, merge, sizeof(merge));
+}
+
+/*
+*  Point edx (which holds the fall-through address) at the branch's target, if its condition holds.
+*/
+static void jit_emitBranch(u8 **ptr, cpu_Instruction *branch) {
+	cpu_Operand *target = &branch->operands[0];
+	u8 source = jit_HOST_ECX;
+	
+	if (target->mode == cpu_RM_REGISTER) {
+		source = jit_GUEST_REG(target->reg);
+	}
+	else {
+		jit_emitMoveImmediate(ptr, jit_HOST_ECX, target->value & 0xffffff);
+	}
+	
+	if (branch->operation == cpu_OP_BRA) {
+		jit_emitMoveRegister(ptr, jit_HOST_EDX, source);
+		return;
+	}
+	
+	u8 condition = branch->operation - cpu_OP_BEQ;
+	
+	/* test esi, flag */
+	jit_emitByte(ptr, 0xf7);
+	jit_emitByte(ptr, 0xc6);
+	jit_emitDword(ptr, jit_conditionFlags[condition >> 1]);
+	
+	/* cmovnz edx, source for the branches taken when the flag is set, cmovz for the ones taken when it's clear */
+	if (source >= 8) jit_emitByte(ptr, 0x41);
+	jit_emitByte(ptr, 0x0f);
+	jit_emitByte(ptr, (condition & 1) ? 0x44 : 0x45);
+	jit_emitByte(ptr, 0xc0 | (jit_HOST_EDX << 3) | (source & 0x07));
+}
+
+/* push/pop r12-r15 */
+static void jit_emitPush(u8 **ptr, u8 hostReg) {
+	jit_emitByte(ptr, 0x41);
+	jit_emitByte(ptr, 0x50 + (hostReg & 0x07));
+}
+
+static void jit_emitPop(u8 **ptr, u8 hostReg) {
+	jit_emitByte(ptr, 0x41);
+	jit_emitByte(ptr, 0x58 + (hostReg & 0x07));
+}
+
+/*
+*  Work out which guest registers a block touches, so only those get loaded and written back,
+*  and whether it sets or tests any flags, so the status register only gets loaded and written back if it does.
+*/
+static u8 jit_getRegisterMask(cpu_Block *block, bool *usesStatus) {
+	u8 mask = 0x00;
+	*usesStatus = FALSE;
+	
+	for (u8 i = 0; i < block->instructionCount; i++) {
+		cpu_Instruction *instruction = &block->instructions[i];
+		
+		if (jit_IS_ALU(instruction->operation) && jit_aluEncodings[instruction->operation - cpu_OP_MOV].flags != cpu_FLAGS_NONE) {
+			*usesStatus = TRUE;
+		}
+		if (cpu_IS_BRANCH(instruction->operation) && instruction->operation != cpu_OP_BRA) {
+			*usesStatus = TRUE;
+		}
+		
+		for (u8 j = 0; j < instruction->operandCount; j++) {
+			switch (instruction->operands[j].mode) {
+				case cpu_RM_REGISTER:
+				case cpu_RM_POST_INCREMENT:
+				case cpu_RM_DISPLACEMENT:
+				case cpu_RM_INDIRECT:
+				case cpu_RM_PRE_DECREMENT:
+				case cpu_RM_REGISTER_INDEXED:
+					mask |= 1 << instruction->operands[j].reg;
+					break;
+				default:
+					break;
+			}
+		}
+	}
+	
+	return mask;
+}
+
+bool jit_canTranslateBlock(cpu_Block *block) {
+	for (u8 i = 0; i < block->instructionCount; i++) {
+		cpu_Instruction *instruction = &block->instructions[i];
+		
+		if (jit_IS_ALU(instruction->operation)) {
+			if (instruction->operands[0].mode != cpu_RM_REGISTER) return FALSE;
+			if (instruction->operands[1].mode != cpu_RM_REGISTER && instruction->operands[1].mode != cpu_RM_IMMEDIATE) return FALSE;
+		}
+		else if (cpu_IS_BRANCH(instruction->operation)) {
+			switch (instruction->operands[0].mode) {
+				case cpu_RM_REGISTER:
+				case cpu_RM_IMMEDIATE:
+				case cpu_RM_ABSOLUTE:
+				case cpu_RM_PGC_RELATIVE:
+					break;
+				default:
+					return FALSE;
+			}
+		}
+	}
+	
+	return TRUE;
+}
+
+jit_BlockFunction jit_translateBlock(jit_CodeBuffer *buffer, cpu_Block *block) {
+	if (buffer->used + jit_MAX_BLOCK_CODE > jit_CODE_BUFFER_SIZE) {
+		return NULL;
+	}
+	
+	/* only the pages this block can be written to lose their execute permission */
+	u32 offset = buffer->used;
+	if (!jit_protectCode(buffer, offset, jit_MAX_BLOCK_CODE, PROT_READ | PROT_WRITE)) {
+		return NULL;
+	}
+	
+	u8 *start = buffer->code + buffer->used;
+	u8 *ptr = start;
+	
+	bool usesStatus;
+	u8 regMask = jit_getRegisterMask(block, &usesStatus);
+	
+	/* prologue: save the callee-saved registers we use and pull the guest state into host registers */
+	for (u8 reg = 4; reg < 8; reg++) {
+		if (regMask & (1 << reg)) jit_emitPush(&ptr, jit_GUEST_REG(reg));
+	}
+	for (u8 reg = 0; reg < 8; reg++) {
+		if (regMask & (1 << reg)) jit_emitLoad32(&ptr, jit_GUEST_REG(reg), offsetof(cpu_Pilot, regs) + reg * sizeof(u32));
+	}
+	if (usesStatus) {
+		jit_emitLoad16(&ptr, jit_HOST_ESI, offsetof(cpu_Pilot, statusReg));
+	}
+	
+	/* the flags only have to be copied out of the host's after the last instruction that sets them */
+	u8 lastFlagSetter = block->instructionCount;
+	for (u8 i = 0; i < block->instructionCount; i++) {
+		cpu_Operation operation = block->instructions[i].operation;
+		if (jit_IS_ALU(operation) && jit_aluEncodings[operation - cpu_OP_MOV].flags != cpu_FLAGS_NONE) lastFlagSetter = i;
+	}
+	
+	/* a block is straight-line code, so the program counter is known at every instruction */
+	u32 programCounter = block->startAddress;
+	cpu_Instruction *branch = NULL;
+	bool halts = FALSE;
+	
+	for (u8 i = 0; i < block->instructionCount; i++) {
+		cpu_Instruction *instruction = &block->instructions[i];
+		programCounter = (programCounter + instruction->length) & 0xffffff;
+		
+		if (jit_IS_ALU(instruction->operation)) {
+			const jit_ALUEncoding *encoding = &jit_aluEncodings[instruction->operation - cpu_OP_MOV];
+			cpu_Operand *destination = &instruction->operands[0];
+			cpu_Operand *source = &instruction->operands[1];
+			
+			if (source->mode == cpu_RM_REGISTER) {
+				jit_emitALURegister(&ptr, encoding, jit_GUEST_REG(destination->reg), jit_GUEST_REG(source->reg));
+			}
+			else {
+				jit_emitALUImmediate(&ptr, encoding, jit_GUEST_REG(destination->reg), (u16)source->value);
+			}
+			
+			if (i == lastFlagSetter) {
+				jit_emitCaptureFlags(&ptr, encoding->flags);
+			}
+		}
+		else if (cpu_IS_BRANCH(instruction->operation)) {
+			/* branches always end a block */
+			branch = instruction;
+		}
+		else if (instruction->operation != cpu_OP_NOP) {
+			halts = TRUE;
+		}
+	}
+	
+	/* epilogue: write the guest state back */
+	jit_emitMoveImmediate(&ptr, jit_HOST_EDX, programCounter);
+	if (branch != NULL) {
+		jit_emitBranch(&ptr, branch);
+	}
+	jit_emitStore32(&ptr, jit_HOST_EDX, offsetof(cpu_Pilot, programCounter));
+	
+	if (halts) {
+		jit_emitStoreImmediate8(&ptr, offsetof(cpu_Pilot, halted), TRUE);
+	}
+	if (usesStatus) {
+		jit_emitStore16(&ptr, jit_HOST_ESI, offsetof(cpu_Pilot, statusReg));
+	}
+	for (u8 reg = 0; reg < 8; reg++) {
+		if (regMask & (1 << reg)) jit_emitStore32(&ptr, jit_GUEST_REG(reg), offsetof(cpu_Pilot, regs) + reg * sizeof(u32));
+	}
+	for (u8 reg = 8; reg > 4; reg--) {
+		if (regMask & (1 << (reg - 1))) jit_emitPop(&ptr, jit_GUEST_REG(reg - 1));
+	}
+	
+	jit_emitMoveImmediate(&ptr, jit_HOST_EAX, block->cycles);
+	jit_emitByte(&ptr, 0xc3);
+	
+	buffer->used += (u32)(ptr - start);
+	
+	/* keep the buffer W^X */
+	if (!jit_protectCode(buffer, offset, jit_MAX_BLOCK_CODE, PROT_READ | PROT_EXEC)) {
+		return NULL;
+	}
+	
+	return (jit_BlockFunction)start;
+}
+
+#endif
\ No newline at end of file
@@ -1,12 +1,26 @@
 /* Source file for Hexlet's ROM image and state file loader */
 
+/* for madvise() */
+#define _DEFAULT_SOURCE
+
 #include <stdio.h>
 #include <string.h>
 
+#if defined(__unix__) || defined(__APPLE__)
+#define ldr_HAS_MMAP
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 #include <hexlet_ints.h>
 #include <hexlet_bools.h>
+#include <hexlet_driver.h>
 #include <hexlet_version.h>
 
+#include "compress.h"
+#include "crc.h"
 #include "errors.h"
 #include "loader.h"
 #include "memory.h"
@@ -16,10 +30,132 @@ static ldr_ROMImage ldr_currentROM;
 static ldr_StateFileChunk cs2Chunk;
 static ldr_StateFileChunk cs1Chunk;
 
+/* Set by ldr_setLazyROMVerification() */
+static bool ldr_lazyVerification;
+
+/* The file mapped by ldr_loadROMFile(), if there is one */
+static void *ldr_mappedFile;
+static size_t ldr_mappedFileSize;
+
 char *ldr_getError(void) {
 	return ldr_errorString;
 }
 
+static inline void ldr_put16(u8 *ptr, u16 value) {
+	ptr[0] = (u8)value;
+	ptr[1] = (u8)(value >> 8);
+}
+
+static inline void ldr_put32(u8 *ptr, u32 value) {
+	ldr_put16(ptr, (u16)value);
+	ldr_put16(ptr + 2, (u16)(value >> 16));
+}
+
+static inline u16 ldr_get16(u8 *ptr) {
+	return ptr[0] | (ptr[1] << 8);
+}
+
+static inline u32 ldr_get24(u8 *ptr) {
+	return ldr_get16(ptr) | ((u32)ptr[2] << 16);
+}
+
+static inline u32 ldr_get32(u8 *ptr) {
+	return ldr_get16(ptr) | ((u32)ldr_get16(ptr + 2) << 16);
+}
+
+/*
+*  The page table has to exist before the ROM can be mapped or dirty pages can be tracked or cleared.
+*/
+static mem_Memory *ldr_getMemory(void) {
+	mem_Memory *memory = mem_getCurrentMemory();
+	if (memory->banks[0] == NULL) mem_initMemory(memory);
+	
+	return memory;
+}
+
+void ldr_setLazyROMVerification(bool lazy) {
+	ldr_lazyVerification = lazy;
+}
+
+static bool ldr_checkROMImage(ldr_ROMImage *image) {
+	return crc_getCRC16(0, image->rom.data, image->rom.length) == image->header.crc;
+}
+
+bool ldr_verifyROM(void) {
+	return ldr_checkROMImage(&ldr_currentROM);
+}
+
+/*
+*  Parse the 256-byte header at the start of a ROM image. Return FALSE if it can't be used, with the reason in error (if that isn't NULL).
+*  This doesn't touch the loaded ROM, so it's safe to call on any thread.
+*/
+static bool ldr_parseROMHeader(u8 *data, ldr_ROMHeader *header, char *error) {
+	memset(header, 0, sizeof(ldr_ROMHeader));
+	memcpy(header->data, data, 256);
+	
+	/* the strings don't have to be terminated if they fill their fields (the last character gets cut off then) */
+	snprintf(header->title, sizeof(header->title), "%.*s", 127, (char *)data);
+	snprintf(header->author, sizeof(header->author), "%.*s", 95, (char *)data + 128);
+	
+	header->romSize = data[0xf0];
+	header->cs1 = data[0xf1];
+	header->cs2 = data[0xf2];
+	header->minHiveCraftVersion = data[0xf3];
+	
+	header->softwareRevision = ldr_get16(data + 0xf8);
+	header->copyrightStartYear = ldr_get16(data + 0xfa);
+	header->copyrightEndYear = ldr_get16(data + 0xfc);
+	header->crc = ldr_get16(data + 0xfe);
+	
+	if (strncmp((char *)data + 224, ldr_ROM_IMAGE_MAGIC, 16)) {
+		if (error != NULL) snprintf(error, err_MAX_ERR_SIZE, "Error loading ROM: Incorrect magic sequence");
+		return FALSE;
+	}
+	
+	if (header->minHiveCraftVersion > ver_MAX_HIVECRAFT_VERSION()) {
+		if (error != NULL) snprintf(error, err_MAX_ERR_SIZE, "Error loading ROM: Emulator is too old (needs SoC version $%.02X)", header->minHiveCraftVersion);
+		return FALSE;
+	}
+	
+	return TRUE;
+}
+
+bool ldr_readROMInfo(void *data, ldr_ROMInfo *info) {
+	ldr_ROMHeader header;
+	bool usable = ldr_parseROMHeader(data, &header, NULL);
+	
+	memcpy(info->title, header.title, sizeof(info->title));
+	memcpy(info->author, header.author, sizeof(info->author));
+	info->romSize = header.romSize;
+	info->cs1 = header.cs1;
+	info->cs2 = header.cs2;
+	info->minHiveCraftVersion = header.minHiveCraftVersion;
+	info->softwareRevision = header.softwareRevision;
+	info->copyrightStartYear = header.copyrightStartYear;
+	info->copyrightEndYear = header.copyrightEndYear;
+	info->crc = header.crc;
+	
+	return usable;
+}
+
+/*
+*  Read one of a ROM image's chunks (a 24-bit length, then the data) at *offset and move *offset past it.
+*  Return FALSE if the image (unless its length is 0, i.e. unknown) ends before the chunk does.
+*/
+static bool ldr_readROMChunk(u8 *data, u32 length, u32 *offset, ldr_StateFileChunk *chunk) {
+	if (length != 0 && length - *offset < 3) return FALSE;
+	
+	chunk->length = ldr_get24(data + *offset);
+	*offset += 3;
+	
+	if (length != 0 && length - *offset < chunk->length) return FALSE;
+	
+	chunk->data = data + *offset;
+	*offset += chunk->length;
+	
+	return TRUE;
+}
+
 bool ldr_loadROMImage(void *data, u32 length) {
 	snprintf(ldr_errorString, err_MAX_ERR_SIZE, "");
 	
@@ -28,102 +164,608 @@ bool ldr_loadROMImage(void *data, u32 length) {
 		return FALSE;
 	}
 	
-	ldr_ROMHeader header;
-	memset(&header, 0, sizeof(header));
+	/* everything is parsed into here first, so a failed load leaves the current ROM alone */
+	ldr_ROMImage image;
+	memset(&image, 0, sizeof(ldr_ROMImage));
 	
-	memcpy(header.data, data, 256);
-	bool noErrors = TRUE;
+	bool noErrors = ldr_parseROMHeader(data, &image.header, ldr_errorString);
+	u32 offset = 256;
 	
-	char *ptrStr = data;
-	snprintf(header.title, 128, "%s", ptrStr);
-	snprintf(header.author, 96, "%s", (ptrStr += 128));
+	if (!ldr_readROMChunk(data, length, &offset, &image.rom)) {
+		snprintf(ldr_errorString, err_MAX_ERR_SIZE, "Error loading ROM: Incomplete ROM chunk detected");
+		return FALSE;
+	}
+	
+	/* mapped any bigger, the ROM would cover RAM */
+	if (image.header.romSize > ldr_MAX_ROM_BANKS || image.rom.length > ldr_MAX_ROM_BANKS * 0x10000) {
+		snprintf(ldr_errorString, err_MAX_ERR_SIZE, "Error loading ROM: ROM is bigger than $%.02X banks", ldr_MAX_ROM_BANKS);
+		return FALSE;
+	}
 	
-	if (!strncmp(ptrStr += 96, ldr_ROM_IMAGE_MAGIC, 16)){
-		snprintf(ldr_errorString, err_MAX_ERR_SIZE, "Error loading ROM: Incorrect magic sequence");
+	/* build the CRC tables here, so a driver's thread can call ldr_verifyROM() without racing to build them */
+	crc_initTables();
+	if (!ldr_lazyVerification && noErrors && !ldr_checkROMImage(&image)) {
+		snprintf(ldr_errorString, err_MAX_ERR_SIZE, "Error loading ROM: Checksum doesn't match (the header says $%.04X)", image.header.crc);
 		noErrors = FALSE;
 	}
 	
-	u8 *ptrByte = data + 0xf0;
-	header.romSize = *ptrByte;
+	/* the chips' contents only follow the ROM if they're stored in the image, CS1's first */
+	if ((image.header.cs1 & ldr_CHIP_TYPE_STORED) && !ldr_readROMChunk(data, length, &offset, &image.cs1)) {
+		snprintf(ldr_errorString, err_MAX_ERR_SIZE, "Error loading ROM: Incomplete CS1 chunk detected");
+		return FALSE;
+	}
 	
-	header.cs1 = *(++ptrByte);
-	header.cs2 = *(++ptrByte);
-	header.minHiveCraftVersion = *ptrByte;
-	if (header.minHiveCraftVersion > ver_MAX_HIVECRAFT_VERSION() && noErrors) {
-		snprintf(ldr_errorString, err_MAX_ERR_SIZE, "Error loading ROM: Emulator is too old (needs SoC version $%.02X)", header.minHiveCraftVersion);
-		noErrors = FALSE;
+	if ((image.header.cs2 & ldr_CHIP_TYPE_STORED) && !ldr_readROMChunk(data, length, &offset, &image.cs2)) {
+		snprintf(ldr_errorString, err_MAX_ERR_SIZE, "Error loading ROM: Incomplete CS2 chunk detected");
+		return FALSE;
 	}
 	
-	u16 *ptrWord = data + 0xf8;
+	if (noErrors) {
+		ldr_currentROM = image;
+		
+		/* the CPU reads the ROM straight out of the image */
+		mem_mapROM(ldr_getMemory(), image.rom.data, image.rom.length);
+	}
 	
-	header.softwareRevision = ldr_LITTLE_ENDIAN_16(*ptrWord);
-	ptrWord += 2;
-	header.copyrightStartYear = ldr_LITTLE_ENDIAN_16(*ptrWord);
-	ptrWord += 2;
-	header.copyrightEndYear = ldr_LITTLE_ENDIAN_16(*ptrWord);
-	ptrWord += 2;
-	header.crc = ldr_LITTLE_ENDIAN_16(*ptrWord);
+	return noErrors;
+}
+
+/*
+*  The RAM regions a state can store, in chunk order
+*/
+typedef struct {
+	ldr_StateFileFlags flag;
+	u32 start;
+	u32 size;
+} ldr_RAMRegion;
+
+static const ldr_RAMRegion ldr_ramRegions[] = {
+	{ ldr_STATE_FILE_FLAG_STORE_WRAM, mem_WRAM_START, mem_WRAM_SIZE },
+	{ ldr_STATE_FILE_FLAG_STORE_VRAM, mem_VRAM_START, mem_VRAM_SIZE },
+	{ ldr_STATE_FILE_FLAG_STORE_TMRAM, mem_TMRAM_START, mem_TMRAM_SIZE },
+	{ ldr_STATE_FILE_FLAG_STORE_HRAM, mem_HRAM_START, mem_HRAM_SIZE },
+};
+
+#define ldr_RAM_REGION_COUNT (sizeof(ldr_ramRegions) / sizeof(ldr_RAMRegion))
+
+/* Identifies the current delta base (0 if there isn't one) */
+static u32 ldr_deltaBaseID;
+
+static ldr_RAMView ldr_viewRAM(mem_Memory *memory) {
+	ldr_RAMView view = { memory->wram, memory->vram, memory->tmram, memory->hram, memory->dirtyPages };
+	return view;
+}
+
+static inline bool ldr_isPageDirty(ldr_RAMView *ram, u32 address) {
+	u32 page = address / mem_PAGE_SIZE;
+	return (ram->dirtyPages[page >> 3] >> (page & 7)) & 1;
+}
+
+/*
+*  Copy part of a RAM region to or from a buffer, keeping the buffer little-endian (WRAM and HRAM are stored as host-order words).
+*/
+static void ldr_copyFromRAM(ldr_RAMView *ram, u32 address, u8 *dest, u32 length) {
+	if (address >= mem_VRAM_START && address < mem_VRAM_START + mem_VRAM_SIZE) {
+		memcpy(dest, &ram->vram[address - mem_VRAM_START], length);
+	}
+	else if (address >= mem_TMRAM_START && address < mem_TMRAM_START + mem_TMRAM_SIZE) {
+		memcpy(dest, &ram->tmram[address - mem_TMRAM_START], length);
+	}
+	else {
+		u16 *words = (address < mem_VRAM_START) ? &ram->wram[(address - mem_WRAM_START) >> 1] : &ram->hram[(address - mem_HRAM_START) >> 1];
+		for (u32 i = 0; i < length / 2; i++) ldr_put16(dest + i * 2, words[i]);
+	}
+}
+
+static void ldr_copyToRAM(mem_Memory *memory, u32 address, u8 *src, u32 length) {
+	if (address >= mem_VRAM_START && address < mem_VRAM_START + mem_VRAM_SIZE) {
+		memcpy(&memory->vram[address - mem_VRAM_START], src, length);
+	}
+	else if (address >= mem_TMRAM_START && address < mem_TMRAM_START + mem_TMRAM_SIZE) {
+		memcpy(&memory->tmram[address - mem_TMRAM_START], src, length);
+	}
+	else {
+		u16 *words = (address < mem_VRAM_START) ? &memory->wram[(address - mem_WRAM_START) >> 1] : &memory->hram[(address - mem_HRAM_START) >> 1];
+		for (u32 i = 0; i < length / 2; i++) words[i] = ldr_get16(src + i * 2);
+	}
 	
-	ldr_currentROM.header = header;
+	/* any code the CPU decoded from this part of WRAM is stale now */
+	for (u32 page = address; page < address + length && page < mem_WRAM_START + mem_WRAM_SIZE; page += mem_CODE_PAGE_SIZE) {
+		memory->wramCodeGeneration[(page - mem_WRAM_START) / mem_CODE_PAGE_SIZE]++;
+	}
+}
+
+static u32 ldr_countDirtyPages(ldr_RAMView *ram, const ldr_RAMRegion *region) {
+	u32 count = 0;
 	
-	u32 offset = 256;
-	ptrByte = data;
+	for (u32 address = region->start; address < region->start + region->size; address += mem_PAGE_SIZE) {
+		if (ldr_isPageDirty(ram, address)) count++;
+	}
+	
+	return count;
+}
+
+static inline u32 ldr_getBitmapSize(const ldr_RAMRegion *region) {
+	return (region->size / mem_PAGE_SIZE + 7) / 8;
+}
+
+static u32 ldr_getChunkSize(ldr_RAMView *ram, ldr_StateFileFlags part, bool delta) {
+	for (u8 i = 0; i < ldr_RAM_REGION_COUNT; i++) {
+		if (ldr_ramRegions[i].flag == part) {
+			if (!delta) return ldr_ramRegions[i].size;
+			return ldr_getBitmapSize(&ldr_ramRegions[i]) + ldr_countDirtyPages(ram, &ldr_ramRegions[i]) * mem_PAGE_SIZE;
+		}
+	}
+	
+	/* CS1, CS2 and OAM don't have any emulated storage yet, so their chunks are empty */
+	return (part == ldr_STATE_FILE_FLAG_STORE_CPU) ? ldr_CPU_STATE_SIZE : 0;
+}
+
+static u32 ldr_getSize(ldr_RAMView *ram, ldr_StateFileFlags getWhat, bool delta) {
+	u32 size = ldr_STATE_HEADER_SIZE;
+	
+	for (u16 part = 0x80; part > 0; part >>= 1) {
+		if (getWhat & part) size += ldr_CHUNK_HEADER_SIZE + ldr_getChunkSize(ram, (ldr_StateFileFlags)part, delta);
+	}
 	
-	if (length == 0 || offset < length) {
-		ldr_StateFileChunk romChunk;
-		romChunk.length = ldr_LITTLE_ENDIAN_32(*(ptrByte + offset)) & 0xffffff;
+	return size;
+}
+
+static void ldr_saveCPU(cpu_Pilot *pilot, u8 *ptr) {
+	for (u8 i = 0; i < 8; i++) ldr_put32(ptr + i * 4, pilot->regs[i]);
+	ldr_put16(ptr + 32, cpu_getStatusReg(pilot));
+	ldr_put32(ptr + 34, pilot->programCounter);
+	ptr[38] = pilot->halted;
+	ldr_put32(ptr + 39, (u32)pilot->cycles);
+	ldr_put32(ptr + 43, (u32)(pilot->cycles >> 32));
+}
+
+static void ldr_loadCPU(cpu_Pilot *pilot, u8 *ptr) {
+	for (u8 i = 0; i < 8; i++) pilot->regs[i] = ldr_get32(ptr + i * 4);
+	cpu_setStatusReg(pilot, ldr_get16(ptr + 32));
+	pilot->programCounter = ldr_get32(ptr + 34) & 0xffffff;
+	pilot->halted = ptr[38] != 0;
+	pilot->cycles = ldr_get32(ptr + 39) | ((u64)ldr_get32(ptr + 43) << 32);
+	pilot->pendingCycles = 0;
+}
+
+/*
+*  Write the chunk data for one part of the state (ldr_getChunkSize() bytes of it) to ptr.
+*/
+static void ldr_writeChunk(ldr_RAMView *ram, cpu_Pilot *pilot, ldr_StateFileFlags part, bool delta, u8 *ptr) {
+	if (part == ldr_STATE_FILE_FLAG_STORE_CPU) {
+		ldr_saveCPU(pilot, ptr);
+	}
+	
+	for (u8 i = 0; i < ldr_RAM_REGION_COUNT; i++) {
+		const ldr_RAMRegion *region = &ldr_ramRegions[i];
+		if (region->flag != part) continue;
 		
-		if (length == 0 || ((offset += 2) < length && (length - offset) > romChunk.length)) {
-			romChunk.data = ptrByte + offset;
-			offset += romChunk.length;
-			ldr_currentROM.rom = romChunk;
+		if (!delta) {
+			ldr_copyFromRAM(ram, region->start, ptr, region->size);
+			break;
 		}
-		else {
-			snprintf(ldr_errorString, err_MAX_ERR_SIZE, "Error loading ROM: Incomplete ROM chunk detected");
-			return FALSE;
+		
+		u8 *bitmap = ptr;
+		u8 *page = ptr + ldr_getBitmapSize(region);
+		memset(bitmap, 0, ldr_getBitmapSize(region));
+		
+		for (u32 n = 0; n < region->size / mem_PAGE_SIZE; n++) {
+			u32 address = region->start + n * mem_PAGE_SIZE;
+			if (!ldr_isPageDirty(ram, address)) continue;
+			
+			bitmap[n >> 3] |= 1 << (n & 7);
+			ldr_copyFromRAM(ram, address, page, mem_PAGE_SIZE);
+			page += mem_PAGE_SIZE;
 		}
 	}
-	else {
-		snprintf(ldr_errorString, err_MAX_ERR_SIZE, "Error loading ROM: Incomplete ROM chunk detected");
-		return FALSE;
+}
+
+/*
+*  Get the largest a part's chunk can be once it's decompressed (a full RAM region plus a delta's page bitmap).
+*/
+static u32 ldr_getMaxChunkSize(ldr_StateFileFlags part) {
+	for (u8 i = 0; i < ldr_RAM_REGION_COUNT; i++) {
+		if (ldr_ramRegions[i].flag == part) return ldr_getBitmapSize(&ldr_ramRegions[i]) + ldr_ramRegions[i].size;
+	}
+	
+	return (part == ldr_STATE_FILE_FLAG_STORE_CPU) ? ldr_CPU_STATE_SIZE : 0;
+}
+
+/*
+*  Save a state from the given RAM and CPU (the live ones or a snapshot's) and return its size, or 0 on failure.
+*  Errors go to the given string, so a snapshot can be saved on another thread without touching ldr_errorString.
+*/
+static u32 ldr_save(ldr_RAMView *ram, cpu_Pilot *pilot, u32 baseID, char *error, u8 *data, u32 length, ldr_StateFileFlags saveWhat, ldr_StateFormatFlags format) {
+	bool delta = (format & ldr_STATE_FORMAT_DELTA) != 0;
+	bool compress = (format & ldr_STATE_FORMAT_COMPRESSED) != 0;
+	
+	snprintf(error, err_MAX_ERR_SIZE, "");
+	
+	if (delta && !baseID) {
+		snprintf(error, err_MAX_ERR_SIZE, "Error saving state: No delta base has been set");
+		return 0;
+	}
+	
+	/* compressed chunks are only kept when they're smaller, so the uncompressed size is also the worst case for a compressed state */
+	if (length < ldr_getSize(ram, saveWhat, delta)) {
+		snprintf(error, err_MAX_ERR_SIZE, "Error saving state: Buffer is too small");
+		return 0;
+	}
+	
+	u8 *ptr = data;
+	
+	/* a compressed chunk is written out whole somewhere else first, then compressed into place */
+	u8 *scratch = NULL;
+	u32 scratchSize = 0;
+	if (compress) {
+		for (u16 part = 0x80; part > 0; part >>= 1) {
+			if ((saveWhat & part) && ldr_getMaxChunkSize((ldr_StateFileFlags)part) > scratchSize) scratchSize = ldr_getMaxChunkSize((ldr_StateFileFlags)part);
+		}
+		
+		scratch = drv_reallocate(NULL, 0, scratchSize);
+		if (scratch == NULL) {
+			snprintf(error, err_MAX_ERR_SIZE, "Error saving state: Out of memory");
+			return 0;
+		}
+	}
+	
+	memset(ptr, 0, ldr_STATE_HEADER_SIZE);
+	memcpy(ptr, ldr_STATE_FILE_MAGIC, ldr_STATE_FILE_MAGIC_SIZE);
+	ldr_put16(ptr + ldr_STATE_OFFSET_VERSION, ver_getLatestVersion()->versionNumber);
+	ptr[ldr_STATE_OFFSET_STORED] = saveWhat;
+	ptr[ldr_STATE_OFFSET_HIVECRAFT] = ver_MAX_HIVECRAFT_VERSION();
+	ptr[ldr_STATE_OFFSET_FORMAT] = format & (ldr_STATE_FORMAT_DELTA | ldr_STATE_FORMAT_CHECKSUM);
+	
+	/* a full state is the delta base if nothing has changed since the base was set */
+	bool isBase = TRUE;
+	for (u8 i = 0; i < ldr_RAM_REGION_COUNT; i++) {
+		if (ldr_countDirtyPages(ram, &ldr_ramRegions[i])) isBase = FALSE;
 	}
+	ldr_put32(ptr + ldr_STATE_OFFSET_BASE_ID, (delta || isBase) ? baseID : 0);
+	ptr += ldr_STATE_HEADER_SIZE;
 	
-	if (length == 0 || offset < length) {
-		if ((header.cs1 & ldr_CHIP_TYPE_STORED)) {
-			ldr_StateFileChunk cs1Chunk;
-			cs1Chunk.length = ldr_LITTLE_ENDIAN_32(*(ptrByte + offset)) & 0xffffff;
+	for (u16 part = 0x80; part > 0; part >>= 1) {
+		if (!(saveWhat & part)) continue;
+		
+		u32 chunkSize = ldr_getChunkSize(ram, (ldr_StateFileFlags)part, delta);
+		u8 *chunk = ptr + ldr_CHUNK_HEADER_SIZE;
+		u32 storedSize = chunkSize;
+		
+		if (!compress) {
+			ldr_writeChunk(ram, pilot, (ldr_StateFileFlags)part, delta, chunk);
+		}
+		else {
+			ldr_writeChunk(ram, pilot, (ldr_StateFileFlags)part, delta, scratch);
+			
+			/* leaving room for the uncompressed size, anything that doesn't come out smaller gets 0 back and is stored as is */
+			size_t compressedSize = 0;
+			if (chunkSize > ldr_CHUNK_HEADER_SIZE + 1) {
+				compressedSize = cmp_compress(scratch, chunkSize, chunk + ldr_CHUNK_HEADER_SIZE, chunkSize - ldr_CHUNK_HEADER_SIZE - 1);
+			}
 			
-			if (length == 0 || ((offset += 2) < length && (length - offset) > cs1Chunk.length)) {
-				cs1Chunk.data = ptrByte + offset;
-				offset += cs1Chunk.length;
-				ldr_currentROM.cs1 = cs1Chunk;
+			if (compressedSize) {
+				ldr_put32(chunk, chunkSize);
+				storedSize = ldr_CHUNK_HEADER_SIZE + (u32)compressedSize;
 			}
 			else {
-				snprintf(ldr_errorString, err_MAX_ERR_SIZE, "Error loading ROM: Incomplete CS1 chunk detected");
+				memcpy(chunk, scratch, chunkSize);
+			}
+		}
+		
+		ldr_put32(ptr, (storedSize == chunkSize) ? chunkSize : storedSize | ldr_CHUNK_COMPRESSED);
+		ptr += ldr_CHUNK_HEADER_SIZE + storedSize;
+	}
+	
+	drv_reallocate(scratch, scratchSize, 0);
+	
+	if (format & ldr_STATE_FORMAT_CHECKSUM) {
+		ldr_put32(data + ldr_STATE_OFFSET_CHECKSUM, crc_getCRC32(0, data + ldr_STATE_HEADER_SIZE, (size_t)(ptr - data) - ldr_STATE_HEADER_SIZE));
+	}
+	
+	return (u32)(ptr - data);
+}
+
+u32 ldr_getStateSize(ldr_StateFileFlags getWhat) {
+	ldr_RAMView ram = ldr_viewRAM(ldr_getMemory());
+	return ldr_getSize(&ram, getWhat, FALSE);
+}
+
+bool ldr_saveState(u8 *data, u32 length, ldr_StateFileFlags saveWhat) {
+	ldr_RAMView ram = ldr_viewRAM(ldr_getMemory());
+	return ldr_save(&ram, cpu_getCurrentPilot(), ldr_deltaBaseID, ldr_errorString, data, length, saveWhat, 0) != 0;
+}
+
+u32 ldr_saveCompressedState(u8 *data, u32 length, ldr_StateFileFlags saveWhat) {
+	ldr_RAMView ram = ldr_viewRAM(ldr_getMemory());
+	return ldr_save(&ram, cpu_getCurrentPilot(), ldr_deltaBaseID, ldr_errorString, data, length, saveWhat, ldr_STATE_FORMAT_COMPRESSED);
+}
+
+void ldr_setDeltaBase(void) {
+	mem_clearDirtyPages(ldr_getMemory());
+	ldr_deltaBaseID++;
+}
+
+u32 ldr_getDeltaStateSize(ldr_StateFileFlags getWhat) {
+	ldr_RAMView ram = ldr_viewRAM(ldr_getMemory());
+	return ldr_deltaBaseID ? ldr_getSize(&ram, getWhat, TRUE) : 0;
+}
+
+bool ldr_saveDeltaState(u8 *data, u32 length, ldr_StateFileFlags saveWhat) {
+	ldr_RAMView ram = ldr_viewRAM(ldr_getMemory());
+	return ldr_save(&ram, cpu_getCurrentPilot(), ldr_deltaBaseID, ldr_errorString, data, length, saveWhat, ldr_STATE_FORMAT_DELTA) != 0;
+}
+
+u32 ldr_saveCompressedDeltaState(u8 *data, u32 length, ldr_StateFileFlags saveWhat) {
+	ldr_RAMView ram = ldr_viewRAM(ldr_getMemory());
+	return ldr_save(&ram, cpu_getCurrentPilot(), ldr_deltaBaseID, ldr_errorString, data, length, saveWhat, ldr_STATE_FORMAT_DELTA | ldr_STATE_FORMAT_COMPRESSED);
+}
+
+ldr_Snapshot *ldr_createSnapshot(void) {
+	return drv_reallocate(NULL, 0, sizeof(ldr_Snapshot));
+}
+
+void ldr_freeSnapshot(ldr_Snapshot *snapshot) {
+	if (snapshot != NULL) drv_reallocate(snapshot, sizeof(ldr_Snapshot), 0);
+}
+
+void ldr_takeSnapshot(ldr_Snapshot *snapshot) {
+	mem_Memory *memory = ldr_getMemory();
+	
+	memcpy(snapshot->wram, memory->wram, sizeof(snapshot->wram));
+	memcpy(snapshot->vram, memory->vram, sizeof(snapshot->vram));
+	memcpy(snapshot->tmram, memory->tmram, sizeof(snapshot->tmram));
+	memcpy(snapshot->hram, memory->hram, sizeof(snapshot->hram));
+	memcpy(snapshot->dirtyPages, memory->dirtyPages, sizeof(snapshot->dirtyPages));
+	
+	snapshot->pilot = *cpu_getCurrentPilot();
+	snapshot->deltaBaseID = ldr_deltaBaseID;
+}
+
+u32 ldr_saveSnapshot(ldr_Snapshot *snapshot, u8 *data, u32 length, ldr_StateFileFlags saveWhat, bool compress) {
+	ldr_StateFormatFlags format = ldr_STATE_FORMAT_CHECKSUM | (compress ? ldr_STATE_FORMAT_COMPRESSED : 0);
+	ldr_RAMView ram = { snapshot->wram, snapshot->vram, snapshot->tmram, snapshot->hram, snapshot->dirtyPages };
+	
+	return ldr_save(&ram, &snapshot->pilot, snapshot->deltaBaseID, snapshot->error, data, length, saveWhat, format);
+}
+
+char *ldr_getSnapshotError(ldr_Snapshot *snapshot) {
+	return snapshot->error;
+}
+
+bool ldr_loadState(u8 *data, u32 length) {
+	snprintf(ldr_errorString, err_MAX_ERR_SIZE, "");
+	
+	/* with no length given, trust the chunk lengths */
+	u32 limit = length ? length : 0xffffffff;
+	
+	if (limit < ldr_STATE_HEADER_SIZE || memcmp(data, ldr_STATE_FILE_MAGIC, ldr_STATE_FILE_MAGIC_SIZE)) {
+		snprintf(ldr_errorString, err_MAX_ERR_SIZE, "Error loading state: Incorrect magic sequence");
+		return FALSE;
+	}
+	
+	if (data[ldr_STATE_OFFSET_HIVECRAFT] > ver_MAX_HIVECRAFT_VERSION()) {
+		snprintf(ldr_errorString, err_MAX_ERR_SIZE, "Error loading state: Emulator is too old (needs SoC version $%.02X)", data[ldr_STATE_OFFSET_HIVECRAFT]);
+		return FALSE;
+	}
+	
+	mem_Memory *memory = ldr_getMemory();
+	ldr_StateFileFlags stored = data[ldr_STATE_OFFSET_STORED];
+	bool checksummed = (data[ldr_STATE_OFFSET_FORMAT] & ldr_STATE_FORMAT_CHECKSUM) != 0;
+	bool delta = (data[ldr_STATE_OFFSET_FORMAT] & ldr_STATE_FORMAT_DELTA) != 0;
+	u32 baseID = ldr_get32(data + ldr_STATE_OFFSET_BASE_ID);
+	
+	if (delta) {
+		/* the pages a delta doesn't store are taken from memory, so memory has to hold exactly the base state */
+		ldr_RAMView ram = ldr_viewRAM(memory);
+		bool atBase = (baseID == ldr_deltaBaseID);
+		for (u8 i = 0; i < ldr_RAM_REGION_COUNT; i++) {
+			if (ldr_countDirtyPages(&ram, &ldr_ramRegions[i])) atBase = FALSE;
+		}
+		
+		if (!atBase) {
+			snprintf(ldr_errorString, err_MAX_ERR_SIZE, "Error loading state: A delta state has to be loaded right after its base state");
+			return FALSE;
+		}
+	}
+	
+	/* check every chunk fits before changing anything */
+	u32 offset = ldr_STATE_HEADER_SIZE;
+	u32 decompressedSize = 0;
+	for (u16 part = 0x80; part > 0; part >>= 1) {
+		if (!(stored & part)) continue;
+		
+		u32 storedSize = (limit - offset < ldr_CHUNK_HEADER_SIZE) ? 0 : ldr_get32(data + offset) & ~ldr_CHUNK_COMPRESSED;
+		if (limit - offset < ldr_CHUNK_HEADER_SIZE || limit - offset - ldr_CHUNK_HEADER_SIZE < storedSize) {
+			snprintf(ldr_errorString, err_MAX_ERR_SIZE, "Error loading state: Incomplete chunk detected");
+			return FALSE;
+		}
+		
+		if (ldr_get32(data + offset) & ldr_CHUNK_COMPRESSED) {
+			if (storedSize < ldr_CHUNK_HEADER_SIZE || ldr_get32(data + offset + ldr_CHUNK_HEADER_SIZE) > ldr_getMaxChunkSize((ldr_StateFileFlags)part)) {
+				snprintf(ldr_errorString, err_MAX_ERR_SIZE, "Error loading state: Corrupt compressed chunk detected");
 				return FALSE;
 			}
+			decompressedSize += ldr_get32(data + offset + ldr_CHUNK_HEADER_SIZE);
 		}
+		offset += ldr_CHUNK_HEADER_SIZE + storedSize;
 	}
-	else {
-		return TRUE;
+	
+	if (checksummed && crc_getCRC32(0, data + ldr_STATE_HEADER_SIZE, offset - ldr_STATE_HEADER_SIZE) != ldr_get32(data + ldr_STATE_OFFSET_CHECKSUM)) {
+		snprintf(ldr_errorString, err_MAX_ERR_SIZE, "Error loading state: Checksum doesn't match");
+		return FALSE;
 	}
 	
-	if (length == 0 || offset < length) {
-		if ((header.cs2 & ldr_CHIP_TYPE_STORED)) {
-			ldr_StateFileChunk cs2Chunk;
-			cs2Chunk.length = ldr_LITTLE_ENDIAN_32(*(ptrByte + offset)) & 0xffffff;
+	/* decompress everything up front too, so a corrupt chunk can't leave a state half loaded */
+	u8 *decompressed = NULL;
+	if (decompressedSize) {
+		decompressed = drv_reallocate(NULL, 0, decompressedSize);
+		if (decompressed == NULL) {
+			snprintf(ldr_errorString, err_MAX_ERR_SIZE, "Error loading state: Out of memory");
+			return FALSE;
+		}
+		
+		u8 *dest = decompressed;
+		offset = ldr_STATE_HEADER_SIZE;
+		for (u16 part = 0x80; part > 0; part >>= 1) {
+			if (!(stored & part)) continue;
 			
-			if (length == 0 || ((offset += 2) < length && (length - offset) > cs2Chunk.length)) {
-				cs2Chunk.data = ptrByte + offset;
-				offset += cs2Chunk.length;
-				ldr_currentROM.cs1 = cs2Chunk;
+			u32 storedSize = ldr_get32(data + offset) & ~ldr_CHUNK_COMPRESSED;
+			if (ldr_get32(data + offset) & ldr_CHUNK_COMPRESSED) {
+				u32 chunkSize = ldr_get32(data + offset + ldr_CHUNK_HEADER_SIZE);
+				u8 *src = data + offset + ldr_CHUNK_HEADER_SIZE * 2;
+				
+				if (cmp_decompress(src, storedSize - ldr_CHUNK_HEADER_SIZE, dest, chunkSize) != chunkSize) {
+					snprintf(ldr_errorString, err_MAX_ERR_SIZE, "Error loading state: Corrupt compressed chunk detected");
+					drv_reallocate(decompressed, decompressedSize, 0);
+					return FALSE;
+				}
+				dest += chunkSize;
 			}
-			else {
-				snprintf(ldr_errorString, err_MAX_ERR_SIZE, "Error loading ROM: Incomplete CS2 chunk detected");
-				return FALSE;
+			offset += ldr_CHUNK_HEADER_SIZE + storedSize;
+		}
+	}
+	
+	offset = ldr_STATE_HEADER_SIZE;
+	u8 *nextDecompressed = decompressed;
+	for (u16 part = 0x80; part > 0; part >>= 1) {
+		if (!(stored & part)) continue;
+		
+		u32 chunkSize = ldr_get32(data + offset) & ~ldr_CHUNK_COMPRESSED;
+		u8 *ptr = data + offset + ldr_CHUNK_HEADER_SIZE;
+		offset += ldr_CHUNK_HEADER_SIZE + chunkSize;
+		
+		if (ldr_get32(ptr - ldr_CHUNK_HEADER_SIZE) & ldr_CHUNK_COMPRESSED) {
+			chunkSize = ldr_get32(ptr);
+			ptr = nextDecompressed;
+			nextDecompressed += chunkSize;
+		}
+		
+		if (part == ldr_STATE_FILE_FLAG_STORE_CPU && chunkSize >= ldr_CPU_STATE_SIZE) {
+			ldr_loadCPU(cpu_getCurrentPilot(), ptr);
+		}
+		
+		for (u8 i = 0; i < ldr_RAM_REGION_COUNT; i++) {
+			const ldr_RAMRegion *region = &ldr_ramRegions[i];
+			if (region->flag != part) continue;
+			
+			if (!delta) {
+				if (chunkSize >= region->size) ldr_copyToRAM(memory, region->start, ptr, region->size);
+				break;
+			}
+			
+			u8 *bitmap = ptr;
+			u8 *page = ptr + ldr_getBitmapSize(region);
+			
+			for (u32 n = 0; n < region->size / mem_PAGE_SIZE && page + mem_PAGE_SIZE <= ptr + chunkSize; n++) {
+				if (!(bitmap[n >> 3] & (1 << (n & 7)))) continue;
+				
+				u32 address = region->start + n * mem_PAGE_SIZE;
+				ldr_copyToRAM(memory, address, page, mem_PAGE_SIZE);
+				mem_setPageDirty(memory, address);
+				page += mem_PAGE_SIZE;
 			}
 		}
 	}
 	
-	return noErrors;
-}
\ No newline at end of file
+	drv_reallocate(decompressed, decompressedSize, 0);
+	
+	/* a full state saved at the delta base is the base again, so its deltas can be loaded on top of it */
+	if (!delta) {
+		if (baseID) {
+			mem_clearDirtyPages(memory);
+			ldr_deltaBaseID = baseID;
+		}
+		else {
+			for (u32 address = 0; address < mem_RAM_END; address += mem_PAGE_SIZE) {
+				mem_setPageDirty(memory, address);
+			}
+		}
+	}
+	
+	return TRUE;
+}
+
+#ifdef ldr_HAS_MMAP
+
+/*
+*  Ask the OS to start reading in the given part of the mapping (which doesn't need to be page-aligned).
+*/
+static void ldr_prefetch(u8 *start, size_t length) {
+	size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+	u8 *alignedStart = (u8 *)((size_t)start & ~(pageSize - 1));
+	
+	madvise(alignedStart, length + (size_t)(start - alignedStart), MADV_WILLNEED);
+}
+
+bool ldr_loadROMFile(char *path) {
+	snprintf(ldr_errorString, err_MAX_ERR_SIZE, "");
+	
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		snprintf(ldr_errorString, err_MAX_ERR_SIZE, "Error loading ROM: Couldn't open %s", path);
+		return FALSE;
+	}
+	
+	struct stat info;
+	if (fstat(fd, &info) || info.st_size < 256 || (u64)info.st_size > 0xffffffff) {
+		snprintf(ldr_errorString, err_MAX_ERR_SIZE, "Error loading ROM: %s isn't a valid ROM image", path);
+		close(fd);
+		return FALSE;
+	}
+	
+	/* the mapping is shared with the page cache, so every instance running the same ROM uses the same physical memory */
+	void *mapping = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	
+	if (mapping == MAP_FAILED) {
+		snprintf(ldr_errorString, err_MAX_ERR_SIZE, "Error loading ROM: Couldn't map %s", path);
+		return FALSE;
+	}
+	
+	/* games jump all over the ROM, so readahead would mostly pull in banks that never get used */
+	madvise(mapping, (size_t)info.st_size, MADV_RANDOM);
+	
+	if (!ldr_loadROMImage(mapping, (u32)info.st_size)) {
+		munmap(mapping, (size_t)info.st_size);
+		return FALSE;
+	}
+	
+	ldr_closeROMFile();
+	ldr_mappedFile = mapping;
+	ldr_mappedFileSize = (size_t)info.st_size;
+	
+	/* the CPU starts in the last bank (the ROM ends at $FFFFFF), so get that one ready */
+	u32 resetBankLength = (ldr_currentROM.rom.length < 0x10000) ? ldr_currentROM.rom.length : 0x10000;
+	ldr_prefetch(ldr_currentROM.rom.data + ldr_currentROM.rom.length - resetBankLength, resetBankLength);
+	
+	return TRUE;
+}
+
+void ldr_closeROMFile(void) {
+	if (ldr_mappedFile != NULL) {
+		u8 *start = ldr_mappedFile;
+		
+		/* the ROM can't stay loaded (or mapped into the emulator's memory) once its pages are gone */
+		if (ldr_currentROM.rom.data >= start && ldr_currentROM.rom.data < start + ldr_mappedFileSize) {
+			memset(&ldr_currentROM, 0, sizeof(ldr_ROMImage));
+			mem_mapROM(ldr_getMemory(), NULL, 0);
+		}
+		
+		munmap(ldr_mappedFile, ldr_mappedFileSize);
+		ldr_mappedFile = NULL;
+		ldr_mappedFileSize = 0;
+	}
+}
+
+#else
+
+bool ldr_loadROMFile(char *path) {
+	snprintf(ldr_errorString, err_MAX_ERR_SIZE, "Error loading ROM: Loading from a path isn't supported on this host (use ldr_loadROMImage())");
+	return FALSE;
+}
+
+void ldr_closeROMFile(void) {
+}
+
+#endif
\ No newline at end of file
@@ -6,10 +6,13 @@
 #include <hexlet_ints.h>
 #include <hexlet_loader.h>
 #include <hexlet_version.h>
+
+#include "errors.h"
+#include "memory.h"
 #include "pilot.h"
 
 /* system byte order stuff */
-const int endianCheck = 1;
+static const int endianCheck = 1;
 #define ldr_BIG_ENDIAN() ((*(char *)&endianCheck) == 0)
 #define ldr_ENDIAN_REVERSE_16(s) (((s & 0xff00) >> 8) | ((s & 0x00ff) << 8))
 #define ldr_ENDIAN_REVERSE_32(s) (((s & 0xff000000) >> 24) | ((s & 0x00ff0000) >> 8) | ((s & 0x0000ff00) << 8) | ((s & 0x000000ff) << 24))
@@ -27,13 +30,16 @@ typedef u8 ldr_ChipType;
 /* This flag is set if the chip's contents are stored in the ROM image, but it shouldn't be set in an actual cartridge ROM */
 #define ldr_CHIP_TYPE_STORED 0x80
 
+/* The ROM can't reach down into the banks below $200000 (RAM and the handler banks) */
+#define ldr_MAX_ROM_BANKS 0xdf
+
 typedef struct {
 	u8 data[256];
 	
 	char title[128];
 	char author[96];
 	
-	/* Size is in 64-KiB units (i.e. cannot be more than 0xdf) */
+	/* Size is in 64-KiB units (i.e. cannot be more than ldr_MAX_ROM_BANKS) */
 	u8 romSize;
 	
 	ldr_ChipType cs1;
@@ -61,6 +67,72 @@ typedef struct {
 } ldr_ROMImage;
 
 #define ldr_STATE_FILE_MAGIC "Hexlet\x1b"
+#define ldr_STATE_FILE_MAGIC_SIZE 7
+
+/*
+*  Layout of a state file's header (the rest of it is reserved and should be 0):
+*  $00 magic, $07 Hexlet version number, $09 ldr_StateFileFlags stored, $0A HiveCraft version, $0B format flags, $0C delta base ID,
+*  $10 CRC-32 of everything after the header (if ldr_STATE_FORMAT_CHECKSUM is set)
+*
+*  The header is followed by one chunk (a 32-bit length, then the data) for each part that's stored, in the order of the flag bits from high to low.
+*/
+#define ldr_STATE_HEADER_SIZE 48
+#define ldr_STATE_OFFSET_VERSION	0x07
+#define ldr_STATE_OFFSET_STORED		0x09
+#define ldr_STATE_OFFSET_HIVECRAFT	0x0a
+#define ldr_STATE_OFFSET_FORMAT		0x0b
+#define ldr_STATE_OFFSET_BASE_ID	0x0c
+#define ldr_STATE_OFFSET_CHECKSUM	0x10
+
+#define ldr_CHUNK_HEADER_SIZE 4
+
+/*
+*  If this bit of a chunk's length is set, the rest of the length counts a 32-bit uncompressed length
+*  followed by the chunk data compressed with cmp_compress() (see compress.h).
+*/
+#define ldr_CHUNK_COMPRESSED 0x80000000
+
+/*
+*  In a delta state, each RAM chunk is a bitmap of the region's 256-byte pages (bit n of byte n / 8 is page n)
+*  followed by the pages whose bits are set, and the chunks for other parts are stored whole.
+*/
+typedef u8 ldr_StateFormatFlags;
+#define ldr_STATE_FORMAT_DELTA 0x01
+#define ldr_STATE_FORMAT_CHECKSUM 0x02
+
+/* Only passed to ldr_save(), never stored in the header (each chunk says whether it's compressed) */
+#define ldr_STATE_FORMAT_COMPRESSED 0x80
+
+/* CPU chunk: regs[0]-regs[7], status register, program counter, halted flag, cycle count */
+#define ldr_CPU_STATE_SIZE (8 * 4 + 2 + 4 + 1 + 8)
+
+/*
+*  The RAM and dirty page bitmap a state is saved from: the live memory's or a snapshot's copies of them
+*/
+typedef struct {
+	u16 *wram;
+	u8 *vram;
+	u8 *tmram;
+	u16 *hram;
+	u8 *dirtyPages;
+} ldr_RAMView;
+
+/*
+*  A copy of everything a state file stores, taken at a frame boundary so it can be saved on another thread.
+*  That's only the RAM, not the rest of mem_Memory (the page tables alone are about 100 KiB).
+*/
+struct ldr_Snapshot {
+	u16 wram[mem_WRAM_SIZE / 2];
+	u8 vram[mem_VRAM_SIZE];
+	u8 tmram[mem_TMRAM_SIZE];
+	u16 hram[mem_HRAM_SIZE / 2];
+	u8 dirtyPages[(mem_RAM_PAGES + 7) / 8];
+	
+	cpu_Pilot pilot;
+	u32 deltaBaseID;
+	
+	char error[err_MAX_ERR_SIZE];
+};
 
 typedef struct {
 	u8 data[48];
@@ -0,0 +1,537 @@
+/* Source file for Hexlet's memory bus emulator */
+
+#include <string.h>
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+#include <hexlet_memory.h>
+
+#include "memory.h"
+
+static mem_Memory mem_currentMemory;
+static trc_Ring mem_traceRing;
+
+static const mem_AccessFunctions mem_fastAccess;
+static const mem_AccessFunctions mem_monitoredAccess;
+
+mem_Memory *mem_getCurrentMemory(void) {
+	return &mem_currentMemory;
+}
+
+/*
+*  Use the monitored accessors only while some bus is being monitored or traced.
+*/
+static void mem_selectAccess(mem_Memory *memory) {
+	bool monitored = memory->cpuBus.monitored || memory->ppuBus.monitored || memory->hexridgeBus.monitored || memory->tracedBuses;
+	memory->access = monitored ? &mem_monitoredAccess : &mem_fastAccess;
+}
+
+void mem_monitorBuses(mem_BusType buses) {
+	mem_currentMemory.cpuBus.monitored = (buses & mem_BUS_TYPE_CPU) != 0;
+	mem_currentMemory.ppuBus.monitored = (buses & mem_BUS_TYPE_PPU) != 0;
+	mem_currentMemory.hexridgeBus.monitored = (buses & mem_BUS_TYPE_HEXRIDGE) != 0;
+	
+	mem_selectAccess(&mem_currentMemory);
+}
+
+u32 mem_getAddress(mem_BusType buses) {
+	u32 address = 0;
+	
+	if (buses & mem_BUS_TYPE_CPU) address |= mem_currentMemory.cpuBus.address;
+	if (buses & mem_BUS_TYPE_PPU) address |= mem_currentMemory.ppuBus.address;
+	if (buses & mem_BUS_TYPE_HEXRIDGE) address |= mem_currentMemory.hexridgeBus.address;
+	
+	return address;
+}
+
+u16 mem_getData(mem_BusType buses) {
+	u16 data = 0;
+	
+	if (buses & mem_BUS_TYPE_CPU) data |= mem_currentMemory.cpuBus.data;
+	if (buses & mem_BUS_TYPE_PPU) data |= mem_currentMemory.ppuBus.data;
+	if (buses & mem_BUS_TYPE_HEXRIDGE) data |= mem_currentMemory.hexridgeBus.data;
+	
+	return data;
+}
+
+bool mem_startTrace(mem_BusType buses, u8 sizeLog2) {
+	mem_stopTrace();
+	
+	if (!trc_initRing(&mem_traceRing, sizeLog2)) {
+		return FALSE;
+	}
+	
+	mem_currentMemory.trace = &mem_traceRing;
+	mem_currentMemory.tracedBuses = buses;
+	mem_selectAccess(&mem_currentMemory);
+	
+	return TRUE;
+}
+
+void mem_stopTrace(void) {
+	mem_currentMemory.tracedBuses = 0;
+	mem_currentMemory.trace = NULL;
+	mem_selectAccess(&mem_currentMemory);
+	
+	trc_freeRing(&mem_traceRing);
+}
+
+size_t mem_readTrace(u8 *buffer, size_t size) {
+	return (mem_traceRing.records != NULL) ? trc_drain(&mem_traceRing, buffer, size) : 0;
+}
+
+u32 mem_getTraceOverruns(void) {
+	return mem_traceRing.overruns;
+}
+
+/*
+*  Latch the address and data lines of the given bus if it's being monitored, and record the access if it's being traced (only called from the monitored set).
+*/
+static inline void mem_latchBus(mem_Memory *memory, mem_BusType bus, u32 address, u16 data, bool write, bool word) {
+	mem_Bus *latch;
+	
+	if (memory->tracedBuses & bus) {
+		trc_push(memory->trace, memory->cycle, bus, address, data, write, word);
+	}
+	
+	switch (bus) {
+		case mem_BUS_TYPE_CPU:
+			latch = &memory->cpuBus;
+			break;
+		case mem_BUS_TYPE_PPU:
+			latch = &memory->ppuBus;
+			break;
+		case mem_BUS_TYPE_HEXRIDGE:
+			latch = &memory->hexridgeBus;
+			break;
+		default:
+			return;
+	}
+	
+	if (latch->monitored) {
+		latch->address = address;
+		latch->data = data;
+	}
+}
+
+/*
+*  WRAM and HRAM are stored as host-order words, so on big-endian hosts they go through the handlers instead of byte pointers.
+*/
+static inline bool mem_hostIsBigEndian(void) {
+	const u16 probe = 0x0001;
+	return *(const u8 *)&probe == 0x00;
+}
+
+static u8 mem_readUnmapped(mem_Memory *memory, u32 address) {
+	return 0xff;
+}
+
+static void mem_writeUnmapped(mem_Memory *memory, u32 address, u8 value) {
+}
+
+static u8 mem_readWRAM(mem_Memory *memory, u32 address) {
+	u16 word = memory->wram[(address - mem_WRAM_START) >> 1];
+	return (address & 1) ? (u8)(word >> 8) : (u8)word;
+}
+
+static void mem_writeWRAM(mem_Memory *memory, u32 address, u8 value) {
+	u16 *word = &memory->wram[(address - mem_WRAM_START) >> 1];
+	*word = (address & 1) ? ((*word & 0x00ff) | (value << 8)) : ((*word & 0xff00) | value);
+}
+
+static void mem_writeVRAM(mem_Memory *memory, u32 address, u8 value) {
+	memory->vram[address - mem_VRAM_START] = value;
+}
+
+static void mem_writeTMRAM(mem_Memory *memory, u32 address, u8 value) {
+	memory->tmram[address - mem_TMRAM_START] = value;
+}
+
+static u8 mem_readHRAM(mem_Memory *memory, u32 address) {
+	u16 word = memory->hram[(address - mem_HRAM_START) >> 1];
+	return (address & 1) ? (u8)(word >> 8) : (u8)word;
+}
+
+static void mem_writeHRAM(mem_Memory *memory, u32 address, u8 value) {
+	u16 *word = &memory->hram[(address - mem_HRAM_START) >> 1];
+	*word = (address & 1) ? ((*word & 0x00ff) | (value << 8)) : ((*word & 0xff00) | value);
+}
+
+static inline mem_Page *mem_getPage(mem_Memory *memory, u32 address) {
+	return &memory->banks[(address >> 16) & 0xff][(address >> 8) & 0xff];
+}
+
+/*
+*  Point the pages covering [start, end) at a block of host memory that holds the byte for address start at host[0].
+*/
+static void mem_mapPages(mem_Page *pages, u32 start, u32 end, u8 *host, bool writable, mem_ReadHandler readHandler, mem_WriteHandler writeHandler) {
+	for (u32 address = start; address < end; address += mem_PAGE_SIZE) {
+		mem_Page *page = &pages[(address >> 8) & 0xff];
+		
+		page->read = (host != NULL) ? host - start : NULL;
+		page->write = (host != NULL && writable) ? host - start : NULL;
+		page->readHandler = readHandler;
+		page->writeHandler = writeHandler;
+		page->protection = 0;
+	}
+}
+
+static mem_WriteHandler mem_getRAMWriteHandler(u32 address) {
+	if (address < mem_VRAM_START) return mem_writeWRAM;
+	if (address < mem_TMRAM_START) return mem_writeVRAM;
+	if (address < mem_HRAM_START) return mem_writeTMRAM;
+	return mem_writeHRAM;
+}
+
+static inline void mem_markDirty(mem_Memory *memory, u32 address) {
+	u32 page = address / mem_PAGE_SIZE;
+	memory->dirtyPages[page >> 3] |= 1 << (page & 7);
+}
+
+/*
+*  Write handler for protected RAM pages: do whatever the protection is there for, then give the page its fast path back.
+*/
+static void mem_writeProtected(mem_Memory *memory, u32 address, u8 value) {
+	mem_Page *page = mem_getPage(memory, address);
+	
+	if (page->protection & mem_PROTECT_CODE) {
+		memory->wramCodeGeneration[(address - mem_WRAM_START) / mem_CODE_PAGE_SIZE]++;
+	}
+	if (page->protection & mem_PROTECT_CLEAN) {
+		mem_markDirty(memory, address);
+	}
+	
+	/* the read pointer is NULL exactly when the RAM has to go through its handler */
+	page->protection = 0;
+	page->write = page->read;
+	page->writeHandler = mem_getRAMWriteHandler(address);
+	
+	page->writeHandler(memory, address, value);
+}
+
+static void mem_protectPage(mem_Memory *memory, u32 address, mem_PageProtection protection) {
+	mem_Page *page = mem_getPage(memory, address);
+	
+	page->protection |= protection;
+	page->write = NULL;
+	page->writeHandler = mem_writeProtected;
+}
+
+void mem_protectCodePage(mem_Memory *memory, u32 address) {
+	mem_protectPage(memory, address, mem_PROTECT_CODE);
+}
+
+void mem_clearDirtyPages(mem_Memory *memory) {
+	memset(memory->dirtyPages, 0x00, sizeof(memory->dirtyPages));
+	
+	for (u32 address = 0; address < mem_RAM_END; address += mem_PAGE_SIZE) {
+		mem_protectPage(memory, address, mem_PROTECT_CLEAN);
+	}
+}
+
+void mem_setPageDirty(mem_Memory *memory, u32 address) {
+	mem_Page *page = mem_getPage(memory, address);
+	mem_markDirty(memory, address);
+	
+	/* keep any code protection, but the page doesn't need to be caught being written anymore */
+	page->protection &= ~mem_PROTECT_CLEAN;
+	if (!page->protection) {
+		page->write = page->read;
+		page->writeHandler = mem_getRAMWriteHandler(address);
+	}
+}
+
+void mem_initMemory(mem_Memory *memory) {
+	bool fastWords = !mem_hostIsBigEndian();
+	mem_selectAccess(memory);
+	
+	mem_mapPages(memory->unmappedPages, 0x000000, 0x010000, NULL, FALSE, mem_readUnmapped, mem_writeUnmapped);
+	for (u32 bank = 0; bank < mem_BANK_COUNT; bank++) {
+		memory->banks[bank] = memory->unmappedPages;
+	}
+	
+	/* bank 0: WRAM and VRAM */
+	mem_mapPages(memory->lowPages[0], mem_WRAM_START, mem_WRAM_START + mem_WRAM_SIZE, fastWords ? (u8 *)memory->wram : NULL, TRUE, mem_readWRAM, mem_writeWRAM);
+	mem_mapPages(memory->lowPages[0], mem_VRAM_START, mem_VRAM_START + mem_VRAM_SIZE, memory->vram, TRUE, mem_readUnmapped, mem_writeVRAM);
+	memory->banks[0x00] = memory->lowPages[0];
+	
+	/* bank 1: TMRAM, HRAM, and space for MMIO */
+	mem_mapPages(memory->lowPages[1], 0x010000, 0x020000, NULL, FALSE, mem_readUnmapped, mem_writeUnmapped);
+	mem_mapPages(memory->lowPages[1], mem_TMRAM_START, mem_TMRAM_START + mem_TMRAM_SIZE, memory->tmram, TRUE, mem_readUnmapped, mem_writeTMRAM);
+	mem_mapPages(memory->lowPages[1], mem_HRAM_START, mem_HRAM_START + mem_HRAM_SIZE, fastWords ? (u8 *)memory->hram : NULL, TRUE, mem_readHRAM, mem_writeHRAM);
+	memory->banks[0x01] = memory->lowPages[1];
+	
+	for (u32 page = 0; page < mem_WRAM_CODE_PAGES; page++) {
+		memory->wramCodeGeneration[page]++;
+	}
+	
+	/* with nothing to compare against, everything counts as changed */
+	memset(memory->dirtyPages, 0xff, sizeof(memory->dirtyPages));
+	
+	mem_mapROM(memory, memory->rom, memory->romLength);
+}
+
+/*
+*  Pages that are only partly covered by the ROM or boot ROM go through these, since a host pointer would run off the end of the image.
+*/
+static u8 mem_readROM(mem_Memory *memory, u32 address) {
+	if (address < mem_ROM_END - memory->romLength) return 0xff;
+	return memory->rom[address - (mem_ROM_END - memory->romLength)];
+}
+
+static u8 mem_readBootROM(mem_Memory *memory, u32 address) {
+	if (address - mem_BOOT_ROM_START < memory->bootRomLength) return memory->bootRom[address - mem_BOOT_ROM_START];
+	return mem_readROM(memory, address);
+}
+
+/*
+*  RAM banks and the boot ROM's bank each have a table nobody else uses; every other table can be shared by several banks.
+*/
+static bool mem_hasOwnPages(mem_Memory *memory, u32 bank) {
+	return bank < 0x02 || memory->banks[bank] == memory->bootPages;
+}
+
+static u32 mem_findHandlerBank(mem_Memory *memory, u32 bank) {
+	for (u32 slot = 0; slot < memory->handlerBankCount; slot++) {
+		if (memory->handlerBanks[slot] == bank) return slot;
+	}
+	return mem_HANDLER_BANKS;
+}
+
+/*
+*  Copy-on-write: give the bank a copy of its table in handlerPages (unless it already has its own), so patching it doesn't touch any other bank.
+*  mem_mapHandlers() has already made sure there's a slot for it.
+*/
+static mem_Page *mem_getOwnPages(mem_Memory *memory, u32 bank) {
+	if (mem_hasOwnPages(memory, bank)) return memory->banks[bank];
+	
+	u32 slot = mem_findHandlerBank(memory, bank);
+	if (slot == mem_HANDLER_BANKS) {
+		slot = memory->handlerBankCount++;
+		memory->handlerBanks[slot] = bank;
+	}
+	
+	mem_Page *pages = memory->handlerPages[slot];
+	if (memory->banks[bank] != pages) {
+		memcpy(pages, memory->banks[bank], sizeof(memory->handlerPages[slot]));
+		memory->banks[bank] = pages;
+	}
+	
+	return pages;
+}
+
+static void mem_patchHandlers(mem_Memory *memory, const mem_HandlerRange *range) {
+	for (u32 address = range->start & ~(mem_PAGE_SIZE - 1); address < range->end; address += mem_PAGE_SIZE) {
+		mem_Page *page = &mem_getOwnPages(memory, address >> 16)[(address >> 8) & 0xff];
+		
+		page->read = NULL;
+		page->write = NULL;
+		page->readHandler = range->readHandler;
+		page->writeHandler = range->writeHandler;
+	}
+}
+
+/*
+*  Point every page in the given table (for the bank at bankStart) at the ROM where the ROM covers it.
+*/
+static void mem_mapROMPages(mem_Memory *memory, mem_Page *pages, u32 bankStart) {
+	u32 romStart = mem_ROM_END - memory->romLength;
+	
+	for (u32 page = 0; page < mem_PAGES_PER_BANK; page++) {
+		u32 address = bankStart + page * mem_PAGE_SIZE;
+		
+		pages[page].read = (address >= romStart) ? memory->rom - romStart : NULL;
+		pages[page].write = NULL;
+		pages[page].readHandler = (address + mem_PAGE_SIZE > romStart) ? mem_readROM : mem_readUnmapped;
+		pages[page].writeHandler = mem_writeUnmapped;
+	}
+}
+
+void mem_mapROM(mem_Memory *memory, u8 *rom, u32 length) {
+	memory->rom = rom;
+	memory->romLength = (rom != NULL) ? length : 0;
+	
+	u32 romStart = mem_ROM_END - memory->romLength;
+	u32 firstBank = romStart >> 16;
+	
+	/* every bank the ROM fully covers shares one table, since the pointers are biased by the whole address */
+	mem_mapROMPages(memory, memory->romPages, mem_ROM_END - 0x10000);
+	
+	for (u32 bank = 0x02; bank < mem_BANK_COUNT; bank++) {
+		if (bank < firstBank) memory->banks[bank] = memory->unmappedPages;
+		else memory->banks[bank] = memory->romPages;
+	}
+	
+	/* the bank the ROM starts partway through gets its own table */
+	if ((romStart & 0xffff) && firstBank >= 0x02) {
+		mem_mapROMPages(memory, memory->romEdgePages, firstBank << 16);
+		memory->banks[firstBank] = memory->romEdgePages;
+	}
+	
+	mem_setBootRomLock(memory, memory->bootRomLock);
+}
+
+void mem_setBootRomLock(mem_Memory *memory, bool locked) {
+	memory->bootRomLock = locked;
+	u32 bootBank = mem_BOOT_ROM_START >> 16;
+	
+	u32 romStart = mem_ROM_END - memory->romLength;
+	
+	mem_Page *underneath;
+	if (romStart >= mem_BOOT_ROM_START + 0x10000) underneath = memory->unmappedPages;
+	else if (romStart <= mem_BOOT_ROM_START) underneath = memory->romPages;
+	else underneath = memory->romEdgePages;
+	
+	if (locked || memory->bootRom == NULL) {
+		memory->banks[bootBank] = underneath;
+	}
+	else {
+		/* the boot ROM covers the start of the bank and whatever is underneath shows through after it */
+		for (u32 page = 0; page < mem_PAGES_PER_BANK; page++) {
+			u32 offset = page * mem_PAGE_SIZE;
+			mem_Page *entry = &memory->bootPages[page];
+			
+			*entry = underneath[page];
+			if (offset + mem_PAGE_SIZE <= memory->bootRomLength) {
+				entry->read = memory->bootRom - mem_BOOT_ROM_START;
+			}
+			else if (offset < memory->bootRomLength) {
+				entry->read = NULL;
+				entry->readHandler = mem_readBootROM;
+			}
+		}
+		
+		memory->banks[bootBank] = memory->bootPages;
+	}
+	
+	/* the banks were just pointed back at the shared tables, so the handlers have to go in again */
+	for (u32 range = 0; range < memory->handlerRangeCount; range++) {
+		mem_patchHandlers(memory, &memory->handlerRanges[range]);
+	}
+}
+
+bool mem_mapHandlers(mem_Memory *memory, u32 start, u32 end, mem_ReadHandler readHandler, mem_WriteHandler writeHandler) {
+	if (start >= end || end > mem_ROM_END) return FALSE;
+	if (memory->handlerRangeCount == mem_MAX_HANDLER_RANGES) return FALSE;
+	
+	/* check for room up front, so a range is either mapped completely or not at all */
+	u32 newBanks = 0;
+	for (u32 bank = start >> 16; bank <= (end - 1) >> 16; bank++) {
+		if (!mem_hasOwnPages(memory, bank) && mem_findHandlerBank(memory, bank) == mem_HANDLER_BANKS) newBanks++;
+	}
+	if (memory->handlerBankCount + newBanks > mem_HANDLER_BANKS) return FALSE;
+	
+	mem_HandlerRange *range = &memory->handlerRanges[memory->handlerRangeCount++];
+	range->start = start;
+	range->end = end;
+	range->readHandler = readHandler;
+	range->writeHandler = writeHandler;
+	
+	mem_patchHandlers(memory, range);
+	return TRUE;
+}
+
+/*
+*  Each access is written once and instantiated twice below: with monitored as a constant, the latch (and its branch) drops out of the fast set entirely.
+*/
+static inline u8 mem_doReadByte(mem_Memory *memory, mem_BusType bus, u32 address, const bool monitored) {
+	address &= 0xffffff;
+	mem_Page *page = mem_getPage(memory, address);
+	
+	u8 value = page->read ? page->read[address] : page->readHandler(memory, address);
+	
+	if (monitored) mem_latchBus(memory, bus, address, value, FALSE, FALSE);
+	return value;
+}
+
+static inline u16 mem_doReadWord(mem_Memory *memory, mem_BusType bus, u32 address, const bool monitored) {
+	address &= 0xfffffe;
+	mem_Page *page = mem_getPage(memory, address);
+	
+	/* a word never crosses a page, since pages are 256-byte aligned */
+	u16 value;
+	if (page->read) {
+		value = page->read[address] | (page->read[address + 1] << 8);
+	}
+	else {
+		value = page->readHandler(memory, address) | (page->readHandler(memory, address + 1) << 8);
+	}
+	
+	if (monitored) mem_latchBus(memory, bus, address, value, FALSE, TRUE);
+	return value;
+}
+
+static inline void mem_doWriteByte(mem_Memory *memory, mem_BusType bus, u32 address, u8 value, const bool monitored) {
+	address &= 0xffffff;
+	mem_Page *page = mem_getPage(memory, address);
+	
+	if (page->write) page->write[address] = value;
+	else page->writeHandler(memory, address, value);
+	
+	if (monitored) mem_latchBus(memory, bus, address, value, TRUE, FALSE);
+}
+
+static inline void mem_doWriteWord(mem_Memory *memory, mem_BusType bus, u32 address, u16 value, const bool monitored) {
+	address &= 0xfffffe;
+	mem_Page *page = mem_getPage(memory, address);
+	
+	if (page->write) {
+		page->write[address] = (u8)value;
+		page->write[address + 1] = (u8)(value >> 8);
+	}
+	else {
+		page->writeHandler(memory, address, (u8)value);
+		
+		/* the first byte may have changed the page's entry (e.g. a code page getting its fast path back) */
+		page = mem_getPage(memory, address);
+		if (page->write) page->write[address + 1] = (u8)(value >> 8);
+		else page->writeHandler(memory, address + 1, (u8)(value >> 8));
+	}
+	
+	if (monitored) mem_latchBus(memory, bus, address, value, TRUE, TRUE);
+}
+static u8 mem_fastReadByte(mem_Memory *memory, mem_BusType bus, u32 address) {
+	return mem_doReadByte(memory, bus, address, FALSE);
+}
+
+static u16 mem_fastReadWord(mem_Memory *memory, mem_BusType bus, u32 address) {
+	return mem_doReadWord(memory, bus, address, FALSE);
+}
+
+static void mem_fastWriteByte(mem_Memory *memory, mem_BusType bus, u32 address, u8 value) {
+	mem_doWriteByte(memory, bus, address, value, FALSE);
+}
+
+static void mem_fastWriteWord(mem_Memory *memory, mem_BusType bus, u32 address, u16 value) {
+	mem_doWriteWord(memory, bus, address, value, FALSE);
+}
+
+static u8 mem_monitoredReadByte(mem_Memory *memory, mem_BusType bus, u32 address) {
+	return mem_doReadByte(memory, bus, address, TRUE);
+}
+
+static u16 mem_monitoredReadWord(mem_Memory *memory, mem_BusType bus, u32 address) {
+	return mem_doReadWord(memory, bus, address, TRUE);
+}
+
+static void mem_monitoredWriteByte(mem_Memory *memory, mem_BusType bus, u32 address, u8 value) {
+	mem_doWriteByte(memory, bus, address, value, TRUE);
+}
+
+static void mem_monitoredWriteWord(mem_Memory *memory, mem_BusType bus, u32 address, u16 value) {
+	mem_doWriteWord(memory, bus, address, value, TRUE);
+}
+
+static const mem_AccessFunctions mem_fastAccess = {
+	mem_fastReadByte,
+	mem_fastReadWord,
+	mem_fastWriteByte,
+	mem_fastWriteWord
+};
+
+static const mem_AccessFunctions mem_monitoredAccess = {
+	mem_monitoredReadByte,
+	mem_monitoredReadWord,
+	mem_monitoredWriteByte,
+	mem_monitoredWriteWord
+};
\ No newline at end of file
@@ -7,6 +7,8 @@
 #include <hexlet_bools.h>
 #include <hexlet_memory.h>
 
+#include "trace.h"
+
 typedef struct {
 	bool monitored;
 	u32 address;
@@ -18,7 +20,83 @@ typedef struct {
 #define mem_TMRAM_SIZE 4096
 #define mem_HRAM_SIZE 3072
 
+/* Where each region sits in the Pilot's 24-bit address space (the ROM is mapped so that it ends at $FFFFFF) */
+#define mem_WRAM_START	0x000000
+#define mem_VRAM_START	0x008000
+#define mem_TMRAM_START	0x010000
+#define mem_HRAM_START	0x011000
+#define mem_ROM_END	0x1000000
+
+/* The boot ROM covers the start of the last bank (where the CPU starts running) until bootRomLock is set */
+#define mem_BOOT_ROM_START	0xff0000
+#define mem_BOOT_ROM_MAX_SIZE	0x10000
+
+/* The address space is mapped in 256-byte pages, grouped into 64-KiB banks */
+#define mem_PAGE_SIZE 256
+#define mem_PAGES_PER_BANK 256
+#define mem_BANK_COUNT 256
+
+/* WRAM, VRAM, TMRAM and HRAM are contiguous, so every page below this is RAM */
+#define mem_RAM_END (mem_HRAM_START + mem_HRAM_SIZE)
+#define mem_RAM_PAGES (mem_RAM_END / mem_PAGE_SIZE)
+
+/* Room for handler ranges (see mem_mapHandlers()) and for the banks outside RAM that they land in */
+#define mem_MAX_HANDLER_RANGES 16
+#define mem_HANDLER_BANKS 4
+
+/* Granularity used to invalidate decoded code when WRAM is written */
+#define mem_CODE_PAGE_SIZE mem_PAGE_SIZE
+#define mem_WRAM_CODE_PAGES (mem_WRAM_SIZE / mem_CODE_PAGE_SIZE)
+
+struct mem_Memory;
+
+/*
+*  Fallbacks for pages that can't be accessed through a host pointer (MMIO, unmapped space, write-protected pages)
+*/
+typedef u8 (*mem_ReadHandler)(struct mem_Memory *memory, u32 address);
+typedef void (*mem_WriteHandler)(struct mem_Memory *memory, u32 address, u8 value);
+
+/*
+*  The bus accessors come in two sets: one that latches the monitored buses and one with no monitoring code at all.
+*  mem_monitorBuses() picks which set memory->access points at.
+*/
 typedef struct {
+	u8 (*readByte)(struct mem_Memory *memory, mem_BusType bus, u32 address);
+	u16 (*readWord)(struct mem_Memory *memory, mem_BusType bus, u32 address);
+	void (*writeByte)(struct mem_Memory *memory, mem_BusType bus, u32 address, u8 value);
+	void (*writeWord)(struct mem_Memory *memory, mem_BusType bus, u32 address, u16 value);
+} mem_AccessFunctions;
+
+/*
+*  Reasons a RAM page can lose its fast write path; the first write to the page clears them all and restores it
+*/
+typedef u8 mem_PageProtection;
+#define mem_PROTECT_CODE	0x01	/* the CPU has cached code from the page */
+#define mem_PROTECT_CLEAN	0x02	/* the page hasn't changed since mem_clearDirtyPages() */
+
+/*
+*  One page table entry.
+*  The host pointers are biased by the page's Pilot address, so a byte is always at pointer[address].
+*  A NULL pointer sends the access to the handler instead.
+*/
+typedef struct {
+	u8 *read;
+	u8 *write;
+	mem_ReadHandler readHandler;
+	mem_WriteHandler writeHandler;
+	mem_PageProtection protection;
+} mem_Page;
+
+typedef struct {
+	u32 start;
+	u32 end;
+	mem_ReadHandler readHandler;
+	mem_WriteHandler writeHandler;
+} mem_HandlerRange;
+
+typedef struct mem_Memory {
+	const mem_AccessFunctions *access;
+	
 	u16 wram[mem_WRAM_SIZE / 2];
 	u8 vram[mem_VRAM_SIZE];
 	
@@ -31,12 +109,121 @@ typedef struct {
 	u8 tmram[mem_TMRAM_SIZE];
 	u16 hram[mem_HRAM_SIZE / 2];
 	
+	u32 bootRomLength;
+	u8 *bootRom;
+	
+	/*
+	*  Two-level page table: one second-level table per bank.
+	*  Every bank the ROM fully covers shares romPages (the pointers are biased, so they're the same for each bank) and every empty bank shares unmappedPages.
+	*/
+	mem_Page *banks[mem_BANK_COUNT];
+	mem_Page lowPages[2][mem_PAGES_PER_BANK];
+	mem_Page romPages[mem_PAGES_PER_BANK];
+	mem_Page romEdgePages[mem_PAGES_PER_BANK];	/* the bank the ROM starts in, if it doesn't start on a bank boundary */
+	mem_Page bootPages[mem_PAGES_PER_BANK];
+	mem_Page unmappedPages[mem_PAGES_PER_BANK];
+	
+	/*
+	*  Handler ranges from mem_mapHandlers(), patched in again whenever mapping the ROM or boot ROM resets the banks under them.
+	*  Patching a shared table would hit every bank that shares it, so a bank gets a copy of its table in handlerPages first.
+	*/
+	mem_HandlerRange handlerRanges[mem_MAX_HANDLER_RANGES];
+	u32 handlerRangeCount;
+	mem_Page handlerPages[mem_HANDLER_BANKS][mem_PAGES_PER_BANK];
+	u8 handlerBanks[mem_HANDLER_BANKS];
+	u32 handlerBankCount;
+	
+	/*
+	*  A write to a WRAM page that the CPU has cached code from bumps that page's generation, which makes the cached code stale.
+	*  Those pages lose their fast write path (see mem_protectCodePage()) so the check costs nothing elsewhere.
+	*/
+	u32 wramCodeGeneration[mem_WRAM_CODE_PAGES];
+	
+	/* One bit per RAM page, set when the page is written (see mem_clearDirtyPages()) */
+	u8 dirtyPages[(mem_RAM_PAGES + 7) / 8];
+	
 	/* used for debugging */
 	mem_Bus cpuBus;
 	mem_Bus ppuBus;
 	mem_Bus hexridgeBus;
+	
+	/* Bus tracing (see mem_startTrace()); cycle is stamped by the CPU at the start of each block and each instruction it runs */
+	mem_BusType tracedBuses;
+	trc_Ring *trace;
+	u64 cycle;
 } mem_Memory;
 
 mem_Memory *mem_getCurrentMemory(void);
 
+/*
+*  Build the page table for the regions, ROM and boot ROM currently in the given memory.
+*/
+void mem_initMemory(mem_Memory *memory);
+
+/*
+*  Map a new ROM image (or swap banks) by rewriting the ROM's page entries.
+*/
+void mem_mapROM(mem_Memory *memory, u8 *rom, u32 length);
+
+/*
+*  Lock (or unlock) the boot ROM, which swaps the cartridge ROM's pages back in over it.
+*/
+void mem_setBootRomLock(mem_Memory *memory, bool locked);
+
+/*
+*  Send accesses to the given address range (which should be page-aligned) to the given handlers, e.g. for MMIO registers.
+*  The range stays mapped through later calls to mem_mapROM() and mem_setBootRomLock().
+*  Returns FALSE if there's no room left for the range or for the banks it touches.
+*/
+bool mem_mapHandlers(mem_Memory *memory, u32 start, u32 end, mem_ReadHandler readHandler, mem_WriteHandler writeHandler);
+
+/*
+*  Called by the CPU when it caches code from the WRAM page containing the given address.
+*  The next write to that page bumps its entry in wramCodeGeneration.
+*/
+void mem_protectCodePage(mem_Memory *memory, u32 address);
+
+/*
+*  Mark every RAM page clean, so the pages written from now on can be found with mem_isPageDirty().
+*  Clean pages lose their fast write path until their first write, so tracking costs nothing for pages that get written over and over.
+*/
+void mem_clearDirtyPages(mem_Memory *memory);
+
+/*
+*  Mark the RAM page containing the given address as dirty (for changes that don't go through the bus, like loading a state).
+*/
+void mem_setPageDirty(mem_Memory *memory, u32 address);
+
+/*
+*  Return TRUE if the RAM page containing the given address was written since the last call to mem_clearDirtyPages().
+*/
+static inline bool mem_isPageDirty(mem_Memory *memory, u32 address) {
+	u32 page = address / mem_PAGE_SIZE;
+	return (memory->dirtyPages[page >> 3] >> (page & 7)) & 1;
+}
+
+/*
+*  Read a byte or a little-endian word from the given address over the specified bus.
+*  Unmapped addresses read as 0xff (or 0xffff).
+*/
+static inline u8 mem_readByte(mem_Memory *memory, mem_BusType bus, u32 address) {
+	return memory->access->readByte(memory, bus, address);
+}
+
+static inline u16 mem_readWord(mem_Memory *memory, mem_BusType bus, u32 address) {
+	return memory->access->readWord(memory, bus, address);
+}
+
+/*
+*  Write a byte or a little-endian word to the given address over the specified bus.
+*  Writes to ROM or unmapped addresses are ignored.
+*/
+static inline void mem_writeByte(mem_Memory *memory, mem_BusType bus, u32 address, u8 value) {
+	memory->access->writeByte(memory, bus, address, value);
+}
+
+static inline void mem_writeWord(mem_Memory *memory, mem_BusType bus, u32 address, u16 value) {
+	memory->access->writeWord(memory, bus, address, value);
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,49 @@
+/* Internal header file for the assembler's mnemonic table (shared with the generator in tools/mnemonics.c) */
+
+#ifndef HEXLET_MNEMONICS_H_INTERNAL
+#define HEXLET_MNEMONICS_H_INTERNAL
+
+#include <stddef.h>
+
+#include <hexlet_ints.h>
+
+typedef u8 asm_MnemonicType;
+#define asm_MNEMONIC_INSTRUCTION	0
+#define asm_MNEMONIC_DIRECTIVE		1
+
+/*
+*  One slot of the generated table. Directives keep their dot, and every name is upper case.
+*  The handler is one of the generated asm_DIRECTIVE_ values for a directive, and unused for an instruction.
+*/
+typedef struct {
+	const char *name;	/* NULL for an empty slot */
+	u8 length;
+	asm_MnemonicType type;
+	u8 handler;
+	u16 opcode;
+	u8 operandCount;
+	u8 rmShift[2];
+} asm_Mnemonic;
+
+/*
+*  Hash a mnemonic or directive, ignoring case. The generator picks the seed that gives every name its own slot.
+*/
+static inline u32 asm_hashMnemonic(const char *name, size_t length, u32 seed) {
+	u32 hash = 2166136261u ^ seed;
+	
+	for (size_t i = 0; i < length; i++) {
+		u8 ch = (u8)name[i];
+		if (ch >= 'a' && ch <= 'z') ch -= 'a' - 'A';
+		
+		hash = (hash ^ ch) * 16777619u;
+	}
+	
+	/* FNV-1a's low bits barely depend on the seed, so mix the high bits down before they get masked */
+	hash ^= hash >> 16;
+	hash *= 0x7feb352du;
+	hash ^= hash >> 15;
+	
+	return hash;
+}
+
+#endif
\ No newline at end of file
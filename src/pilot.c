@@ -1,7 +1,766 @@
 /* Source file for Hexlet's Pilot CPU emulator */
 
+#include <string.h>
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+#include <hexlet_driver.h>
+
 #include "pilot.h"
 
+#ifdef HEXLET_JIT
+#include "jit.h"
+#endif
+
+/*
+*  Internal struct describing how to decode one opcode
+*/
+typedef struct {
+	u16 opcode;
+	u16 mask;
+	cpu_Operation operation;
+	u8 operandCount;
+	u8 baseCycles;
+	u8 rmShift[2];	/* bit position of each operand's 6-bit RM field in the opcode word */
+} cpu_OpcodeInfo;
+
+static const cpu_OpcodeInfo cpu_opcodeTable[] = {
+#define INSTRUCTION(name, opcode, mask, operandCount, cycles, rmShift0, rmShift1) \
+	{ opcode, mask, cpu_OP_##name, operandCount, cycles, { rmShift0, rmShift1 } },
+#define DIRECTIVE(name)
+#include "instructions.def"
+#undef INSTRUCTION
+#undef DIRECTIVE
+};
+
+#define cpu_OPCODE_COUNT (sizeof(cpu_opcodeTable) / sizeof(cpu_OpcodeInfo))
+
+static cpu_Pilot cpu_currentPilot;
+
+/* this evaluates value only once, since it is usually an extension word fetch */
+#define cpu_SIGN_EXTEND_16(value) ((u32)(s32)(s16)(value))
+
+cpu_Pilot *cpu_getCurrentPilot(void) {
+	return &cpu_currentPilot;
+}
+
+/*
+*  Work out the flags an ALU operation leaves in the given status register.
+*/
+static inline u16 cpu_computeFlags(u16 statusReg, cpu_FlagOperation operation, cpu_OperandSize size, u32 destination, u32 source, u32 fullResult) {
+	u32 mask = cpu_SIZE_MASK(size);
+	u32 sign = cpu_SIZE_SIGN(size);
+	u32 result = fullResult & mask;
+	
+	u16 flags = 0;
+	u16 affected = cpu_FLAG_SIGN | cpu_FLAG_ZERO | cpu_FLAG_CARRY | cpu_FLAG_OVERFLOW;
+	
+	if (result & sign) flags |= cpu_FLAG_SIGN;
+	if (result == 0) flags |= cpu_FLAG_ZERO;
+	
+	switch (operation) {
+		case cpu_FLAGS_ADD: {
+			affected |= cpu_FLAG_EXTEND;
+			
+			if (fullResult > mask) flags |= cpu_FLAG_CARRY | cpu_FLAG_EXTEND;
+			if (~(destination ^ source) & (destination ^ result) & sign) flags |= cpu_FLAG_OVERFLOW;
+			break;
+		}
+		case cpu_FLAGS_SUB: {
+			affected |= cpu_FLAG_EXTEND;
+			
+			if (source > destination) flags |= cpu_FLAG_CARRY | cpu_FLAG_EXTEND;
+			if ((destination ^ source) & (destination ^ result) & sign) flags |= cpu_FLAG_OVERFLOW;
+			break;
+		}
+		default:
+			break;
+	}
+	
+	return (statusReg & ~affected) | flags;
+}
+
+u16 cpu_getStatusReg(cpu_Pilot *pilot) {
+	cpu_LazyFlags *lazy = &pilot->lazyFlags;
+	
+	if (lazy->operation != cpu_FLAGS_NONE) {
+		pilot->statusReg = cpu_computeFlags(pilot->statusReg, lazy->operation, lazy->size, lazy->destination, lazy->source, lazy->result);
+		lazy->operation = cpu_FLAGS_NONE;
+	}
+	
+	return pilot->statusReg;
+}
+
+void cpu_setStatusReg(cpu_Pilot *pilot, u16 value) {
+	pilot->statusReg = value;
+	pilot->lazyFlags.operation = cpu_FLAGS_NONE;
+}
+
+bool cpu_initPilot(cpu_Pilot *pilot) {
+	pilot->lazyFlags.operation = cpu_FLAGS_NONE;
+	pilot->halted = FALSE;
+	pilot->cycles = 0;
+	pilot->skippedCycles = 0;
+	pilot->pendingCycles = 0;
+	
+	pilot->blockCache = drv_reallocate(NULL, 0, sizeof(cpu_BlockCache));
+	if (pilot->blockCache == NULL) {
+		return FALSE;
+	}
+
+#ifdef HEXLET_JIT
+	/* without an executable buffer, just stay in the interpreter */
+	pilot->jitEnabled = FALSE;
+	pilot->jit = drv_reallocate(NULL, 0, sizeof(jit_CodeBuffer));
+	if (pilot->jit != NULL) {
+		if (jit_initCodeBuffer(pilot->jit)) {
+			pilot->jitEnabled = TRUE;
+		}
+		else {
+			pilot->jit = drv_reallocate(pilot->jit, sizeof(jit_CodeBuffer), 0);
+		}
+	}
+#endif
+	
+	cpu_flushBlockCache(pilot);
+	return TRUE;
+}
+
+void cpu_freePilot(cpu_Pilot *pilot) {
+	if (pilot->blockCache != NULL) {
+		pilot->blockCache = drv_reallocate(pilot->blockCache, sizeof(cpu_BlockCache), 0);
+	}
+
+#ifdef HEXLET_JIT
+	if (pilot->jit != NULL) {
+		jit_freeCodeBuffer(pilot->jit);
+		pilot->jit = drv_reallocate(pilot->jit, sizeof(jit_CodeBuffer), 0);
+	}
+	pilot->jitEnabled = FALSE;
+#endif
+}
+
+void cpu_flushBlockCache(cpu_Pilot *pilot) {
+	for (u32 i = 0; i < cpu_BLOCK_CACHE_SIZE; i++) {
+		pilot->blockCache->blocks[i].startAddress = cpu_NO_BLOCK;
+	}
+
+#ifdef HEXLET_JIT
+	if (pilot->jit != NULL) {
+		jit_resetCodeBuffer(pilot->jit);
+	}
+#endif
+}
+
+bool cpu_setJITEnabled(cpu_Pilot *pilot, bool enabled) {
+#ifdef HEXLET_JIT
+	if (pilot->jit == NULL) {
+		return !enabled;
+	}
+	
+	pilot->jitEnabled = enabled;
+	return TRUE;
+#else
+	return !enabled;
+#endif
+}
+
+/*
+*  Fetch a 16-bit extension word, or two of them for a 24-bit value, and advance the address past them.
+*/
+static inline u32 cpu_fetchExtension(mem_Memory *memory, u32 *address, bool pointer) {
+	u32 value = mem_readWord(memory, mem_BUS_TYPE_CPU, *address);
+	*address += 2;
+	
+	if (pointer) {
+		value |= (u32)mem_readWord(memory, mem_BUS_TYPE_CPU, *address) << 16;
+		*address += 2;
+	}
+	
+	return value;
+}
+
+/*
+*  Decode a 6-bit RM field (and any extension words after it) into an operand.
+*/
+static void cpu_decodeRMOperand(mem_Memory *memory, u8 field, u32 *address, cpu_Operand *operand) {
+	operand->reg = (field >> 2) & 0x07;
+	operand->index = 0;
+	operand->value = 0;
+	
+	switch (field & 0x03) {
+		case 0x00:
+			operand->mode = (field & 0x20) ? cpu_RM_POST_INCREMENT : cpu_RM_REGISTER;
+			break;
+		case 0x01: {
+			if (!(field & 0x20)) {
+				operand->mode = cpu_RM_DISPLACEMENT;
+				operand->value = cpu_SIGN_EXTEND_16(cpu_fetchExtension(memory, address, FALSE));
+				break;
+			}
+			
+			switch (operand->reg) {
+				case 0x00:
+					operand->mode = cpu_RM_IMMEDIATE;
+					operand->value = cpu_SIGN_EXTEND_16(cpu_fetchExtension(memory, address, FALSE));
+					break;
+				case 0x01:
+					operand->mode = cpu_RM_IMMEDIATE;
+					operand->value = cpu_fetchExtension(memory, address, TRUE) & 0xffffff;
+					break;
+				case 0x02:
+					operand->mode = cpu_RM_ABSOLUTE;
+					operand->value = cpu_SIGN_EXTEND_16(cpu_fetchExtension(memory, address, FALSE)) & 0xffffff;
+					break;
+				case 0x03:
+					operand->mode = cpu_RM_ABSOLUTE;
+					operand->value = cpu_fetchExtension(memory, address, TRUE) & 0xffffff;
+					break;
+				case 0x04: {
+					/* relative to the extension word itself (which is how the assembler works it out), and made absolute here since the block can't move */
+					u32 base = *address;
+					operand->mode = cpu_RM_PGC_RELATIVE;
+					operand->value = (base + cpu_SIGN_EXTEND_16(cpu_fetchExtension(memory, address, FALSE))) & 0xffffff;
+					break;
+				}
+				case 0x05: {
+					u32 base = *address;
+					operand->mode = cpu_RM_PGC_RELATIVE;
+					operand->value = (base + cpu_fetchExtension(memory, address, TRUE)) & 0xffffff;
+					break;
+				}
+				case 0x06: {
+					u32 word = cpu_fetchExtension(memory, address, FALSE);
+					operand->mode = cpu_RM_REGISTER_INDEXED;
+					operand->reg = (word >> 2) & 0x07;
+					operand->index = (u8)(word >> 8);
+					break;
+				}
+				case 0x07: {
+					u32 words = cpu_fetchExtension(memory, address, TRUE);
+					operand->mode = cpu_RM_ABSOLUTE_INDEXED;
+					operand->value = words & 0xffffff;
+					operand->index = (u8)(words >> 24);
+					break;
+				}
+			}
+			break;
+		}
+		case 0x02:
+			operand->mode = (field & 0x20) ? cpu_RM_PRE_DECREMENT : cpu_RM_INDIRECT;
+			break;
+		case 0x03:
+			operand->mode = cpu_RM_IMMEDIATE;
+			operand->value = (field >> 2) & 0x0f;
+			break;
+	}
+}
+
+bool cpu_decodeInstruction(mem_Memory *memory, u32 address, cpu_Instruction *instruction) {
+	u32 current = address;
+	u16 opcode = (u16)cpu_fetchExtension(memory, &current, FALSE);
+	
+	const cpu_OpcodeInfo *info = NULL;
+	for (u32 i = 0; i < cpu_OPCODE_COUNT; i++) {
+		if ((opcode & cpu_opcodeTable[i].mask) == cpu_opcodeTable[i].opcode) {
+			info = &cpu_opcodeTable[i];
+			break;
+		}
+	}
+	
+	if (info == NULL) {
+		/* unknown opcodes behave like ILG */
+		instruction->operation = cpu_OP_ILG;
+		instruction->operandCount = 0;
+		instruction->length = 2;
+		instruction->cycles = cpu_CYCLES_PER_FETCH;
+		return FALSE;
+	}
+	
+	instruction->operation = info->operation;
+	instruction->operandCount = info->operandCount;
+	
+	for (u8 i = 0; i < info->operandCount; i++) {
+		cpu_decodeRMOperand(memory, (opcode >> info->rmShift[i]) & 0x3f, &current, &instruction->operands[i]);
+	}
+	
+	instruction->length = (u8)(current - address);
+	instruction->cycles = info->baseCycles + (instruction->length / 2) * cpu_CYCLES_PER_FETCH;
+	return TRUE;
+}
+
+/*
+*  Return TRUE if the instruction writes to memory (MOV and every ALU instruction but CMP write to their destination).
+*/
+static inline bool cpu_storesToMemory(cpu_Instruction *instruction) {
+	if (instruction->operation < cpu_OP_MOV || instruction->operation > cpu_OP_XOR || instruction->operation == cpu_OP_CMP) {
+		return FALSE;
+	}
+	
+	return instruction->operands[0].mode != cpu_RM_REGISTER && instruction->operands[0].mode != cpu_RM_IMMEDIATE;
+}
+
+/*
+*  Decode the basic block starting at the given address into the given cache slot.
+*  Blocks end after an instruction that stops sequential execution, when they are full, or at the end of a code page.
+*/
+static void cpu_buildBlock(mem_Memory *memory, u32 startAddress, cpu_Block *block) {
+	u32 address = startAddress;
+	u32 page = address / mem_CODE_PAGE_SIZE;
+	bool cacheable = (address >= mem_ROM_END - memory->romLength);
+	
+	/* the boot ROM gets swapped out from under the cache when it's locked, so it's decoded every time (it only runs once anyway) */
+	if (memory->banks[address >> 16] == memory->bootPages) {
+		cacheable = FALSE;
+	}
+	
+	block->inWRAM = (address < mem_WRAM_START + mem_WRAM_SIZE);
+	block->instructionCount = 0;
+	block->cycles = 0;
+	block->loopsToItself = FALSE;
+	block->stores = FALSE;
+
+#ifdef HEXLET_JIT
+	block->hits = 0;
+	block->nativeCode = NULL;
+#endif
+	
+	while (block->instructionCount < cpu_MAX_BLOCK_INSTRUCTIONS) {
+		cpu_Instruction *instruction = &block->instructions[block->instructionCount];
+		cpu_decodeInstruction(memory, address, instruction);
+		
+		/* an instruction straddling two code pages can't be invalidated properly, so it gets a block of its own */
+		bool straddles = (address + instruction->length - 1) / mem_CODE_PAGE_SIZE != page;
+		if (straddles && block->instructionCount > 0) {
+			break;
+		}
+		
+		block->instructionCount++;
+		block->cycles += instruction->cycles;
+		address = (address + instruction->length) & 0xffffff;
+		
+		if (cpu_storesToMemory(instruction)) {
+			block->stores = TRUE;
+		}
+		
+		if (straddles) {
+			block->inWRAM = FALSE;
+			break;
+		}
+		if (instruction->operation == cpu_OP_HALT || instruction->operation == cpu_OP_ILG || cpu_IS_BRANCH(instruction->operation)) {
+			break;
+		}
+		if (address / mem_CODE_PAGE_SIZE != page) {
+			break;
+		}
+	}
+	
+	if (block->inWRAM) {
+		u32 wramPage = page - mem_WRAM_START / mem_CODE_PAGE_SIZE;
+		mem_protectCodePage(memory, startAddress);
+		block->generation = memory->wramCodeGeneration[wramPage];
+		cacheable = TRUE;
+	}
+
+#ifdef HEXLET_JIT
+	block->translatable = jit_canTranslateBlock(block);
+#endif
+	
+	/* code in VRAM, TMRAM or HRAM is decoded again every time it runs */
+	block->startAddress = cacheable ? startAddress : cpu_NO_BLOCK;
+}
+
+/*
+*  Find the cached block starting at the given address, decoding it if it isn't cached or has gone stale.
+*/
+static inline cpu_Block *cpu_lookupBlock(cpu_Pilot *pilot, mem_Memory *memory, u32 address) {
+	cpu_Block *block = &pilot->blockCache->blocks[(address >> 1) & (cpu_BLOCK_CACHE_SIZE - 1)];
+	
+	if (block->startAddress == address) {
+		if (!block->inWRAM || block->generation == memory->wramCodeGeneration[(address - mem_WRAM_START) / mem_CODE_PAGE_SIZE]) {
+			return block;
+		}
+	}
+	
+	cpu_buildBlock(memory, address, block);
+	return block;
+}
+
+/*
+*  Read the index register of an indexed operand. Its index byte picks the register in bits 0-2 (L0-L3 then M0-M3 for a byte),
+*  sign-extends it if bit 3 is set, and gives its size in bits 6-7.
+*/
+static inline u32 cpu_getIndex(cpu_Pilot *pilot, u8 index) {
+	u8 reg = index & 0x07;
+	u32 value;
+	
+	switch (index >> 6) {
+		case cpu_SIZE_BYTE:
+			value = (reg < 4) ? pilot->regs[reg] & 0xff : (pilot->regs[reg - 4] >> 8) & 0xff;
+			if ((index & 0x08) && (value & 0x80)) value |= 0xffff00;
+			break;
+		case cpu_SIZE_WORD:
+			value = pilot->regs[reg] & 0xffff;
+			if ((index & 0x08) && (value & 0x8000)) value |= 0xff0000;
+			break;
+		default:
+			value = pilot->regs[reg];
+			break;
+	}
+	
+	return value;
+}
+
+/* What cpu_getOperandAddress() returns for an operand that isn't in memory */
+#define cpu_NO_ADDRESS 0xffffffff
+
+/*
+*  Work out where a memory operand is, stepping its register if it's an increment or decrement (by a word, the only size so far).
+*  Return cpu_NO_ADDRESS for a register or an immediate.
+*/
+static inline u32 cpu_getOperandAddress(cpu_Pilot *pilot, cpu_Operand *operand) {
+	u32 *reg = &pilot->regs[operand->reg];
+	u32 address;
+	
+	switch (operand->mode) {
+		case cpu_RM_POST_INCREMENT:
+			address = *reg;
+			*reg = (*reg + 2) & 0xffffff;
+			return address;
+		case cpu_RM_DISPLACEMENT:
+			return (*reg + operand->value) & 0xffffff;
+		case cpu_RM_INDIRECT:
+			return *reg;
+		case cpu_RM_PRE_DECREMENT:
+			*reg = (*reg - 2) & 0xffffff;
+			return *reg;
+		case cpu_RM_ABSOLUTE:
+		case cpu_RM_PGC_RELATIVE:
+			return operand->value;
+		case cpu_RM_REGISTER_INDEXED:
+			return (*reg + cpu_getIndex(pilot, operand->index)) & 0xffffff;
+		case cpu_RM_ABSOLUTE_INDEXED:
+			return (operand->value + cpu_getIndex(pilot, operand->index)) & 0xffffff;
+		default:
+			return cpu_NO_ADDRESS;
+	}
+}
+
+static inline u16 cpu_readOperand(cpu_Pilot *pilot, mem_Memory *memory, cpu_Operand *operand, u32 address) {
+	if (operand->mode == cpu_RM_REGISTER) return (u16)pilot->regs[operand->reg];
+	if (operand->mode == cpu_RM_IMMEDIATE) return (u16)operand->value;
+	
+	return mem_readWord(memory, mem_BUS_TYPE_CPU, address);
+}
+
+/*
+*  Writing a W register leaves the top byte of the register alone, and writing to an immediate does nothing.
+*/
+static inline void cpu_writeOperand(cpu_Pilot *pilot, mem_Memory *memory, cpu_Operand *operand, u32 address, u16 value) {
+	if (operand->mode == cpu_RM_REGISTER) {
+		pilot->regs[operand->reg] = (pilot->regs[operand->reg] & 0xff0000) | value;
+	}
+	else if (address != cpu_NO_ADDRESS) {
+		mem_writeWord(memory, mem_BUS_TYPE_CPU, address, value);
+	}
+}
+
+/*
+*  Keep an ALU operation's operands for cpu_getStatusReg() to work the flags out from later, or work them out now if eagerFlags is set.
+*/
+static inline void cpu_setFlags(cpu_Pilot *pilot, cpu_FlagOperation operation, u32 destination, u32 source, u32 result, const bool eagerFlags) {
+	if (eagerFlags) {
+		pilot->statusReg = cpu_computeFlags(pilot->statusReg, operation, cpu_SIZE_WORD, destination, source, result);
+		return;
+	}
+	
+	cpu_LazyFlags *lazy = &pilot->lazyFlags;
+	lazy->operation = operation;
+	lazy->size = cpu_SIZE_WORD;
+	lazy->destination = destination;
+	lazy->source = source;
+	lazy->result = result;
+}
+
+/*
+*  Run an ALU instruction: read both operands, write the result to the destination (unless it's CMP), and set the flags.
+*/
+static inline void cpu_executeALU(cpu_Pilot *pilot, mem_Memory *memory, cpu_Instruction *instruction, const bool eagerFlags) {
+	cpu_Operand *destination = &instruction->operands[0];
+	cpu_Operand *source = &instruction->operands[1];
+	
+	u32 sourceValue = cpu_readOperand(pilot, memory, source, cpu_getOperandAddress(pilot, source));
+	u32 address = cpu_getOperandAddress(pilot, destination);
+	u32 destinationValue = cpu_readOperand(pilot, memory, destination, address);
+	
+	u32 result;
+	cpu_FlagOperation flags = cpu_FLAGS_LOGIC;
+	
+	switch (instruction->operation) {
+		case cpu_OP_ADD:
+			result = destinationValue + sourceValue;
+			flags = cpu_FLAGS_ADD;
+			break;
+		case cpu_OP_SUB:
+		case cpu_OP_CMP:
+			result = destinationValue - sourceValue;
+			flags = cpu_FLAGS_SUB;
+			break;
+		case cpu_OP_AND:
+			result = destinationValue & sourceValue;
+			break;
+		case cpu_OP_OR:
+			result = destinationValue | sourceValue;
+			break;
+		case cpu_OP_XOR:
+		default:
+			result = destinationValue ^ sourceValue;
+			break;
+	}
+	
+	if (instruction->operation != cpu_OP_CMP) {
+		cpu_writeOperand(pilot, memory, destination, address, (u16)result);
+	}
+	
+	cpu_setFlags(pilot, flags, destinationValue, sourceValue, result, eagerFlags);
+}
+
+/*
+*  Return TRUE if a branch's condition holds. Only this makes the lazy flags get worked out.
+*/
+static inline bool cpu_checkCondition(cpu_Pilot *pilot, cpu_Operation operation) {
+	if (operation == cpu_OP_BRA) {
+		return TRUE;
+	}
+	
+	u16 status = cpu_getStatusReg(pilot);
+	
+	switch (operation) {
+		case cpu_OP_BEQ: return (status & cpu_FLAG_ZERO) != 0;
+		case cpu_OP_BNE: return !(status & cpu_FLAG_ZERO);
+		case cpu_OP_BCS: return (status & cpu_FLAG_CARRY) != 0;
+		case cpu_OP_BCC: return !(status & cpu_FLAG_CARRY);
+		case cpu_OP_BMI: return (status & cpu_FLAG_SIGN) != 0;
+		case cpu_OP_BPL: return !(status & cpu_FLAG_SIGN);
+		case cpu_OP_BVS: return (status & cpu_FLAG_OVERFLOW) != 0;
+		case cpu_OP_BVC:
+		default:
+			return !(status & cpu_FLAG_OVERFLOW);
+	}
+}
+
+/*
+*  A branch goes to a register's value, an immediate, or the address of a memory operand.
+*/
+static inline u32 cpu_getBranchTarget(cpu_Pilot *pilot, cpu_Operand *operand) {
+	if (operand->mode == cpu_RM_REGISTER) return pilot->regs[operand->reg] & 0xffffff;
+	if (operand->mode == cpu_RM_IMMEDIATE) return operand->value & 0xffffff;
+	
+	return cpu_getOperandAddress(pilot, operand);
+}
+
+/*
+*  Run a single decoded instruction.
+*/
+static inline void cpu_execute(cpu_Pilot *pilot, mem_Memory *memory, cpu_Instruction *instruction, const bool eagerFlags) {
+	pilot->programCounter = (pilot->programCounter + instruction->length) & 0xffffff;
+	
+	switch (instruction->operation) {
+		case cpu_OP_NOP:
+			break;
+		case cpu_OP_HALT:
+			pilot->halted = TRUE;
+			break;
+		case cpu_OP_MOV: {
+			cpu_Operand *destination = &instruction->operands[0];
+			cpu_Operand *source = &instruction->operands[1];
+			
+			u16 value = cpu_readOperand(pilot, memory, source, cpu_getOperandAddress(pilot, source));
+			cpu_writeOperand(pilot, memory, destination, cpu_getOperandAddress(pilot, destination), value);
+			break;
+		}
+		case cpu_OP_ADD:
+		case cpu_OP_SUB:
+		case cpu_OP_CMP:
+		case cpu_OP_AND:
+		case cpu_OP_OR:
+		case cpu_OP_XOR:
+			cpu_executeALU(pilot, memory, instruction, eagerFlags);
+			break;
+		case cpu_OP_BRA:
+		case cpu_OP_BEQ:
+		case cpu_OP_BNE:
+		case cpu_OP_BCS:
+		case cpu_OP_BCC:
+		case cpu_OP_BMI:
+		case cpu_OP_BPL:
+		case cpu_OP_BVS:
+		case cpu_OP_BVC:
+			if (cpu_checkCondition(pilot, instruction->operation)) {
+				pilot->programCounter = cpu_getBranchTarget(pilot, &instruction->operands[0]);
+			}
+			break;
+		case cpu_OP_ILG:
+		default:
+			/* there are no exception vectors yet, so an illegal instruction stops the CPU */
+			pilot->halted = TRUE;
+			break;
+	}
+}
+
+#ifdef HEXLET_JIT
+/*
+*  Translate a hot block, starting over with an empty code buffer if it's full.
+*/
+static void cpu_translateBlock(cpu_Pilot *pilot, cpu_Block *block) {
+	block->nativeCode = jit_translateBlock(pilot->jit, block);
+	
+	if (block->nativeCode == NULL) {
+		for (u32 i = 0; i < cpu_BLOCK_CACHE_SIZE; i++) {
+			pilot->blockCache->blocks[i].nativeCode = NULL;
+		}
+		
+		jit_resetCodeBuffer(pilot->jit);
+		block->nativeCode = jit_translateBlock(pilot->jit, block);
+	}
+}
+#endif
+
+/*
+*  What a block that doesn't store anything could have changed, used to spot loops that spin without doing anything
+*/
+typedef struct {
+	u32 regs[8];
+	u16 statusReg;
+	cpu_LazyFlags lazyFlags;
+} cpu_IdleSnapshot;
+
+static inline void cpu_takeIdleSnapshot(cpu_Pilot *pilot, cpu_IdleSnapshot *snapshot) {
+	memcpy(snapshot->regs, pilot->regs, sizeof(snapshot->regs));
+	snapshot->statusReg = pilot->statusReg;
+	snapshot->lazyFlags = pilot->lazyFlags;
+}
+
+static inline bool cpu_matchesIdleSnapshot(cpu_Pilot *pilot, cpu_IdleSnapshot *snapshot) {
+	return pilot->statusReg == snapshot->statusReg
+		&& pilot->lazyFlags.operation == snapshot->lazyFlags.operation
+		&& pilot->lazyFlags.size == snapshot->lazyFlags.size
+		&& pilot->lazyFlags.destination == snapshot->lazyFlags.destination
+		&& pilot->lazyFlags.source == snapshot->lazyFlags.source
+		&& pilot->lazyFlags.result == snapshot->lazyFlags.result
+		&& !memcmp(pilot->regs, snapshot->regs, sizeof(snapshot->regs));
+}
+
+/*
+*  cpu_runPilot() and cpu_runPilotEagerFlags() are both this, instantiated with eagerFlags as a constant so neither pays for the other's branch.
+*/
+static inline u32 cpu_run(cpu_Pilot *pilot, mem_Memory *memory, u32 cycleBudget, const bool eagerFlags) {
+	u32 cyclesRun = 0;
+	
+	if (eagerFlags) {
+		cpu_getStatusReg(pilot);
+	}
+	
+	while (cyclesRun < cycleBudget) {
+		if (pilot->halted) {
+			/* nothing can wake the CPU up in the middle of a run, so skip the rest of it */
+			pilot->skippedCycles += cycleBudget - cyclesRun;
+			cyclesRun = cycleBudget;
+			break;
+		}
+		
+		u32 address = pilot->programCounter;
+		memory->cycle = pilot->cycles + cyclesRun;
+		
+		cpu_Block *block = cpu_lookupBlock(pilot, memory, address);
+		u32 generation = block->generation;
+		bool ranNative = FALSE;
+		
+		/* a loop that stores anything has side effects, so only the others are worth checking */
+		bool idleCandidate = block->loopsToItself && !block->stores;
+		
+		cpu_IdleSnapshot snapshot;
+		if (idleCandidate) {
+			cpu_takeIdleSnapshot(pilot, &snapshot);
+		}
+
+#ifdef HEXLET_JIT
+		/* a translated block always runs to its end, so it only runs when the interpreter wouldn't stop partway through it */
+		if (pilot->jitEnabled && block->translatable && block->startAddress != cpu_NO_BLOCK && block->cycles <= cycleBudget - cyclesRun) {
+			if (block->nativeCode == NULL && block->hits >= jit_HOT_THRESHOLD) {
+				cpu_translateBlock(pilot, block);
+			}
+			
+			if (block->nativeCode != NULL) {
+				/* the translation keeps the flags in a host register, so they have to be worked out going in */
+				cpu_getStatusReg(pilot);
+				cyclesRun += ((jit_BlockFunction)block->nativeCode)(pilot);
+				ranNative = TRUE;
+			}
+			else {
+				block->hits++;
+			}
+		}
+#endif
+		
+		if (!ranNative) {
+			for (u8 i = 0; i < block->instructionCount; i++) {
+				cpu_Instruction *instruction = &block->instructions[i];
+				
+				/* so every access the instruction makes is traced with the cycle it started on */
+				memory->cycle = pilot->cycles + cyclesRun;
+				cpu_execute(pilot, memory, instruction, eagerFlags);
+				cyclesRun += instruction->cycles;
+				
+				if (pilot->halted || cyclesRun >= cycleBudget) {
+					break;
+				}
+				
+				/* the block just overwrote itself */
+				if (block->inWRAM && memory->wramCodeGeneration[(address - mem_WRAM_START) / mem_CODE_PAGE_SIZE] != generation) {
+					break;
+				}
+			}
+		}
+		
+		if (pilot->programCounter == address && !pilot->halted) {
+			/*
+			*  The block went all the way around without storing anything or changing a register or a flag,
+			*  so it will keep spinning exactly like this until an event changes memory or wakes the CPU, and that can't happen in the middle of a run.
+			*/
+			if (idleCandidate && cpu_matchesIdleSnapshot(pilot, &snapshot)) {
+				if (cyclesRun < cycleBudget) {
+					pilot->skippedCycles += cycleBudget - cyclesRun;
+					cyclesRun = cycleBudget;
+				}
+				break;
+			}
+			
+			block->loopsToItself = TRUE;
+		}
+	}
+	
+	pilot->cycles += cyclesRun;
+	return cyclesRun;
+}
+
+u32 cpu_runPilot(cpu_Pilot *pilot, mem_Memory *memory, u32 cycleBudget) {
+	return cpu_run(pilot, memory, cycleBudget, FALSE);
+}
+
+u32 cpu_runPilotEagerFlags(cpu_Pilot *pilot, mem_Memory *memory, u32 cycleBudget) {
+	return cpu_run(pilot, memory, cycleBudget, TRUE);
+}
+
 void cpu_tickPilot(cpu_Pilot *pilot, mem_Memory *memory) {
+	if (pilot->pendingCycles > 0) {
+		pilot->pendingCycles--;
+		pilot->cycles++;
+		return;
+	}
 	
+	/* start the next instruction and spread the rest of its cycles over the following ticks */
+	u32 cyclesRun = cpu_runPilot(pilot, memory, 1);
+	pilot->cycles -= cyclesRun - 1;
+	pilot->pendingCycles = cyclesRun - 1;
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #define HEXLET_CPU_H_INTERNAL
 
 #include <hexlet_ints.h>
+#include <hexlet_bools.h>
 
 #include "memory.h"
 
@@ -16,13 +17,196 @@ typedef u16 cpu_StatusRegMask;
 #define cpu_FLAG_DECIMAL	0x0002
 #define cpu_FLAG_EXTEND		0x0001
 
+/* Operand sizes (these match the assembler's .B, .W and .P suffixes) */
+typedef u8 cpu_OperandSize;
+#define cpu_SIZE_BYTE		0
+#define cpu_SIZE_WORD		1
+#define cpu_SIZE_POINTER	2
+
+#define cpu_SIZE_MASK(size) ((size) == cpu_SIZE_BYTE ? 0xff : ((size) == cpu_SIZE_WORD ? 0xffff : 0xffffff))
+#define cpu_SIZE_SIGN(size) ((size) == cpu_SIZE_BYTE ? 0x80 : ((size) == cpu_SIZE_WORD ? 0x8000 : 0x800000))
+
+/* The kind of ALU operation whose flags haven't been worked out yet */
+typedef u8 cpu_FlagOperation;
+#define cpu_FLAGS_NONE		0x00	/* statusReg is up to date */
+#define cpu_FLAGS_ADD		0x01	/* sets sign, zero, carry, overflow and extend */
+#define cpu_FLAGS_SUB		0x02	/* sets sign, zero, carry (borrow), overflow and extend */
+#define cpu_FLAGS_LOGIC		0x03	/* sets sign and zero, clears carry and overflow */
+
+/*
+*  The last ALU operation, kept around so statusReg only gets computed when something reads it.
+*/
+typedef struct {
+	cpu_FlagOperation operation;
+	cpu_OperandSize size;
+	u32 destination;
+	u32 source;
+	u32 result;	/* not truncated to the operand size, so the carry out is still there */
+} cpu_LazyFlags;
+
+/* Operations the decoder knows about (instructions.def describes their encodings, for the decoder and the assembler) */
+typedef u8 cpu_Operation;
+#define cpu_OP_NOP	0x00
+#define cpu_OP_HALT	0x01
+#define cpu_OP_ILG	0x02
+#define cpu_OP_MOV	0x03
+#define cpu_OP_ADD	0x04
+#define cpu_OP_SUB	0x05
+#define cpu_OP_CMP	0x06
+#define cpu_OP_AND	0x07
+#define cpu_OP_OR	0x08
+#define cpu_OP_XOR	0x09
+#define cpu_OP_BRA	0x0a
+#define cpu_OP_BEQ	0x0b
+#define cpu_OP_BNE	0x0c
+#define cpu_OP_BCS	0x0d
+#define cpu_OP_BCC	0x0e
+#define cpu_OP_BMI	0x0f
+#define cpu_OP_BPL	0x10
+#define cpu_OP_BVS	0x11
+#define cpu_OP_BVC	0x12
+
+/* The branches are numbered in the same order as their condition field, so each one's condition is its distance from BRA */
+#define cpu_IS_BRANCH(operation) ((operation) >= cpu_OP_BRA && (operation) <= cpu_OP_BVC)
+
+/* Addressing modes of an RM operand, decoded from its 6-bit field */
+typedef u8 cpu_RMMode;
+#define cpu_RM_REGISTER		0x00	/* Rn */
+#define cpu_RM_POST_INCREMENT	0x01	/* @Pn+ */
+#define cpu_RM_DISPLACEMENT	0x02	/* @Pn+disp16 */
+#define cpu_RM_INDIRECT		0x03	/* @Pn */
+#define cpu_RM_PRE_DECREMENT	0x04	/* @-Pn */
+#define cpu_RM_IMMEDIATE	0x05	/* #imm4, #imm16 or #imm24 */
+#define cpu_RM_ABSOLUTE		0x06	/* @abs16 or @abs24 */
+#define cpu_RM_PGC_RELATIVE	0x07	/* @PGC+rel16 or @PGC+rel24 */
+#define cpu_RM_REGISTER_INDEXED	0x08	/* @Pn+Xn */
+#define cpu_RM_ABSOLUTE_INDEXED	0x09	/* @abs24+Xn */
+
+typedef struct {
+	cpu_RMMode mode;
+	u8 reg;		/* register number for register-based modes */
+	u8 index;	/* raw index byte for the indexed modes */
+	u32 value;	/* immediate value, absolute address, or displacement (already sign-extended; PGC-relative addresses are already made absolute) */
+} cpu_Operand;
+
+typedef struct {
+	cpu_Operation operation;
+	u8 operandCount;
+	u8 length;	/* in bytes, including extension words */
+	u8 cycles;
+	cpu_Operand operands[2];
+} cpu_Instruction;
+
+/* A basic block holds at most this many instructions and never crosses a code page */
+#define cpu_MAX_BLOCK_INSTRUCTIONS 16
+#define cpu_BLOCK_CACHE_SIZE 512
+
+/* Cycles taken by each 16-bit fetch of an instruction or extension word */
+#define cpu_CYCLES_PER_FETCH 1
+
+typedef struct {
+	u32 startAddress;	/* cpu_NO_BLOCK when the slot is empty */
+	u32 generation;		/* WRAM code page generation at decode time */
+	u16 cycles;
+	u8 instructionCount;
+	bool inWRAM;
+	bool loopsToItself;	/* set once the block has been seen branching back to its own start */
+	bool stores;		/* some instruction in the block writes to memory, so it can't be an idle loop */
+	cpu_Instruction instructions[cpu_MAX_BLOCK_INSTRUCTIONS];
+
+#ifdef HEXLET_JIT
+	/* times this block has run in the interpreter, and its translation once it gets hot (if the recompiler can translate it) */
+	u16 hits;
+	bool translatable;
+	void *nativeCode;
+#endif
+} cpu_Block;
+
+#define cpu_NO_BLOCK 0xffffffff
+
+typedef struct {
+	cpu_Block blocks[cpu_BLOCK_CACHE_SIZE];
+} cpu_BlockCache;
+
 typedef struct {
 	u32 regs[8];
-	u16 statusReg;
+	u16 statusReg;	/* the flag bits may be stale; use cpu_getStatusReg() to read it */
 	u32 programCounter;
 	u16 prefetchQueue[6];
+	
+	cpu_LazyFlags lazyFlags;
+	
+	bool halted;
+	
+	/* Total cycles run since reset, and how many of those were skipped because the CPU was halted or idling */
+	u64 cycles;
+	u64 skippedCycles;
+	
+	/* Cycles still owed by the last instruction started through cpu_tickPilot() */
+	u32 pendingCycles;
+	
+	cpu_BlockCache *blockCache;
+
+#ifdef HEXLET_JIT
+	bool jitEnabled;
+	struct jit_CodeBuffer *jit;
+#endif
 } cpu_Pilot;
 
+cpu_Pilot *cpu_getCurrentPilot(void);
+
+/*
+*  Bring the flags in statusReg up to date and return it.
+*  This has to be called before anything reads the flags: branches, flag-reading instructions, interrupt pushes, and state saves.
+*/
+u16 cpu_getStatusReg(cpu_Pilot *pilot);
+
+/*
+*  Overwrite statusReg, throwing away any flags that haven't been computed yet.
+*/
+void cpu_setStatusReg(cpu_Pilot *pilot, u16 value);
+
+/*
+*  Allocate the CPU's block cache and reset it. Return FALSE on failure or TRUE on success.
+*/
+bool cpu_initPilot(cpu_Pilot *pilot);
+
+/*
+*  Free the CPU's block cache.
+*/
+void cpu_freePilot(cpu_Pilot *pilot);
+
+/*
+*  Throw away every cached block (e.g. after the ROM or the memory map changes).
+*/
+void cpu_flushBlockCache(cpu_Pilot *pilot);
+
+/*
+*  Switch between the dynamic recompiler and the interpreter at runtime (the recompiler is on by default).
+*  Return FALSE if Hexlet was built without the recompiler or TRUE on success.
+*/
+bool cpu_setJITEnabled(cpu_Pilot *pilot, bool enabled);
+
+/*
+*  Decode the instruction at the given address. Return FALSE if it is not a valid instruction.
+*/
+bool cpu_decodeInstruction(mem_Memory *memory, u32 address, cpu_Instruction *instruction);
+
+/*
+*  Run whole instructions over the specified memory bus until at least cycleBudget cycles have passed.
+*  If the CPU is halted or stuck in a loop that changes nothing, the rest of the budget is skipped instead of emulated.
+*  Return the number of cycles actually run, which can overshoot the budget by the length of the last instruction.
+*  Translated blocks only run when they fit in what's left of the budget, so the recompiler stops exactly where the interpreter would.
+*  Note: Like cpu_tickPilot(), this does not check whether the CPU should be running at all.
+*/
+u32 cpu_runPilot(cpu_Pilot *pilot, mem_Memory *memory, u32 cycleBudget);
+
+/*
+*  Same as cpu_runPilot(), but work out the flags after every ALU instruction instead of leaving them for cpu_getStatusReg().
+*  This is only for measuring what lazy flags save and for checking them against the eager result.
+*/
+u32 cpu_runPilotEagerFlags(cpu_Pilot *pilot, mem_Memory *memory, u32 cycleBudget);
+
 /*
 *  Perform a single CPU cycle over the specified memory bus.
 *  Note: This method does not check whether the CPU should actually be ticked (e.g. if a DMA is in progress, it shouldn't be).
@@ -0,0 +1,278 @@
+/* Source file for Hexlet's rewind buffer */
+
+/* for clock_gettime() */
+#define _DEFAULT_SOURCE
+
+#include <string.h>
+#include <time.h>
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+#include <hexlet_driver.h>
+#include <hexlet_loader.h>
+#include <hexlet_rewind.h>
+
+#include "compress.h"
+#include "rewind.h"
+
+static rwd_Rewind rwd_buffer;
+
+/*
+*  Get a timestamp in microseconds, from a clock that only moves forward (clock() is CPU time on Unix-likes and wall time on Windows).
+*/
+static inline u64 rwd_getMicroseconds(void) {
+#if defined(__unix__) || defined(__APPLE__)
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (u64)now.tv_sec * 1000000 + (u64)now.tv_nsec / 1000;
+#else
+	return (u64)clock() * 1000000 / CLOCKS_PER_SEC;
+#endif
+}
+
+static inline rwd_Entry *rwd_getEntry(rwd_Rewind *rewind, u32 number) {
+	return &rewind->entries[number % rewind->entryCapacity];
+}
+
+static void *rwd_resize(void *ptr, size_t oldSize, size_t newSize) {
+	if (ptr == NULL && newSize == 0) return NULL;
+	return drv_reallocate(ptr, oldSize, newSize);
+}
+
+/*
+*  Allocate (or with free set, free) everything the buffer needs.
+*/
+static bool rwd_allocate(rwd_Rewind *rewind, bool free) {
+	size_t compressedSize = cmp_getBound(rewind->stateSize);
+	
+	rewind->ring = rwd_resize(rewind->ring, rewind->ringSize, free ? 0 : rewind->ringSize);
+	rewind->entries = rwd_resize(rewind->entries, rewind->entryCapacity * sizeof(rwd_Entry), free ? 0 : rewind->entryCapacity * sizeof(rwd_Entry));
+	rewind->state = rwd_resize(rewind->state, rewind->stateSize, free ? 0 : rewind->stateSize);
+	rewind->delta = rwd_resize(rewind->delta, rewind->stateSize, free ? 0 : rewind->stateSize);
+	rewind->keyframe = rwd_resize(rewind->keyframe, rewind->stateSize, free ? 0 : rewind->stateSize);
+	rewind->compressed = rwd_resize(rewind->compressed, compressedSize, free ? 0 : compressedSize);
+	
+	return rewind->ring && rewind->entries && rewind->state && rewind->delta && rewind->keyframe && rewind->compressed;
+}
+
+bool rwd_initRewind(u32 bufferSize, u8 captureInterval, u8 keyframeInterval) {
+	rwd_Rewind *rewind = &rwd_buffer;
+	rwd_freeRewind();
+	
+	rewind->ringSize = bufferSize;
+	rewind->entryCapacity = bufferSize / rwd_MIN_AVERAGE_ENTRY_SIZE + 1;
+	rewind->stateSize = ldr_getStateSize(rwd_STATE_PARTS);
+	
+	if (!rewind->stateSize || !rwd_allocate(rewind, FALSE)) {
+		rwd_freeRewind();
+		return FALSE;
+	}
+	
+	rewind->ringHead = 0;
+	rewind->bytesUsed = 0;
+	rewind->firstEntry = 0;
+	rewind->entryCount = 0;
+	rewind->keyframeCount = 0;
+	rewind->captureInterval = captureInterval ? captureInterval : 1;
+	rewind->keyframeInterval = keyframeInterval ? keyframeInterval : 1;
+	rewind->framesUntilCapture = 0;
+	rewind->keyframeValid = FALSE;
+	rewind->lastCaptureMicroseconds = 0;
+	rewind->lastRestoreMicroseconds = 0;
+	
+	return TRUE;
+}
+
+void rwd_freeRewind(void) {
+	rwd_allocate(&rwd_buffer, TRUE);
+	
+	rwd_buffer.entryCount = 0;
+	rwd_buffer.keyframeValid = FALSE;
+}
+
+/*
+*  Drop the oldest keyframe and all the deltas against it, so the oldest entry is always a keyframe.
+*/
+static void rwd_dropOldestGroup(rwd_Rewind *rewind) {
+	u32 keyframe = rewind->firstEntry;
+	
+	while (rewind->entryCount > 0 && rwd_getEntry(rewind, rewind->firstEntry)->keyframe == keyframe) {
+		rwd_Entry *entry = rwd_getEntry(rewind, rewind->firstEntry);
+		
+		if (entry->keyframe == rewind->firstEntry) rewind->keyframeCount--;
+		rewind->bytesUsed -= entry->size;
+		rewind->firstEntry++;
+		rewind->entryCount--;
+	}
+	
+	if (rewind->keyframeValid && rewind->keyframeNumber - rewind->firstEntry >= rewind->entryCount) {
+		rewind->keyframeValid = FALSE;
+	}
+}
+
+/*
+*  Find room in the ring for size bytes, dropping the oldest entries if needed. Return the offset, or ringSize if it can never fit.
+*/
+static u32 rwd_allocateEntry(rwd_Rewind *rewind, u32 size) {
+	if (size > rewind->ringSize) {
+		return rewind->ringSize;
+	}
+	
+	if (rewind->entryCount == rewind->entryCapacity) {
+		rwd_dropOldestGroup(rewind);
+	}
+	
+	/* the data never wraps around the end of the ring, so the leftover bit at the end gets skipped */
+	u32 offset = (rewind->ringHead + size > rewind->ringSize) ? 0 : rewind->ringHead;
+	
+	/* the entries are laid out in capture order, so the oldest one is always the next to be in the way */
+	while (rewind->entryCount > 0) {
+		rwd_Entry *oldest = rwd_getEntry(rewind, rewind->firstEntry);
+		if (oldest->offset >= offset + size || oldest->offset + oldest->size <= offset) break;
+		
+		rwd_dropOldestGroup(rewind);
+	}
+	
+	return offset;
+}
+
+bool rwd_captureFrame(void) {
+	rwd_Rewind *rewind = &rwd_buffer;
+	if (rewind->ring == NULL) return FALSE;
+	
+	if (rewind->framesUntilCapture > 0) {
+		rewind->framesUntilCapture--;
+		return TRUE;
+	}
+	rewind->framesUntilCapture = rewind->captureInterval - 1;
+	
+	u64 start = rwd_getMicroseconds();
+	
+	if (!ldr_saveState(rewind->state, rewind->stateSize, rwd_STATE_PARTS)) {
+		return FALSE;
+	}
+	
+	u32 number = rewind->firstEntry + rewind->entryCount;
+	bool isKeyframe = !rewind->keyframeValid || number - rewind->keyframeNumber >= rewind->keyframeInterval;
+	u8 *source = rewind->state;
+	
+	if (isKeyframe) {
+		memcpy(rewind->keyframe, rewind->state, rewind->stateSize);
+	}
+	else {
+		/* most of the state is the same as in the keyframe, so the XOR is mostly zeros and compresses very well */
+		for (u32 i = 0; i < rewind->stateSize; i++) {
+			rewind->delta[i] = rewind->state[i] ^ rewind->keyframe[i];
+		}
+		source = rewind->delta;
+	}
+	
+	u32 size = (u32)cmp_compress(source, rewind->stateSize, rewind->compressed, cmp_getBound(rewind->stateSize));
+	u32 offset = rwd_allocateEntry(rewind, size);
+	if (offset == rewind->ringSize) {
+		rewind->keyframeValid = FALSE;
+		return FALSE;
+	}
+	
+	/* making room might have dropped every entry, which changes the number this one gets */
+	number = rewind->firstEntry + rewind->entryCount;
+	if (!isKeyframe && !rewind->keyframeValid) {
+		/* the keyframe this was a delta against got dropped, so store the state whole instead */
+		memcpy(rewind->keyframe, rewind->state, rewind->stateSize);
+		isKeyframe = TRUE;
+		
+		size = (u32)cmp_compress(rewind->state, rewind->stateSize, rewind->compressed, cmp_getBound(rewind->stateSize));
+		offset = rwd_allocateEntry(rewind, size);
+		if (offset == rewind->ringSize) return FALSE;
+		number = rewind->firstEntry + rewind->entryCount;
+	}
+	
+	memcpy(rewind->ring + offset, rewind->compressed, size);
+	rewind->ringHead = offset + size;
+	rewind->bytesUsed += size;
+	
+	rwd_Entry *entry = rwd_getEntry(rewind, number);
+	entry->offset = offset;
+	entry->size = size;
+	
+	if (isKeyframe) {
+		entry->keyframe = number;
+		rewind->keyframeNumber = number;
+		rewind->keyframeValid = TRUE;
+		rewind->keyframeCount++;
+	}
+	else {
+		entry->keyframe = rewind->keyframeNumber;
+	}
+	
+	rewind->entryCount++;
+	rewind->lastCaptureMicroseconds = (u32)(rwd_getMicroseconds() - start);
+	
+	return TRUE;
+}
+
+bool rwd_stepBack(void) {
+	rwd_Rewind *rewind = &rwd_buffer;
+	if (rewind->ring == NULL || rewind->entryCount == 0) return FALSE;
+	
+	u64 start = rwd_getMicroseconds();
+	
+	u32 number = rewind->firstEntry + rewind->entryCount - 1;
+	rwd_Entry *entry = rwd_getEntry(rewind, number);
+	
+	/* the keyframe buffer usually holds the right keyframe already, unless this steps back past one */
+	if (!rewind->keyframeValid || rewind->keyframeNumber != entry->keyframe) {
+		rwd_Entry *keyframe = rwd_getEntry(rewind, entry->keyframe);
+		
+		if (cmp_decompress(rewind->ring + keyframe->offset, keyframe->size, rewind->keyframe, rewind->stateSize) != rewind->stateSize) {
+			return FALSE;
+		}
+		rewind->keyframeNumber = entry->keyframe;
+		rewind->keyframeValid = TRUE;
+	}
+	
+	if (entry->keyframe == number) {
+		memcpy(rewind->state, rewind->keyframe, rewind->stateSize);
+	}
+	else {
+		if (cmp_decompress(rewind->ring + entry->offset, entry->size, rewind->delta, rewind->stateSize) != rewind->stateSize) {
+			return FALSE;
+		}
+		for (u32 i = 0; i < rewind->stateSize; i++) {
+			rewind->state[i] = rewind->delta[i] ^ rewind->keyframe[i];
+		}
+	}
+	
+	if (!ldr_loadState(rewind->state, rewind->stateSize)) {
+		return FALSE;
+	}
+	
+	/* the next capture goes where this one was */
+	if (entry->keyframe == number) {
+		rewind->keyframeCount--;
+		rewind->keyframeValid = FALSE;
+	}
+	rewind->ringHead = entry->offset;
+	rewind->bytesUsed -= entry->size;
+	rewind->entryCount--;
+	rewind->framesUntilCapture = rewind->captureInterval - 1;
+	
+	rewind->lastRestoreMicroseconds = (u32)(rwd_getMicroseconds() - start);
+	return TRUE;
+}
+
+void rwd_getStats(rwd_Stats *stats) {
+	rwd_Rewind *rewind = &rwd_buffer;
+	
+	stats->entries = rewind->entryCount;
+	stats->keyframes = rewind->keyframeCount;
+	stats->bytesUsed = rewind->bytesUsed;
+	stats->bufferSize = rewind->ringSize;
+	stats->stateSize = rewind->stateSize;
+	
+	stats->framesOfHistory = rewind->entryCount * rewind->captureInterval;
+	stats->bytesPerSecond = stats->framesOfHistory ? (u32)((u64)rewind->bytesUsed * rwd_FRAMES_PER_SECOND / stats->framesOfHistory) : 0;
+	
+	stats->lastCaptureMicroseconds = rewind->lastCaptureMicroseconds;
+	stats->lastRestoreMicroseconds = rewind->lastRestoreMicroseconds;
+}
\ No newline at end of file
@@ -0,0 +1,58 @@
+/* Internal header file for Hexlet's rewind buffer */
+
+#ifndef HEXLET_RWD_H_INTERNAL
+#define HEXLET_RWD_H_INTERNAL
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+#include <hexlet_loader.h>
+#include <hexlet_rewind.h>
+
+/* Every part of the state goes into the rewind buffer */
+#define rwd_STATE_PARTS 0xff
+
+/* The buffer assumes states compress to at least this many bytes on average when deciding how many it can index */
+#define rwd_MIN_AVERAGE_ENTRY_SIZE 64
+
+#define rwd_FRAMES_PER_SECOND 60
+
+/*
+*  One captured state in the ring.
+*  Entries are numbered in capture order; the number wraps around, but only differences between numbers are ever used.
+*/
+typedef struct {
+	u32 offset;	/* where the compressed state starts in the ring */
+	u32 size;
+	u32 keyframe;	/* number of the keyframe this one is a delta against (itself if it's a keyframe) */
+} rwd_Entry;
+
+typedef struct {
+	u8 *ring;
+	u32 ringSize;
+	u32 ringHead;		/* where the next entry goes */
+	u32 bytesUsed;
+	
+	rwd_Entry *entries;
+	u32 entryCapacity;
+	u32 firstEntry;		/* number of the oldest entry */
+	u32 entryCount;
+	u32 keyframeCount;
+	
+	u8 captureInterval;
+	u8 keyframeInterval;
+	u8 framesUntilCapture;
+	
+	/* scratch buffers, each as big as a state (except compressed, which is as big as a compressed state can get) */
+	u32 stateSize;
+	u8 *state;
+	u8 *delta;
+	u8 *compressed;
+	u8 *keyframe;
+	u32 keyframeNumber;	/* which entry keyframe holds */
+	bool keyframeValid;
+	
+	u32 lastCaptureMicroseconds;
+	u32 lastRestoreMicroseconds;
+} rwd_Rewind;
+
+#endif
\ No newline at end of file
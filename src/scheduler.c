@@ -0,0 +1,110 @@
+/* Source file for Hexlet's event scheduler */
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+
+#include "scheduler.h"
+
+void sch_initScheduler(sch_Scheduler *scheduler) {
+	scheduler->now = 0;
+	scheduler->count = 0;
+	
+	for (u8 i = 0; i < sch_EVENT_TYPE_COUNT; i++) {
+		scheduler->position[i] = -1;
+	}
+}
+
+/*
+*  Put an event at the given heap index and remember where it went.
+*/
+static inline void sch_place(sch_Scheduler *scheduler, u8 index, sch_Event event) {
+	scheduler->heap[index] = event;
+	scheduler->position[event.type] = (s8)index;
+}
+
+static void sch_siftUp(sch_Scheduler *scheduler, u8 index) {
+	sch_Event event = scheduler->heap[index];
+	
+	while (index > 0) {
+		u8 parent = (index - 1) / 2;
+		if (scheduler->heap[parent].deadline <= event.deadline) break;
+		
+		sch_place(scheduler, index, scheduler->heap[parent]);
+		index = parent;
+	}
+	
+	sch_place(scheduler, index, event);
+}
+
+static void sch_siftDown(sch_Scheduler *scheduler, u8 index) {
+	sch_Event event = scheduler->heap[index];
+	
+	while (TRUE) {
+		u8 child = index * 2 + 1;
+		if (child >= scheduler->count) break;
+		
+		if (child + 1 < scheduler->count && scheduler->heap[child + 1].deadline < scheduler->heap[child].deadline) {
+			child++;
+		}
+		if (event.deadline <= scheduler->heap[child].deadline) break;
+		
+		sch_place(scheduler, index, scheduler->heap[child]);
+		index = child;
+	}
+	
+	sch_place(scheduler, index, event);
+}
+
+/*
+*  Take the event at the given heap index out of the heap.
+*/
+static void sch_remove(sch_Scheduler *scheduler, u8 index) {
+	scheduler->position[scheduler->heap[index].type] = -1;
+	scheduler->count--;
+	
+	if (index != scheduler->count) {
+		sch_place(scheduler, index, scheduler->heap[scheduler->count]);
+		sch_siftDown(scheduler, index);
+		sch_siftUp(scheduler, (u8)scheduler->position[scheduler->heap[index].type]);
+	}
+}
+
+void sch_schedule(sch_Scheduler *scheduler, sch_EventType type, u64 deadline, u32 data) {
+	sch_Event event;
+	event.deadline = deadline;
+	event.type = type;
+	event.data = data;
+	
+	if (scheduler->position[type] >= 0) {
+		u8 index = (u8)scheduler->position[type];
+		u64 oldDeadline = scheduler->heap[index].deadline;
+		
+		scheduler->heap[index] = event;
+		if (deadline < oldDeadline) sch_siftUp(scheduler, index);
+		else sch_siftDown(scheduler, index);
+	}
+	else {
+		scheduler->heap[scheduler->count] = event;
+		sch_siftUp(scheduler, scheduler->count++);
+	}
+}
+
+void sch_cancel(sch_Scheduler *scheduler, sch_EventType type) {
+	if (scheduler->position[type] >= 0) {
+		sch_remove(scheduler, (u8)scheduler->position[type]);
+	}
+}
+
+bool sch_isScheduled(sch_Scheduler *scheduler, sch_EventType type) {
+	return scheduler->position[type] >= 0;
+}
+
+bool sch_popDueEvent(sch_Scheduler *scheduler, sch_Event *event) {
+	if (scheduler->count == 0 || scheduler->heap[0].deadline > scheduler->now) {
+		return FALSE;
+	}
+	
+	*event = scheduler->heap[0];
+	sch_remove(scheduler, 0);
+	return TRUE;
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+/* Internal header file for Hexlet's event scheduler */
+
+#ifndef HEXLET_SCH_H_INTERNAL
+#define HEXLET_SCH_H_INTERNAL
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+
+/* Each kind of event can be pending at most once */
+typedef u8 sch_EventType;
+#define sch_EVENT_SCANLINE	0x00	/* the PPU finished a scanline */
+#define sch_EVENT_FRAME		0x01	/* the frame ended (the end of emu_tick()) */
+#define sch_EVENT_TIMER		0x02	/* a TMRAM timer ran out */
+#define sch_EVENT_DMA		0x03	/* a DMA transfer finished, so the CPU can run again */
+#define sch_EVENT_IRQ		0x04	/* an IRQ line changed level */
+
+#define sch_EVENT_TYPE_COUNT 5
+
+#define sch_NO_DEADLINE 0xffffffffffffffffULL
+
+typedef struct {
+	u64 deadline;	/* absolute cycle count */
+	sch_EventType type;
+	u32 data;	/* event-specific (e.g. the IRQ level) */
+} sch_Event;
+
+/*
+*  A binary min-heap of pending events ordered by deadline
+*/
+typedef struct {
+	u64 now;
+	u8 count;
+	sch_Event heap[sch_EVENT_TYPE_COUNT];
+	s8 position[sch_EVENT_TYPE_COUNT];	/* where each event type is in the heap, or -1 if it isn't pending */
+} sch_Scheduler;
+
+/*
+*  Empty the scheduler and set the current time to 0.
+*/
+void sch_initScheduler(sch_Scheduler *scheduler);
+
+/*
+*  Schedule an event at an absolute cycle count, replacing the pending event of the same type if there is one.
+*/
+void sch_schedule(sch_Scheduler *scheduler, sch_EventType type, u64 deadline, u32 data);
+
+/*
+*  Remove the pending event of the given type, if there is one.
+*/
+void sch_cancel(sch_Scheduler *scheduler, sch_EventType type);
+
+/*
+*  Return TRUE if an event of the given type is pending.
+*/
+bool sch_isScheduled(sch_Scheduler *scheduler, sch_EventType type);
+
+/*
+*  Return the deadline of the next pending event, or sch_NO_DEADLINE if nothing is pending.
+*/
+static inline u64 sch_getNextDeadline(sch_Scheduler *scheduler) {
+	return scheduler->count ? scheduler->heap[0].deadline : sch_NO_DEADLINE;
+}
+
+/*
+*  If the next event is due (its deadline is at or before the current time), remove it, copy it into event, and return TRUE.
+*/
+bool sch_popDueEvent(sch_Scheduler *scheduler, sch_Event *event);
+
+#endif
\ No newline at end of file
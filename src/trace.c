@@ -0,0 +1,159 @@
+/* Source file for Hexlet's bus trace recorder */
+
+#include <string.h>
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+#include <hexlet_driver.h>
+#include <hexlet_memory.h>
+
+#include "trace.h"
+
+bool trc_initRing(trc_Ring *ring, u8 sizeLog2) {
+	ring->mask = (1u << sizeLog2) - 1;
+	ring->head = 0;
+	ring->cachedTail = 0;
+	ring->overruns = 0;
+	ring->tail = 0;
+	ring->headerWritten = FALSE;
+	ring->lastCycle = 0;
+	ring->lastAddress = 0;
+	
+	ring->records = drv_reallocate(NULL, 0, (ring->mask + 1) * sizeof(mem_Transaction));
+	return ring->records != NULL;
+}
+
+void trc_freeRing(trc_Ring *ring) {
+	if (ring->records != NULL) {
+		drv_reallocate(ring->records, (ring->mask + 1) * sizeof(mem_Transaction), 0);
+		ring->records = NULL;
+	}
+}
+
+static inline u8 trc_getBusIndex(mem_BusType bus) {
+	if (bus == mem_BUS_TYPE_PPU) return 1;
+	if (bus == mem_BUS_TYPE_HEXRIDGE) return 2;
+	return 0;
+}
+
+static inline u8 *trc_putVarint(u8 *ptr, u64 value) {
+	while (value >= 0x80) {
+		*ptr++ = (u8)value | 0x80;
+		value >>= 7;
+	}
+	*ptr++ = (u8)value;
+	
+	return ptr;
+}
+
+size_t trc_drain(trc_Ring *ring, u8 *buffer, size_t size) {
+	u8 *ptr = buffer;
+	u8 *end = buffer + size;
+	
+	if (!ring->headerWritten) {
+		if (size < trc_HEADER_SIZE) return 0;
+		
+		memcpy(ptr, trc_MAGIC, trc_MAGIC_SIZE);
+		ptr[trc_MAGIC_SIZE] = trc_VERSION;
+		ptr += trc_HEADER_SIZE;
+		ring->headerWritten = TRUE;
+	}
+	
+	u32 tail = ring->tail;
+	u32 head = trc_LOAD_ACQUIRE(&ring->head);
+	
+	while (tail != head && end - ptr >= trc_MAX_ENCODED_SIZE) {
+		mem_Transaction *record = &ring->records[tail & ring->mask];
+		
+		u8 tag = trc_getBusIndex(record->bus);
+		if (record->write) tag |= trc_TAG_WRITE;
+		if (record->word) tag |= trc_TAG_WORD;
+		*ptr++ = tag;
+		
+		/* the deltas are taken mod 2^64 and 2^32, so records that come out of order still decode correctly */
+		ptr = trc_putVarint(ptr, record->cycle - ring->lastCycle);
+		
+		s32 addressDelta = (s32)(record->address - ring->lastAddress);
+		ptr = trc_putVarint(ptr, (u32)((addressDelta << 1) ^ (addressDelta >> 31)));
+		
+		*ptr++ = (u8)record->data;
+		if (tag & trc_TAG_WORD) *ptr++ = (u8)(record->data >> 8);
+		
+		ring->lastCycle = record->cycle;
+		ring->lastAddress = record->address;
+		tail++;
+	}
+	
+	/* hand the slots back to the emulator only after we're done reading them */
+	trc_STORE_RELEASE(&ring->tail, tail);
+	
+	return (size_t)(ptr - buffer);
+}
+
+size_t mem_checkTraceHeader(const u8 *data, size_t size) {
+	if (size < trc_HEADER_SIZE || memcmp(data, trc_MAGIC, trc_MAGIC_SIZE) || data[trc_MAGIC_SIZE] != trc_VERSION) {
+		return 0;
+	}
+	
+	return trc_HEADER_SIZE;
+}
+
+void mem_initTraceDecoder(mem_TraceDecoder *decoder) {
+	decoder->cycle = 0;
+	decoder->address = 0;
+}
+
+/*
+*  Read a varint, returning NULL if it runs past the end of the data.
+*/
+static const u8 *trc_getVarint(const u8 *ptr, const u8 *end, u64 *value) {
+	u64 result = 0;
+	
+	for (u8 shift = 0; ptr < end && shift < 64; shift += 7) {
+		u8 byte = *ptr++;
+		result |= (u64)(byte & 0x7f) << shift;
+		
+		if (!(byte & 0x80)) {
+			*value = result;
+			return ptr;
+		}
+	}
+	
+	return NULL;
+}
+
+size_t mem_decodeTrace(mem_TraceDecoder *decoder, const u8 *data, size_t size, mem_Transaction *transaction) {
+	static const mem_BusType buses[4] = {mem_BUS_TYPE_CPU, mem_BUS_TYPE_PPU, mem_BUS_TYPE_HEXRIDGE, 0};
+	
+	const u8 *ptr = data;
+	const u8 *end = data + size;
+	
+	if (ptr >= end) return 0;
+	u8 tag = *ptr++;
+	
+	u64 cycleDelta;
+	u64 zigzag;
+	
+	ptr = trc_getVarint(ptr, end, &cycleDelta);
+	if (ptr == NULL) return 0;
+	ptr = trc_getVarint(ptr, end, &zigzag);
+	if (ptr == NULL) return 0;
+	
+	if (end - ptr < ((tag & trc_TAG_WORD) ? 2 : 1)) return 0;
+	u16 value = *ptr++;
+	if (tag & trc_TAG_WORD) value |= *ptr++ << 8;
+	
+	s32 addressDelta = (s32)((u32)(zigzag >> 1) ^ -(u32)(zigzag & 1));
+	
+	decoder->cycle += cycleDelta;
+	decoder->address += (u32)addressDelta;
+	
+	transaction->cycle = decoder->cycle;
+	transaction->address = decoder->address;
+	transaction->data = value;
+	transaction->bus = buses[tag & trc_TAG_BUS_MASK];
+	transaction->write = (tag & trc_TAG_WRITE) != 0;
+	transaction->word = (tag & trc_TAG_WORD) != 0;
+	
+	return (size_t)(ptr - data);
+}
\ No newline at end of file
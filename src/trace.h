@@ -0,0 +1,108 @@
+/* Internal header file for Hexlet's bus trace recorder */
+
+#ifndef HEXLET_TRC_H_INTERNAL
+#define HEXLET_TRC_H_INTERNAL
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+#include <hexlet_memory.h>
+
+/*
+*  The ring is shared by exactly two threads: the emulator pushes records and one other thread drains them.
+*  Each index is only written by one side, so an acquire load and a release store per index are all the synchronization it needs.
+*/
+#if defined(__GNUC__) || defined(__clang__)
+#define trc_LOAD_ACQUIRE(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define trc_STORE_RELEASE(ptr, value) __atomic_store_n((ptr), (value), __ATOMIC_RELEASE)
+#else
+/* MSVC gives volatile accesses acquire/release semantics by default on x86 */
+#define trc_LOAD_ACQUIRE(ptr) (*(volatile u32 *)(ptr))
+#define trc_STORE_RELEASE(ptr, value) (*(volatile u32 *)(ptr) = (value))
+#endif
+
+/* File header for a trace file: the magic bytes followed by a version byte */
+#define trc_MAGIC "HXTR"
+#define trc_MAGIC_SIZE 4
+#define trc_VERSION 0x01
+#define trc_HEADER_SIZE (trc_MAGIC_SIZE + 1)
+
+/*
+*  Each record is encoded as:
+*  - a tag byte (bits 0-1: bus index, bit 2: write, bit 3: a 16-bit access)
+*  - the cycle delta from the previous record as an unsigned LEB128 varint
+*  - the address delta from the previous record, zigzag-encoded, as a varint
+*  - one or two little-endian data bytes
+*/
+#define trc_TAG_BUS_MASK	0x03
+#define trc_TAG_WRITE		0x04
+#define trc_TAG_WORD		0x08
+
+/* Host cache line size (a guess that's right for current x86 and ARM hosts) */
+#define trc_CACHE_LINE_SIZE 64
+
+/* An encoded record is never longer than this */
+#define trc_MAX_ENCODED_SIZE (1 + 10 + 5 + 2)
+
+typedef struct {
+	u32 mask;	/* capacity - 1 (the capacity is a power of 2) */
+	mem_Transaction *records;
+	
+	/* written only by the emulator (each side gets its own cache line so they don't keep stealing it from each other) */
+	u8 emulatorPadding[trc_CACHE_LINE_SIZE];
+	u32 head;
+	u32 cachedTail;	/* the last tail the emulator saw, so it only has to look at the real one when the ring seems full */
+	u32 overruns;
+	
+	/* written only by the draining thread */
+	u8 drainPadding[trc_CACHE_LINE_SIZE];
+	u32 tail;
+	bool headerWritten;
+	u64 lastCycle;
+	u32 lastAddress;
+} trc_Ring;
+
+/*
+*  Allocate a ring with room for 2^sizeLog2 records. Return FALSE on failure or TRUE on success.
+*/
+bool trc_initRing(trc_Ring *ring, u8 sizeLog2);
+
+/*
+*  Free the ring's records. Nothing may be pushing or draining while this runs.
+*/
+void trc_freeRing(trc_Ring *ring);
+
+/*
+*  Add a record to the ring (emulator thread only).
+*  If the draining thread has fallen behind and the ring is full, the record is dropped and counted instead of stalling emulation.
+*/
+static inline void trc_push(trc_Ring *ring, u64 cycle, mem_BusType bus, u32 address, u16 data, bool write, bool word) {
+	u32 head = ring->head;
+	
+	if (head - ring->cachedTail > ring->mask) {
+		ring->cachedTail = trc_LOAD_ACQUIRE(&ring->tail);
+		
+		if (head - ring->cachedTail > ring->mask) {
+			ring->overruns++;
+			return;
+		}
+	}
+	
+	mem_Transaction *record = &ring->records[head & ring->mask];
+	record->cycle = cycle;
+	record->address = address;
+	record->data = data;
+	record->bus = bus;
+	record->write = write;
+	record->word = word;
+	
+	trc_STORE_RELEASE(&ring->head, head + 1);
+}
+
+/*
+*  Delta-encode as many pending records as fit into the given buffer and take them off the ring (draining thread only).
+*  The first call after trc_initRing() starts with the file header.
+*  Return the number of bytes written.
+*/
+size_t trc_drain(trc_Ring *ring, u8 *buffer, size_t size);
+
+#endif
\ No newline at end of file
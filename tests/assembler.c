@@ -0,0 +1,47 @@
+/* Tests for the assembler and linker */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+#include <hexlet_assembler.h>
+#include <hexlet_loader.h>
+
+#include "tests.h"
+
+bool tst_assemblerRoundTrip(void) {
+	/* two objects, one referring to a .DEFINE in the other, linked into an image the loader has to read back as written */
+	static const char *sources[] = {
+		".HXH_TITLE \"Round Trip\"\n.HXH_AUTHOR \"Hexlet\"\nstart:\nNOP\n.DB value\n",
+		"far:\nHALT\n.DEFINE value $5A\n",
+	};
+	
+	asm_Object *objects[2];
+	for (u32 i = 0; i < 2; i++) {
+		objects[i] = asm_assembleObject(sources[i], NULL);
+	}
+	
+	bool linked = objects[0] != NULL && objects[1] != NULL && asm_linkObjects(objects, 2);
+	for (u32 i = 0; i < 2; i++) {
+		asm_freeObject(objects[i]);
+	}
+	
+	u32 length;
+	u8 *image = asm_getROMImage(&length);
+	if (!linked || image == NULL) {
+		fprintf(stderr, "The test ROM didn't link:\n%s", asm_getError());
+		return FALSE;
+	}
+	
+	ldr_ROMInfo info;
+	tst_CHECK(ldr_readROMInfo(image, &info));
+	tst_CHECK(!strcmp(info.title, "Round Trip"));
+	tst_CHECK(!strcmp(info.author, "Hexlet"));
+	
+	ldr_setLazyROMVerification(FALSE);
+	tst_CHECK(ldr_loadROMImage(image, length));
+	tst_CHECK(ldr_verifyROM());
+	
+	return TRUE;
+}
\ No newline at end of file
@@ -0,0 +1,30 @@
+/* Source file for the unit tests' stub driver: plain allocation and a screen the tests can look at */
+
+#include <stdlib.h>
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+#include <hexlet_driver.h>
+
+#include "tests.h"
+
+u8 tst_screen[256][256];
+u32 tst_plotCount;
+
+void *drv_reallocate(void *oldPtr, size_t oldSize, size_t newSize) {
+	(void)oldSize;
+	
+	if (newSize == 0) {
+		free(oldPtr);
+		return NULL;
+	}
+	
+	return realloc(oldPtr, newSize);
+}
+
+bool drv_plotPix(u8 x, u8 y, u8 intensity) {
+	tst_screen[y][x] = intensity & 0x0f;
+	tst_plotCount++;
+	
+	return TRUE;
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+/* Tests for the graphics engine */
+
+#include <string.h>
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+
+#include "graphics.h"
+
+#include "tests.h"
+
+bool tst_graphicsSpans(void) {
+	/* packed two to a byte, high nibble first, counting from the start of the span rather than from x */
+	static u8 data[128];
+	for (u32 i = 0; i < sizeof(data); i++) data[i] = (u8)(((i * 2) & 0x0f) << 4 | ((i * 2 + 1) & 0x0f));
+	
+	memset(tst_screen, 0xff, sizeof(tst_screen));
+	tst_plotCount = 0;
+	
+	/* an odd x and an odd length */
+	tst_CHECK(gfx_drawSpan(3, 10, 5, data));
+	tst_CHECK(tst_plotCount == 5);
+	for (u32 i = 0; i < 5; i++) tst_CHECK(tst_screen[10][3 + i] == i);
+	tst_CHECK(tst_screen[10][2] == 0xff);
+	tst_CHECK(tst_screen[10][8] == 0xff);
+	
+	/* a span running off the right edge is clipped there instead of wrapping around to x = 0 */
+	tst_plotCount = 0;
+	tst_CHECK(gfx_drawSpan(250, 20, 10, data));
+	tst_CHECK(tst_plotCount == 6);
+	for (u32 i = 0; i < 6; i++) tst_CHECK(tst_screen[20][250 + i] == i);
+	for (u32 x = 0; x < 4; x++) tst_CHECK(tst_screen[20][x] == 0xff);
+	
+	/* a whole row, and nothing at all */
+	tst_plotCount = 0;
+	tst_CHECK(gfx_drawSpan(0, 30, 256, data));
+	tst_CHECK(tst_plotCount == 256);
+	for (u32 x = 0; x < 256; x++) tst_CHECK(tst_screen[30][x] == (x & 0x0f));
+	
+	tst_plotCount = 0;
+	tst_CHECK(gfx_drawSpan(17, 40, 0, data));
+	tst_CHECK(gfx_drawSpan(255, 40, 300, data));
+	tst_CHECK(tst_plotCount == 1);
+	tst_CHECK(tst_screen[40][255] == 0);
+	tst_CHECK(tst_screen[40][17] == 0xff);
+	
+	return TRUE;
+}
\ No newline at end of file
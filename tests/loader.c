@@ -0,0 +1,136 @@
+/* Tests for the ROM image and state loader */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+#include <hexlet_loader.h>
+
+#include "loader.h"
+#include "memory.h"
+#include "pilot.h"
+
+#include "tests.h"
+
+#define tst_STATE_PARTS (ldr_STATE_FILE_FLAG_STORE_WRAM | ldr_STATE_FILE_FLAG_STORE_VRAM | ldr_STATE_FILE_FLAG_STORE_TMRAM | ldr_STATE_FILE_FLAG_STORE_HRAM | ldr_STATE_FILE_FLAG_STORE_CPU)
+
+/* Where the image's header keeps the ROM size, and where the ROM chunk's length starts */
+#define tst_HEADER_ROM_SIZE 0xf0
+#define tst_ROM_CHUNK_LENGTH 256
+
+bool tst_loaderSnapshot(void) {
+	/* leave an ADD's flags pending, so the snapshot has to work them out just like a live save */
+	static const u16 program[] = {
+		tst_MOV(tst_RM_REG(0), tst_RM_IMM16), 0xfffe,
+		tst_ADD(tst_RM_REG(0), tst_RM_IMM4(3)),
+		tst_HALT,
+	};
+	
+	tst_CHECK(tst_loadProgram(0x001000, program, 4));
+	cpu_Pilot *pilot = cpu_getCurrentPilot();
+	mem_Memory *memory = mem_getCurrentMemory();
+	
+	cpu_runPilot(pilot, memory, 100);
+	mem_writeByte(memory, mem_BUS_TYPE_CPU, mem_VRAM_START + 0x123, 0x45);
+	mem_writeByte(memory, mem_BUS_TYPE_CPU, mem_TMRAM_START + 0x67, 0x89);
+	mem_writeWord(memory, mem_BUS_TYPE_CPU, mem_HRAM_START + 0xa0, 0xbcde);
+	
+	u32 size = ldr_getStateSize(tst_STATE_PARTS);
+	u8 *live = malloc(size);
+	u8 *saved = malloc(size);
+	ldr_Snapshot *snapshot = ldr_createSnapshot();
+	tst_CHECK(live != NULL && saved != NULL && snapshot != NULL);
+	
+	tst_CHECK(ldr_saveState(live, size, tst_STATE_PARTS));
+	ldr_takeSnapshot(snapshot);
+	
+	/* nothing that changes after the snapshot is taken may show up in it */
+	mem_writeWord(memory, mem_BUS_TYPE_CPU, 0x002000, 0x1111);
+	mem_writeByte(memory, mem_BUS_TYPE_CPU, mem_VRAM_START + 0x123, 0x22);
+	pilot->regs[0] = 0x333333;
+	cpu_setStatusReg(pilot, 0x0700);
+	
+	tst_CHECK(ldr_saveSnapshot(snapshot, saved, size, tst_STATE_PARTS, FALSE) == size);
+	tst_CHECK(!memcmp(live + ldr_STATE_HEADER_SIZE, saved + ldr_STATE_HEADER_SIZE, size - ldr_STATE_HEADER_SIZE));
+	
+	tst_CHECK(ldr_loadState(saved, size));
+	tst_CHECK(pilot->regs[0] == 0x000001);
+	tst_CHECK(cpu_getStatusReg(pilot) == (cpu_FLAG_CARRY | cpu_FLAG_EXTEND));
+	tst_CHECK(mem_readByte(memory, mem_BUS_TYPE_CPU, mem_VRAM_START + 0x123) == 0x45);
+	
+	/* the snapshot is the RAM and the CPU, not the page tables that come with mem_Memory */
+	tst_CHECK(sizeof(ldr_Snapshot) < sizeof(mem_Memory));
+	
+	ldr_freeSnapshot(snapshot);
+	free(saved);
+	free(live);
+	return TRUE;
+}
+
+bool tst_loaderROMImage(void) {
+	static const u16 code[] = { tst_MOV(tst_RM_REG(0), tst_RM_IMM4(1)), tst_HALT };
+	static u8 corrupted[256 + 3 + 0x10000];
+	
+	ldr_setLazyROMVerification(FALSE);
+	
+	u32 length;
+	u8 *image = tst_loadROM(code, 2, &length);
+	tst_CHECK(image != NULL);
+	tst_CHECK(ldr_verifyROM());
+	
+	ldr_ROMInfo info;
+	tst_CHECK(ldr_readROMInfo(image, &info));
+	tst_CHECK(!strcmp(info.title, "Hexlet Tests"));
+	tst_CHECK(!strcmp(info.author, "Hexlet"));
+	tst_CHECK(info.romSize == 1);
+	
+	tst_CHECK(ldr_loadROMImage(image, 0));
+	tst_CHECK(!ldr_loadROMImage(image, length - 1));
+	tst_CHECK(!ldr_loadROMImage(image, 255));
+	
+	tst_CHECK(length <= sizeof(corrupted));
+	memcpy(corrupted, image, length);
+	corrupted[length - 1] ^= 0xff;
+	tst_CHECK(!ldr_loadROMImage(corrupted, length));
+	
+	/* the failed loads mustn't have touched the ROM that did load */
+	tst_CHECK(ldr_verifyROM());
+	tst_CHECK(mem_readWord(mem_getCurrentMemory(), mem_BUS_TYPE_CPU, 0xff0000) == code[0]);
+	
+	/* with lazy verification, the bad image loads and it's up to ldr_verifyROM() to catch it */
+	ldr_setLazyROMVerification(TRUE);
+	tst_CHECK(ldr_loadROMImage(corrupted, length));
+	tst_CHECK(!ldr_verifyROM());
+	ldr_setLazyROMVerification(FALSE);
+	
+	return TRUE;
+}
+
+bool tst_loaderROMSize(void) {
+	static const u16 code[] = { tst_HALT };
+	
+	u32 length;
+	u8 *image = tst_loadROM(code, 1, &length);
+	tst_CHECK(image != NULL);
+	
+	/* $DF banks reach down to $210000, and one more would cover the handler banks */
+	image[tst_HEADER_ROM_SIZE] = ldr_MAX_ROM_BANKS;
+	tst_CHECK(ldr_loadROMImage(image, length));
+	
+	image[tst_HEADER_ROM_SIZE] = ldr_MAX_ROM_BANKS + 1;
+	tst_CHECK(!ldr_loadROMImage(image, length));
+	
+	image[tst_HEADER_ROM_SIZE] = 1;
+	tst_CHECK(ldr_loadROMImage(image, length));
+	
+	/* with no length to check it against, the ROM chunk's own length has to be checked before the CRC reads that far */
+	image[tst_ROM_CHUNK_LENGTH] = 0x00;
+	image[tst_ROM_CHUNK_LENGTH + 1] = 0x00;
+	image[tst_ROM_CHUNK_LENGTH + 2] = ldr_MAX_ROM_BANKS + 1;
+	tst_CHECK(!ldr_loadROMImage(image, 0));
+	
+	/* and the ROM that loaded last is still there */
+	tst_CHECK(ldr_verifyROM());
+	return TRUE;
+}
\ No newline at end of file
@@ -0,0 +1,123 @@
+/* Main source file for Hexlet's unit tests: runs the test named on the command line (CTest runs each one on its own) */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+#include <hexlet_loader.h>
+
+#include "crc.h"
+#include "loader.h"
+#include "memory.h"
+#include "pilot.h"
+
+#include "tests.h"
+
+/* Where tst_loadROM() builds its image: the header, the ROM chunk's length, and 64 KiB of ROM */
+#define tst_ROM_SIZE 0x10000
+#define tst_IMAGE_SIZE (256 + 3 + tst_ROM_SIZE)
+
+typedef struct {
+	const char *name;
+	bool (*run)(void);
+} tst_Test;
+
+static const tst_Test tst_tests[] = {
+	{ "pilot_block_split",		tst_pilotBlockSplit },
+	{ "pilot_boot_rom",		tst_pilotBootROM },
+	{ "pilot_wram_invalidation",	tst_pilotWRAMInvalidation },
+	{ "pilot_isa",			tst_pilotISA },
+	{ "pilot_jit",			tst_pilotJIT },
+	{ "pilot_lazy_flags",		tst_pilotLazyFlags },
+	{ "pilot_idle_loops",		tst_pilotIdleLoops },
+	{ "memory_handlers",		tst_memoryHandlers },
+	{ "trace_round_trip",		tst_traceRoundTrip },
+	{ "loader_snapshot",		tst_loaderSnapshot },
+	{ "loader_rom_image",		tst_loaderROMImage },
+	{ "loader_rom_size",		tst_loaderROMSize },
+	{ "rewind_step_back",		tst_rewindStepBack },
+	{ "graphics_spans",		tst_graphicsSpans },
+	{ "assembler_round_trip",	tst_assemblerRoundTrip },
+};
+
+#define tst_TEST_COUNT (sizeof(tst_tests) / sizeof(tst_Test))
+
+static bool tst_pilotInitialized = FALSE;
+static u8 tst_image[tst_IMAGE_SIZE];
+
+bool tst_loadProgram(u32 address, const u16 *words, u32 count) {
+	cpu_Pilot *pilot = cpu_getCurrentPilot();
+	mem_Memory *memory = mem_getCurrentMemory();
+	
+	if (tst_pilotInitialized) {
+		cpu_freePilot(pilot);
+	}
+	
+	mem_initMemory(memory);
+	memset(memory->wram, 0, sizeof(memory->wram));
+	memset(memory->vram, 0, sizeof(memory->vram));
+	memset(memory->tmram, 0, sizeof(memory->tmram));
+	memset(memory->hram, 0, sizeof(memory->hram));
+	
+	tst_pilotInitialized = cpu_initPilot(pilot);
+	if (!tst_pilotInitialized) {
+		return FALSE;
+	}
+	
+	for (u8 i = 0; i < 8; i++) pilot->regs[i] = 0;
+	cpu_setStatusReg(pilot, 0x0000);
+	pilot->programCounter = address;
+	
+	for (u32 i = 0; i < count; i++) {
+		mem_writeWord(memory, mem_BUS_TYPE_CPU, address + i * 2, words[i]);
+	}
+	
+	return TRUE;
+}
+
+u8 *tst_loadROM(const u16 *words, u32 count, u32 *length) {
+	u8 *rom = tst_image + 256 + 3;
+	memset(tst_image, 0, sizeof(tst_image));
+	
+	strcpy((char *)tst_image, "Hexlet Tests");
+	strcpy((char *)tst_image + 128, "Hexlet");
+	memcpy(tst_image + 224, ldr_ROM_IMAGE_MAGIC, 16);
+	tst_image[0xf0] = tst_ROM_SIZE >> 16;
+	
+	tst_image[256] = (u8)tst_ROM_SIZE;
+	tst_image[257] = (u8)(tst_ROM_SIZE >> 8);
+	tst_image[258] = (u8)(tst_ROM_SIZE >> 16);
+	
+	for (u32 i = 0; i < count; i++) {
+		rom[i * 2] = (u8)words[i];
+		rom[i * 2 + 1] = (u8)(words[i] >> 8);
+	}
+	
+	crc_initTables();
+	u16 crc = crc_getCRC16(0, rom, tst_ROM_SIZE);
+	tst_image[0xfe] = (u8)crc;
+	tst_image[0xff] = (u8)(crc >> 8);
+	
+	*length = tst_IMAGE_SIZE;
+	return ldr_loadROMImage(tst_image, tst_IMAGE_SIZE) ? tst_image : NULL;
+}
+
+int main(int argc, char **argv) {
+	if (argc != 2) {
+		fprintf(stderr, "Usage: %s <test>\n\nTests:\n", argv[0]);
+		for (u32 i = 0; i < tst_TEST_COUNT; i++) fprintf(stderr, "  %s\n", tst_tests[i].name);
+		return -1;
+	}
+	
+	for (u32 i = 0; i < tst_TEST_COUNT; i++) {
+		if (strcmp(argv[1], tst_tests[i].name)) continue;
+		
+		bool passed = tst_tests[i].run();
+		printf("%s %s\n", tst_tests[i].name, passed ? "passed" : "FAILED");
+		return passed ? 0 : -1;
+	}
+	
+	fprintf(stderr, "Error: There's no test called '%s'.\n", argv[1]);
+	return -1;
+}
\ No newline at end of file
@@ -0,0 +1,111 @@
+/* Tests for the memory map */
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+
+#include "memory.h"
+
+#include "tests.h"
+
+/* One handler range in empty space and one at the start of the ROM's last bank (the boot ROM's bank) */
+#define tst_LOW_HANDLERS	0x020000
+#define tst_HIGH_HANDLERS	0xff8000
+#define tst_HANDLER_RANGE	0x000100
+
+static u32 tst_handlerReads;
+static u32 tst_handlerWrites;
+static u32 tst_lastWriteAddress;
+static u8 tst_lastWriteValue;
+
+static u8 tst_rom[0x20000];
+static u8 tst_bootROM[0x200];
+
+static u8 tst_readHandler(mem_Memory *memory, u32 address) {
+	(void)memory;
+	
+	tst_handlerReads++;
+	return (u8)(address ^ 0x5a);
+}
+
+static void tst_writeHandler(mem_Memory *memory, u32 address, u8 value) {
+	(void)memory;
+	
+	tst_handlerWrites++;
+	tst_lastWriteAddress = address;
+	tst_lastWriteValue = value;
+}
+
+/*
+*  Check that both handler ranges (and nothing just past them) still reach the handlers.
+*/
+static bool tst_checkHandlers(mem_Memory *memory) {
+	static const u32 starts[] = { tst_LOW_HANDLERS, tst_HIGH_HANDLERS };
+	
+	for (u32 i = 0; i < 2; i++) {
+		u32 reads = tst_handlerReads;
+		u32 writes = tst_handlerWrites;
+		u32 start = starts[i];
+		
+		tst_CHECK(mem_readByte(memory, mem_BUS_TYPE_CPU, start) == (u8)(start ^ 0x5a));
+		tst_CHECK(mem_readByte(memory, mem_BUS_TYPE_CPU, start + tst_HANDLER_RANGE - 1) == (u8)((start + tst_HANDLER_RANGE - 1) ^ 0x5a));
+		tst_CHECK(tst_handlerReads == reads + 2);
+		
+		mem_writeByte(memory, mem_BUS_TYPE_CPU, start + 0x20, 0xa5);
+		tst_CHECK(tst_handlerWrites == writes + 1);
+		tst_CHECK(tst_lastWriteAddress == start + 0x20);
+		tst_CHECK(tst_lastWriteValue == 0xa5);
+		
+		mem_readByte(memory, mem_BUS_TYPE_CPU, start + tst_HANDLER_RANGE);
+		mem_writeByte(memory, mem_BUS_TYPE_CPU, start + tst_HANDLER_RANGE, 0xa5);
+		tst_CHECK(tst_handlerReads == reads + 2);
+		tst_CHECK(tst_handlerWrites == writes + 1);
+	}
+	
+	return TRUE;
+}
+
+bool tst_memoryHandlers(void) {
+	for (u32 i = 0; i < sizeof(tst_rom); i++) tst_rom[i] = (u8)(i * 7 + (i >> 8));
+	for (u32 i = 0; i < sizeof(tst_bootROM); i++) tst_bootROM[i] = 0xb0;
+	
+	mem_Memory *memory = mem_getCurrentMemory();
+	mem_initMemory(memory);
+	
+	tst_CHECK(mem_mapHandlers(memory, tst_LOW_HANDLERS, tst_LOW_HANDLERS + tst_HANDLER_RANGE, tst_readHandler, tst_writeHandler));
+	tst_CHECK(mem_mapHandlers(memory, tst_HIGH_HANDLERS, tst_HIGH_HANDLERS + tst_HANDLER_RANGE, tst_readHandler, tst_writeHandler));
+	tst_CHECK(!mem_mapHandlers(memory, 0x030000, 0x030000, tst_readHandler, tst_writeHandler));
+	tst_CHECK(tst_checkHandlers(memory));
+	
+	/* remapping the ROM rebuilds the ROM's tables, which mustn't lose the handlers patched into them */
+	mem_mapROM(memory, tst_rom, sizeof(tst_rom));
+	tst_CHECK(tst_checkHandlers(memory));
+	tst_CHECK(mem_readByte(memory, mem_BUS_TYPE_CPU, 0xfe0000) == tst_rom[0]);
+	tst_CHECK(mem_readByte(memory, mem_BUS_TYPE_CPU, 0xff7fff) == tst_rom[0x17fff]);
+	tst_CHECK(mem_readByte(memory, mem_BUS_TYPE_CPU, 0xff8100) == tst_rom[0x18100]);
+	
+	/* and so does switching the boot ROM in and out over the last bank */
+	memory->bootRom = tst_bootROM;
+	memory->bootRomLength = sizeof(tst_bootROM);
+	
+	mem_setBootRomLock(memory, FALSE);
+	tst_CHECK(tst_checkHandlers(memory));
+	tst_CHECK(mem_readByte(memory, mem_BUS_TYPE_CPU, mem_BOOT_ROM_START) == 0xb0);
+	tst_CHECK(mem_readByte(memory, mem_BUS_TYPE_CPU, mem_BOOT_ROM_START + 0x1ff) == 0xb0);
+	tst_CHECK(mem_readByte(memory, mem_BUS_TYPE_CPU, mem_BOOT_ROM_START + 0x200) == tst_rom[0x10200]);
+	
+	mem_setBootRomLock(memory, TRUE);
+	tst_CHECK(tst_checkHandlers(memory));
+	tst_CHECK(mem_readByte(memory, mem_BUS_TYPE_CPU, mem_BOOT_ROM_START) == tst_rom[0x10000]);
+	
+	/* a ROM starting partway through the last bank gets a table of its own */
+	mem_mapROM(memory, tst_rom, 0x8000);
+	tst_CHECK(tst_checkHandlers(memory));
+	tst_CHECK(mem_readByte(memory, mem_BUS_TYPE_CPU, 0xff8100) == tst_rom[0x100]);
+	
+	mem_setBootRomLock(memory, FALSE);
+	tst_CHECK(tst_checkHandlers(memory));
+	
+	memory->bootRom = NULL;
+	memory->bootRomLength = 0;
+	return TRUE;
+}
\ No newline at end of file
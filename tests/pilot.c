@@ -0,0 +1,403 @@
+/* Tests for the Pilot CPU emulator */
+
+#include <string.h>
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+
+#include "memory.h"
+#include "pilot.h"
+
+#include "tests.h"
+
+/* A PGC-relative extension word at word index from, pointing at word index to */
+#define tst_REL(from, to) ((u16)(((to) - (from)) * 2))
+
+/* Where the programs go in WRAM (out of the way of the data they write) */
+#define tst_CODE_START 0x001000
+#define tst_DATA_START 0x002000
+
+/* Every slot the state is compared at in the JIT test */
+#define tst_MAX_CHUNKS 4096
+
+static cpu_Block *tst_getBlock(cpu_Pilot *pilot, u32 address) {
+	return &pilot->blockCache->blocks[(address >> 1) & (cpu_BLOCK_CACHE_SIZE - 1)];
+}
+
+bool tst_pilotBlockSplit(void) {
+	/* 30 NOPs from $0000D0 then a HALT: a full block, one cut short by the code page ending at $000100, and the rest */
+	u16 program[31];
+	for (u32 i = 0; i < 30; i++) program[i] = tst_NOP;
+	program[30] = tst_HALT;
+	
+	tst_CHECK(tst_loadProgram(0x0000d0, program, 31));
+	cpu_Pilot *pilot = cpu_getCurrentPilot();
+	
+	tst_CHECK(cpu_runPilot(pilot, mem_getCurrentMemory(), 31) == 31);
+	tst_CHECK(pilot->halted);
+	tst_CHECK(pilot->programCounter == 0x00010e);
+	
+	cpu_Block *block = tst_getBlock(pilot, 0x0000d0);
+	tst_CHECK(block->startAddress == 0x0000d0);
+	tst_CHECK(block->instructionCount == cpu_MAX_BLOCK_INSTRUCTIONS);
+	tst_CHECK(block->cycles == cpu_MAX_BLOCK_INSTRUCTIONS);
+	
+	block = tst_getBlock(pilot, 0x0000f0);
+	tst_CHECK(block->startAddress == 0x0000f0);
+	tst_CHECK(block->instructionCount == 8);
+	
+	block = tst_getBlock(pilot, 0x000100);
+	tst_CHECK(block->startAddress == 0x000100);
+	tst_CHECK(block->instructionCount == 7);
+	tst_CHECK(block->instructions[6].operation == cpu_OP_HALT);
+	
+	return TRUE;
+}
+
+bool tst_pilotBootROM(void) {
+	/* the boot ROM sets W0 and the cartridge ROM underneath it (one bank, so it starts at $FF0000) sets W1 */
+	static u8 cartridge[0x10000];
+	cartridge[0] = (u8)tst_MOV(tst_RM_REG(1), tst_RM_IMM4(2));
+	cartridge[1] = (u8)(tst_MOV(tst_RM_REG(1), tst_RM_IMM4(2)) >> 8);
+	cartridge[2] = (u8)tst_HALT;
+	cartridge[3] = 0;
+	
+	static u8 bootROM[mem_PAGE_SIZE];
+	bootROM[0] = (u8)tst_MOV(tst_RM_REG(0), tst_RM_IMM4(1));
+	bootROM[1] = (u8)(tst_MOV(tst_RM_REG(0), tst_RM_IMM4(1)) >> 8);
+	bootROM[2] = (u8)tst_HALT;
+	bootROM[3] = 0;
+	
+	mem_Memory *memory = mem_getCurrentMemory();
+	mem_mapROM(memory, cartridge, sizeof(cartridge));
+	memory->bootRom = bootROM;
+	memory->bootRomLength = sizeof(bootROM);
+	memory->bootRomLock = FALSE;
+	
+	tst_CHECK(tst_loadProgram(mem_BOOT_ROM_START, NULL, 0));
+	cpu_Pilot *pilot = cpu_getCurrentPilot();
+	
+	cpu_runPilot(pilot, memory, 100);
+	tst_CHECK(pilot->halted);
+	tst_CHECK(pilot->regs[0] == 1);
+	tst_CHECK(pilot->regs[1] == 0);
+	tst_CHECK(tst_getBlock(pilot, mem_BOOT_ROM_START)->startAddress == cpu_NO_BLOCK);
+	
+	/* once the boot ROM is locked, the same address has to run the cartridge's code, not a leftover boot ROM block */
+	mem_setBootRomLock(memory, TRUE);
+	pilot->halted = FALSE;
+	pilot->programCounter = mem_BOOT_ROM_START;
+	
+	cpu_runPilot(pilot, memory, 100);
+	tst_CHECK(pilot->halted);
+	tst_CHECK(pilot->regs[1] == 2);
+	tst_CHECK(tst_getBlock(pilot, mem_BOOT_ROM_START)->startAddress == mem_BOOT_ROM_START);
+	
+	memory->bootRom = NULL;
+	memory->bootRomLength = 0;
+	return TRUE;
+}
+
+bool tst_pilotWRAMInvalidation(void) {
+	static const u16 program[] = { tst_MOV(tst_RM_REG(0), tst_RM_IMM4(1)), tst_HALT };
+	
+	tst_CHECK(tst_loadProgram(tst_CODE_START, program, 2));
+	cpu_Pilot *pilot = cpu_getCurrentPilot();
+	mem_Memory *memory = mem_getCurrentMemory();
+	
+	cpu_runPilot(pilot, memory, 100);
+	tst_CHECK(pilot->regs[0] == 1);
+	
+	cpu_Block *block = tst_getBlock(pilot, tst_CODE_START);
+	tst_CHECK(block->startAddress == tst_CODE_START);
+	u32 generation = block->generation;
+	
+	/* rewriting the code through the bus makes the cached block stale */
+	mem_writeWord(memory, mem_BUS_TYPE_CPU, tst_CODE_START, tst_MOV(tst_RM_REG(0), tst_RM_IMM4(7)));
+	pilot->halted = FALSE;
+	pilot->programCounter = tst_CODE_START;
+	
+	cpu_runPilot(pilot, memory, 100);
+	tst_CHECK(pilot->regs[0] == 7);
+	tst_CHECK(block->generation != generation);
+	
+	/* a block that overwrites its own next instruction has to stop and run the new one */
+	static const u16 selfModifying[] = {
+		tst_MOV(tst_RM_INDIRECT(1), tst_RM_REG(2)),
+		tst_MOV(tst_RM_REG(0), tst_RM_IMM4(1)),
+		tst_HALT,
+	};
+	
+	tst_CHECK(tst_loadProgram(tst_CODE_START, selfModifying, 3));
+	pilot->regs[1] = tst_CODE_START + 2;
+	pilot->regs[2] = tst_MOV(tst_RM_REG(0), tst_RM_IMM4(5));
+	
+	cpu_runPilot(pilot, memory, 100);
+	tst_CHECK(pilot->halted);
+	tst_CHECK(pilot->regs[0] == 5);
+	
+	return TRUE;
+}
+
+bool tst_pilotISA(void) {
+	/* add up 10 to 1 into W0, storing each running total at P1, then load a 16-bit immediate and a PGC-relative word */
+	static const u16 program[] = {
+		tst_MOV(tst_RM_REG(0), tst_RM_IMM4(0)),
+		tst_MOV(tst_RM_REG(2), tst_RM_IMM4(10)),
+		tst_ADD(tst_RM_REG(0), tst_RM_REG(2)),		/* 2: loop */
+		tst_MOV(tst_RM_POST_INCREMENT(1), tst_RM_REG(0)),
+		tst_SUB(tst_RM_REG(2), tst_RM_IMM4(1)),
+		tst_BNE(tst_RM_PGC16), tst_REL(6, 2),
+		tst_MOV(tst_RM_REG(3), tst_RM_IMM16), 0x3456,
+		tst_MOV(tst_RM_REG(4), tst_RM_PGC16), tst_REL(10, 12),
+		tst_HALT,
+		0xbeef,
+	};
+	static const u16 totals[] = { 10, 19, 27, 34, 40, 45, 49, 52, 54, 55 };
+	
+	tst_CHECK(tst_loadProgram(tst_CODE_START, program, sizeof(program) / sizeof(u16)));
+	cpu_Pilot *pilot = cpu_getCurrentPilot();
+	mem_Memory *memory = mem_getCurrentMemory();
+	
+	pilot->regs[1] = tst_DATA_START;
+	pilot->regs[3] = 0x120000;
+	
+	cpu_runPilot(pilot, memory, 1000);
+	tst_CHECK(pilot->halted);
+	tst_CHECK(pilot->programCounter == tst_CODE_START + 12 * 2);
+	
+	tst_CHECK(pilot->regs[0] == 55);
+	tst_CHECK(pilot->regs[1] == tst_DATA_START + 10 * 2);
+	tst_CHECK(pilot->regs[2] == 0);
+	tst_CHECK(pilot->regs[3] == 0x123456);
+	tst_CHECK(pilot->regs[4] == 0xbeef);
+	tst_CHECK(cpu_getStatusReg(pilot) & cpu_FLAG_ZERO);
+	
+	for (u32 i = 0; i < 10; i++) {
+		tst_CHECK(mem_readWord(memory, mem_BUS_TYPE_CPU, tst_DATA_START + i * 2) == totals[i]);
+	}
+	
+	return TRUE;
+}
+
+/*
+*  The registers, flags and program counter the JIT test compares after each slice of cycles
+*/
+typedef struct {
+	u32 regs[8];
+	u16 statusReg;
+	u32 programCounter;
+	u64 cycles;
+} tst_PilotState;
+
+static tst_PilotState tst_states[tst_MAX_CHUNKS];
+static u16 tst_wram[mem_WRAM_SIZE / 2];
+
+/*
+*  Run the JIT test's program in slices of an odd number of cycles, until it halts.
+*  With compare set, check every slice ends in the same state as last time. Return the number of slices, or 0 on a mismatch.
+*/
+static u32 tst_runSlices(cpu_Pilot *pilot, mem_Memory *memory, bool compare) {
+	u32 chunk = 0;
+	
+	while (!pilot->halted && chunk < tst_MAX_CHUNKS) {
+		cpu_runPilot(pilot, memory, 97);
+		
+		tst_PilotState state;
+		memcpy(state.regs, pilot->regs, sizeof(state.regs));
+		state.statusReg = cpu_getStatusReg(pilot);
+		state.programCounter = pilot->programCounter;
+		state.cycles = pilot->cycles;
+		
+		if (compare && memcmp(&state, &tst_states[chunk], sizeof(tst_PilotState))) {
+			fprintf(stderr, "The runs went different ways in slice %u (PC $%06X vs $%06X).\n", chunk, state.programCounter, tst_states[chunk].programCounter);
+			return 0;
+		}
+		
+		tst_states[chunk++] = state;
+	}
+	
+	return chunk;
+}
+
+bool tst_pilotJIT(void) {
+	/* a loop of ALU instructions between registers and immediates with every kind of branch, and a store the recompiler can't do */
+	static const u16 program[] = {
+		tst_MOV(tst_RM_REG(0), tst_RM_IMM4(0)),
+		tst_MOV(tst_RM_REG(1), tst_RM_IMM16), 0x1234,
+		tst_MOV(tst_RM_REG(2), tst_RM_IMM16), 600,
+		tst_MOV(tst_RM_REG(3), tst_RM_IMM4(0)),
+		tst_MOV(tst_RM_REG(5), tst_RM_IMM16), tst_DATA_START,
+		tst_ADD(tst_RM_REG(0), tst_RM_REG(1)),			/* 8: loop */
+		tst_BCC(tst_RM_PGC16), tst_REL(10, 12),
+		tst_ADD(tst_RM_REG(3), tst_RM_IMM4(1)),
+		tst_XOR(tst_RM_REG(1), tst_RM_REG(0)),			/* 12 */
+		tst_ADD(tst_RM_REG(1), tst_RM_IMM16), 0x9e37,
+		tst_BPL(tst_RM_PGC16), tst_REL(16, 19),
+		tst_SUB(tst_RM_REG(3), tst_RM_IMM16), 3,
+		tst_SUB(tst_RM_REG(4), tst_RM_REG(1)),			/* 19 */
+		tst_BVC(tst_RM_PGC16), tst_REL(21, 24),
+		tst_OR(tst_RM_REG(3), tst_RM_IMM16), 0x0100,
+		tst_AND(tst_RM_REG(0), tst_RM_IMM16), 0x7fff,		/* 24 */
+		tst_BNE(tst_RM_PGC16), tst_REL(27, 29),
+		tst_ADD(tst_RM_REG(3), tst_RM_REG(0)),
+		tst_CMP(tst_RM_REG(1), tst_RM_REG(4)),			/* 29 */
+		tst_BCS(tst_RM_PGC16), tst_REL(31, 33),
+		tst_XOR(tst_RM_REG(3), tst_RM_REG(1)),
+		tst_CMP(tst_RM_REG(4), tst_RM_REG(0)),			/* 33 */
+		tst_BMI(tst_RM_PGC16), tst_REL(35, 37),
+		tst_SUB(tst_RM_REG(3), tst_RM_REG(4)),
+		tst_ADD(tst_RM_REG(6), tst_RM_REG(0)),			/* 37 */
+		tst_BVS(tst_RM_PGC16), tst_REL(39, 41),
+		tst_ADD(tst_RM_REG(6), tst_RM_IMM4(1)),
+		tst_MOV(tst_RM_REG(7), tst_RM_REG(1)),			/* 41 */
+		tst_CMP(tst_RM_REG(7), tst_RM_REG(1)),
+		tst_BEQ(tst_RM_PGC16), tst_REL(44, 46),
+		tst_HALT,
+		tst_MOV(tst_RM_POST_INCREMENT(5), tst_RM_REG(3)),	/* 46 */
+		tst_SUB(tst_RM_REG(2), tst_RM_IMM4(1)),
+		tst_BNE(tst_RM_PGC16), tst_REL(49, 8),
+		tst_MOV(tst_RM_REG(7), tst_RM_IMM16), tst_CODE_START + 54 * 2,
+		tst_BRA(tst_RM_REG(7)),
+		tst_HALT,
+		tst_HALT,						/* 54 */
+	};
+	u32 count = sizeof(program) / sizeof(u16);
+	
+	tst_CHECK(tst_loadProgram(tst_CODE_START, program, count));
+	cpu_Pilot *pilot = cpu_getCurrentPilot();
+	mem_Memory *memory = mem_getCurrentMemory();
+	
+	tst_CHECK(cpu_setJITEnabled(pilot, TRUE));
+	u32 chunks = tst_runSlices(pilot, memory, FALSE);
+	
+	tst_CHECK(pilot->halted);
+	tst_CHECK(pilot->programCounter == tst_CODE_START + 55 * 2);
+#ifdef HEXLET_JIT
+	tst_CHECK(tst_getBlock(pilot, tst_CODE_START + 8 * 2)->nativeCode != NULL);
+#endif
+	memcpy(tst_wram, memory->wram, sizeof(tst_wram));
+	
+	/* the interpreter has to stop at exactly the same points with exactly the same state */
+	tst_CHECK(tst_loadProgram(tst_CODE_START, program, count));
+	tst_CHECK(cpu_setJITEnabled(pilot, FALSE));
+	
+	tst_CHECK(tst_runSlices(pilot, memory, TRUE) == chunks);
+	tst_CHECK(!memcmp(tst_wram, memory->wram, sizeof(tst_wram)));
+	
+	return TRUE;
+}
+
+/*
+*  One ALU instruction to run with lazy and eager flags, and the status register it should leave (or 0 to just compare the two)
+*/
+typedef struct {
+	u16 opcode;
+	u16 destination;
+	u16 source;
+	u16 statusReg;
+	u16 expected;
+} tst_FlagCase;
+
+/*
+*  Run OP W0, W1 with the given case's values, with lazy or eager flags. Return FALSE if the flags weren't handled that way.
+*/
+static bool tst_runFlagCase(const tst_FlagCase *flagCase, bool eager, u32 *result, u16 *status) {
+	u16 program[] = { flagCase->opcode | (tst_RM_REG(0) << 6) | tst_RM_REG(1), tst_HALT };
+	
+	tst_CHECK(tst_loadProgram(tst_CODE_START, program, 2));
+	cpu_Pilot *pilot = cpu_getCurrentPilot();
+	mem_Memory *memory = mem_getCurrentMemory();
+	
+	pilot->regs[0] = flagCase->destination;
+	pilot->regs[1] = flagCase->source;
+	cpu_setStatusReg(pilot, flagCase->statusReg);
+	
+	if (eager) {
+		cpu_runPilotEagerFlags(pilot, memory, 10);
+		tst_CHECK(pilot->lazyFlags.operation == cpu_FLAGS_NONE);
+	}
+	else {
+		cpu_runPilot(pilot, memory, 10);
+		tst_CHECK(pilot->lazyFlags.operation != cpu_FLAGS_NONE);
+	}
+	
+	*result = pilot->regs[0];
+	*status = cpu_getStatusReg(pilot);
+	return TRUE;
+}
+
+bool tst_pilotLazyFlags(void) {
+	static const u16 opcodes[] = { 0x2000, 0x3000, 0x4000, 0x5000, 0x6000, 0x7000 };
+	static const u16 values[] = { 0x0000, 0x0001, 0x7fff, 0x8000, 0x8001, 0xfffe, 0xffff, 0x1234 };
+	static const u16 statuses[] = { 0x0000, 0x07ff };
+	
+	/* the carry and overflow edges, and a logic instruction leaving extend (and the rest of the register) alone */
+	static const tst_FlagCase edges[] = {
+		{ 0x2000, 0x7fff, 0x0001, 0x0000, cpu_FLAG_SIGN | cpu_FLAG_OVERFLOW },
+		{ 0x2000, 0xffff, 0x0001, 0x0000, cpu_FLAG_ZERO | cpu_FLAG_CARRY | cpu_FLAG_EXTEND },
+		{ 0x3000, 0x0000, 0x0001, 0x0000, cpu_FLAG_SIGN | cpu_FLAG_CARRY | cpu_FLAG_EXTEND },
+		{ 0x3000, 0x8000, 0x0001, 0x0000, cpu_FLAG_OVERFLOW },
+		{ 0x5000, 0x8000, 0xffff, 0x07ff, 0x0733 | cpu_FLAG_SIGN },
+	};
+	
+	u32 lazyResult, eagerResult;
+	u16 lazyStatus, eagerStatus;
+	
+	for (u32 i = 0; i < sizeof(edges) / sizeof(tst_FlagCase); i++) {
+		tst_CHECK(tst_runFlagCase(&edges[i], FALSE, &lazyResult, &lazyStatus));
+		tst_CHECK(tst_runFlagCase(&edges[i], TRUE, &eagerResult, &eagerStatus));
+		tst_CHECK(lazyStatus == edges[i].expected);
+		tst_CHECK(eagerStatus == edges[i].expected);
+	}
+	
+	for (u32 op = 0; op < sizeof(opcodes) / sizeof(u16); op++) {
+		for (u32 d = 0; d < sizeof(values) / sizeof(u16); d++) {
+			for (u32 s = 0; s < sizeof(values) / sizeof(u16); s++) {
+				for (u32 st = 0; st < sizeof(statuses) / sizeof(u16); st++) {
+					tst_FlagCase flagCase = { opcodes[op], values[d], values[s], statuses[st], 0 };
+					
+					tst_CHECK(tst_runFlagCase(&flagCase, FALSE, &lazyResult, &lazyStatus));
+					tst_CHECK(tst_runFlagCase(&flagCase, TRUE, &eagerResult, &eagerStatus));
+					tst_CHECK(lazyResult == eagerResult);
+					tst_CHECK(lazyStatus == eagerStatus);
+				}
+			}
+		}
+	}
+	
+	return TRUE;
+}
+
+bool tst_pilotIdleLoops(void) {
+	static const u16 spin[] = { tst_BRA(tst_RM_PGC16), tst_REL(1, 0) };
+	static const u16 store[] = { tst_MOV(tst_RM_INDIRECT(1), tst_RM_REG(0)), tst_BRA(tst_RM_PGC16), tst_REL(2, 0) };
+	static const u16 count[] = { tst_ADD(tst_RM_REG(0), tst_RM_IMM4(1)), tst_BRA(tst_RM_PGC16), tst_REL(2, 0) };
+	static const u16 halt[] = { tst_HALT };
+	
+	mem_Memory *memory = mem_getCurrentMemory();
+	cpu_Pilot *pilot = cpu_getCurrentPilot();
+	
+	/* a loop that changes nothing only has to go around twice before the rest of the budget is skipped */
+	tst_CHECK(tst_loadProgram(tst_CODE_START, spin, 2));
+	tst_CHECK(cpu_runPilot(pilot, memory, 100000) == 100000);
+	tst_CHECK(pilot->skippedCycles > 99000);
+	tst_CHECK(pilot->programCounter == tst_CODE_START);
+	
+	/* storing the same value over and over still counts as doing something (an event could be watching that address) */
+	tst_CHECK(tst_loadProgram(tst_CODE_START, store, 3));
+	pilot->regs[1] = tst_DATA_START;
+	tst_CHECK(cpu_runPilot(pilot, memory, 100000) >= 100000);
+	tst_CHECK(pilot->skippedCycles == 0);
+	
+	tst_CHECK(tst_loadProgram(tst_CODE_START, count, 3));
+	tst_CHECK(cpu_runPilot(pilot, memory, 100000) >= 100000);
+	tst_CHECK(pilot->skippedCycles == 0);
+	tst_CHECK(pilot->regs[0] != 0);
+	
+	tst_CHECK(tst_loadProgram(tst_CODE_START, halt, 1));
+	tst_CHECK(cpu_runPilot(pilot, memory, 5000) == 5000);
+	tst_CHECK(pilot->skippedCycles == 4999);
+	
+	return TRUE;
+}
\ No newline at end of file
@@ -0,0 +1,84 @@
+/* Tests for the rewind buffer */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+#include <hexlet_emulate.h>
+#include <hexlet_loader.h>
+#include <hexlet_rewind.h>
+
+#include "loader.h"
+#include "memory.h"
+#include "pilot.h"
+
+#include "tests.h"
+
+#define tst_STATE_PARTS (ldr_STATE_FILE_FLAG_STORE_WRAM | ldr_STATE_FILE_FLAG_STORE_VRAM | ldr_STATE_FILE_FLAG_STORE_TMRAM | ldr_STATE_FILE_FLAG_STORE_HRAM | ldr_STATE_FILE_FLAG_STORE_CPU)
+
+/* Where the program goes (above the part of WRAM it writes to) */
+#define tst_REWIND_CODE 0x004000
+
+/* Frames to record, and the one to step back to */
+#define tst_REWIND_FRAMES 10
+#define tst_REWIND_TARGET 6
+
+bool tst_rewindStepBack(void) {
+	/* count in W0 and keep storing it across the bottom 16 KiB of WRAM, so every frame changes the state */
+	static const u16 program[] = {
+		tst_MOV(tst_RM_REG(1), tst_RM_IMM16), 0x0100,
+		tst_ADD(tst_RM_REG(0), tst_RM_IMM4(1)),
+		tst_MOV(tst_RM_POST_INCREMENT(1), tst_RM_REG(0)),
+		tst_AND(tst_RM_REG(1), tst_RM_IMM16), 0x3ffe,
+		tst_BRA(tst_RM_PGC16), (u16)((2 - 7) * 2),
+	};
+	
+	tst_CHECK(emu_reset());
+	
+	mem_Memory *memory = mem_getCurrentMemory();
+	for (u32 i = 0; i < sizeof(program) / sizeof(u16); i++) {
+		mem_writeWord(memory, mem_BUS_TYPE_CPU, tst_REWIND_CODE + i * 2, program[i]);
+	}
+	cpu_getCurrentPilot()->programCounter = tst_REWIND_CODE;
+	tst_CHECK(rwd_initRewind(8 * 1024 * 1024, 1, 4));
+	
+	u32 size = ldr_getStateSize(tst_STATE_PARTS);
+	u8 *saved = malloc(size);
+	u8 *restored = malloc(size);
+	tst_CHECK(saved != NULL && restored != NULL);
+	
+	u64 savedCycles = 0;
+	for (u32 frame = 1; frame <= tst_REWIND_FRAMES; frame++) {
+		tst_CHECK(emu_tick());
+		tst_CHECK(rwd_captureFrame());
+		
+		if (frame == tst_REWIND_TARGET) {
+			tst_CHECK(ldr_saveState(saved, size, tst_STATE_PARTS));
+			savedCycles = emu_getCycles();
+		}
+	}
+	
+	/* the frames only differ if the program is running */
+	tst_CHECK(cpu_getCurrentPilot()->regs[0] != 0);
+	
+	/* the newest state is the last frame's, so it takes one more step than the frames in between */
+	for (u32 step = 0; step < tst_REWIND_FRAMES - tst_REWIND_TARGET + 1; step++) {
+		tst_CHECK(rwd_stepBack());
+	}
+	
+	tst_CHECK(emu_getCycles() == savedCycles);
+	tst_CHECK(ldr_saveState(restored, size, tst_STATE_PARTS));
+	tst_CHECK(!memcmp(saved + ldr_STATE_HEADER_SIZE, restored + ldr_STATE_HEADER_SIZE, size - ldr_STATE_HEADER_SIZE));
+	
+	/* and the frames before it are still there */
+	for (u32 step = 0; step < tst_REWIND_TARGET - 1; step++) {
+		tst_CHECK(rwd_stepBack());
+	}
+	tst_CHECK(!rwd_stepBack());
+	
+	rwd_freeRewind();
+	free(restored);
+	free(saved);
+	return TRUE;
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+/* Header file for Hexlet's unit tests */
+
+#ifndef HEXLET_TESTS_H
+#define HEXLET_TESTS_H
+
+#include <stdio.h>
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+
+/*
+*  Fail the test (with the file, line and condition) if the condition doesn't hold.
+*/
+#define tst_CHECK(condition) do { \
+	if (!(condition)) { \
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+		return FALSE; \
+	} \
+} while (0)
+
+/* RM fields for hand-assembled programs (see cpu_decodeRMOperand()) */
+#define tst_RM_REG(n)			((n) << 2)
+#define tst_RM_POST_INCREMENT(n)	(0x20 | ((n) << 2))
+#define tst_RM_INDIRECT(n)		(0x02 | ((n) << 2))
+#define tst_RM_IMM4(value)		(0x03 | ((value) << 2))
+#define tst_RM_IMM16			0x21	/* followed by the value */
+#define tst_RM_PGC16			0x31	/* followed by the target's offset from this extension word */
+
+/* Opcode words: a two-operand instruction has its destination's RM field in bits 6-11 and its source's in bits 0-5 */
+#define tst_NOP				0x0000
+#define tst_HALT			0x0001
+#define tst_MOV(destination, source)	(0x1000 | ((destination) << 6) | (source))
+#define tst_ADD(destination, source)	(0x2000 | ((destination) << 6) | (source))
+#define tst_SUB(destination, source)	(0x3000 | ((destination) << 6) | (source))
+#define tst_CMP(destination, source)	(0x4000 | ((destination) << 6) | (source))
+#define tst_AND(destination, source)	(0x5000 | ((destination) << 6) | (source))
+#define tst_OR(destination, source)	(0x6000 | ((destination) << 6) | (source))
+#define tst_XOR(destination, source)	(0x7000 | ((destination) << 6) | (source))
+#define tst_BRA(target)			(0x8000 | (target))
+#define tst_BEQ(target)			(0x8040 | (target))
+#define tst_BNE(target)			(0x8080 | (target))
+#define tst_BCS(target)			(0x80c0 | (target))
+#define tst_BCC(target)			(0x8100 | (target))
+#define tst_BMI(target)			(0x8140 | (target))
+#define tst_BPL(target)			(0x8180 | (target))
+#define tst_BVS(target)			(0x81c0 | (target))
+#define tst_BVC(target)			(0x8200 | (target))
+
+/* The stub driver's screen (one intensity per byte) and how many pixels have been plotted on it */
+extern u8 tst_screen[256][256];
+extern u32 tst_plotCount;
+
+/*
+*  Reset the CPU, the memory map and RAM, write a program into RAM at the given address (through the CPU's bus), and point the CPU at it.
+*  Return FALSE on failure or TRUE on success.
+*/
+bool tst_loadProgram(u32 address, const u16 *words, u32 count);
+
+/*
+*  Build a 64-KiB ROM image with the given code at its start (so it's mapped at $FF0000) and load it.
+*  Return the image, which stays valid until the next call, or NULL on failure.
+*/
+u8 *tst_loadROM(const u16 *words, u32 count, u32 *length);
+
+/* pilot.c */
+bool tst_pilotBlockSplit(void);
+bool tst_pilotBootROM(void);
+bool tst_pilotWRAMInvalidation(void);
+bool tst_pilotISA(void);
+bool tst_pilotJIT(void);
+bool tst_pilotLazyFlags(void);
+bool tst_pilotIdleLoops(void);
+
+/* memory.c */
+bool tst_memoryHandlers(void);
+
+/* trace.c */
+bool tst_traceRoundTrip(void);
+
+/* loader.c */
+bool tst_loaderSnapshot(void);
+bool tst_loaderROMImage(void);
+bool tst_loaderROMSize(void);
+
+/* rewind.c */
+bool tst_rewindStepBack(void);
+
+/* graphics.c */
+bool tst_graphicsSpans(void);
+
+/* assembler.c */
+bool tst_assemblerRoundTrip(void);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,98 @@
+/* Tests for the bus trace recorder and decoder */
+
+#include <string.h>
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+#include <hexlet_memory.h>
+
+#include "trace.h"
+
+#include "tests.h"
+
+/*
+*  Records around every varint length boundary: cycle gaps of 7, 14 and 63 bits and more, a cycle going backwards,
+*  and addresses wrapping around the top of the 24-bit space in both directions
+*/
+static const mem_Transaction tst_records[] = {
+	{ 0x0000000000000000, 0x000000, 0x0012, mem_BUS_TYPE_CPU, FALSE, FALSE },
+	{ 0x0000000000000001, 0xffffff, 0x3456, mem_BUS_TYPE_PPU, TRUE, TRUE },
+	{ 0x0000000000000001, 0x000001, 0x0078, mem_BUS_TYPE_HEXRIDGE, TRUE, FALSE },
+	{ 0x0000000000000080, 0xfffffe, 0x9abc, mem_BUS_TYPE_CPU, FALSE, TRUE },
+	{ 0x0000000000004080, 0x00003e, 0x00de, mem_BUS_TYPE_CPU, TRUE, FALSE },
+	{ 0x0000000000008000, 0x00007e, 0xf00d, mem_BUS_TYPE_PPU, FALSE, TRUE },
+	{ 0x0000000100000000, 0x00003e, 0x0001, mem_BUS_TYPE_CPU, FALSE, FALSE },
+	{ 0x00000000ffffffff, 0x00007f, 0x0002, mem_BUS_TYPE_CPU, TRUE, FALSE },
+	{ 0x8000000000000000, 0x00003d, 0xffff, mem_BUS_TYPE_HEXRIDGE, FALSE, TRUE },
+	{ 0xffffffffffffffff, 0x800000, 0x00ff, mem_BUS_TYPE_CPU, TRUE, FALSE },
+	{ 0x0000000000000000, 0x7fffff, 0x0000, mem_BUS_TYPE_PPU, FALSE, TRUE },
+};
+
+#define tst_RECORD_COUNT (sizeof(tst_records) / sizeof(mem_Transaction))
+
+bool tst_traceRoundTrip(void) {
+	static u8 trace[trc_HEADER_SIZE + tst_RECORD_COUNT * trc_MAX_ENCODED_SIZE];
+	size_t size = 0;
+	
+	trc_Ring ring;
+	tst_CHECK(trc_initRing(&ring, 4));
+	
+	for (u32 i = 0; i < tst_RECORD_COUNT; i++) {
+		const mem_Transaction *record = &tst_records[i];
+		trc_push(&ring, record->cycle, record->bus, record->address, record->data, record->write, record->word);
+	}
+	tst_CHECK(ring.overruns == 0);
+	
+	/* drain into the smallest buffer that always fits a record, so the deltas have to carry over between calls */
+	size_t drained;
+	do {
+		drained = trc_drain(&ring, trace + size, trc_HEADER_SIZE + trc_MAX_ENCODED_SIZE);
+		size += drained;
+	} while (drained);
+	trc_freeRing(&ring);
+	
+	size_t offset = mem_checkTraceHeader(trace, size);
+	tst_CHECK(offset == trc_HEADER_SIZE);
+	
+	mem_TraceDecoder decoder;
+	mem_initTraceDecoder(&decoder);
+	
+	mem_TraceDecoder lastDecoder = decoder;
+	size_t lastLength = 0;
+	for (u32 i = 0; i < tst_RECORD_COUNT; i++) {
+		lastDecoder = decoder;
+		
+		mem_Transaction transaction;
+		size_t length = mem_decodeTrace(&decoder, trace + offset, size - offset, &transaction);
+		tst_CHECK(length);
+		
+		const mem_Transaction *record = &tst_records[i];
+		tst_CHECK(transaction.cycle == record->cycle);
+		tst_CHECK(transaction.address == record->address);
+		tst_CHECK(transaction.data == record->data);
+		tst_CHECK(transaction.bus == record->bus);
+		tst_CHECK(transaction.write == record->write);
+		tst_CHECK(transaction.word == record->word);
+		
+		offset += length;
+		lastLength = length;
+	}
+	tst_CHECK(offset == size);
+	
+	/* a record cut off at any point decodes to nothing */
+	for (size_t cut = 0; cut < lastLength; cut++) {
+		mem_TraceDecoder copy = lastDecoder;
+		mem_Transaction transaction;
+		tst_CHECK(mem_decodeTrace(&copy, trace + size - lastLength, cut, &transaction) == 0);
+	}
+	
+	/* a full ring drops records instead of overwriting them */
+	tst_CHECK(trc_initRing(&ring, 2));
+	for (u32 i = 0; i < 6; i++) {
+		trc_push(&ring, i, mem_BUS_TYPE_CPU, i, 0, FALSE, FALSE);
+	}
+	tst_CHECK(ring.overruns == 2);
+	trc_freeRing(&ring);
+	
+	return TRUE;
+}
\ No newline at end of file
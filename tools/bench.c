@@ -0,0 +1,211 @@
+/* Core benchmarks: lazy against eager flags over an ALU-heavy loop, and the bus accessors against the page table they sit on */
+
+#if defined(__unix__) || defined(__APPLE__)
+#define _DEFAULT_SOURCE	/* for clock_gettime() */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+#include <hexlet_driver.h>
+#include <hexlet_memory.h>
+
+#include "memory.h"
+#include "pilot.h"
+
+/* Default cycles to run the ALU loop for, and passes to make over the bus workload */
+#define bch_DEFAULT_CYCLES 100000000
+#define bch_DEFAULT_PASSES 2000
+
+/* The bus workload reads the bottom 16 KiB of WRAM and read-modify-writes VRAM with it */
+#define bch_COPY_SIZE 0x4000
+#define bch_CODE_START 0x004000
+
+void *drv_reallocate(void *oldPtr, size_t oldSize, size_t newSize) {
+	(void)oldSize;
+	
+	if (newSize == 0) {
+		free(oldPtr);
+		return NULL;
+	}
+	
+	return realloc(oldPtr, newSize);
+}
+
+/*
+*  Seconds from a monotonic clock (clock() counts CPU time, which isn't what a benchmark wants either).
+*/
+static double bch_getSeconds(void) {
+#if defined(__unix__) || defined(__APPLE__)
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+#else
+	return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+/*
+*  Run the ALU loop for the given number of cycles with lazy or eager flags, print how fast it went, and return the seconds taken.
+*/
+static double bch_runALU(u64 cycles, bool eager) {
+	/* a loop that's all ALU instructions and one branch, so the flags are nearly all the interpreter does */
+	static const u16 program[] = {
+		0x1000 | (0x00 << 6) | 0x21, 0x1234,	/* MOV W0, #$1234 */
+		0x1000 | (0x04 << 6) | 0x21, 0x5678,	/* MOV W1, #$5678 */
+		0x2000 | (0x00 << 6) | 0x04,		/* loop: ADD W0, W1 */
+		0x7000 | (0x04 << 6) | 0x00,		/* XOR W1, W0 */
+		0x3000 | (0x08 << 6) | 0x07,		/* SUB W2, #1 */
+		0x5000 | (0x00 << 6) | 0x21, 0x7fff,	/* AND W0, #$7FFF */
+		0x6000 | (0x0c << 6) | 0x04,		/* OR W3, W1 */
+		0x4000 | (0x00 << 6) | 0x04,		/* CMP W0, W1 */
+		0x2000 | (0x04 << 6) | 0x0f,		/* ADD W1, #3 */
+		0x8000 | 0x31, (u16)((4 - 13) * 2),	/* BRA loop */
+	};
+	
+	cpu_Pilot *pilot = cpu_getCurrentPilot();
+	mem_Memory *memory = mem_getCurrentMemory();
+	
+	mem_initMemory(memory);
+	if (!cpu_initPilot(pilot)) return -1.0;
+	
+	for (u32 i = 0; i < sizeof(program) / sizeof(u16); i++) {
+		mem_writeWord(memory, mem_BUS_TYPE_CPU, bch_CODE_START + i * 2, program[i]);
+	}
+	for (u8 i = 0; i < 8; i++) pilot->regs[i] = 0;
+	cpu_setStatusReg(pilot, 0x0000);
+	pilot->programCounter = bch_CODE_START;
+	
+	double start = bch_getSeconds();
+	for (u64 run = 0; run < cycles; run += 1000000) {
+		if (eager) cpu_runPilotEagerFlags(pilot, memory, 1000000);
+		else cpu_runPilot(pilot, memory, 1000000);
+	}
+	double seconds = bch_getSeconds() - start;
+	
+	printf("%-12s %.3f s: %.1f MHz emulated (W0 = $%06X, SR = $%04X)\n", eager ? "eager flags" : "lazy flags", seconds, pilot->cycles / seconds / 1e6, pilot->regs[0], cpu_getStatusReg(pilot));
+	
+	cpu_freePilot(pilot);
+	return seconds;
+}
+
+/*
+*  The baseline: the bus workload written straight against the page table, with nothing between it and RAM.
+*  Pages without a host pointer (protected VRAM, or WRAM on a big-endian host) fall back on the accessors.
+*/
+static u32 bch_copyDirect(mem_Memory *memory, u32 pass) {
+	u32 sum = 0;
+	
+	for (u32 offset = 0; offset < bch_COPY_SIZE; offset += 2) {
+		u32 source = mem_WRAM_START + offset;
+		u32 destination = mem_VRAM_START + offset;
+		
+		mem_Page *page = &memory->banks[source >> 16][(source >> 8) & 0xff];
+		u16 value = page->read ? page->read[source] | (page->read[source + 1] << 8) : mem_readWord(memory, mem_BUS_TYPE_CPU, source);
+		
+		page = &memory->banks[destination >> 16][(destination >> 8) & 0xff];
+		u16 old = page->read ? page->read[destination] | (page->read[destination + 1] << 8) : mem_readWord(memory, mem_BUS_TYPE_CPU, destination);
+		u16 result = (u16)(old + (value ^ pass));
+		
+		if (page->write) {
+			page->write[destination] = (u8)result;
+			page->write[destination + 1] = (u8)(result >> 8);
+		}
+		else {
+			mem_writeWord(memory, mem_BUS_TYPE_CPU, destination, result);
+		}
+		sum += result;
+	}
+	
+	return sum;
+}
+
+/*
+*  The same workload through the accessors, which are the monitored set or the unmonitored one depending on mem_monitorBuses().
+*/
+static u32 bch_copyAccessors(mem_Memory *memory, u32 pass) {
+	u32 sum = 0;
+	
+	for (u32 offset = 0; offset < bch_COPY_SIZE; offset += 2) {
+		u16 value = mem_readWord(memory, mem_BUS_TYPE_CPU, mem_WRAM_START + offset);
+		u16 old = mem_readWord(memory, mem_BUS_TYPE_CPU, mem_VRAM_START + offset);
+		u16 result = (u16)(old + (value ^ pass));
+		
+		mem_writeWord(memory, mem_BUS_TYPE_CPU, mem_VRAM_START + offset, result);
+		sum += result;
+	}
+	
+	return sum;
+}
+
+/*
+*  Run the bus workload for the given number of passes, print how fast it went, and return the seconds taken.
+*/
+static double bch_runBus(u32 passes, u32 (*copy)(mem_Memory *memory, u32 pass), char *label) {
+	mem_Memory *memory = mem_getCurrentMemory();
+	
+	mem_initMemory(memory);
+	for (u32 offset = 0; offset < bch_COPY_SIZE; offset += 2) {
+		mem_writeWord(memory, mem_BUS_TYPE_CPU, mem_WRAM_START + offset, (u16)(offset * 0x9e37));
+		mem_writeWord(memory, mem_BUS_TYPE_CPU, mem_VRAM_START + offset, 0x0000);
+	}
+	
+	/* the sum keeps the compiler from dropping the work, and shows that every version did the same work */
+	u32 sum = 0;
+	double start = bch_getSeconds();
+	for (u32 pass = 0; pass < passes; pass++) {
+		sum += copy(memory, pass);
+	}
+	double seconds = bch_getSeconds() - start;
+	
+	u64 accesses = (u64)passes * (bch_COPY_SIZE / 2) * 3;
+	printf("%-12s %.3f s: %.2f ns per access (sum $%08X)\n", label, seconds, seconds * 1e9 / accesses, sum);
+	return seconds;
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2 || argc > 3 || (strcmp(argv[1], "alu") && strcmp(argv[1], "bus"))) {
+		fprintf(stderr, "Usage: %s alu [cycles] | bus [passes]\n", argv[0]);
+		return -1;
+	}
+	bool alu = !strcmp(argv[1], "alu");
+	
+	u64 count = alu ? bch_DEFAULT_CYCLES : bch_DEFAULT_PASSES;
+	if (argc == 3) {
+		char *end;
+		count = strtoull(argv[2], &end, 0);
+		if (*end != '\0' || count == 0 || (!alu && count > 0xffffffff)) {
+			fprintf(stderr, "Error: Invalid count.\n");
+			return -1;
+		}
+	}
+	
+	if (alu) {
+		double lazy = bch_runALU(count, FALSE);
+		double eager = bch_runALU(count, TRUE);
+		if (lazy < 0.0 || eager < 0.0) {
+			fprintf(stderr, "Error: Couldn't set up the CPU.\n");
+			return -1;
+		}
+		
+		printf("Lazy flags take %.1f%% less time.\n", 100.0 * (1.0 - lazy / eager));
+	}
+	else {
+		double direct = bch_runBus((u32)count, bch_copyDirect, "page table");
+		
+		mem_monitorBuses(0);
+		double unmonitored = bch_runBus((u32)count, bch_copyAccessors, "unmonitored");
+		
+		mem_monitorBuses(mem_BUS_TYPE_CPU | mem_BUS_TYPE_PPU | mem_BUS_TYPE_HEXRIDGE);
+		double monitored = bch_runBus((u32)count, bch_copyAccessors, "monitored");
+		mem_monitorBuses(0);
+		
+		printf("The accessors cost %.1f%% over the page table, and monitoring %.1f%% more.\n", 100.0 * (unmonitored / direct - 1.0), 100.0 * (monitored / unmonitored - 1.0));
+	}
+	
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,139 @@
+/* Build-time generator for the assembler's mnemonic table: a perfect hash of every mnemonic and directive in src/instructions.def */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+
+#include "mnemonics.h"
+
+/* Give up on a table size after this many seeds, and try one twice as big */
+#define gen_SEEDS_PER_SIZE 0x100000
+#define gen_MAX_SLOT_BITS 12
+
+typedef struct {
+	const char *name;
+	asm_MnemonicType type;
+	const char *handler;
+	u16 opcode;
+	u8 operandCount;
+	u8 rmShift[2];
+} gen_Key;
+
+static const gen_Key gen_keys[] = {
+#define INSTRUCTION(name, opcode, mask, operandCount, cycles, rmShift0, rmShift1) \
+	{ #name, asm_MNEMONIC_INSTRUCTION, NULL, opcode, operandCount, { rmShift0, rmShift1 } },
+#define DIRECTIVE(name) \
+	{ "." #name, asm_MNEMONIC_DIRECTIVE, #name, 0, 0, { 0, 0 } },
+#include "instructions.def"
+#undef INSTRUCTION
+#undef DIRECTIVE
+};
+
+#define gen_KEY_COUNT (sizeof(gen_keys) / sizeof(gen_Key))
+
+static s32 gen_slots[1 << gen_MAX_SLOT_BITS];
+static u8 gen_handlers[gen_KEY_COUNT];
+
+/*
+*  Try to put every key in its own slot with the given seed. Return FALSE if two of them collide or TRUE if they don't.
+*/
+static bool gen_trySeed(u32 seed, u32 slotCount) {
+	for (u32 i = 0; i < slotCount; i++) {
+		gen_slots[i] = -1;
+	}
+	
+	for (u32 i = 0; i < gen_KEY_COUNT; i++) {
+		u32 slot = asm_hashMnemonic(gen_keys[i].name, strlen(gen_keys[i].name), seed) & (slotCount - 1);
+		if (gen_slots[slot] >= 0) return FALSE;
+		
+		gen_slots[slot] = (s32)i;
+	}
+	
+	return TRUE;
+}
+
+static bool gen_writeTable(FILE *file, u32 seed, u32 slotBits) {
+	fprintf(file, "/* Generated from src/instructions.def by tools/mnemonics.c at build time, so don't edit it */\n\n");
+	fprintf(file, "#ifndef HEXLET_MNEMONIC_TABLE_H_INTERNAL\n#define HEXLET_MNEMONIC_TABLE_H_INTERNAL\n\n");
+	fprintf(file, "/* this goes after mnemonics.h, which has asm_Mnemonic */\n\n");
+	
+	for (u32 i = 0; i < gen_KEY_COUNT; i++) {
+		if (gen_keys[i].type == asm_MNEMONIC_DIRECTIVE) {
+			fprintf(file, "#define asm_DIRECTIVE_%s %u\n", gen_keys[i].handler, gen_handlers[i]);
+		}
+	}
+	
+	fprintf(file, "\n#define asm_MNEMONIC_SEED 0x%08xu\n", seed);
+	fprintf(file, "#define asm_MNEMONIC_SLOTS %u\n\n", 1u << slotBits);
+	fprintf(file, "static const asm_Mnemonic asm_mnemonicTable[asm_MNEMONIC_SLOTS] = {\n");
+	
+	for (u32 slot = 0; slot < (1u << slotBits); slot++) {
+		if (gen_slots[slot] < 0) {
+			fprintf(file, "\t{ NULL, 0, 0, 0, 0x0000, 0, { 0, 0 } },\n");
+			continue;
+		}
+		
+		const gen_Key *key = &gen_keys[gen_slots[slot]];
+		
+		fprintf(file, "\t{ \"%s\", %u, %s, %u, 0x%04x, %u, { %u, %u } },\n",
+			key->name, (u32)strlen(key->name),
+			key->type == asm_MNEMONIC_DIRECTIVE ? "asm_MNEMONIC_DIRECTIVE" : "asm_MNEMONIC_INSTRUCTION",
+			gen_handlers[gen_slots[slot]],
+			key->opcode, key->operandCount, key->rmShift[0], key->rmShift[1]
+		);
+	}
+	
+	fprintf(file, "};\n\n#endif\n");
+	return !ferror(file);
+}
+
+int main(int argc, char **argv) {
+	if (argc != 2) {
+		fprintf(stderr, "Usage: %s <output header>\n", argv[0]);
+		return -1;
+	}
+	
+	/* directives get numbered in the order they're described, and two names the same would never get their own slots */
+	u8 directives = 0;
+	for (u32 i = 0; i < gen_KEY_COUNT; i++) {
+		if (gen_keys[i].type == asm_MNEMONIC_DIRECTIVE) gen_handlers[i] = directives++;
+		
+		for (u32 j = 0; j < i; j++) {
+			if (!strcasecmp(gen_keys[i].name, gen_keys[j].name)) {
+				fprintf(stderr, "Error: '%s' is described twice.\n", gen_keys[i].name);
+				return -1;
+			}
+		}
+	}
+	
+	/* the table starts at least twice as big as the key count, which keeps the seed search short */
+	u32 slotBits = 1;
+	while ((1u << slotBits) < gen_KEY_COUNT * 2) slotBits++;
+	
+	for (; slotBits <= gen_MAX_SLOT_BITS; slotBits++) {
+		for (u32 seed = 0; seed < gen_SEEDS_PER_SIZE; seed++) {
+			if (!gen_trySeed(seed, 1u << slotBits)) continue;
+			
+			FILE *file = fopen(argv[1], "w");
+			if (file == NULL) {
+				fprintf(stderr, "Error: Couldn't open '%s' for writing.\n", argv[1]);
+				return -1;
+			}
+			
+			bool written = gen_writeTable(file, seed, slotBits);
+			if (fclose(file) != 0 || !written) {
+				fprintf(stderr, "Error: Couldn't write '%s'.\n", argv[1]);
+				return -1;
+			}
+			
+			return 0;
+		}
+	}
+	
+	fprintf(stderr, "Error: No seed gives every mnemonic its own slot.\n");
+	return -1;
+}
\ No newline at end of file
@@ -0,0 +1,96 @@
+/* Bus trace dumper: prints every transaction in a trace file recorded with the SDL3 driver's --trace */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <hexlet_ints.h>
+#include <hexlet_bools.h>
+#include <hexlet_driver.h>
+#include <hexlet_memory.h>
+
+/* trace.c allocates its ring through the driver, but the decoder never does */
+void *drv_reallocate(void *oldPtr, size_t oldSize, size_t newSize) {
+	(void)oldSize;
+	
+	if (newSize == 0) {
+		free(oldPtr);
+		return NULL;
+	}
+	
+	return realloc(oldPtr, newSize);
+}
+
+/*
+*  Read a whole file into memory. Return NULL on failure.
+*/
+static u8 *dmp_loadFile(char *path, size_t *size) {
+	FILE *file = fopen(path, "rb");
+	if (file == NULL) {
+		return NULL;
+	}
+	
+	u8 *data = NULL;
+	if (!fseek(file, 0, SEEK_END)) {
+		long length = ftell(file);
+		
+		if (length >= 0 && !fseek(file, 0, SEEK_SET)) {
+			/* one spare byte so an empty file still gets a buffer */
+			data = malloc((size_t)length + 1);
+			
+			if (data != NULL && fread(data, 1, (size_t)length, file) != (size_t)length) {
+				free(data);
+				data = NULL;
+			}
+			*size = (size_t)length;
+		}
+	}
+	
+	fclose(file);
+	return data;
+}
+
+int main(int argc, char **argv) {
+	if (argc != 2) {
+		fprintf(stderr, "Usage: %s <trace file>\n", argv[0]);
+		return -1;
+	}
+	
+	size_t size;
+	u8 *data = dmp_loadFile(argv[1], &size);
+	if (data == NULL) {
+		fprintf(stderr, "Error: Couldn't read '%s'.\n", argv[1]);
+		return -1;
+	}
+	
+	size_t offset = mem_checkTraceHeader(data, size);
+	if (!offset) {
+		fprintf(stderr, "Error: '%s' isn't a bus trace.\n", argv[1]);
+		free(data);
+		return -1;
+	}
+	
+	mem_TraceDecoder decoder;
+	mem_Transaction transaction;
+	mem_initTraceDecoder(&decoder);
+	
+	while (offset < size) {
+		size_t length = mem_decodeTrace(&decoder, data + offset, size - offset, &transaction);
+		if (!length) break;
+		offset += length;
+		
+		char *bus = "CPU";
+		if (transaction.bus == mem_BUS_TYPE_PPU) bus = "PPU";
+		else if (transaction.bus == mem_BUS_TYPE_HEXRIDGE) bus = "HXR";
+		
+		printf("%12llu %s %c $%06X $%0*X\n", (unsigned long long)transaction.cycle, bus, transaction.write ? 'W' : 'R', transaction.address, transaction.word ? 4 : 2, transaction.data);
+	}
+	
+	free(data);
+	
+	if (offset != size) {
+		fprintf(stderr, "Error: '%s' ends partway through a transaction.\n", argv[1]);
+		return -1;
+	}
+	
+	return 0;
+}
\ No newline at end of file